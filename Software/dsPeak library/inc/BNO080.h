@@ -1,5 +1,9 @@
+#ifndef __BNO080_H_
+#define __BNO080_H_
+
 #include "dsPeak_generic.h"
 #include "i2c.h"
+#include "spi.h"
 
 // The default I2C address for the BNO08X on the Smart DOF click is 0x94 (7b))
 // It can be changed to 0x96 using an on-board solderable jumper
@@ -8,6 +12,7 @@
 #define BNO08X_QTY              1
 #define BNO08X_1                0
 #define SHTP_MAX_CARGO          32766   // Includes header bytes (4x bytes) -> data max is 32762
+#define BNO08X_TX_CARGO_LENGTH  256     // Address byte + SHTP header + cargo of a write
 #define BNO08X_SENSOR_CHANNELS  6       // 6 channels supported by BNO08X
 
 #define BNO08X_MKB1         0
@@ -17,6 +22,10 @@
 #define BNO08X_MKB2_INT     1
 #define BNO08X_MKB2_RST     1
 
+#define BNO08X_TRANSPORT_I2C    0       // I2C_1, 400kHz
+#define BNO08X_TRANSPORT_SPI    1       // SPI_4, 2.9MHz, MikroBus AN pin is PS0 / WAKE
+#define BNO08X_TX_TIMEOUT_US    I2C_TIMEOUT_US  // SPI write waiting for INTn, as a stuck I2C write
+
 // BNO08X sensor IDs
 #define BNO08X_SENSOR_ID_ACCEL          0x01
 #define BNO08X_SENSOR_ID_GYRO           0x02
@@ -24,6 +33,42 @@
 #define BNO08X_SENSOR_ID_ACCEL_LIN      0x04
 #define BNO08X_SENSOR_ID_GYRO_ROT_VECT  0x05
 #define BNO08X_SENSOR_ID_GRAVITY        0x06
+#define BNO08X_SENSOR_ID_GYRO_UNCAL     0x07
+#define BNO08X_SENSOR_ID_GAME_ROT_VECT  0x08
+#define BNO08X_SENSOR_ID_GEOMAG_ROT_VECT 0x09
+#define BNO08X_SENSOR_ID_PRESSURE       0x0A
+#define BNO08X_SENSOR_ID_AMBIENT_LIGHT  0x0B
+#define BNO08X_SENSOR_ID_HUMIDITY       0x0C
+#define BNO08X_SENSOR_ID_PROXIMITY      0x0D
+#define BNO08X_SENSOR_ID_TEMPERATURE    0x0E
+#define BNO08X_SENSOR_ID_MAGNETO_UNCAL  0x0F
+#define BNO08X_SENSOR_ID_TAP            0x10
+#define BNO08X_SENSOR_ID_STEP_COUNTER   0x11
+#define BNO08X_SENSOR_ID_SIG_MOTION     0x12
+#define BNO08X_SENSOR_ID_STABILITY_CLS  0x13
+#define BNO08X_SENSOR_ID_RAW_ACCEL      0x14
+#define BNO08X_SENSOR_ID_RAW_GYRO       0x15
+#define BNO08X_SENSOR_ID_RAW_MAGNETO    0x16
+#define BNO08X_SENSOR_ID_STEP_DETECTOR  0x18
+#define BNO08X_SENSOR_ID_SHAKE          0x19
+#define BNO08X_SENSOR_ID_FLIP           0x1A
+#define BNO08X_SENSOR_ID_PICKUP         0x1B
+#define BNO08X_SENSOR_ID_STABILITY_DET  0x1C
+#define BNO08X_SENSOR_ID_ACTIVITY_CLS   0x1E
+#define BNO08X_SENSOR_ID_SLEEP          0x1F
+#define BNO08X_SENSOR_ID_TILT           0x20
+#define BNO08X_SENSOR_ID_POCKET         0x21
+#define BNO08X_SENSOR_ID_CIRCLE         0x22
+#define BNO08X_SENSOR_ID_HEART_RATE     0x23
+#define BNO08X_SENSOR_ID_ARVR_ROT_VECT  0x28
+#define BNO08X_SENSOR_ID_ARVR_GAME_RV   0x29
+#define BNO08X_SENSOR_ID_GYRO_INT_RV    0x2A    // Channel 5, reports carry no header
+#define BNO08X_SENSOR_ID_IZRO_REQUEST   0x2B
+#define BNO08X_SENSOR_ID_QTY            0x2C
+
+// BNO08X sensor report channel special records
+#define BNO08X_REPORT_TIMESTAMP_REBASE  0xFA    // 32-bit rebase delta, 100us units
+#define BNO08X_REPORT_BASE_TIMESTAMP    0xFB    // 32-bit base delta, 100us units
 
 // BNO08X cargo channel defines
 #define BNO08X_CHANNEL0_SHTP    0
@@ -33,6 +78,60 @@
 #define BNO08X_CHANNEL4_WISR    4
 #define BNO08X_CHANNEL5_GYRVEC  5
 
+// BNO08X SHTP parser
+#define BNO08X_SHTP_HEADER_LENGTH   4
+#define BNO08X_REPORT_MAX_LENGTH    17      // Longest report, get feature response
+#define BNO08X_REPORT_MAX_VALUES    7       // 16-bit fields decoded per report
+#define BNO08X_GYRO_INT_RV_LENGTH   14
+#define BNO08X_REPORT_ANY           0x00    // Handler id receiving every report
+#define BNO08X_HANDLER_QTY          8
+
+#define BNO08X_ERROR_SEQUENCE       0       // Cargo sequence number skipped on a channel
+#define BNO08X_ERROR_UNKNOWN        1       // Unknown report ID, rest of the cargo dropped
+#define BNO08X_ERROR_TRUNCATED      2       // Cargo ended in the middle of a report
+#define BNO08X_ERROR_BUS            3       // Interrupt-driven read aborted on the I2C bus, SPI write timeout
+#define BNO08X_ERROR_QTY            4
+
+// Timestamped sensor report FIFO, filled when the reports are dispatched
+#define BNO08X_FIFO_SIZE            32      // Must be a power of 2, holds a full batch cargo
+#define BNO08X_FIFO_MASK            (BNO08X_FIFO_SIZE - 1)
+
+// BNO08X interrupt-driven read, started by the INTn line, chained by I2C completion
+#define BNO08X_RX_BUF_LENGTH        256     // Longer cargos are read in continuation fragments
+#define BNO08X_RX_IDLE              0
+#define BNO08X_RX_HEADER            1       // Reading the 4-byte SHTP header
+#define BNO08X_RX_CARGO             2       // Reading header + cargo
+
+#define BNO08X_READ_HEADER_FIRST    0       // Header read, then header + cargo read
+#define BNO08X_READ_SINGLE          1       // Header + expected cargo in one read, remainder read if larger
+
+#define BNO08X_RX_STAT_TRANSACTIONS 0       // I2C reads issued by the interrupt-driven path
+#define BNO08X_RX_STAT_BYTES        1       // Bus bytes of these reads, address included
+#define BNO08X_RX_STAT_QTY          2
+
+// BNO08X set feature command, SH-2 reference manual 6.5.4
+#define BNO08X_SET_FEATURE_LENGTH           17
+#define BNO08X_FEATURE_FLAG_SENS_RELATIVE   0x01    // Change sensitivity is relative
+#define BNO08X_FEATURE_FLAG_SENS_ENABLE     0x02    // Report only on a change larger than the sensitivity
+#define BNO08X_FEATURE_FLAG_WAKEUP          0x04    // Report even when the host is asleep
+#define BNO08X_FEATURE_FLAG_ALWAYS_ON       0x08
+#define BNO08X_FEATURE_QTY                  8       // Sensor reports tracked at once
+#define BNO08X_FEATURE_NONE                 0
+#define BNO08X_FEATURE_PENDING              1       // Set feature sent, no get feature response yet
+#define BNO08X_FEATURE_CONFIRMED            2
+
+// BNO08X report fixed-point Q-points, SH-2 reference manual
+#define BNO08X_Q_ACCEL              8       // Accelerometer, linear acceleration, gravity (m/s^2)
+#define BNO08X_Q_GYRO               9       // Calibrated / uncalibrated gyroscope (rad/s)
+#define BNO08X_Q_MAGNETO            4       // Calibrated / uncalibrated magnetometer (uT)
+#define BNO08X_Q_ROT_VECT           14      // Rotation vector quaternions
+#define BNO08X_Q_ROT_ACCURACY       12      // Rotation vector heading accuracy estimate (rad)
+#define BNO08X_Q_GYRO_INT_VEL       10      // Gyro-integrated rotation vector angular velocity (rad/s)
+#define BNO08X_Q_VECTOR             16      // Decoded vectors are Q16.16
+
+// Euler angles are 16-bit binary angles, -32768..32767 = -180..+179.995 deg
+#define BNO08X_ANGLE_DEG(a)         ((int16_t)(((int32_t)(a) * 32768L) / 180))
+
 // BNO08X SHTP channel defines
 #define BNO08X_SHTP_ADVERTISE_HOST  0
 #define BNO08X_SHTP_ADVERTISE_HUB   1
@@ -44,6 +143,7 @@
 #define BNO08X_EXEC_RD_RESET        1
 
 // BNO08X Sensor hub channel supported commands
+#define BNO08X_SHCC_FLUSH_COMPLETED 0xEF
 #define BNO08X_SHCC_COM_RES         0xF1
 #define BNO08X_SHCC_COM_REQ         0xF2
 #define BNO08X_SHCC_FRS_RD_RES      0xF3
@@ -59,12 +159,87 @@
 
 typedef struct
 {
+    uint8_t id;                                     // Report ID, BNO08X_SENSOR_ID_x or BNO08X_SHCC_x
+    uint8_t channel;
+    uint8_t sequence;                               // Report sequence number (sensor reports)
+    uint8_t status;                                 // Accuracy, bits 1:0 (sensor reports)
+    uint16_t delay;                                 // Delay from the base timestamp, 100us units
+    int32_t base_timestamp;                         // Base timestamp, 100us units before INTn
+    uint32_t timestamp;                             // Sample time, host timebase ticks
+    uint8_t length;                                 // Report length in bytes
+    uint8_t value_qty;
+    int16_t value[BNO08X_REPORT_MAX_VALUES];        // Little-endian 16-bit fields after the header
+    uint8_t *raw;                                   // Report bytes, valid inside the handler only
+}STRUCT_BNO08X_REPORT;
+
+typedef struct
+{
+    uint8_t id;                                     // BNO08X_SENSOR_ID_x
+    uint8_t sequence;
+    uint8_t status;
+    uint8_t value_qty;
+    uint32_t timestamp;                             // Sample time, host timebase ticks
+    int16_t value[BNO08X_REPORT_MAX_VALUES];
+}STRUCT_BNO08X_SAMPLE;
+
+typedef struct
+{
+    int32_t x;                                      // Q16.16, unit of the report
+    int32_t y;
+    int32_t z;
+    uint8_t accuracy;                               // Report status bits 1:0
+}STRUCT_BNO08X_VECTOR;
+
+typedef struct
+{
+    int16_t i;                                      // Q14
+    int16_t j;
+    int16_t k;
+    int16_t real;
+    int16_t accuracy;                               // Heading accuracy estimate, rad Q12, 0 if not reported
+    uint8_t status;                                 // Report status bits 1:0
+}STRUCT_BNO08X_QUATERNION;
+
+typedef struct
+{
+    int16_t roll;                                   // Rotation around X, binary angle
+    int16_t pitch;                                  // Rotation around Y, -90..+90 deg
+    int16_t yaw;                                    // Rotation around Z
+}STRUCT_BNO08X_EULER;
+
+typedef struct
+{
+    uint8_t id;                                     // BNO08X_SENSOR_ID_x
+    uint8_t flags;                                  // BNO08X_FEATURE_FLAG_x
+    uint16_t sensitivity;                           // Change sensitivity, Q-point of the report
+    uint32_t interval_us;                           // Report interval, 0 disables the report
+    uint32_t batch_us;                              // Batch interval, 0 = no batching
+    uint32_t specific;                              // Sensor-specific configuration
+}STRUCT_BNO08X_FEATURE;
+
+typedef struct
+{
+    uint8_t id;
+    uint8_t state;                                  // BNO08X_FEATURE_x
+    uint32_t interval_us;                           // Interval granted by the hub
+}STRUCT_BNO08X_FEATURE_STATE;
+
+typedef struct
+{
+    uint8_t id;                                     // Report ID or BNO08X_REPORT_ANY
+    void (*handler)(STRUCT_BNO08X_REPORT *report);  // Called from BNO08X_shtp_feed
+}STRUCT_BNO08X_HANDLER;
+
+typedef struct
+{
+    uint8_t transport;                              // BNO08X_TRANSPORT_x
     STRUCT_I2C *i2c_ref;
+    STRUCT_SPI *spi_ref;
     uint8_t mkb_port;
     uint8_t has_reset;
     uint8_t int_flag;
        
-    uint8_t cargo[256];                             // Set cargo length to 256, including SHTP header 
+    uint8_t cargo[BNO08X_TX_CARGO_LENGTH];          // Address byte + SHTP header + cargo
     uint8_t cargo_continue;                         // Cargo length bit 15 (15..0) indicates continuatio of pref. transaction
     uint16_t cargo_length;                          // cargo length including SHTP header
     uint16_t write_length;                          // Total of cargo + adr byte to write on I2C
@@ -72,11 +247,77 @@ typedef struct
     uint8_t length_msb;                             // bit 14:0 total number of bytes in cargo including header
     uint8_t channel;                                // channel type
     uint8_t channel_seqnum[BNO08X_SENSOR_CHANNELS]; // seq number for each channel
+    
+    // SHTP parser, reports may straddle continuation fragments
+    uint8_t rx_seqnum[BNO08X_SENSOR_CHANNELS];      // Last cargo sequence number received per channel
+    uint8_t rx_seqnum_valid;                        // Bit n set once channel n received a cargo
+    uint8_t rx_channel;                             // Channel of the cargo being parsed
+    uint8_t rx_skip;                                // Drop the rest of the cargo
+    uint8_t part[BNO08X_REPORT_MAX_LENGTH];         // Report split across 2 fragments
+    uint8_t part_length;
+    uint8_t part_need;
+    uint8_t exec_event;                             // Last executable channel byte (1 = reset complete)
+    int32_t base_timestamp;                         // Current cargo base, 100us units before INTn
+    STRUCT_BNO08X_REPORT report;
+    STRUCT_BNO08X_HANDLER handler[BNO08X_HANDLER_QTY];
+    uint32_t bytes_parsed;
+    uint16_t error[BNO08X_ERROR_QTY];
+    
+    // Interrupt-driven data path
+    STRUCT_I2C_TRANSACTION rx_transaction;
+    STRUCT_I2C_TRANSACTION tx_transaction;
+    uint8_t rx_buf[BNO08X_RX_BUF_LENGTH];
+    uint8_t *rx_data;                               // Last read, rx_buf or the SPI receive buffer
+    volatile uint8_t tx_pending;                    // SPI write waiting for the next INTn transfer
+    uint8_t tx_in_transfer;
+    uint32_t tx_time;                               // Timebase when the SPI write was posted
+    uint32_t tx_timeout;                            // BNO08X_TX_TIMEOUT_US in timebase ticks
+    uint8_t spi_active;                             // The SPI_4 transfer in progress is ours
+    uint8_t rx_deferred;                            // Read held off, SPI_4 was busy with another device
+    volatile uint8_t rx_state;                      // BNO08X_RX_x
+    uint8_t irq_read;                               // INTn starts the reads
+    volatile uint8_t int_pending;                   // INTn asserted during a read
+    uint32_t int_pending_time;
+    volatile uint8_t report_ready;
+    uint32_t int_time;                              // Timebase at the INTn edge
+    uint32_t latency;                               // INTn edge to reports dispatched, timebase ticks
+    uint8_t read_mode;                              // BNO08X_READ_x
+    uint16_t rx_expect;                             // Last sensor cargo length, 0 = not known yet
+    uint32_t rx_stat[BNO08X_RX_STAT_QTY];
+    STRUCT_BNO08X_FEATURE_STATE feature[BNO08X_FEATURE_QTY];
+    
+    STRUCT_BNO08X_SAMPLE fifo[BNO08X_FIFO_SIZE];
+    volatile uint8_t fifo_wr_ptr;
+    volatile uint8_t fifo_rd_ptr;
+    uint8_t fifo_enable;
+    volatile uint16_t fifo_overflow;
 }STRUCT_BNO08X;
 
 uint8_t BNO08X_init (STRUCT_BNO08X *bno, STRUCT_I2C *i2c, uint8_t port);
+uint8_t BNO08X_init_spi (STRUCT_BNO08X *bno, STRUCT_SPI *spi, uint8_t port);
 uint8_t BNO08X_has_reset (STRUCT_BNO08X *bno);
 uint8_t BNO08X_int_state (STRUCT_BNO08X *bno);
 void BNO08X_parse_shtp (STRUCT_BNO08X *bno, uint8_t *data);
 uint16_t BNO08X_get_cargo_length (STRUCT_BNO08X *bno);
-uint8_t BNO08X_write (STRUCT_BNO08X *bno, uint8_t channel, uint8_t *data, uint16_t data_length);
\ No newline at end of file
+uint8_t BNO08X_write (STRUCT_BNO08X *bno, uint8_t channel, uint8_t *data, uint16_t data_length);
+uint8_t BNO08X_register_handler (STRUCT_BNO08X *bno, uint8_t id, void (*handler)(STRUCT_BNO08X_REPORT *report));
+uint16_t BNO08X_shtp_feed (STRUCT_BNO08X *bno, uint8_t *data, uint16_t length);
+uint16_t BNO08X_get_error (STRUCT_BNO08X *bno, uint8_t type);
+uint32_t BNO08X_get_bytes_parsed (STRUCT_BNO08X *bno);
+uint8_t BNO08X_decode_vector (STRUCT_BNO08X_REPORT *report, STRUCT_BNO08X_VECTOR *vector);
+uint8_t BNO08X_decode_quaternion (STRUCT_BNO08X_REPORT *report, STRUCT_BNO08X_QUATERNION *quat);
+void BNO08X_quaternion_to_euler (STRUCT_BNO08X_QUATERNION *quat, STRUCT_BNO08X_EULER *euler);
+void BNO08X_irq_read_enable (STRUCT_BNO08X *bno, uint8_t state);
+uint8_t BNO08X_report_ready (STRUCT_BNO08X *bno);
+uint8_t BNO08X_get_exec_event (STRUCT_BNO08X *bno);
+uint32_t BNO08X_get_latency (STRUCT_BNO08X *bno);
+void BNO08X_set_read_mode (STRUCT_BNO08X *bno, uint8_t mode);
+uint32_t BNO08X_get_rx_stat (STRUCT_BNO08X *bno, uint8_t type);
+uint8_t BNO08X_set_features (STRUCT_BNO08X *bno, STRUCT_BNO08X_FEATURE *features, uint8_t qty);
+uint8_t BNO08X_get_feature_state (STRUCT_BNO08X *bno, uint8_t id);
+uint32_t BNO08X_get_feature_interval (STRUCT_BNO08X *bno, uint8_t id);
+void BNO08X_fifo_enable (STRUCT_BNO08X *bno, uint8_t state);
+uint8_t BNO08X_fifo_read (STRUCT_BNO08X *bno, STRUCT_BNO08X_SAMPLE *sample);
+uint8_t BNO08X_fifo_get_count (STRUCT_BNO08X *bno);
+uint16_t BNO08X_fifo_get_overflow (STRUCT_BNO08X *bno);
+#endif
@@ -54,12 +54,124 @@
 #define CAN_BUFFER_X6               6
 #define CAN_BUFFER_X4               4
 
-#define NUM_OF_CAN_BUFFERS          CAN_BUFFER_X4
+// DMA RAM is reserved for the largest layout, the buffer count in use is a CAN_init parameter
+#define NUM_OF_CAN_BUFFERS          CAN_BUFFER_X32
+#define CAN_MAX_TX_BUFFERS          8   // Only buffers 0..7 can transmit
+
+// Buffer layout set by CAN_init(..., buffer_qty, tx_buffer_qty) :
+// Buffers 0 .. tx_buffer_qty-1           : transmit buffers
+// Buffers tx_buffer_qty .. buffer_qty-1  : hardware receive FIFO region
+// A standard 8-byte frame takes at least ~222us at 500kbps (0-byte : ~94us),
+// so the FIFO region absorbs (buffer_qty - tx_buffer_qty) frames, ex. 24 
+// frames = at least 2.2ms at full bus load, before _C1Interrupt must run
+#define CAN_FIFO_BUFFER_POINTER     0x0F    // C1BUFPNTx value that routes a filter to the FIFO
 
 #define CAN_MAXIMUM_BUS_FREQ        550000UL
 
 #define CAN_MAXIMUM_TX_RETRY        32
 
+// Software receive FIFO, drained from the hardware buffers by _C1Interrupt
+// It holds CAN_RX_FIFO_SIZE - 1 frames, at least a full hardware FIFO region
+// (31 buffers with CAN_BUFFER_X32 and 1 transmit buffer), so a burst the
+// hardware absorbed while the interrupt was held is never dropped on drain
+#define CAN_RX_FIFO_SIZE            32  // Must be a power of 2
+#define CAN_RX_FIFO_MASK            (CAN_RX_FIFO_SIZE - 1)
+
+#define CAN_RX_OVERFLOW_FIFO        0   // Frame dropped, software FIFO was full
+#define CAN_RX_OVERFLOW_HW          1   // Frame lost by ECAN, a hardware buffer was overwritten
+
+typedef struct
+{
+    uint16_t SID;                   // Standard identifier, 11 bits
+    uint32_t EID;                   // Extended identifier, 18 bits
+    uint8_t IDE;
+    uint8_t RTR;
+    uint8_t DLC;
+    uint8_t filter_hit;             // Acceptance filter that accepted the frame
+    uint8_t payload[8];
+    uint32_t timestamp;             // Timebase ticks at ISR copy (0 without timebase)
+}STRUCT_CAN_FRAME;
+
+// Software transmit queue, ordered by priority then arbitration ID
+#define CAN_TX_QUEUE_SIZE           16
+#define CAN_TX_PRIORITY_QTY         4   // Same levels as TXnPRI, 3 is the highest
+
+#define CAN_TX_LATENCY_LAST         0
+#define CAN_TX_LATENCY_MAX          1
+
+// Acceptance filter table manager
+#define CAN_FILTER_QTY              16
+#define CAN_MASK_QTY                3
+#define CAN_FILTER_TABLE_MAX_ID     32  // Identifiers accepted by CAN_filter_table_build
+#define CAN_ID_EXTENDED             0x80000000UL            // Flag for 29-bit identifiers in an ID list
+#define CAN_EXT_ID(sid, eid)        (CAN_ID_EXTENDED | ((uint32_t)(sid) << 18) | ((uint32_t)(eid) & 0x3FFFF))
+
+typedef struct
+{
+    uint32_t filter[CAN_FILTER_QTY];        // 29-bit SID:EID value, standard IDs use the SID bits only
+    uint8_t filter_ide[CAN_FILTER_QTY];     // EXIDE, 1 = filter matches extended frames
+    uint8_t filter_mask[CAN_FILTER_QTY];    // Mask used by each filter (0..2)
+    uint32_t mask[CAN_MASK_QTY];            // 29-bit SID:EID masks, 1 = bit must match
+    uint8_t filter_qty;
+    uint32_t false_accept;                  // Unwanted identifiers let through by the table
+}STRUCT_CAN_FILTER_TABLE;
+
+// Node traffic load and error statistics, see CAN_stat_update
+#define CAN_STATE_ACTIVE            0
+#define CAN_STATE_WARNING           1   // TEC or REC >= 96
+#define CAN_STATE_PASSIVE           2   // TEC or REC >= 128
+#define CAN_STATE_BUS_OFF           3   // TEC >= 256
+#define CAN_STATE_QTY               4
+#define CAN_ERR_HISTORY_SIZE        8   // Must be a power of 2
+
+// The load counts only the traffic of this node, the frames accepted by the
+// filter table and the frames sent through the transmit queue. Frames of
+// other nodes rejected by the filters, error frames and retransmissions are
+// not seen, so it is a node traffic load, not the bus occupancy
+#define CAN_STAT_LOAD_LAST          0   // Node traffic load, permille of the bus bit rate
+#define CAN_STAT_LOAD_AVG           1
+#define CAN_STAT_LOAD_MAX           2
+#define CAN_STAT_RX_FPS             3   // Frames per second
+#define CAN_STAT_TX_FPS             4
+#define CAN_STAT_STATE              5   // Current CAN_STATE_x
+#define CAN_STAT_WARNING_CNT        6   // Transitions into each error state
+#define CAN_STAT_PASSIVE_CNT        7
+#define CAN_STAT_BUS_OFF_CNT        8
+
+typedef struct
+{
+    uint8_t state;                  // CAN_STATE_x entered
+    uint8_t tec;
+    uint8_t rec;
+    uint32_t timestamp;
+}STRUCT_CAN_ERR_EVENT;
+
+typedef struct
+{
+    volatile uint32_t bits;                         // Nominal bits seen since the last update
+    volatile uint16_t rx_frames;
+    volatile uint16_t tx_frames;
+    volatile uint16_t filter_hits[CAN_FILTER_QTY];
+    uint32_t window_start;
+    uint16_t load_last;
+    uint16_t load_avg;
+    uint16_t load_max;
+    uint16_t rx_fps;
+    uint16_t tx_fps;
+    uint16_t filter_fps[CAN_FILTER_QTY];
+    volatile uint8_t state;
+    volatile uint16_t state_count[CAN_STATE_QTY];
+    STRUCT_CAN_ERR_EVENT history[CAN_ERR_HISTORY_SIZE];
+    volatile uint8_t history_wr_ptr;
+}STRUCT_CAN_STAT;
+
+typedef struct
+{
+    STRUCT_CAN_FRAME frame;         // frame.timestamp holds the enqueue time
+    uint8_t priority;
+    uint32_t arb_id;                // SID:EID, lower value wins bus arbitration
+}STRUCT_CAN_TX_ENTRY;
+
 typedef struct
 {
     uint8_t node_type;              // Type of CAN node
@@ -80,6 +192,27 @@ typedef struct
     uint8_t tbif_flag;
     
     uint16_t transmit_retry_counter;
+    
+    uint8_t buffer_qty;             // Message buffers in DMA RAM (4 to 32)
+    uint8_t tx_buffer_qty;          // Transmit buffers, the rest is the receive FIFO
+    
+    STRUCT_CAN_FRAME rx_fifo[CAN_RX_FIFO_SIZE];
+    volatile uint8_t rx_fifo_wr_ptr;
+    volatile uint8_t rx_fifo_rd_ptr;
+    uint8_t rx_fifo_max_level;
+    volatile uint16_t rx_fifo_overflow;
+    volatile uint16_t rx_hw_overflow;
+    
+    STRUCT_CAN_TX_ENTRY tx_queue[CAN_TX_QUEUE_SIZE];    // tx_queue[tx_queue_count-1] is sent next
+    volatile uint8_t tx_queue_count;
+    volatile uint8_t tx_buf_busy;                       // Hardware buffers loaded by the queue
+    uint8_t tx_buf_priority[CAN_MAX_TX_BUFFERS];
+    uint32_t tx_buf_enqueue_time[CAN_MAX_TX_BUFFERS];
+    uint32_t tx_latency_last[CAN_TX_PRIORITY_QTY];      // Enqueue to transmit complete, timebase ticks
+    uint32_t tx_latency_max[CAN_TX_PRIORITY_QTY];
+    uint16_t tx_queue_overflow;
+    
+    STRUCT_CAN_STAT stat;
 }STRUCT_CAN;
 
 typedef struct
@@ -120,7 +253,8 @@ uint8_t CAN_init_message (STRUCT_CAN_MSG *msg, uint16_t SID, uint16_t EID, uint8
                             uint8_t tx_length, uint8_t rx_length, uint8_t node_type);
 
 uint8_t CAN_init (STRUCT_CAN *node, uint8_t channel, uint32_t bus_freq, uint16_t tx_retry,
-                uint8_t DMA_tx_channel, uint8_t DMA_rx_channel, uint8_t node_type);
+                uint8_t DMA_tx_channel, uint8_t DMA_rx_channel, uint8_t node_type,
+                uint8_t buffer_qty, uint8_t tx_buffer_qty);
 
 uint8_t CAN_set_rx_filter_sid (STRUCT_CAN_MSG *msg, uint8_t filter_channel, uint16_t filter_SID);
 
@@ -138,6 +272,24 @@ uint8_t CAN_get_ivr_state (STRUCT_CAN *node);
 uint8_t CAN_send_msg (STRUCT_CAN *node, STRUCT_CAN_MSG *msg, uint8_t priority);
 uint8_t CAN_get_txbuf_state (STRUCT_CAN *node);
 uint8_t CAN_get_rxbuf_state (STRUCT_CAN *node);
+uint8_t CAN_rx_fifo_read (STRUCT_CAN *node, STRUCT_CAN_FRAME *frame);
+uint8_t CAN_rx_fifo_get_count (STRUCT_CAN *node);
+uint8_t CAN_rx_fifo_get_max_level (STRUCT_CAN *node);
+uint8_t CAN_get_hw_fifo_depth (STRUCT_CAN *node);
+uint8_t CAN_tx_queue_push (STRUCT_CAN *node, STRUCT_CAN_FRAME *frame, uint8_t priority);
+uint8_t CAN_tx_queue_get_count (STRUCT_CAN *node);
+uint16_t CAN_tx_queue_get_overflow (STRUCT_CAN *node);
+uint32_t CAN_get_tx_latency (STRUCT_CAN *node, uint8_t priority, uint8_t type);
+void CAN_reset_tx_latency (STRUCT_CAN *node);
+uint8_t CAN_filter_table_build (STRUCT_CAN_FILTER_TABLE *table, const uint32_t *id_list, uint8_t id_qty);
+uint8_t CAN_filter_table_apply (STRUCT_CAN *node, STRUCT_CAN_FILTER_TABLE *table);
+uint8_t CAN_stat_update (STRUCT_CAN *node);
+uint16_t CAN_stat_get (STRUCT_CAN *node, uint8_t type);
+uint16_t CAN_stat_get_filter_fps (STRUCT_CAN *node, uint8_t filter);
+uint8_t CAN_stat_get_error_event (STRUCT_CAN *node, uint8_t age, STRUCT_CAN_ERR_EVENT *event);
+void CAN_stat_reset (STRUCT_CAN *node);
+uint16_t CAN_get_rx_overflow (STRUCT_CAN *node, uint8_t type);
+void CAN_clear_rx_overflow (STRUCT_CAN *node);
 
 #endif	
 
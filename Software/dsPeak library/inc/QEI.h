@@ -13,12 +13,19 @@
 //              uint8_t QEI_get_event (uint8_t channel);
 //              uint8_t QEI_get_direction (uint8_t channel);
 //              uint16_t QEI_get_velocity (uint8_t channel);
+//              uint32_t QEI_get_speed_rpm_q16 (uint8_t channel);
 //              void QEI_calculate_velocity (uint8_t channel);
 //              void QEI_interrupt_handle (uint8_t channel);
 //
 // Includes  :  dspeak_generic.h
+//              Timer.h
 //
 // Purpose   :  QEI driver for the dsPIC33EP
+//              The speed is measured between the last counted edges of two
+//              calls to QEI_calculate_velocity (counts / edge-to-edge time),
+//              edge times come from the QEI interval timer and the 32-bit 
+//              timebase. Without the timebase, the speed is the count per
+//              refresh period (1/refresh_freq).
 //
 //Jean-Francois Bilodeau    MPLab X v5.10    10/02/2020 
 //****************************************************************************//
@@ -26,6 +33,7 @@
 #define __QEI_H__
 
 #include "dspeak_generic.h"
+#include "Timer.h"
 
 typedef struct
 {
@@ -48,6 +56,10 @@ typedef struct
     uint32_t velocity;
     uint32_t pulse_diff;
     uint32_t pulse_per_tour;
+    uint32_t speed_rpm_q16;         // Edge timed speed, Q16.16 RPM
+    uint32_t rpm_num;               // QEI_VEL_RPM_NUM / pulse_per_tour, set with the cpr / gear derate
+    uint32_t last_edge;             // Time of the last counted edge, FCY ticks
+    uint8_t has_edge;               // last_edge is valid
 }STRUCT_QEI;
 
 #define QEI_1       0
@@ -85,6 +97,13 @@ typedef struct
 #define QEI_ROT_ENC_MAX_RPM 110                        // Max RPM   
 #define QEI_ROT_ENC_PPR (QEI_MOT1_CPR * QEI_MOT1_GDR)  // Max pulse per rotation
 
+// Edge timed velocity
+// The interval timer (INTxTMR) runs at FCY and is reset on every count edge
+#define QEI_VEL_INTDIV      0                                   // Interval timer clock, FCY / 1
+#define QEI_VEL_TIMEOUT     (FCY / 2UL)                         // 500ms without edge, speed is 0
+#define QEI_VEL_RPM_NUM     (FCY * 60UL)                        // RPM = counts x NUM / (FCY ticks x pulse_per_tour), fits 32 bits
+#define QEI_VEL_READ_TRIES  4                                   // Reads of VELxCNT between two stable INTxTMR reads
+
 #define MAX_PULSE_CNT 100000000
 #define MAX_TOUR_CNT 100000000
 
@@ -105,6 +124,7 @@ uint8_t QEI_get_event (uint8_t channel);
 uint8_t QEI_get_direction (uint8_t channel);
 uint16_t QEI_get_speed_rpm (uint8_t channel);
 uint16_t QEI_get_speed_rps (uint8_t channel);
+uint32_t QEI_get_speed_rpm_q16 (uint8_t channel);
 void QEI_calculate_velocity (uint8_t channel);
 uint16_t QEI_get_velocity (uint8_t channel);
 uint16_t QEI_get_max_rpm (uint8_t channel);
@@ -57,6 +57,9 @@ typedef struct
 {
     uint8_t TIMER_channel;
     uint8_t int_state;
+    volatile uint16_t expiry_cnt;   // Periods counted by the ISR since the last read
+    uint16_t elapsed;           // Periods collected by the last read
+    uint32_t overrun;           // Total periods missed by the caller
     uint32_t freq;
     uint8_t prescaler;
     uint8_t running;
@@ -79,6 +82,17 @@ uint32_t TIMER_get_freq (STRUCT_TIMER *timer);
 uint8_t TIMER_start (STRUCT_TIMER *timer);
 uint8_t TIMER_stop (STRUCT_TIMER *timer);
 uint8_t TIMER_get_state (STRUCT_TIMER *timer, uint8_t type);
+uint16_t TIMER_get_elapsed (STRUCT_TIMER *timer);
+uint16_t TIMER_get_last_elapsed (STRUCT_TIMER *timer);
+uint32_t TIMER_get_overrun (STRUCT_TIMER *timer);
+void TIMER_clear_overrun (STRUCT_TIMER *timer);
+uint32_t TIMER_get_ticks_to_expiry (STRUCT_TIMER *timer);
+
+uint8_t TIMER_timebase_init (STRUCT_TIMER *timer, uint8_t channel, uint8_t prescaler);
+uint32_t TIMER_timebase_get (void);
+uint32_t TIMER_timebase_get_freq (void);
+uint32_t TIMER_timebase_us_to_ticks (uint32_t us);
+uint32_t TIMER_timebase_ticks_to_us (uint32_t ticks);
 
 uint8_t COUNTER_init (STRUCT_TIMER *timer, uint8_t channel, uint8_t mode, uint8_t prescaler, uint32_t freq);
 #endif	/* TIMER_H */
@@ -0,0 +1,75 @@
+//****************************************************************************//
+// File      :  balance.h
+//
+// Functions :  void BALANCE_init (STRUCT_BALANCE *ctrl, int16_t kp, int16_t ki, int16_t kd);
+//              void BALANCE_set_setpoint (STRUCT_BALANCE *ctrl, int16_t angle);
+//              void BALANCE_set_tilt_limit (STRUCT_BALANCE *ctrl, int16_t angle);
+//              int16_t BALANCE_update (STRUCT_BALANCE *ctrl, int16_t angle,
+//                                      int32_t rate, uint32_t timestamp);
+//              void BALANCE_reset (STRUCT_BALANCE *ctrl);
+//              int16_t BALANCE_get_output (STRUCT_BALANCE *ctrl);
+//              int16_t BALANCE_get_error (STRUCT_BALANCE *ctrl);
+//
+// Includes  :  dspeak_generic.h
+//              Timer.h
+//
+// Purpose   :  Fixed-point tilt (balance) controller
+//              PID on a binary angle (32768 = 180 deg), the derivative term
+//              is the measured angular rate (Q16.16 rad/s) instead of the
+//              differentiated error. BALANCE_update() is called once per new
+//              orientation sample, the integral uses the time elapsed between
+//              the sample timestamps (32-bit timebase ticks). The output is a
+//              signed duty, Q15 (32767 = 100% forward). Integer math only,
+//              16x16 multiplies except the bounded integral step.
+//              Gains are Q8 (256 = 1.0), with 1 deg = 182 binary angle LSB :
+//              kp : Q15 duty per binary angle LSB, 8000 = 17.4% duty / deg
+//              ki : Q15 duty per binary angle LSB x s, 6000 = 13% duty / deg.s
+//              kd : Q15 duty per 16 binary angle LSB/s, 3000 = 0.4% duty / deg/s
+//              8000, 6000, 3000 are the BNO080 motor control project gains
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#ifndef __BALANCE_H_
+#define	__BALANCE_H_
+
+#include "dspeak_generic.h"
+#include "Timer.h"
+
+#define BALANCE_OUT_MAX             32767       // Q15 duty, 100%
+#define BALANCE_DT_MAX_US           100000UL    // Longer sample gaps are not integrated
+#define BALANCE_TILT_LIMIT_DEFAULT  8192        // 45 deg, motors stopped past it (fallen)
+#define BALANCE_I_RATE_MAX          262143L     // Integral slope limit, Q15 duty/s (8 x 100%/s)
+
+// Binary angle rate unit : 16 LSB/s = 0.088 deg/s, +/-2880 deg/s in 16 bits
+#define BALANCE_RATE_SHIFT          4
+
+typedef struct
+{
+    int16_t kp;             // Gains, see the header
+    int16_t ki;
+    int16_t kd;
+    int16_t setpoint;       // Binary angle
+    int16_t tilt_limit;     // Binary angle error where the output is cut
+
+    int16_t error;          // Last setpoint - angle
+    int16_t rate;           // Last angular rate, 16 binary angle LSB/s
+    int32_t i_acc;          // Integral term, duty Q15 << 16
+    int16_t out;            // Last output, Q15 duty
+    uint32_t last_time;     // Timestamp of the last sample
+    uint32_t dt_max;        // BALANCE_DT_MAX_US in timebase ticks
+    uint16_t dt_unit;       // Timebase ticks per 2^-16 s
+    uint8_t has_time;       // last_time is valid
+    uint8_t fallen;         // Tilt past tilt_limit, output is 0
+}STRUCT_BALANCE;
+
+void BALANCE_init (STRUCT_BALANCE *ctrl, int16_t kp, int16_t ki, int16_t kd);
+void BALANCE_set_setpoint (STRUCT_BALANCE *ctrl, int16_t angle);
+void BALANCE_set_tilt_limit (STRUCT_BALANCE *ctrl, int16_t angle);
+int16_t BALANCE_update (STRUCT_BALANCE *ctrl, int16_t angle, int32_t rate, uint32_t timestamp);
+void BALANCE_reset (STRUCT_BALANCE *ctrl);
+int16_t BALANCE_get_output (STRUCT_BALANCE *ctrl);
+int16_t BALANCE_get_error (STRUCT_BALANCE *ctrl);
+#endif	/* __BALANCE_H_ */
@@ -189,6 +189,17 @@ typedef struct
 #define DSPEAK_MKB_UART_RX_WR   LATGbits.LATG1
 #define DSPEAK_MKB_UART_RX_RD   PORTGbits.RG1
 
+// ----------------------- dsPeak on-board I2C_2 ----------------------------//
+// RC-DAC rheostats, ASDA2 / ASCL2
+// SDA
+#define DSPEAK_I2C2_SDA_DIR     TRISAbits.TRISA3
+#define DSPEAK_I2C2_SDA_WR      LATAbits.LATA3
+#define DSPEAK_I2C2_SDA_RD      PORTAbits.RA3
+// SCL
+#define DSPEAK_I2C2_SCL_DIR     TRISAbits.TRISA2
+#define DSPEAK_I2C2_SCL_WR      LATAbits.LATA2
+#define DSPEAK_I2C2_SCL_RD      PORTAbits.RA2
+
 // ---------------------------- Bringup defines ----------------------------- //
 // Before release of the documentation, these defines should be removes
 #define BRINGUP_DSPEAK_1
@@ -203,6 +214,12 @@ typedef struct
     
 // To use the FTDI EVE port, uncomment the following line
 //#define EVE_SCREEN_ENABLE
+
+// To compile the PROF_ENTER / PROF_EXIT execution time probes, uncomment the following line
+//#define PROFILER_ENABLE
+
+// To compile the ISR_STAT_x interrupt count / duration / latency probes, uncomment the following line
+//#define ISR_STAT_ENABLE
     
    
 void dsPeak_init(void);
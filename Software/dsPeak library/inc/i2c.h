@@ -5,14 +5,30 @@
 //              void I2C_fill_transmit_buffer (uint8_t port, uint8_t *ptr, uint8_t length);
 //              void I2C_master_write (uint8_t port, uint8_t *data, uint8_t length);
 //              void I2C_master_read (uint8_t port, uint8_t *data, uint8_t w_length, uint8_t r_length);
+//              void I2C_master_write_buffer (STRUCT_I2C *i2c, uint8_t address, uint8_t *data, uint16_t length);
+//              void I2C_master_read_buffer (STRUCT_I2C *i2c, uint8_t mode, uint8_t address, uint8_t *tx,
+//                                           uint16_t w_length, uint8_t *rx, uint16_t r_length);
 //              uint8_t I2C_wait (uint8_t port);
 //              uint8_t I2C_read_state (uint8_t port);
 //              uint8_t * I2C_get_rx_buffer (uint8_t port);
 //              uint8_t I2C_rx_done (uint8_t port);
 //              void I2C_change_address (uint8_t adr);
 //              void I2C_clear_rx_buffer (uint8_t port);
+//              uint8_t I2C_queue_submit (STRUCT_I2C *i2c, STRUCT_I2C_TRANSACTION *t);
+//              uint8_t I2C_queue_get_count (STRUCT_I2C *i2c);
+//              uint32_t I2C_get_freq (STRUCT_I2C *i2c);
+//              void I2C_set_timeout (STRUCT_I2C *i2c, uint32_t timeout_us);
+//              uint8_t I2C_bus_recover (STRUCT_I2C *i2c);
+//              uint8_t I2C_get_fault (STRUCT_I2C *i2c);
+//              uint16_t I2C_get_fault_count (STRUCT_I2C *i2c);
+//              uint8_t I2C_task (STRUCT_I2C *i2c);
 //
 // Includes  : dspeak_generic.h
+//             Timer.h
+//
+// Purpose   : Master bus clocks from I2C_FREQ_MIN (~134kHz) to 1MHz. The
+//             100kHz standard mode is not available at Fcy=70MIPS, the 9-bit
+//             BRG cannot divide FCY down to it, see I2C_FREQ_MIN
 //
 //Jean-Francois Bilodeau    MPLab X v5.10    10/02/2020  
 //****************************************************************************//
@@ -20,19 +36,37 @@
 #define	__I2C_H__
 
 #include "dspeak_generic.h"
+#include "Timer.h"
 
 #define I2C_1 0
 #define I2C_2 1
 #define I2C_QTY 2
 
-#define I2C_FREQ_100k 511   //@Fcy=70MIPS
-#define I2C_FREQ_400k 115   //@Fcy=70MIPS
+// Bus clock in Hz, the BRG value is computed from FCY in I2C_init
+#define I2C_FREQ_400k 400000UL  // Fast mode
+#define I2C_FREQ_1M   1000000UL // Fast mode Plus, Fm+ slaves only
+#define I2C_FREQ_MAX  I2C_FREQ_1M
+
+#define I2C_BRG_MAX   0x1FF     // I2CxBRG is 9-bit
+#define I2C_PGD_NS    120       // Pulse gobbler delay, BRG formula rise time compensation
+#define I2C_PGD_CYCLES (((FCY / 1000) * I2C_PGD_NS) / 1000000UL)
+
+// Lowest bus clock the 9-bit BRG can divide FCY down to, ~134.4kHz @Fcy=70MIPS
+// Slower slaves need a lower FCY or the bus_recover style GPIO bit-bang
+#define I2C_FREQ_MIN  ((FCY + I2C_BRG_MAX + I2C_PGD_CYCLES + 1) / (I2C_BRG_MAX + I2C_PGD_CYCLES + 2))
 
 #define I2C_mode_master 0
 #define I2C_mode_slave 1
 
+// Port buffers used by the slave mode and the copying master transfers
+// (I2C_master_write / I2C_master_read). Can be reduced in dspeak_generic.h
+// when the master only uses the zero-copy _buffer transfers or the queue
+#ifndef I2C_TX_LENGTH
 #define I2C_TX_LENGTH 512
+#endif
+#ifndef I2C_RX_LENGTH
 #define I2C_RX_LENGTH 512
+#endif
 
 #define I2C_WRITE 0
 #define I2C_READ 1
@@ -40,6 +74,40 @@
 #define I2C_READ_MODE_RESTART       0
 #define I2C_READ_MODE_STOP_START    1
 
+// Transaction queue, transactions are chained from the master interrupt
+#define I2C_QUEUE_SIZE              8       // Must be a power of 2
+#define I2C_QUEUE_MASK              (I2C_QUEUE_SIZE - 1)
+
+#define I2C_TRANSACTION_WRITE       0       // ADR, tx_buf, STOP
+#define I2C_TRANSACTION_READ        1       // ADR+1, rx_buf, STOP
+#define I2C_TRANSACTION_WRITE_READ  2       // ADR, tx_buf, RESTART, ADR+1, rx_buf, STOP
+
+#define I2C_STATUS_PENDING          0
+#define I2C_STATUS_DONE             1
+#define I2C_STATUS_TIMEOUT          2       // Aborted, bus recovery was run
+
+// Transaction timeout and stuck bus recovery
+#define I2C_TIMEOUT_US              10000UL // Default, needs the 32-bit timebase
+#define I2C_RECOVERY_PULSES         9       // SCL pulses to free a slave holding SDA
+#define I2C_RECOVERY_HALF_US        5       // SCL half period during recovery (100kHz)
+
+#define I2C_FAULT_NONE              0
+#define I2C_FAULT_TIMEOUT           1       // Transaction timed out, bus recovered
+#define I2C_FAULT_BUS_STUCK         2       // SDA still low after the recovery sequence
+
+typedef struct
+{
+    uint8_t type;                   // I2C_TRANSACTION_x
+    uint8_t address;                // 8-bit slave write address (R/W bit = 0)
+    uint8_t *tx_buf;                // Bytes sent after the address, not copied
+    uint16_t tx_length;
+    uint8_t *rx_buf;                // Bytes read from the slave, written in place
+    uint16_t rx_length;
+    void (*callback)(void *context, uint8_t status);    // Called from the master interrupt, 0 for none
+    void *context;
+    volatile uint8_t status;        // I2C_STATUS_x
+}STRUCT_I2C_TRANSACTION;
+
 typedef struct
 {   
     uint8_t I2C_channel;
@@ -54,12 +122,35 @@ typedef struct
     uint8_t i2c_message_mode;
     uint8_t ack_state;
     uint8_t read_mode;
+    uint8_t address;                // 8-bit slave write address of the master transfer
+    uint8_t *tx_ptr;                // Master transfer buffers, read / written by the
+    uint8_t *rx_ptr;                // master interrupt in place
+    uint16_t brg;                   // I2CxBRG value computed in I2C_init
+    uint32_t timeout_us;            // Transaction timeout in us, 0 = none
+    uint32_t timeout;               // timeout_us in timebase ticks, converted at a transaction start
+    uint32_t start_time;            // Timebase at the START of the current transaction
+    uint8_t fault;                  // Last I2C_FAULT_x, cleared when read
+    uint16_t fault_count;
+    
+    STRUCT_I2C_TRANSACTION *queue[I2C_QUEUE_SIZE];
+    volatile uint8_t queue_wr_ptr;
+    volatile uint8_t queue_rd_ptr;
+    STRUCT_I2C_TRANSACTION * volatile active;   // Transaction on the bus, 0 for a direct transfer
 }STRUCT_I2C;
 
-uint8_t I2C_init (STRUCT_I2C *i2c, uint8_t port, uint16_t freq, uint8_t mode, uint8_t address);
+uint8_t I2C_init (STRUCT_I2C *i2c, uint8_t port, uint32_t freq, uint8_t mode, uint8_t address);
+uint32_t I2C_get_freq (STRUCT_I2C *i2c);
+void I2C_set_timeout (STRUCT_I2C *i2c, uint32_t timeout_us);
+uint8_t I2C_bus_recover (STRUCT_I2C *i2c);
+uint8_t I2C_get_fault (STRUCT_I2C *i2c);
+uint16_t I2C_get_fault_count (STRUCT_I2C *i2c);
+uint8_t I2C_task (STRUCT_I2C *i2c);
 void I2C_fill_transmit_buffer (STRUCT_I2C *i2c, uint8_t *ptr, uint8_t length);
-void I2C_master_write (STRUCT_I2C *i2c, uint8_t *data, uint16_t length);
-void I2C_master_read (STRUCT_I2C *i2c, uint8_t mode, uint8_t *data, uint16_t w_length, uint16_t r_length);
+uint8_t I2C_master_write (STRUCT_I2C *i2c, uint8_t *data, uint16_t length);
+uint8_t I2C_master_read (STRUCT_I2C *i2c, uint8_t mode, uint8_t *data, uint16_t w_length, uint16_t r_length);
+void I2C_master_write_buffer (STRUCT_I2C *i2c, uint8_t address, uint8_t *data, uint16_t length);
+void I2C_master_read_buffer (STRUCT_I2C *i2c, uint8_t mode, uint8_t address, uint8_t *tx,
+                             uint16_t w_length, uint8_t *rx, uint16_t r_length);
 uint8_t I2C_wait (STRUCT_I2C *i2c);
 uint8_t I2C_read_state (STRUCT_I2C *i2c);
 uint8_t * I2C_get_rx_buffer (STRUCT_I2C *i2c);
@@ -68,6 +159,8 @@ uint8_t I2C_rx_done (STRUCT_I2C *i2c);
 uint8_t I2C_get_ack_state (STRUCT_I2C *i2c);
 void I2C_change_address (STRUCT_I2C *i2c);
 void I2C_clear_rx_buffer (STRUCT_I2C *i2c);
+uint8_t I2C_queue_submit (STRUCT_I2C *i2c, STRUCT_I2C_TRANSACTION *t);
+uint8_t I2C_queue_get_count (STRUCT_I2C *i2c);
 
 
 #endif	/* I2C_H */
\ No newline at end of file
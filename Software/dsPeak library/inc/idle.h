@@ -0,0 +1,58 @@
+//****************************************************************************//
+// File      :  idle.h
+//
+// Functions :  uint8_t IDLE_init (STRUCT_TIMER *wake_timer, uint8_t wake_channel);
+//              uint8_t IDLE_enter (uint32_t (*get_bound)(void));
+//              uint16_t IDLE_get_busy_permille (void);
+//              uint32_t IDLE_get_stat (uint8_t type);
+//              void IDLE_reset_stat (void);
+//
+// Includes  :  dspeak_generic.h
+//              Timer.h
+//
+// Purpose   :  CPU idle manager
+//              Computes the next pending deadline from the running timers 
+//              and an application supplied bound (ex. scheduler next release)
+//              with interrupts masked, then puts the CPU in Idle mode until 
+//              an interrupt arrives. 
+//              Peripherals (PWM, QEI, DMA, UART) keep running in Idle mode.
+//              An optional 16-bit wake timer bounds the idle time when the 
+//              deadline does not come from a timer interrupt.
+//              The time spent in Idle is accumulated to report the CPU busy
+//              ratio. Requires the 32-bit timebase (TIMER_timebase_init).
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#ifndef __IDLE_H_
+#define	__IDLE_H_
+
+#include "dspeak_generic.h"
+#include "Timer.h"
+
+// Do not idle for less than the Idle entry / wake-up cost, in instruction cycles
+#define IDLE_MIN_SLEEP_TICKS        700UL           // 10us at 70MIPS
+// Longest wake timer period, 16-bit timer with 256x prescaler
+#define IDLE_MAX_SLEEP_TICKS        (FCY / 5)       // 200ms
+
+#define IDLE_STAT_COUNT             0
+#define IDLE_STAT_IDLE_TICKS        1
+#define IDLE_STAT_WAKE_LATENCY_MAX  2
+
+typedef struct
+{
+    STRUCT_TIMER *wake_timer;           // 0 if only running timer interrupts wake the CPU
+    uint32_t window_start;              // Timebase at the start of the busy ratio window
+    uint32_t idle_ticks;                // Ticks spent in Idle during the window
+    uint32_t idle_count;
+    uint32_t wake_latency_max;          // Worst wake-up delay past the computed deadline
+}STRUCT_IDLE;
+
+uint8_t IDLE_init (STRUCT_TIMER *wake_timer, uint8_t wake_channel);
+uint8_t IDLE_enter (uint32_t (*get_bound)(void));
+uint16_t IDLE_get_busy_permille (void);
+uint32_t IDLE_get_stat (uint8_t type);
+void IDLE_reset_stat (void);
+#endif	/* __IDLE_H_ */
@@ -0,0 +1,128 @@
+//****************************************************************************//
+// File      :  isotp.h
+//
+// Functions :  uint8_t ISOTP_init (STRUCT_ISOTP *link, STRUCT_CAN *node, uint16_t tx_sid,
+//                                  uint16_t rx_sid, uint8_t *rx_buf, uint16_t rx_buf_size,
+//                                  uint8_t block_size, uint8_t st_min);
+//              uint8_t ISOTP_send (STRUCT_ISOTP *link, uint8_t *buf, uint16_t length);
+//              uint8_t ISOTP_rx_frame (STRUCT_ISOTP *link, STRUCT_CAN_FRAME *frame);
+//              void ISOTP_task (STRUCT_ISOTP *link);
+//              uint16_t ISOTP_rx_get_length (STRUCT_ISOTP *link);
+//              void ISOTP_rx_release (STRUCT_ISOTP *link);
+//              uint8_t ISOTP_get_tx_state (STRUCT_ISOTP *link);
+//              uint16_t ISOTP_get_error (STRUCT_ISOTP *link, uint8_t type);
+//
+// Includes  :  dspeak_generic.h
+//              CAN.h
+//              Timer.h
+//
+// Purpose   :  ISO 15765-2 (ISO-TP) segmented transport over CAN_1
+//              Normal addressing on 11-bit identifiers, payloads up to 4095
+//              bytes. Frames are sent through the CAN transmit queue and
+//              received frames are handed over by the application from the
+//              CAN receive FIFO with ISOTP_rx_frame(). ISOTP_task() paces
+//              consecutive frames with the peer block size / STmin and
+//              handles the N_Bs / N_Cr timeouts on the 32-bit timebase.
+//              The transmit buffer must stay valid until the transfer ends.
+//              A first frame received while the previous message is not
+//              released is held off with FC_WAIT frames and accepted by
+//              ISOTP_rx_release(), up to ISOTP_WFT_MAX wait frames.
+//              A flow control refused by a full transmit queue is kept and
+//              sent again by the next ISOTP_task() calls.
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#ifndef __ISOTP_H_
+#define	__ISOTP_H_
+
+#include "dspeak_generic.h"
+#include "CAN.h"
+#include "Timer.h"
+
+#define ISOTP_MAX_LENGTH            4095    // 12-bit first frame length
+#define ISOTP_PADDING               0xCC    // Unused bytes of a frame, DLC is always 8
+#define ISOTP_TX_PRIORITY           1       // CAN transmit queue priority of ISO-TP frames
+#define ISOTP_TIMEOUT_US            1000000UL   // N_Bs and N_Cr
+#define ISOTP_FC_WAIT_US            500000UL    // FC_WAIT period, within the peer N_Bs
+#define ISOTP_WFT_MAX               10          // FC_WAIT frames sent before a held off message is dropped
+#define ISOTP_RX_BUF_MIN            8           // Smallest reassembly buffer, a segmented message is 8 bytes or more
+
+// Protocol control information, high nibble of the 1st byte
+#define ISOTP_PCI_SF                0x00    // Single frame
+#define ISOTP_PCI_FF                0x10    // First frame
+#define ISOTP_PCI_CF                0x20    // Consecutive frame
+#define ISOTP_PCI_FC                0x30    // Flow control
+
+#define ISOTP_FC_CTS                0       // Continue to send
+#define ISOTP_FC_WAIT               1
+#define ISOTP_FC_OVERFLOW           2
+#define ISOTP_FC_NONE               0xFF    // No flow control waiting for the transmit queue
+
+#define ISOTP_TX_IDLE               0
+#define ISOTP_TX_WAIT_FC            1
+#define ISOTP_TX_SENDING            2
+#define ISOTP_TX_DONE               3
+#define ISOTP_TX_ERROR              4
+
+#define ISOTP_RX_IDLE               0
+#define ISOTP_RX_RECEIVING          1
+#define ISOTP_RX_DONE               2
+
+#define ISOTP_ERROR_TIMEOUT         0       // N_Bs / N_Cr expired
+#define ISOTP_ERROR_SEQUENCE        1       // Wrong consecutive frame sequence number
+#define ISOTP_ERROR_OVERFLOW        2       // Message larger than the receive buffer (either side)
+#define ISOTP_ERROR_QTY             3
+
+typedef struct
+{
+    STRUCT_CAN *node;
+    uint16_t tx_sid;                // Identifier of the frames sent by this link
+    uint16_t rx_sid;                // Identifier of the frames received by this link
+
+    // Transmit side
+    uint8_t *tx_buf;
+    uint16_t tx_length;
+    uint16_t tx_index;
+    uint8_t tx_sn;                  // Next consecutive frame sequence number
+    volatile uint8_t tx_state;
+    uint8_t tx_bs;                  // Peer block size, 0 = no further flow control
+    uint8_t tx_bs_counter;
+    uint32_t tx_st_min;             // Peer separation time, timebase ticks
+    uint32_t tx_last_time;
+    uint32_t tx_timer;              // Start of the N_Bs wait
+
+    // Receive side
+    uint8_t *rx_buf;
+    uint16_t rx_buf_size;
+    uint16_t rx_length;
+    uint16_t rx_index;
+    uint8_t rx_sn;
+    uint8_t rx_state;
+    uint8_t rx_bs_counter;
+    uint32_t rx_timer;              // Start of the N_Cr wait
+    uint8_t rx_wait;                // First frame held off with FC_WAIT
+    uint8_t rx_wait_count;          // FC_WAIT frames sent for it
+    uint16_t rx_wait_length;        // Its FF_DL
+    uint8_t rx_wait_data[6];        // Its payload
+    uint32_t rx_wait_timer;         // Last FC_WAIT sent
+    uint8_t fc_pending;             // Flow status to send again, ISOTP_FC_NONE when sent
+    uint8_t block_size;             // Flow control sent to the peer
+    uint8_t st_min;
+
+    uint16_t error[ISOTP_ERROR_QTY];
+}STRUCT_ISOTP;
+
+uint8_t ISOTP_init (STRUCT_ISOTP *link, STRUCT_CAN *node, uint16_t tx_sid,
+                    uint16_t rx_sid, uint8_t *rx_buf, uint16_t rx_buf_size,
+                    uint8_t block_size, uint8_t st_min);
+uint8_t ISOTP_send (STRUCT_ISOTP *link, uint8_t *buf, uint16_t length);
+uint8_t ISOTP_rx_frame (STRUCT_ISOTP *link, STRUCT_CAN_FRAME *frame);
+void ISOTP_task (STRUCT_ISOTP *link);
+uint16_t ISOTP_rx_get_length (STRUCT_ISOTP *link);
+void ISOTP_rx_release (STRUCT_ISOTP *link);
+uint8_t ISOTP_get_tx_state (STRUCT_ISOTP *link);
+uint16_t ISOTP_get_error (STRUCT_ISOTP *link, uint8_t type);
+#endif	/* __ISOTP_H_ */
@@ -0,0 +1,113 @@
+//****************************************************************************//
+// File      :  isr_stat.h
+//
+// Functions :  void ISR_STAT_init (void);
+//              void ISR_STAT_record (uint8_t vector, uint32_t entry);
+//              void ISR_STAT_latency (uint8_t vector, uint32_t latency);
+//              uint32_t ISR_STAT_get (uint8_t vector, uint8_t type);
+//              void ISR_STAT_reset (uint8_t vector);
+//
+// Includes  :  dspeak_generic.h
+//              Timer.h
+//
+// Purpose   :  Opt-in interrupt service routine instrumentation
+//              Records, per interrupt vector, the number of calls, the 
+//              maximum duration and the maximum entry latency when the 
+//              driver can measure it (timers). Durations are wall-clock 
+//              timebase ticks. Nesting is disabled (NSTDIS = 1), so an ISR 
+//              is never preempted, a large latency shows that the ISR entry 
+//              waited for another ISR to complete.
+//              The ISR_STAT_x macros compile to nothing unless 
+//              ISR_STAT_ENABLE is defined in dspeak_generic.h. 
+//              Requires the 32-bit timebase (TIMER_timebase_init).
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#ifndef __ISR_STAT_H_
+#define	__ISR_STAT_H_
+
+#include "dspeak_generic.h"
+#include "Timer.h"
+
+// Instrumented interrupt vectors
+#define ISR_VECT_T1             0
+#define ISR_VECT_T2             1
+#define ISR_VECT_T3             2
+#define ISR_VECT_T4             3
+#define ISR_VECT_T5             4
+#define ISR_VECT_T6             5
+#define ISR_VECT_T7             6
+#define ISR_VECT_T8             7
+#define ISR_VECT_T9             8
+#define ISR_VECT_SPI1           9
+#define ISR_VECT_SPI2           10
+#define ISR_VECT_SPI3           11
+#define ISR_VECT_SPI4           12
+#define ISR_VECT_U1RX           13
+#define ISR_VECT_U1TX           14
+#define ISR_VECT_U2RX           15
+#define ISR_VECT_U2TX           16
+#define ISR_VECT_U3RX           17
+#define ISR_VECT_U3TX           18
+#define ISR_VECT_U4RX           19
+#define ISR_VECT_U4TX           20
+#define ISR_VECT_MI2C1          21
+#define ISR_VECT_SI2C1          22
+#define ISR_VECT_MI2C2          23
+#define ISR_VECT_DCI            24
+#define ISR_VECT_DMA0           25
+#define ISR_VECT_DMA1           26
+#define ISR_VECT_DMA2           27
+#define ISR_VECT_DMA3           28
+#define ISR_VECT_DMA4           29
+#define ISR_VECT_DMA5           30
+#define ISR_VECT_DMA6           31
+#define ISR_VECT_DMA7           32
+#define ISR_VECT_DMA8           33
+#define ISR_VECT_DMA9           34
+#define ISR_VECT_DMA10          35
+#define ISR_VECT_DMA11          36
+#define ISR_VECT_DMA12          37
+#define ISR_VECT_DMA13          38
+#define ISR_VECT_DMA14          39
+#define ISR_VECT_C1             40
+#define ISR_VECT_INT4           41
+#define ISR_VECT_QEI1           42
+#define ISR_VECT_QEI2           43
+#define ISR_VECT_AD1            44
+#define ISR_VECT_AD2            45
+#define ISR_VECT_CN             46
+#define ISR_VECT_QTY            47
+
+#define ISR_STAT_COUNT          0
+#define ISR_STAT_DURATION_MAX   1
+#define ISR_STAT_LATENCY_MAX    2
+
+#ifdef ISR_STAT_ENABLE
+    // ISR_STAT_ENTER declares a local, place it after the ISR local declarations
+    #define ISR_STAT_ENTER(vector)              uint32_t isr_stat_entry = TIMER_timebase_get()
+    #define ISR_STAT_EXIT(vector)               ISR_STAT_record(vector, isr_stat_entry)
+    #define ISR_STAT_LATENCY(vector, latency)   ISR_STAT_latency(vector, latency)
+#else
+    #define ISR_STAT_ENTER(vector)
+    #define ISR_STAT_EXIT(vector)
+    #define ISR_STAT_LATENCY(vector, latency)
+#endif
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t duration_max;
+    uint32_t latency_max;
+}STRUCT_ISR_STAT;
+
+void ISR_STAT_init (void);
+void ISR_STAT_record (uint8_t vector, uint32_t entry);
+void ISR_STAT_latency (uint8_t vector, uint32_t latency);
+uint32_t ISR_STAT_get (uint8_t vector, uint8_t type);
+uint32_t ISR_STAT_get_overhead (void);
+void ISR_STAT_reset (uint8_t vector);
+#endif	/* __ISR_STAT_H_ */
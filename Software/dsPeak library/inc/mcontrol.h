@@ -30,6 +30,8 @@ typedef struct
     double last_error_rpm;
     uint16_t actual_rpm;
     uint16_t last_actual_rpm;    
+    uint32_t actual_rpm_q16;        // Q16.16 RPM, QEI edge timed speed
+    uint32_t last_actual_rpm_q16;
     
     uint16_t max_rpm;
     uint16_t min_rpm;
@@ -37,6 +39,7 @@ typedef struct
     uint16_t speed_rpm;
     
     uint8_t speed_perc;
+    uint16_t speed_duty;        // PWM_DUTY_MAX = 100%
     uint8_t direction;
     uint8_t pwm_h_channel;
     uint8_t pwm_l_channel;
@@ -55,6 +58,8 @@ typedef struct
 
 void MOTOR_init (STRUCT_PWM *pwm_h, STRUCT_PWM *pwm_l, uint8_t channel, uint16_t speed_fs);
 void MOTOR_drive_perc (uint8_t channel, uint8_t direction, uint8_t perc);
+void MOTOR_drive_duty (uint8_t channel, uint8_t direction, uint16_t duty);
+uint16_t MOTOR_get_speed_duty (uint8_t channel);
 void MOTOR_set_rpm (uint8_t channel, uint16_t new_rpm);
 void MOTOR_pid_calc_gains (uint8_t channel);
 double MOTOR_get_error (uint8_t channel);
@@ -0,0 +1,110 @@
+//****************************************************************************//
+// File      :  profiler.h
+//
+// Functions :  void PROF_init (void);
+//              uint8_t PROF_region_init (uint8_t region, const char *name);
+//              void PROF_enter (uint8_t region);
+//              void PROF_exit (uint8_t region);
+//              uint32_t PROF_get_stat (uint8_t region, uint8_t type);
+//              void PROF_reset_stat (uint8_t region);
+//              uint8_t PROF_export (STRUCT_UART *uart);
+//
+// Includes  :  dspeak_generic.h
+//              Timer.h
+//              UART.h
+//
+// Purpose   :  Execution time profiler for tagged code regions
+//              Each PROF_ENTER / PROF_EXIT pair timestamps a region with the 
+//              32-bit timer timebase, stores the events in a RAM ring and 
+//              keeps per-region count, min, max and total duration. 
+//              PROF_export() prints the statistics on a UART in plain ASCII,
+//              one line per named region, then the ring header and the ring 
+//              records from the oldest, PROF_EXPORT_RECORDS per line :
+//              PROF <name> r=<region> n=<count> min=<cycles> avg=<cycles> max=<cycles>
+//              PROFT n=<records> ovh=<cycles> hz=<timebase Hz>
+//              PROFR <record> <record> ...
+//              A record is <region><E|X><timestamp>, region in decimal, E for
+//              entry, X for exit, timestamp as 8 hex digits, e.g. 1E0012ABCD.
+//              The ring does not record during the export. An exit minus 
+//              its entry minus ovh is the region duration, unpaired records 
+//              are cut by the ring wrap. Software/test/tools/prof_decode 
+//              decodes the export on Linux.
+//              The probes compile to nothing unless PROFILER_ENABLE is 
+//              defined in dspeak_generic.h.
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#ifndef __PROFILER_H_
+#define	__PROFILER_H_
+
+#include "dspeak_generic.h"
+#include "Timer.h"
+#include "UART.h"
+
+#define PROF_REGION_QTY         8       // Number of tagged regions
+#define PROF_RING_SIZE          64      // Number of entry / exit records kept in RAM, power of 2
+#define PROF_NAME_LENGTH        12
+
+#define PROF_RECORD_ENTER       0
+#define PROF_RECORD_EXIT        1
+
+#define PROF_STAT_COUNT         0
+#define PROF_STAT_MIN           1
+#define PROF_STAT_MAX           2
+#define PROF_STAT_AVG           3
+#define PROF_STAT_LAST          4
+
+#define PROF_EXPORT_DONE        1
+#define PROF_EXPORT_BUSY        0
+#define PROF_EXPORT_RECORDS     5       // Ring records per PROFR line
+
+#ifdef PROFILER_ENABLE
+    #define PROF_ENTER(region)  PROF_enter(region)
+    #define PROF_EXIT(region)   PROF_exit(region)
+#else
+    #define PROF_ENTER(region)
+    #define PROF_EXIT(region)
+#endif
+
+typedef struct
+{
+    uint32_t timestamp;
+    uint8_t region;
+    uint8_t type;
+}STRUCT_PROF_RECORD;
+
+typedef struct
+{
+    char name[PROF_NAME_LENGTH];
+    uint32_t entry_time;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t last;
+    uint64_t total;
+}STRUCT_PROF_REGION;
+
+typedef struct
+{
+    STRUCT_PROF_RECORD ring[PROF_RING_SIZE];
+    uint16_t ring_wr_ptr;
+    uint16_t ring_count;                // Valid records, saturates at PROF_RING_SIZE
+    uint8_t ring_freeze;                // Set while PROF_export() sends the ring
+    uint32_t overhead;                  // Cost of an empty enter / exit pair, subtracted from durations
+    uint8_t export_region;              // Region to send, PROF_REGION_QTY for the ring header
+    uint16_t export_record;             // Ring records sent
+}STRUCT_PROFILER;
+
+void PROF_init (void);
+uint8_t PROF_region_init (uint8_t region, const char *name);
+void PROF_enter (uint8_t region);
+void PROF_exit (uint8_t region);
+uint32_t PROF_get_stat (uint8_t region, uint8_t type);
+uint32_t PROF_get_overhead (void);
+void PROF_reset_stat (uint8_t region);
+STRUCT_PROF_RECORD * PROF_get_record (uint16_t age);
+uint8_t PROF_export (STRUCT_UART *uart);
+#endif	/* __PROFILER_H_ */
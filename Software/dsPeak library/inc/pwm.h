@@ -2,7 +2,9 @@
 // File      : PWM.h
 //
 // Functions :  void PWM_init (void);
-//              void PWM_change_duty (uint8_t channel, uint8_t duty);
+//              void PWM_change_duty (STRUCT_PWM *pwm, uint16_t duty);
+//              void PWM_change_duty_perc (STRUCT_PWM *pwm, uint8_t duty);
+//              uint16_t PWM_get_duty (STRUCT_PWM *pwm);
 //              uint8_t PWM_get_position (uint8_t channel);
 //
 // Includes  : dspeak_generic.h
@@ -26,7 +28,26 @@
 
 #define PWM_QTY 9
 
-#define PWM_CLOCK_PRESCALE  64L      // MUST FIT WITH DIVIDER IN PTCON2bits.PCLKDIV
+// PWM clock prescalers. Each generator takes its clock from the primary 
+// master time base (PTCON2) or from the secondary one (STCON2), selected by
+// PWMx_MTBS. At 1:1 a 40kHz motor channel has 3500 duty steps (54 at 1:64),
+// the 50Hz servo phases only fit the 16-bit PHASEx registers at 1:64
+#define PWM_CLOCK_PRESCALE          1L      // MUST FIT WITH DIVIDER IN PTCON2bits.PCLKDIV
+#define PWM_CLOCK_PCLKDIV           0       // 0 = 1:1, 1 = 1:2, ... 6 = 1:64
+#define PWM_SERVO_CLOCK_PRESCALE    64L     // MUST FIT WITH DIVIDER IN STCON2bits.PCLKDIV
+#define PWM_SERVO_CLOCK_PCLKDIV     6
+
+#define PWM_MTBS_PRIMARY    0
+#define PWM_MTBS_SECONDARY  1
+#define PWM_TB_PRESCALE(mtbs) (((mtbs) == PWM_MTBS_SECONDARY) ? PWM_SERVO_CLOCK_PRESCALE : PWM_CLOCK_PRESCALE)
+
+#define PWM1_MTBS           PWM_MTBS_PRIMARY    // Motors
+#define PWM2_MTBS           PWM_MTBS_PRIMARY    // Motors
+#define PWM4_MTBS           PWM_MTBS_SECONDARY  // Servo
+#define PWM5_MTBS           PWM_MTBS_SECONDARY  // Servos
+#define PWM6_MTBS           PWM_MTBS_PRIMARY
+
+#define PWM_DUTY_MAX        32768U  // PWM_change_duty full scale (Q15, 100%)
 
 #define PWM1H_PHASE         40000L
 #define PWM1H_SERVO_BASE    0.05F   // Ratio in % of phase, base duty cycle, irrelevant in load mode
@@ -74,11 +95,14 @@ typedef struct
     uint16_t base_value;
     uint16_t end_value;
     uint8_t value_p;  
+    uint16_t value_q15;             // Last duty, PWM_DUTY_MAX = 100%
     uint16_t new_duty;
     uint8_t pwm_type;
 }STRUCT_PWM;
 
 void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type);
+void PWM_change_duty (STRUCT_PWM *pwm, uint16_t duty);
 void PWM_change_duty_perc (STRUCT_PWM *pwm, uint8_t duty);
+uint16_t PWM_get_duty (STRUCT_PWM *pwm);
 uint8_t PWM_get_position (STRUCT_PWM *pwm);
 #endif
\ No newline at end of file
@@ -0,0 +1,90 @@
+//****************************************************************************//
+// File      :  scheduler.h
+//
+// Functions :  uint8_t SCHED_init (STRUCT_TIMER *timebase, uint8_t timebase_channel);
+//              uint8_t SCHED_task_init (STRUCT_TASK *task, uint8_t priority, 
+//                                       void (*handler)(uint16_t events), 
+//                                       uint32_t period_us, uint32_t deadline_us);
+//              uint8_t SCHED_task_enable (uint8_t priority, uint8_t state);
+//              void SCHED_post_event (uint8_t priority, uint16_t events);
+//              uint8_t SCHED_run (void);
+//              uint32_t SCHED_get_next_release (void);
+//              uint32_t SCHED_get_stat (uint8_t priority, uint8_t type);
+//              void SCHED_reset_stat (uint8_t priority);
+//
+// Includes  :  dspeak_generic.h
+//              Timer.h
+//
+// Purpose   :  Cooperative, run-to-completion, priority-ordered task scheduler
+//              Each task slot index is the task priority (0 = highest).
+//              A task becomes ready when one of its event bits is posted, 
+//              either by the scheduler itself (periodic release) or by an 
+//              ISR / application call to SCHED_post_event().
+//              SCHED_run() always dispatches the highest priority ready task
+//              and records dispatch latency, run time and deadline misses
+//              measured against the 32-bit timer timebase.
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#ifndef __SCHEDULER_H_
+#define	__SCHEDULER_H_
+
+#include "dspeak_generic.h"
+#include "Timer.h"
+
+#define SCHED_TASK_QTY              8       // Task slots, slot index is task priority
+
+#define SCHED_TASK_DISABLE          0
+#define SCHED_TASK_ENABLE           1
+
+// Event bits passed to the task handler
+#define SCHED_EVENT_PERIOD          0x0001  // Periodic release generated by SCHED_run()
+#define SCHED_EVENT_USER_1          0x0002  // Application defined events
+#define SCHED_EVENT_USER_2          0x0004
+#define SCHED_EVENT_USER_3          0x0008
+#define SCHED_EVENT_USER_4          0x0010
+#define SCHED_EVENT_USER_5          0x0020
+#define SCHED_EVENT_USER_6          0x0040
+#define SCHED_EVENT_USER_7          0x0080
+
+// Statistics available through SCHED_get_stat(), durations in timebase ticks
+#define SCHED_STAT_RUN_COUNT        0
+#define SCHED_STAT_RUN_TIME_LAST    1
+#define SCHED_STAT_RUN_TIME_MAX     2
+#define SCHED_STAT_LATENCY_LAST     3
+#define SCHED_STAT_LATENCY_MAX      4
+#define SCHED_STAT_DEADLINE_MISS    5
+#define SCHED_STAT_RELEASE_OVERRUN  6
+
+typedef struct
+{
+    void (*handler)(uint16_t events);   // Task body, must run to completion
+    uint8_t priority;
+    uint8_t enable;
+    volatile uint16_t events;           // Pending event bits
+    volatile uint32_t release_time;     // Timebase value when the first pending event was posted
+    uint32_t period;                    // Periodic release in ticks, 0 = event driven only
+    uint32_t deadline;                  // Release to completion deadline in ticks, 0 = none
+    uint32_t next_release;
+    
+    uint32_t run_count;
+    uint32_t run_time_last;
+    uint32_t run_time_max;
+    uint32_t latency_last;
+    uint32_t latency_max;
+    uint32_t deadline_miss;
+    uint32_t release_overrun;           // Periodic releases lost while the previous one was pending
+}STRUCT_TASK;
+
+uint8_t SCHED_init (STRUCT_TIMER *timebase, uint8_t timebase_channel);
+uint8_t SCHED_task_init (STRUCT_TASK *task, uint8_t priority, void (*handler)(uint16_t events), uint32_t period_us, uint32_t deadline_us);
+uint8_t SCHED_task_enable (uint8_t priority, uint8_t state);
+void SCHED_post_event (uint8_t priority, uint16_t events);
+uint8_t SCHED_run (void);
+uint32_t SCHED_get_next_release (void);
+uint32_t SCHED_get_stat (uint8_t priority, uint8_t type);
+void SCHED_reset_stat (uint8_t priority);
+#endif	/* __SCHEDULER_H_ */
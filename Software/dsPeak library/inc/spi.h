@@ -11,6 +11,7 @@
 //              void SPI_flush_txbuffer (uint8_t channel);
 //              void SPI_flush_rxbuffer (uint8_t channel);
 //              uint8_t SPI_module_busy (uint8_t channel);
+//              void SPI_set_callback (STRUCT_SPI *spi, void (*callback)(void *context), void *context);
 //
 // Includes  :  dspeak_generic.h
 //           
@@ -120,6 +121,8 @@ typedef struct
     uint8_t txfer_state;
     uint16_t rx_cnt;
     uint16_t tx_cnt;
+    void (*callback)(void *context);    // Called from the SPI interrupt when a SPI_write transfer is over
+    void *context;
 }STRUCT_SPI;
 
 void SPI_init (STRUCT_SPI *spi, uint8_t spi_channel, uint8_t spi_mode, uint8_t ppre, 
@@ -142,5 +145,6 @@ uint8_t SPI_assert_cs (STRUCT_SPI *spi);
 void SPI_flush_txbuffer (STRUCT_SPI *spi);
 void SPI_flush_rxbuffer (STRUCT_SPI *spi);
 uint8_t SPI_module_busy (STRUCT_SPI *spi);
+void SPI_set_callback (STRUCT_SPI *spi, void (*callback)(void *context), void *context);
 #endif
 
@@ -10,6 +10,7 @@
 //Jean-Francois Bilodeau    MPLab X v5.10    10/02/2020  
 //****************************************************************************//
 #include "ADC.h"
+#include "isr_stat.h"
 unsigned char adc1_init = 0;
 unsigned char adc2_init = 0;
 unsigned char adc1_sample_ready = ADC_SAMPLE_NOT_READY;
@@ -397,12 +398,16 @@ uint16_t ADC_get_eng_channel (STRUCT_ADC *adc)
 
 void __attribute__((__interrupt__, no_auto_psv))_AD1Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_AD1);
     IFS0bits.AD1IF = 0; 
     adc1_sample_ready = ADC_SAMPLE_READY;
+    ISR_STAT_EXIT(ISR_VECT_AD1);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_AD2Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_AD2);
     IFS1bits.AD2IF = 0;
     adc2_sample_ready = ADC_SAMPLE_READY;
+    ISR_STAT_EXIT(ISR_VECT_AD2);
 }
\ No newline at end of file
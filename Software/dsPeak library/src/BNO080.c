@@ -1,11 +1,52 @@
 #include "BNO080.h"
+#include "isr_stat.h"
 
 STRUCT_BNO08X BNO08X_struct[BNO08X_QTY];
 
+static void BNO08X_rx_read (STRUCT_BNO08X *bno, uint8_t *buf, uint16_t length, void (*callback)(void *context, uint8_t status));
+static void BNO08X_rx_header_done (void *context, uint8_t status);
+static void BNO08X_rx_cargo_done (void *context, uint8_t status);
+static void BNO08X_rx_end (STRUCT_BNO08X *bno);
+static void BNO08X_rx_start (STRUCT_BNO08X *bno);
+static uint8_t BNO08X_send (STRUCT_BNO08X *bno, uint8_t channel, uint16_t data_length);
+static void BNO08X_feature_restore (STRUCT_BNO08X *bno, uint8_t *slot, STRUCT_BNO08X_FEATURE_STATE *saved, uint8_t qty);
+static void BNO08X_feature_response (STRUCT_BNO08X *bno, uint8_t *p);
+static uint8_t BNO08X_setup (STRUCT_BNO08X *bno, uint8_t port);
+static void BNO08X_spi_done (void *context);
+static void BNO08X_tx_wait (STRUCT_BNO08X *bno);
+
 uint8_t BNO08X_init (STRUCT_BNO08X *bno, STRUCT_I2C *i2c, uint8_t port)
 {      
-    uint16_t i = 0;
+    bno->transport = BNO08X_TRANSPORT_I2C;
     bno->i2c_ref = i2c;
+    bno->spi_ref = 0;
+    I2C_init(bno->i2c_ref, I2C_1, I2C_FREQ_400k, I2C_mode_master, 0);   // Initialize MikroBus I2C port
+    return BNO08X_setup(bno, port);
+}
+
+// SHTP over the MikroBus SPI port (SPI_4, mode 3, FCY / 24 = 2.9MHz)
+// The click PS0 / PS1 straps must select SPI, PS0 doubles as the WAKE input
+// and is driven from the MikroBus AN pin. Reads are always started by INTn
+// (BNO08X_irq_read_enable is set), a write asserts WAKE and is clocked out
+// during the next INTn transfer, full-duplex. The SPI_4 callback belongs to
+// the BNO08X, another MikroBus device may share the port without callback,
+// a read falling on one of its transfers is started when it completes
+uint8_t BNO08X_init_spi (STRUCT_BNO08X *bno, STRUCT_SPI *spi, uint8_t port)
+{
+    uint8_t ret;
+    bno->transport = BNO08X_TRANSPORT_SPI;
+    bno->i2c_ref = 0;
+    bno->spi_ref = spi;
+    SPI_init(bno->spi_ref, SPI_4, SPI_MODE3, PPRE_4_1, SPRE_6_1, SPI_BUF_LENGTH, SPI_BUF_LENGTH, 0, 0);
+    SPI_set_callback(bno->spi_ref, BNO08X_spi_done, bno);
+    ret = BNO08X_setup(bno, port);
+    bno->irq_read = 1;
+    return ret;
+}
+
+static uint8_t BNO08X_setup (STRUCT_BNO08X *bno, uint8_t port)
+{
+    uint16_t i = 0;
     bno->mkb_port = port;
     bno->has_reset = 0;     // 1st external interrupt caused by device waking up
     bno->int_flag = 0;
@@ -15,22 +56,67 @@ uint8_t BNO08X_init (STRUCT_BNO08X *bno, STRUCT_I2C *i2c, uint8_t port)
     {
         bno->channel_seqnum[i] = 0;
     }
-    for (i=0; i<256; i++)
+    for (i=0; i<BNO08X_TX_CARGO_LENGTH; i++)
     {
         bno->cargo[i] = 0;
     }
-    
-    I2C_init(bno->i2c_ref, I2C_1, I2C_FREQ_100k, I2C_mode_master, 0);   // Initialize MikroBus I2C port
+    for (i=0; i<BNO08X_FEATURE_QTY; i++)
+    {
+        bno->feature[i].state = BNO08X_FEATURE_NONE;
+    }
+    for (i=0; i<BNO08X_HANDLER_QTY; i++)
+    {
+        bno->handler[i].handler = 0;
+    }
+    for (i=0; i<BNO08X_ERROR_QTY; i++)
+    {
+        bno->error[i] = 0;
+    }
+    bno->rx_seqnum_valid = 0;
+    bno->rx_channel = 0;
+    bno->rx_skip = 0;
+    bno->part_length = 0;
+    bno->exec_event = 0;
+    bno->base_timestamp = 0;
+    bno->fifo_wr_ptr = 0;
+    bno->fifo_rd_ptr = 0;
+    bno->fifo_enable = 0;
+    bno->fifo_overflow = 0;
+    bno->bytes_parsed = 0;
+    bno->rx_state = BNO08X_RX_IDLE;
+    bno->irq_read = 0;
+    bno->int_pending = 0;
+    bno->report_ready = 0;
+    bno->int_time = 0;
+    bno->int_pending_time = 0;
+    bno->latency = 0;
+    bno->tx_transaction.status = I2C_STATUS_DONE;
+    bno->read_mode = BNO08X_READ_SINGLE;
+    bno->rx_expect = 0;
+    for (i=0; i<BNO08X_RX_STAT_QTY; i++)
+    {
+        bno->rx_stat[i] = 0;
+    }
+    bno->rx_data = bno->rx_buf;
+    bno->tx_pending = 0;
+    bno->tx_in_transfer = 0;
+    bno->tx_time = 0;
+    bno->tx_timeout = 0;
+    bno->spi_active = 0;
+    bno->rx_deferred = 0;
     
     if (bno->mkb_port == BNO08X_MKB1)
     {
+        DSPEAK_MKB1_AIN1_ANS = 0;   // PS0 / WAKE, high selects SPI with PS1
+        DSPEAK_MKB1_AIN1_DIR = 0;
+        DSPEAK_MKB1_AIN1_WR = (bno->transport == BNO08X_TRANSPORT_SPI);
         DSPEAK_MKB1_RST_DIR = 0;    // Set reset pin to output
         DSPEAK_MKB1_RST_WR = 1;     // Get the IC out of reset
         __delay_ms(10);
         DSPEAK_MKB1_RST_WR = 0;     // Keep BNO080 in reset
         __delay_ms(10);
         DSPEAK_MKB1_PWM_DIR = 0;    // Set BOOTn pin to output
-        DSPEAK_MKB1_PWM_WR = 1;     // Set BOOTn to 1 (I2C mode, no bootloader)
+        DSPEAK_MKB1_PWM_WR = 1;     // Set BOOTn to 1 (no bootloader)
         DSPEAK_MKB1_INT_DIR = 1;    // Set interrupt pin to input
         __delay_ms(10);
         DSPEAK_MKB1_RST_WR = 1;     // Get the IC out of reset
@@ -39,13 +125,16 @@ uint8_t BNO08X_init (STRUCT_BNO08X *bno, STRUCT_I2C *i2c, uint8_t port)
     
     if (bno->mkb_port == BNO08X_MKB2)
     {
+        DSPEAK_MKB2_AIN1_ANS = 0;   // PS0 / WAKE, high selects SPI with PS1
+        DSPEAK_MKB2_AIN1_DIR = 0;
+        DSPEAK_MKB2_AIN1_WR = (bno->transport == BNO08X_TRANSPORT_SPI);
         DSPEAK_MKB2_RST_DIR = 0;    // Set reset pin to output
         DSPEAK_MKB2_RST_WR = 1;     // Get the IC out of reset
         __delay_ms(10);
         DSPEAK_MKB2_RST_WR = 0;     // Keep BNO080 in reset 
         __delay_ms(10);
         DSPEAK_MKB2_PWM_DIR = 0;    // Set BOOTn pin to output
-        DSPEAK_MKB2_PWM_WR = 1;     // Set BOOTn to 1 (I2C mode, no bootloader)
+        DSPEAK_MKB2_PWM_WR = 1;     // Set BOOTn to 1 (no bootloader)
         DSPEAK_MKB2_INT_DIR = 1;    // Set interrupt pin to input
         
         // Enable external interrupt on BNO08X interrupt pin
@@ -90,9 +179,12 @@ void BNO08X_parse_shtp (STRUCT_BNO08X *bno, uint8_t *data)
     else
         bno->cargo_continue = 0;
     length = bno->length_lsb | (bno->length_msb << 8);
-    bno->cargo_length = length & 0x7F;
+    bno->cargo_length = length & 0x7FFF;
     bno->channel = *data++;
-    bno->channel_seqnum[bno->channel] = *data;
+    if (bno->channel < BNO08X_SENSOR_CHANNELS)
+    {
+        bno->rx_seqnum[bno->channel] = *data;   // channel_seqnum holds the host sequence
+    }
 }
 
 uint16_t BNO08X_get_cargo_length (STRUCT_BNO08X *bno)
@@ -103,30 +195,1051 @@ uint16_t BNO08X_get_cargo_length (STRUCT_BNO08X *bno)
 uint8_t BNO08X_write (STRUCT_BNO08X *bno, uint8_t channel, uint8_t *data, uint16_t data_length)
 {
     uint16_t i = 0;
-    if (data_length > SHTP_MAX_CARGO)
+    if ((data_length + BNO08X_SHTP_HEADER_LENGTH + 1) > BNO08X_TX_CARGO_LENGTH)
+    {
+        return 0;
+    }
+    BNO08X_tx_wait(bno);                            // Cargo is sent in place
+    for (; i<data_length; i++)
+    {
+        bno->cargo[i+5] = *data++;
+    }
+    return BNO08X_send(bno, channel, data_length);
+}
+
+// Adds the SHTP header to the cargo built at bno->cargo[5] and queues it
+// Queued, so it cannot collide with a read started from INTn
+static uint8_t BNO08X_send (STRUCT_BNO08X *bno, uint8_t channel, uint16_t data_length)
+{
+    uint16_t shtp_length = data_length + BNO08X_SHTP_HEADER_LENGTH;
+    
+    bno->write_length = shtp_length + 1;            // Include address byte
+    bno->cargo[0] = BNO08X_DEFAULT_ADDRESS;
+    bno->cargo[1] = (shtp_length & 0x00FF);         // Length includes the SHTP header
+    bno->cargo[2] = (shtp_length >> 8);
+    bno->cargo[3] = channel;
+    bno->cargo[4] = bno->channel_seqnum[channel]++;
+    
+    if (bno->transport == BNO08X_TRANSPORT_SPI)
+    {
+        // Sent with the next INTn transfer, WAKE makes the hub assert INTn
+        bno->tx_timeout = TIMER_timebase_us_to_ticks(BNO08X_TX_TIMEOUT_US);
+        bno->tx_time = TIMER_timebase_get();
+        bno->tx_transaction.status = I2C_STATUS_PENDING;
+        bno->tx_pending = 1;
+        if (bno->mkb_port == BNO08X_MKB1)
+        {
+            DSPEAK_MKB1_AIN1_WR = 0;
+        }
+        else
+        {
+            DSPEAK_MKB2_AIN1_WR = 0;
+        }
+        return 1;
+    }
+    bno->tx_transaction.type = I2C_TRANSACTION_WRITE;
+    bno->tx_transaction.address = BNO08X_DEFAULT_ADDRESS;
+    bno->tx_transaction.tx_buf = &bno->cargo[1];
+    bno->tx_transaction.tx_length = bno->write_length - 1;
+    bno->tx_transaction.rx_buf = 0;
+    bno->tx_transaction.rx_length = 0;
+    bno->tx_transaction.callback = 0;
+    bno->tx_transaction.context = bno;
+    if (I2C_queue_submit(bno->i2c_ref, &bno->tx_transaction) == 0)
+    {
+        bno->channel_seqnum[channel]--;             // Not sent, the next write takes its number
+        return 0;
+    }
+    return 1;
+}
+
+// Waits until the transmit cargo is free, the previous write is over
+// A SPI write the hub never asked for with INTn is dropped after 
+// BNO08X_TX_TIMEOUT_US, as the I2C timeout does for a stuck write. Both
+// need the 32-bit timebase
+static void BNO08X_tx_wait (STRUCT_BNO08X *bno)
+{
+    uint16_t old_ipl;
+    
+    while (bno->tx_transaction.status == I2C_STATUS_PENDING)
+    {
+        if (bno->transport == BNO08X_TRANSPORT_I2C)
+        {
+            I2C_wait(bno->i2c_ref);         // Services the I2C timeout
+        }
+        else if ((bno->tx_timeout != 0) && ((TIMER_timebase_get() - bno->tx_time) > bno->tx_timeout))
+        {
+            SET_AND_SAVE_CPU_IPL(old_ipl, 7);
+            if (bno->tx_pending == 1)       // Not clocked out yet, a transfer ends by itself
+            {
+                bno->tx_pending = 0;
+                bno->tx_transaction.status = I2C_STATUS_TIMEOUT;
+                bno->error[BNO08X_ERROR_BUS]++;
+                if (bno->mkb_port == BNO08X_MKB1)
+                {
+                    DSPEAK_MKB1_AIN1_WR = 1;    // Release WAKE
+                }
+                else
+                {
+                    DSPEAK_MKB2_AIN1_WR = 1;
+                }
+            }
+            RESTORE_CPU_IPL(old_ipl);
+        }
+    }
+}
+
+// Enables / configures sensor reports. The set feature commands are packed
+// back to back in as few SHTP writes as the cargo holds (14 per write),
+// built in place. Each report is confirmed by its get feature response,
+// see BNO08X_get_feature_state. Returns the number of writes, 0 on error.
+// On error the entries packed since the last write get their state back,
+// the writes already queued stay pending
+uint8_t BNO08X_set_features (STRUCT_BNO08X *bno, STRUCT_BNO08X_FEATURE *features, uint8_t qty)
+{
+    uint8_t writes = 0;
+    uint8_t i = 0;
+    uint8_t slot = 0;
+    uint16_t length = 0;
+    uint8_t *p;
+    uint8_t unsent = 0;
+    uint8_t unsent_slot[BNO08X_FEATURE_QTY];
+    STRUCT_BNO08X_FEATURE_STATE saved[BNO08X_FEATURE_QTY];
+    
+    if (qty > BNO08X_FEATURE_QTY)
     {
         return 0;
     }
+    for (i=0; i<qty; i++)
+    {
+        if (length == 0)
+        {
+            BNO08X_tx_wait(bno);                    // Cargo is built in place
+        }
+        // Same report already tracked, or a free entry
+        for (slot=0; slot<BNO08X_FEATURE_QTY; slot++)
+        {
+            if ((bno->feature[slot].state != BNO08X_FEATURE_NONE) && (bno->feature[slot].id == features[i].id))
+            {
+                break;
+            }
+        }
+        if (slot == BNO08X_FEATURE_QTY)
+        {
+            for (slot=0; slot<BNO08X_FEATURE_QTY; slot++)
+            {
+                if (bno->feature[slot].state == BNO08X_FEATURE_NONE)
+                {
+                    break;
+                }
+            }
+        }
+        if (slot == BNO08X_FEATURE_QTY)
+        {
+            BNO08X_feature_restore(bno, unsent_slot, saved, unsent);
+            return 0;
+        }
+        unsent_slot[unsent] = slot;
+        saved[unsent++] = bno->feature[slot];
+        bno->feature[slot].id = features[i].id;
+        bno->feature[slot].interval_us = 0;
+        bno->feature[slot].state = BNO08X_FEATURE_PENDING;
+        
+        p = &bno->cargo[5 + length];
+        p[0] = BNO08X_SHCC_SET_FEAT_COM;
+        p[1] = features[i].id;
+        p[2] = features[i].flags;
+        p[3] = features[i].sensitivity;
+        p[4] = features[i].sensitivity >> 8;
+        p[5] = features[i].interval_us;
+        p[6] = features[i].interval_us >> 8;
+        p[7] = features[i].interval_us >> 16;
+        p[8] = features[i].interval_us >> 24;
+        p[9] = features[i].batch_us;
+        p[10] = features[i].batch_us >> 8;
+        p[11] = features[i].batch_us >> 16;
+        p[12] = features[i].batch_us >> 24;
+        p[13] = features[i].specific;
+        p[14] = features[i].specific >> 8;
+        p[15] = features[i].specific >> 16;
+        p[16] = features[i].specific >> 24;
+        length += BNO08X_SET_FEATURE_LENGTH;
+        
+        // Cargo full or last command, send what was packed
+        if (((i + 1) == qty) || 
+            ((length + BNO08X_SET_FEATURE_LENGTH + BNO08X_SHTP_HEADER_LENGTH + 1) > BNO08X_TX_CARGO_LENGTH))
+        {
+            if (BNO08X_send(bno, BNO08X_CHANNEL2_SHCC, length) == 0)
+            {
+                BNO08X_feature_restore(bno, unsent_slot, saved, unsent);
+                return 0;
+            }
+            writes++;
+            length = 0;
+            unsent = 0;
+        }
+    }
+    return writes;
+}
+
+// Puts back the entries of set feature commands that were not sent, the
+// latest first as a report given twice holds the same entry
+static void BNO08X_feature_restore (STRUCT_BNO08X *bno, uint8_t *slot, STRUCT_BNO08X_FEATURE_STATE *saved, uint8_t qty)
+{
+    while (qty-- > 0)
+    {
+        bno->feature[slot[qty]] = saved[qty];
+    }
+}
+
+uint8_t BNO08X_get_feature_state (STRUCT_BNO08X *bno, uint8_t id)
+{
+    uint8_t i = 0;
+    for (i=0; i<BNO08X_FEATURE_QTY; i++)
+    {
+        if ((bno->feature[i].state != BNO08X_FEATURE_NONE) && (bno->feature[i].id == id))
+        {
+            return bno->feature[i].state;
+        }
+    }
+    return BNO08X_FEATURE_NONE;
+}
+
+// Returns the report interval granted by the hub, in us, 0 if not confirmed
+uint32_t BNO08X_get_feature_interval (STRUCT_BNO08X *bno, uint8_t id)
+{
+    uint8_t i = 0;
+    for (i=0; i<BNO08X_FEATURE_QTY; i++)
+    {
+        if ((bno->feature[i].state == BNO08X_FEATURE_CONFIRMED) && (bno->feature[i].id == id))
+        {
+            return bno->feature[i].interval_us;
+        }
+    }
+    return 0;
+}
+
+// Get feature response, same layout as the set feature command
+static void BNO08X_feature_response (STRUCT_BNO08X *bno, uint8_t *p)
+{
+    uint8_t i = 0;
+    for (i=0; i<BNO08X_FEATURE_QTY; i++)
+    {
+        if ((bno->feature[i].state != BNO08X_FEATURE_NONE) && (bno->feature[i].id == p[1]))
+        {
+            bno->feature[i].interval_us = (uint32_t)p[5] | ((uint32_t)p[6] << 8) | ((uint32_t)p[7] << 16) | ((uint32_t)p[8] << 24);
+            bno->feature[i].state = BNO08X_FEATURE_CONFIRMED;
+        }
+    }
+}
+
+// Report lengths from the SH-2 reference manual, 0 = unknown report ID
+static const uint8_t BNO08X_sensor_length[BNO08X_SENSOR_ID_QTY] = 
+{
+    0,  10, 10, 10, 10, 14, 10, 16,     // 0x00 - 0x07
+    12, 14, 8,  8,  6,  6,  6,  16,     // 0x08 - 0x0F
+    5,  12, 6,  6,  16, 16, 16, 0,      // 0x10 - 0x17
+    8,  6,  6,  8,  6,  0,  16, 6,      // 0x18 - 0x1F
+    6,  6,  6,  6,  0,  0,  0,  0,      // 0x20 - 0x27
+    14, 12, 14, 6                       // 0x28 - 0x2B
+};
+
+static uint8_t BNO08X_report_length (uint8_t id)
+{
+    if (id < BNO08X_SENSOR_ID_QTY)
+    {
+        return BNO08X_sensor_length[id];
+    }
+    switch (id)
+    {
+        case BNO08X_SHCC_FLUSH_COMPLETED:
+            return 2;                   // Report ID, sensor ID
+        case BNO08X_SHCC_COM_RES:
+        case BNO08X_SHCC_FRS_RD_RES:
+        case BNO08X_SHCC_PID_RES:
+            return 16;
+        case BNO08X_SHCC_FRS_WR_RES:
+            return 4;
+        case BNO08X_REPORT_TIMESTAMP_REBASE:
+        case BNO08X_REPORT_BASE_TIMESTAMP:
+            return 5;
+        case BNO08X_SHCC_GET_FEAT_RES:
+            return 17;
+        default:
+            return 0;
+    }
+}
+
+// Host time of a sample, from the INTn edge of the cargo, the cargo base
+// timestamp and the report delay (SH-2 : INTn - base + delay)
+static uint32_t BNO08X_timestamp (STRUCT_BNO08X *bno, uint16_t delay)
+{
+    int32_t offset = (int32_t)delay - bno->base_timestamp;     // 100us units
+    
+    if (offset >= 0)
+    {
+        return bno->int_time + TIMER_timebase_us_to_ticks((uint32_t)offset * 100);
+    }
+    return bno->int_time - TIMER_timebase_us_to_ticks((uint32_t)(-offset) * 100);
+}
+
+// Copies a sensor report to the FIFO, dropped when the FIFO is full
+static void BNO08X_fifo_write (STRUCT_BNO08X *bno, STRUCT_BNO08X_REPORT *r)
+{
+    uint8_t wr_ptr = bno->fifo_wr_ptr;
+    uint8_t next = (wr_ptr + 1) & BNO08X_FIFO_MASK;
+    STRUCT_BNO08X_SAMPLE *sample = &bno->fifo[wr_ptr];
+    uint8_t i = 0;
+    
+    if (next == bno->fifo_rd_ptr)
+    {
+        bno->fifo_overflow++;
+        return;
+    }
+    sample->id = r->id;
+    sample->sequence = r->sequence;
+    sample->status = r->status;
+    sample->value_qty = r->value_qty;
+    sample->timestamp = r->timestamp;
+    for (i=0; i<r->value_qty; i++)
+    {
+        sample->value[i] = r->value[i];
+    }
+    bno->fifo_wr_ptr = next;
+}
+
+// Decodes one complete report and hands it to the registered handlers
+static void BNO08X_dispatch (STRUCT_BNO08X *bno, uint8_t *p, uint8_t length)
+{
+    STRUCT_BNO08X_REPORT *r = &bno->report;
+    uint8_t header = 0;
+    uint8_t i = 0;
+    
+    r->channel = bno->rx_channel;
+    r->length = length;
+    r->raw = p;
+    r->sequence = 0;
+    r->status = 0;
+    r->delay = 0;
+    if (bno->rx_channel == BNO08X_CHANNEL5_GYRVEC)
+    {
+        r->id = BNO08X_SENSOR_ID_GYRO_INT_RV;   // i, j, k, real, x, y, z without header
+    }
     else
     {
-        bno->cargo_length = data_length;
-        bno->write_length = bno->cargo_length + 5;   // Include address byte + SHTP header
-        bno->cargo[0] = BNO08X_DEFAULT_ADDRESS;
-        bno->cargo[1] = (bno->cargo_length & 0x00FF);
-        bno->cargo[2] = ((bno->cargo_length & 0xFF)<<8);
-        bno->cargo[3] = channel;
-        bno->cargo[4] = bno->channel_seqnum[channel]++;
-        for (; i<data_length; i++)
+        r->id = p[0];
+        // Base : time of the cargo reference before INTn, rebase : signed
+        // move of the reference for the reports that follow it
+        if (r->id == BNO08X_REPORT_BASE_TIMESTAMP)
+        {
+            bno->base_timestamp = (int32_t)((uint32_t)p[1] | ((uint32_t)p[2] << 8) | ((uint32_t)p[3] << 16) | ((uint32_t)p[4] << 24));
+            return;
+        }
+        if (r->id == BNO08X_REPORT_TIMESTAMP_REBASE)
+        {
+            bno->base_timestamp -= (int32_t)((uint32_t)p[1] | ((uint32_t)p[2] << 8) | ((uint32_t)p[3] << 16) | ((uint32_t)p[4] << 24));
+            return;
+        }
+        if (r->id < BNO08X_SENSOR_ID_QTY)
+        {
+            r->sequence = p[1];
+            r->status = p[2] & 0x03;
+            r->delay = ((uint16_t)(p[2] & 0xFC) << 6) | p[3];
+            header = 4;
+        }
+        else
+        {
+            header = length;            // Sensor hub responses, see raw
+            if (r->id == BNO08X_SHCC_GET_FEAT_RES)
+            {
+                BNO08X_feature_response(bno, p);
+            }
+        }
+    }
+    r->base_timestamp = bno->base_timestamp;
+    r->timestamp = BNO08X_timestamp(bno, r->delay);
+    
+    r->value_qty = (length - header) >> 1;
+    if (r->value_qty > BNO08X_REPORT_MAX_VALUES)
+    {
+        r->value_qty = BNO08X_REPORT_MAX_VALUES;
+    }
+    for (i=0; i<r->value_qty; i++)
+    {
+        r->value[i] = (int16_t)(p[header + (i << 1)] | ((uint16_t)p[header + (i << 1) + 1] << 8));
+    }
+    if ((bno->fifo_enable == 1) && (r->id < BNO08X_SENSOR_ID_QTY))
+    {
+        BNO08X_fifo_write(bno, r);
+    }
+    
+    for (i=0; i<BNO08X_HANDLER_QTY; i++)
+    {
+        if ((bno->handler[i].handler != 0) && 
+            ((bno->handler[i].id == r->id) || (bno->handler[i].id == BNO08X_REPORT_ANY)))
+        {
+            bno->handler[i].handler(r);
+        }
+    }
+}
+
+// Registers a function called for every decoded report with the given ID
+// (BNO08X_REPORT_ANY for all of them). Returns 0 when the table is full
+uint8_t BNO08X_register_handler (STRUCT_BNO08X *bno, uint8_t id, void (*handler)(STRUCT_BNO08X_REPORT *report))
+{
+    uint8_t i = 0;
+    for (i=0; i<BNO08X_HANDLER_QTY; i++)
+    {
+        if (bno->handler[i].handler == 0)
+        {
+            bno->handler[i].id = id;
+            bno->handler[i].handler = handler;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Parses one SHTP transfer as read on the bus (4-byte header + cargo bytes)
+// Transfers may be partial reads or continuation fragments, a report cut at
+// the end of a fragment is completed from the next one. Every report packed
+// in the cargo is decoded and dispatched, the bus is never read again.
+// Returns the number of reports and timestamp records parsed
+uint16_t BNO08X_shtp_feed (STRUCT_BNO08X *bno, uint8_t *data, uint16_t length)
+{
+    uint16_t cargo_length = 0;
+    uint16_t index = BNO08X_SHTP_HEADER_LENGTH;
+    uint16_t reports = 0;
+    uint8_t channel = 0;
+    uint8_t need = 0;
+    
+    if (length < BNO08X_SHTP_HEADER_LENGTH)
+    {
+        return 0;
+    }
+    cargo_length = data[0] | ((uint16_t)(data[1] & 0x7F) << 8);
+    bno->cargo_continue = data[1] >> 7;
+    channel = data[2];
+    bno->channel = channel;
+    bno->cargo_length = cargo_length;
+    if ((cargo_length <= BNO08X_SHTP_HEADER_LENGTH) || (channel >= BNO08X_SENSOR_CHANNELS))
+    {
+        return 0;                       // Nothing to read
+    }
+    if (length > cargo_length)
+    {
+        length = cargo_length;          // Bytes past the cargo are not data
+    }
+    
+    // Every transfer, continuation or not, increments the channel sequence
+    if ((((bno->rx_seqnum_valid >> channel) & 1) == 1) && (data[3] != (uint8_t)(bno->rx_seqnum[channel] + 1)))
+    {
+        bno->error[BNO08X_ERROR_SEQUENCE]++;
+    }
+    bno->rx_seqnum[channel] = data[3];
+    bno->rx_seqnum_valid |= (1 << channel);
+    
+    // A new cargo, or a fragment of another channel, ends any pending report
+    if ((bno->cargo_continue == 0) || (channel != bno->rx_channel))
+    {
+        if (bno->part_length != 0)
+        {
+            bno->error[BNO08X_ERROR_TRUNCATED]++;
+            bno->part_length = 0;
+        }
+        bno->rx_skip = 0;
+    }
+    if (bno->cargo_continue == 0)
+    {
+        bno->base_timestamp = 0;        // Each cargo carries its own base
+    }
+    bno->rx_channel = channel;
+    bno->bytes_parsed += length;
+    
+    if (channel == BNO08X_CHANNEL1_EXEC)
+    {
+        if (index < length)             // A header-only partial read has no event byte
+        {
+            bno->exec_event = data[index];
+        }
+        return 0;
+    }
+    if ((channel == BNO08X_CHANNEL0_SHTP) || (bno->rx_skip == 1))
+    {
+        return 0;                       // Advertisement is not decoded
+    }
+    
+    // Finish the report started in the previous fragment
+    if (bno->part_length != 0)
+    {
+        while ((index < length) && (bno->part_length < bno->part_need))
+        {
+            bno->part[bno->part_length++] = data[index++];
+        }
+        if (bno->part_length == bno->part_need)
+        {
+            BNO08X_dispatch(bno, bno->part, bno->part_need);
+            bno->part_length = 0;
+            reports++;
+        }
+    }
+    
+    while (index < length)
+    {
+        if (channel == BNO08X_CHANNEL5_GYRVEC)
+        {
+            need = BNO08X_GYRO_INT_RV_LENGTH;
+        }
+        else
+        {
+            need = BNO08X_report_length(data[index]);
+        }
+        if (need == 0)
+        {
+            bno->error[BNO08X_ERROR_UNKNOWN]++;
+            bno->rx_skip = 1;           // Report boundaries are lost
+            break;
+        }
+        
+        if ((length - index) >= need)
+        {
+            BNO08X_dispatch(bno, &data[index], need);
+            index += need;
+            reports++;
+        }
+        else
+        {
+            // Keep the start of the report until the continuation arrives
+            bno->part_need = need;
+            while (index < length)
+            {
+                bno->part[bno->part_length++] = data[index++];
+            }
+        }
+    }
+    return reports;
+}
+
+uint16_t BNO08X_get_error (STRUCT_BNO08X *bno, uint8_t type)
+{
+    if (type < BNO08X_ERROR_QTY)
+    {
+        return bno->error[type];
+    }
+    return 0;
+}
+
+uint32_t BNO08X_get_bytes_parsed (STRUCT_BNO08X *bno)
+{
+    return bno->bytes_parsed;
+}
+
+// Converts an accelerometer, gyroscope or magnetometer report to Q16.16 in
+// the unit of the report. Uncalibrated reports return the uncorrected axes,
+// the gyro-integrated rotation vector returns its angular velocity.
+// Returns 0 for a report without a 3-axis vector
+uint8_t BNO08X_decode_vector (STRUCT_BNO08X_REPORT *report, STRUCT_BNO08X_VECTOR *vector)
+{
+    uint8_t first = 0;
+    int32_t scale = 0;
+    
+    switch (report->id)
+    {
+        case BNO08X_SENSOR_ID_ACCEL:
+        case BNO08X_SENSOR_ID_ACCEL_LIN:
+        case BNO08X_SENSOR_ID_GRAVITY:
+            scale = 1L << (BNO08X_Q_VECTOR - BNO08X_Q_ACCEL);
+            break;
+        case BNO08X_SENSOR_ID_GYRO:
+        case BNO08X_SENSOR_ID_GYRO_UNCAL:
+            scale = 1L << (BNO08X_Q_VECTOR - BNO08X_Q_GYRO);
+            break;
+        case BNO08X_SENSOR_ID_MAGNETO:
+        case BNO08X_SENSOR_ID_MAGNETO_UNCAL:
+            scale = 1L << (BNO08X_Q_VECTOR - BNO08X_Q_MAGNETO);
+            break;
+        case BNO08X_SENSOR_ID_GYRO_INT_RV:
+            scale = 1L << (BNO08X_Q_VECTOR - BNO08X_Q_GYRO_INT_VEL);
+            first = 4;                  // After i, j, k, real
+            break;
+        default:
+            return 0;
+    }
+    if (report->value_qty < (first + 3))
+    {
+        return 0;
+    }
+    vector->x = (int32_t)report->value[first] * scale;
+    vector->y = (int32_t)report->value[first + 1] * scale;
+    vector->z = (int32_t)report->value[first + 2] * scale;
+    vector->accuracy = report->status;
+    return 1;
+}
+
+// Copies a rotation vector report quaternion (Q14). Returns 0 for a report
+// that is not a rotation vector
+uint8_t BNO08X_decode_quaternion (STRUCT_BNO08X_REPORT *report, STRUCT_BNO08X_QUATERNION *quat)
+{
+    quat->accuracy = 0;
+    switch (report->id)
+    {
+        case BNO08X_SENSOR_ID_GYRO_ROT_VECT:
+        case BNO08X_SENSOR_ID_GEOMAG_ROT_VECT:
+        case BNO08X_SENSOR_ID_ARVR_ROT_VECT:
+            if (report->value_qty < 5)
+            {
+                return 0;
+            }
+            quat->accuracy = report->value[4];
+            break;
+        case BNO08X_SENSOR_ID_GAME_ROT_VECT:
+        case BNO08X_SENSOR_ID_ARVR_GAME_RV:
+        case BNO08X_SENSOR_ID_GYRO_INT_RV:
+            if (report->value_qty < 4)
+            {
+                return 0;
+            }
+            break;
+        default:
+            return 0;
+    }
+    quat->i = report->value[0];
+    quat->j = report->value[1];
+    quat->k = report->value[2];
+    quat->real = report->value[3];
+    quat->status = report->status;
+    return 1;
+}
+
+// atan(2^-n), 2^29 = 180 deg
+static const int32_t BNO08X_cordic_atan[16] = 
+{
+    134217728, 79233351, 41864727, 21251189, 10666833, 5338616, 2669960, 1335061,
+    667541,    333772,   166886,   83443,    41722,    20861,   10430,   5215
+};
+
+// CORDIC vectoring atan2, returns a 16-bit binary angle
+static int16_t BNO08X_atan2 (int32_t y, int32_t x)
+{
+    int32_t angle = 0;
+    int32_t t = 0;
+    uint8_t n = 0;
+    
+    if ((x == 0) && (y == 0))
+    {
+        return 0;
+    }
+    // Scale up to keep 16 iterations worth of resolution, 2^28 * 1.65 gain fits
+    while ((x < (1L << 27)) && (x > -(1L << 27)) && (y < (1L << 27)) && (y > -(1L << 27)))
+    {
+        x <<= 1;
+        y <<= 1;
+    }
+    // Bring the vector in the right half plane, CORDIC converges within +/-99 deg
+    if (x < 0)
+    {
+        t = x;
+        if (y >= 0)
+        {
+            x = y;
+            y = -t;
+            angle = 1L << 28;           // +90 deg
+        }
+        else
+        {
+            x = -y;
+            y = t;
+            angle = -(1L << 28);        // -90 deg
+        }
+    }
+    for (n=0; n<16; n++)
+    {
+        t = x;
+        if (y > 0)
+        {
+            x += y >> n;
+            y -= t >> n;
+            angle += BNO08X_cordic_atan[n];
+        }
+        else
+        {
+            x -= y >> n;
+            y += t >> n;
+            angle -= BNO08X_cordic_atan[n];
+        }
+    }
+    return (int16_t)((angle + (1L << 13)) >> 14);   // +180 deg wraps to -180 deg
+}
+
+static uint16_t BNO08X_isqrt (uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (value >= root + bit)
         {
-            bno->cargo[i+5] = *data++;
+            value -= root + bit;
+            root = (root >> 1) + bit;
         }
-        I2C_master_write(bno->i2c_ref, bno->cargo, bno->write_length);
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint16_t)root;
+}
+
+// Converts a Q14 quaternion to roll / pitch / yaw (Z-Y-X Tait-Bryan angles)
+// in 16-bit binary angles, integer only
+void BNO08X_quaternion_to_euler (STRUCT_BNO08X_QUATERNION *quat, STRUCT_BNO08X_EULER *euler)
+{
+    int16_t w = quat->real;
+    int16_t x = quat->i;
+    int16_t y = quat->j;
+    int16_t z = quat->k;
+    int32_t xx = (int32_t)x * x;        // 16x16 products, Q28
+    int32_t yy = (int32_t)y * y;
+    int32_t zz = (int32_t)z * z;
+    int32_t roll_sin = ((int32_t)w * x) + ((int32_t)y * z);
+    int32_t roll_cos = (1L << 27) - (xx + yy);
+    int32_t pitch_sin = ((int32_t)w * y) - ((int32_t)z * x);
+    int16_t a = 0;
+    int16_t b = 0;
+    
+    // atan2 only needs the ratio, all terms are kept at half scale in Q28
+    euler->roll = BNO08X_atan2(roll_sin, roll_cos);
+    euler->yaw = BNO08X_atan2(((int32_t)w * z) + ((int32_t)x * y), (1L << 27) - (yy + zz));
+    
+    // cos(pitch) = |(roll_sin, roll_cos)|, better conditioned than asin near +/-90 deg
+    a = (int16_t)(roll_sin >> 13);
+    b = (int16_t)(roll_cos >> 13);
+    euler->pitch = BNO08X_atan2(pitch_sin, 
+                   (int32_t)BNO08X_isqrt((uint32_t)((int32_t)a * a) + (uint32_t)((int32_t)b * b)) << 13);
+}
+
+// Reads the SHTP header, then the cargo, as soon as INTn is asserted.
+// Reports are dispatched to the handlers from the I2C master interrupt
+void BNO08X_irq_read_enable (STRUCT_BNO08X *bno, uint8_t state)
+{
+    uint16_t old_ipl;
+    
+    SET_AND_SAVE_CPU_IPL(old_ipl, 7);
+    bno->irq_read = state;
+    bno->int_pending = 0;
+    // INTn already low, the edge was missed
+    if ((state == 1) && (bno->rx_state == BNO08X_RX_IDLE) && 
+        (bno->mkb_port == BNO08X_MKB2) && (DSPEAK_MKB2_INT_RD == 0))
+    {
+        bno->int_time = TIMER_timebase_get();
+        BNO08X_rx_start(bno);
     }
+    RESTORE_CPU_IPL(old_ipl);
+}
+
+uint8_t BNO08X_report_ready (STRUCT_BNO08X *bno)
+{
+    if (bno->report_ready == 1)
+    {
+        bno->report_ready = 0;
+        return 1;
+    }
+    else
+        return 0;
+}
+
+uint8_t BNO08X_get_exec_event (STRUCT_BNO08X *bno)
+{
+    return bno->exec_event;
+}
+
+// BNO08X_READ_SINGLE reads the header and the expected cargo in one
+// transaction once a sensor cargo was seen, BNO08X_READ_HEADER_FIRST always
+// reads the header alone first
+void BNO08X_set_read_mode (STRUCT_BNO08X *bno, uint8_t mode)
+{
+    bno->read_mode = mode;
+}
+
+uint32_t BNO08X_get_rx_stat (STRUCT_BNO08X *bno, uint8_t type)
+{
+    if (type < BNO08X_RX_STAT_QTY)
+    {
+        return bno->rx_stat[type];
+    }
+    return 0;
+}
+
+// Returns the last INTn edge to reports dispatched latency, in us
+uint32_t BNO08X_get_latency (STRUCT_BNO08X *bno)
+{
+    return TIMER_timebase_ticks_to_us(bno->latency);
+}
+
+// Every sensor report is also copied with its sample time to the FIFO, so
+// a batch of reports can be drained by the application in one go.
+// Enabling or disabling the FIFO flushes it
+void BNO08X_fifo_enable (STRUCT_BNO08X *bno, uint8_t state)
+{
+    uint16_t old_ipl;
+    
+    SET_AND_SAVE_CPU_IPL(old_ipl, 7);
+    bno->fifo_enable = state;
+    bno->fifo_rd_ptr = bno->fifo_wr_ptr;
+    RESTORE_CPU_IPL(old_ipl);
+}
+
+// Oldest report of the FIFO, returns 0 when the FIFO is empty
+uint8_t BNO08X_fifo_read (STRUCT_BNO08X *bno, STRUCT_BNO08X_SAMPLE *sample)
+{
+    uint8_t rd_ptr = bno->fifo_rd_ptr;
+    
+    if (rd_ptr == bno->fifo_wr_ptr)
+    {
+        return 0;
+    }
+    *sample = bno->fifo[rd_ptr];
+    bno->fifo_rd_ptr = (rd_ptr + 1) & BNO08X_FIFO_MASK;
     return 1;
 }
 
+uint8_t BNO08X_fifo_get_count (STRUCT_BNO08X *bno)
+{
+    return (bno->fifo_wr_ptr - bno->fifo_rd_ptr) & BNO08X_FIFO_MASK;
+}
+
+// Reports dropped because the FIFO was full
+uint16_t BNO08X_fifo_get_overflow (STRUCT_BNO08X *bno)
+{
+    return bno->fifo_overflow;
+}
+
+static void BNO08X_rx_read (STRUCT_BNO08X *bno, uint8_t *buf, uint16_t length, void (*callback)(void *context, uint8_t status))
+{
+    STRUCT_I2C_TRANSACTION *t = &bno->rx_transaction;
+    STRUCT_SPI *spi = bno->spi_ref;
+    uint16_t i = 0;
+    
+    if (bno->transport == BNO08X_TRANSPORT_SPI)
+    {
+        t->rx_length = length;
+        t->callback = callback;
+        // SPI_4 busy with a transfer of another device : SPI_write would
+        // spin in the INTn interrupt, which the SPI interrupt cannot preempt
+        // (NSTDIS = 1). The read is started by BNO08X_spi_done instead
+        if (SPI_module_busy(spi) != SPI_MODULE_FREE)
+        {
+            bno->rx_deferred = 1;
+            return;
+        }
+        
+        // Full-duplex, a pending write is clocked out while the hub cargo
+        // is read, otherwise a null header is sent
+        if (bno->tx_pending == 1)
+        {
+            bno->tx_pending = 0;
+            bno->tx_in_transfer = 1;
+            SPI_load_tx_buffer(spi, &bno->cargo[1], bno->write_length - 1);
+            i = bno->write_length - 1;
+        }
+        else
+        {
+            spi->tx_length = 0;
+        }
+        for (; i<length; i++)
+        {
+            spi->tx_data[i] = 0;
+        }
+        if (length > spi->tx_length)
+        {
+            spi->tx_length = length;
+        }
+        // A write longer than the read clocks in more of the hub cargo,
+        // every byte of the transfer is parsed as a cargo read
+        if (spi->tx_length > length)
+        {
+            t->rx_length = spi->tx_length;
+            t->callback = BNO08X_rx_cargo_done;
+            bno->rx_state = BNO08X_RX_CARGO;
+        }
+        bno->rx_data = SPI_get_rx_buffer(spi);
+        bno->spi_active = 1;
+        SPI_write(spi, (bno->mkb_port == BNO08X_MKB1) ? MIKROBUS1_CS : MIKROBUS2_CS);
+        bno->rx_stat[BNO08X_RX_STAT_TRANSACTIONS]++;
+        bno->rx_stat[BNO08X_RX_STAT_BYTES] += spi->tx_length;
+        return;
+    }
+    
+    bno->rx_data = buf;
+    t->type = I2C_TRANSACTION_READ;
+    t->address = BNO08X_DEFAULT_ADDRESS;
+    t->tx_buf = 0;
+    t->tx_length = 0;
+    t->rx_buf = buf;
+    t->rx_length = length;
+    t->callback = callback;
+    t->context = bno;
+    if (I2C_queue_submit(bno->i2c_ref, t) == 0)
+    {
+        bno->error[BNO08X_ERROR_BUS]++;
+        bno->rx_state = BNO08X_RX_IDLE;
+        return;
+    }
+    bno->rx_stat[BNO08X_RX_STAT_TRANSACTIONS]++;
+    bno->rx_stat[BNO08X_RX_STAT_BYTES] += length + 1;
+}
+
+// End of a SPI_4 transfer, same completion path as an I2C read
+// The callback runs for every transfer of the port, only ours are completed
+static void BNO08X_spi_done (void *context)
+{
+    STRUCT_BNO08X *bno = (STRUCT_BNO08X *)context;
+    
+    if (bno->spi_active == 0)
+    {
+        // Transfer of another device, start the read it held off
+        if (bno->rx_deferred == 1)
+        {
+            bno->rx_deferred = 0;
+            BNO08X_rx_read(bno, bno->rx_buf, bno->rx_transaction.rx_length, bno->rx_transaction.callback);
+        }
+        return;
+    }
+    bno->spi_active = 0;
+    if (bno->tx_in_transfer == 1)
+    {
+        bno->tx_in_transfer = 0;
+        bno->tx_transaction.status = I2C_STATUS_DONE;
+        if (bno->mkb_port == BNO08X_MKB1)
+        {
+            DSPEAK_MKB1_AIN1_WR = 1;        // Release WAKE
+        }
+        else
+        {
+            DSPEAK_MKB2_AIN1_WR = 1;
+        }
+    }
+    bno->rx_transaction.callback(bno, I2C_STATUS_DONE);
+}
+
+// 1st read after INTn, a single one when the cargo length can be expected
+static void BNO08X_rx_start (STRUCT_BNO08X *bno)
+{
+    if ((bno->read_mode == BNO08X_READ_SINGLE) && (bno->rx_expect != 0))
+    {
+        bno->rx_state = BNO08X_RX_CARGO;
+        BNO08X_rx_read(bno, bno->rx_buf, bno->rx_expect, BNO08X_rx_cargo_done);
+    }
+    else
+    {
+        bno->rx_state = BNO08X_RX_HEADER;
+        BNO08X_rx_read(bno, bno->rx_buf, BNO08X_SHTP_HEADER_LENGTH, BNO08X_rx_header_done);
+    }
+}
+
+// Header read, the cargo length gives the size of the 2nd read
+static void BNO08X_rx_header_done (void *context, uint8_t status)
+{
+    STRUCT_BNO08X *bno = (STRUCT_BNO08X *)context;
+    uint16_t length = 0;
+    
+    if (status != I2C_STATUS_DONE)
+    {
+        bno->error[BNO08X_ERROR_BUS]++;
+        BNO08X_rx_end(bno);
+        return;
+    }
+    length = bno->rx_data[0] | ((uint16_t)(bno->rx_data[1] & 0x7F) << 8);
+    // The header read is a transfer of its own, keep the sequence in step
+    if (bno->rx_data[2] < BNO08X_SENSOR_CHANNELS)
+    {
+        bno->rx_seqnum[bno->rx_data[2]] = bno->rx_data[3];
+        bno->rx_seqnum_valid |= (1 << bno->rx_data[2]);
+    }
+    if (length <= BNO08X_SHTP_HEADER_LENGTH)
+    {
+        BNO08X_rx_end(bno);                 // Nothing to read
+        return;
+    }
+    if (length > BNO08X_RX_BUF_LENGTH)
+    {
+        length = BNO08X_RX_BUF_LENGTH;      // Rest follows as a continuation
+    }
+    bno->rx_state = BNO08X_RX_CARGO;
+    BNO08X_rx_read(bno, bno->rx_buf, length, BNO08X_rx_cargo_done);
+}
+
+// Cargo read, reports are decoded and dispatched right away
+static void BNO08X_rx_cargo_done (void *context, uint8_t status)
+{
+    STRUCT_BNO08X *bno = (STRUCT_BNO08X *)context;
+    uint16_t length = bno->rx_transaction.rx_length;
+    
+    if (status != I2C_STATUS_DONE)
+    {
+        bno->error[BNO08X_ERROR_BUS]++;
+        BNO08X_rx_end(bno);
+        return;
+    }
+    if (BNO08X_shtp_feed(bno, bno->rx_data, length) != 0)
+    {
+        bno->latency = TIMER_timebase_get() - bno->int_time;
+        bno->report_ready = 1;
+    }
+    
+    // Sensor cargos set the size of the next single read
+    if ((bno->cargo_continue == 0) && (bno->channel >= BNO08X_CHANNEL3_SNSREP) && 
+        (bno->channel < BNO08X_SENSOR_CHANNELS))
+    {
+        bno->rx_expect = bno->cargo_length;
+        if (bno->rx_expect > BNO08X_RX_BUF_LENGTH)
+        {
+            bno->rx_expect = BNO08X_RX_BUF_LENGTH;
+        }
+    }
+    
+    // Cargo longer than the read, the rest follows as a continuation
+    // with a new header, its length is known
+    if (bno->cargo_length > length)
+    {
+        length = bno->cargo_length - length + BNO08X_SHTP_HEADER_LENGTH;
+        if (length > BNO08X_RX_BUF_LENGTH)
+        {
+            length = BNO08X_RX_BUF_LENGTH;
+        }
+        bno->rx_state = BNO08X_RX_CARGO;
+        BNO08X_rx_read(bno, bno->rx_buf, length, BNO08X_rx_cargo_done);
+    }
+    else
+    {
+        BNO08X_rx_end(bno);
+    }
+}
+
+// Read sequence over, serve INTn if it was asserted again meanwhile
+static void BNO08X_rx_end (STRUCT_BNO08X *bno)
+{
+    if (bno->int_pending == 1)
+    {
+        bno->int_pending = 0;
+        bno->int_time = bno->int_pending_time;
+        BNO08X_rx_start(bno);
+    }
+    else
+    {
+        bno->rx_state = BNO08X_RX_IDLE;
+    }
+}
+
 void __attribute__((__interrupt__, no_auto_psv)) _INT4Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_INT4);
     IFS3bits.INT4IF = 0;
     // 1st boot behavior
     if (BNO08X_struct[BNO08X_1].has_reset == 0)
@@ -138,6 +1251,21 @@ void __attribute__((__interrupt__, no_auto_psv)) _INT4Interrupt(void)
     {
         BNO08X_struct[BNO08X_1].int_flag = 1;
     }
+    // Start the read right away, or right after the one in progress
+    if (BNO08X_struct[BNO08X_1].irq_read == 1)
+    {
+        if (BNO08X_struct[BNO08X_1].rx_state == BNO08X_RX_IDLE)
+        {
+            BNO08X_struct[BNO08X_1].int_time = TIMER_timebase_get();
+            BNO08X_rx_start(&BNO08X_struct[BNO08X_1]);
+        }
+        else if (BNO08X_struct[BNO08X_1].int_pending == 0)
+        {
+            BNO08X_struct[BNO08X_1].int_pending_time = TIMER_timebase_get();
+            BNO08X_struct[BNO08X_1].int_pending = 1;
+        }
+    }
+    ISR_STAT_EXIT(ISR_VECT_INT4);
 }
 
 
@@ -17,6 +17,8 @@
 //****************************************************************************//
 #include "CAN.h"
 #include "DMA.h"
+#include "Timer.h"
+#include "isr_stat.h"
 
 __eds__ uint16_t CAN_MSG_BUFFER[NUM_OF_CAN_BUFFERS][8] __attribute__((eds, space(dma), aligned(32*16)));
 
@@ -280,47 +282,323 @@ uint8_t CAN_set_rx_mask (STRUCT_CAN_MSG *msg, uint8_t mask_channel, uint16_t mas
         return 0;
 }
 
+//**********uint8_t CAN_assign_rx_mask (STRUCT_CAN_MSG *msg, uint8_t mask_channel)**********//
+//Description : Function selects the acceptance mask used by the filter set
+//              with CAN_set_rx_filter_sid (msg->rx_filter_channel).
+//              Per-buffer routing is not supported : CAN_init and 
+//              CAN_filter_table_apply point every filter to the receive FIFO
+//              (C1BUFPNTx = 0xF), buffers below it are transmit buffers, so 
+//              frames accepted by the filter are read with CAN_rx_fifo_read
+//
+//Function prototype : uint8_t CAN_assign_rx_mask (STRUCT_CAN_MSG *msg, uint8_t mask_channel)
+//
+//Enter params       : STRUCT_CAN_MSG *msg    : Message set by CAN_set_rx_filter_sid
+//                     uint8_t mask_channel   : Mask 0..2
+//
+//Exit params        : uint8_t : 1 : Mask selected
+//                               0 : Error
+//
+//Function call      : CAN_assign_rx_mask(&CAN_MSG_DSPEAK, 0);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
 uint8_t CAN_assign_rx_mask (STRUCT_CAN_MSG *msg, uint8_t mask_channel)
 {
+    uint8_t shift;
     if ((msg->node_type == CAN_NODE_TYPE_RX_ONLY) || (msg->node_type == CAN_NODE_TYPE_TX_RX))
     {
-        if (mask_channel > 2){return 0;}
-        switch (msg->rx_msg_channel)
+        if ((mask_channel > 2) || (msg->rx_filter_channel > 15)){return 0;}
+        shift = (msg->rx_filter_channel & 0x07) << 1;   // FnMSK, 2 bits per filter
+        C1CTRL1bits.WIN = 1;                            // Set at 1 to access CAN filter / mask registers
+        if (msg->rx_filter_channel < 8)
         {
-            case 0:
-                C1BUFPNT1bits.F0BP = 0;             // Acceptance filter will use message buffer 0    
-                break;
-                
-            case 1:
-                C1BUFPNT1bits.F1BP = 1;             // Acceptance filter will use message buffer 1   
-                break;
-                
-            case 2:
-                break;
-                
-            case 3:
-                break;
-                
-            case 4:
-                break;
+            C1FMSKSEL1 = (C1FMSKSEL1 & ~(0x0003 << shift)) | ((uint16_t)mask_channel << shift);
         }
+        else
+        {
+            C1FMSKSEL2 = (C1FMSKSEL2 & ~(0x0003 << shift)) | ((uint16_t)mask_channel << shift);
+        }
+        C1CTRL1bits.WIN = 0;                            // Set at 0 to access CAN control registers
         return 1;
     }
     else
         return 0;
 }
 
+#define CAN_EXT_MASK_FULL           0x1FFFFFFFUL    // Every bit of a 29-bit SID:EID value
+
+// Number of identifiers of the frame type that pass a filter using mask
+static uint32_t CAN_filter_cost (uint32_t mask, uint8_t ide)
+{
+    uint8_t bit = (ide == 1) ? 0 : 18;
+    uint8_t zeros = 0;
+    for (; bit < 29; bit++)
+    {
+        if ((mask & (1UL << bit)) == 0){zeros++;}
+    }
+    return (1UL << zeros);
+}
+
+//*uint8_t CAN_filter_table_build (STRUCT_CAN_FILTER_TABLE *table, const uint32_t *id_list, uint8_t id_qty)*//
+//Description : Function computes an acceptance filter table for a list of 
+//              wanted identifiers. Each identifier starts as an exact match
+//              filter. While more than 16 filters are needed, the 2 filters 
+//              whose merge lets through the fewest extra identifiers are 
+//              merged (differing bits become don't care). The distinct masks
+//              are then merged the same way until 3 remain. 
+//              false_accept is an upper estimate of the unwanted identifiers
+//              accepted by the table, 0 when every ID got an exact filter
+//
+//Function prototype : uint8_t CAN_filter_table_build (STRUCT_CAN_FILTER_TABLE *table, const uint32_t *id_list, uint8_t id_qty)
+//
+//Enter params       : STRUCT_CAN_FILTER_TABLE *table : Table to fill
+//                     const uint32_t *id_list        : 11-bit standard IDs, or CAN_EXT_ID(sid, eid) for extended IDs
+//                     uint8_t id_qty                 : 1 to CAN_FILTER_TABLE_MAX_ID
+//
+//Exit params        : uint8_t : 1 : Table computed
+//                               0 : Invalid ID quantity
+//
+//Function call      : CAN_filter_table_build(&can_table, can_id_list, 20);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t CAN_filter_table_build (STRUCT_CAN_FILTER_TABLE *table, const uint32_t *id_list, uint8_t id_qty)
+{
+    uint32_t val[CAN_FILTER_TABLE_MAX_ID];
+    uint32_t mask[CAN_FILTER_TABLE_MAX_ID];
+    uint8_t ide[CAN_FILTER_TABLE_MAX_ID];
+    uint32_t masks[CAN_FILTER_QTY];
+    uint8_t qty = 0, unique = 0, mask_qty = 0;
+    uint8_t i, j, k, best_i = 0, best_j = 0;
+    uint32_t id, merged, best_mask = 0;
+    int32_t delta, best;
+    int64_t delta_sum, best_sum;
+    uint64_t accepted = 0;
+    
+    if ((id_qty == 0) || (id_qty > CAN_FILTER_TABLE_MAX_ID)){return 0;}
+    
+    // 1 exact match group per unique identifier
+    for (i = 0; i < id_qty; i++)
+    {
+        if (id_list[i] & CAN_ID_EXTENDED)
+        {
+            id = id_list[i] & CAN_EXT_MASK_FULL;
+            k = 1;
+        }
+        else
+        {
+            id = (id_list[i] & 0x07FF) << 18;
+            k = 0;
+        }
+        for (j = 0; j < qty; j++)
+        {
+            if ((val[j] == id) && (ide[j] == k)){break;}
+        }
+        if (j == qty)
+        {
+            val[qty] = id;
+            mask[qty] = CAN_EXT_MASK_FULL;
+            ide[qty] = k;
+            qty++;
+        }
+    }
+    unique = qty;
+    
+    // Merge the closest groups of the same frame type until they fit the filters
+    while (qty > CAN_FILTER_QTY)
+    {
+        best = INT32_MAX;
+        for (i = 0; i < qty; i++)
+        {
+            for (j = i + 1; j < qty; j++)
+            {
+                if (ide[i] != ide[j]){continue;}
+                merged = mask[i] & mask[j] & ~(val[i] ^ val[j]);
+                delta = (int32_t)CAN_filter_cost(merged, ide[i]) - (int32_t)CAN_filter_cost(mask[i], ide[i]) 
+                        - (int32_t)CAN_filter_cost(mask[j], ide[j]);
+                if (delta < best)
+                {
+                    best = delta;
+                    best_i = i;
+                    best_j = j;
+                    best_mask = merged;
+                }
+            }
+        }
+        mask[best_i] = best_mask;
+        val[best_i] &= best_mask;
+        qty--;
+        val[best_j] = val[qty];
+        mask[best_j] = mask[qty];
+        ide[best_j] = ide[qty];
+    }
+    
+    // Hardware holds 3 masks, merge the distinct masks with the lowest cost
+    for (i = 0; i < qty; i++)
+    {
+        for (j = 0; j < mask_qty; j++)
+        {
+            if (masks[j] == mask[i]){break;}
+        }
+        if (j == mask_qty){masks[mask_qty++] = mask[i];}
+    }
+    while (mask_qty > CAN_MASK_QTY)
+    {
+        best_sum = INT64_MAX;
+        for (i = 0; i < mask_qty; i++)
+        {
+            for (j = i + 1; j < mask_qty; j++)
+            {
+                merged = masks[i] & masks[j];
+                delta_sum = 0;
+                for (k = 0; k < qty; k++)
+                {
+                    if ((mask[k] == masks[i]) || (mask[k] == masks[j]))
+                    {
+                        delta_sum += (int64_t)CAN_filter_cost(merged, ide[k]) - CAN_filter_cost(mask[k], ide[k]);
+                    }
+                }
+                if (delta_sum < best_sum)
+                {
+                    best_sum = delta_sum;
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+        merged = masks[best_i] & masks[best_j];
+        for (k = 0; k < qty; k++)
+        {
+            if ((mask[k] == masks[best_i]) || (mask[k] == masks[best_j]))
+            {
+                mask[k] = merged;
+                val[k] &= merged;
+            }
+        }
+        masks[best_i] = merged;
+        masks[best_j] = masks[--mask_qty];
+    }
+    
+    for (k = 0; k < CAN_MASK_QTY; k++)
+    {
+        table->mask[k] = (k < mask_qty) ? masks[k] : CAN_EXT_MASK_FULL;
+    }
+    for (i = 0; i < qty; i++)
+    {
+        for (k = 0; k < mask_qty; k++)
+        {
+            if (masks[k] == mask[i]){break;}
+        }
+        table->filter[i] = val[i];
+        table->filter_ide[i] = ide[i];
+        table->filter_mask[i] = k;
+        accepted += CAN_filter_cost(mask[i], ide[i]);
+    }
+    table->filter_qty = qty;
+    accepted -= unique;
+    table->false_accept = (accepted > 0xFFFFFFFFUL) ? 0xFFFFFFFFUL : (uint32_t)accepted;
+    return 1;
+}
+
+// SID register layout shared by CxRXFnSID and CxRXMnSID : SID<10:0> in 
+// bits 15:5, EXIDE / MIDE in bit 3, EID<17:16> in bits 1:0
+static uint16_t CAN_filter_sid_reg (uint32_t id, uint8_t ide)
+{
+    return (uint16_t)((((id >> 18) & 0x07FF) << 5) | (ide << 3) | ((id >> 16) & 0x0003));
+}
+
+//*******uint8_t CAN_filter_table_apply (STRUCT_CAN *node, STRUCT_CAN_FILTER_TABLE *table)*******//
+//Description : Function writes a table computed by CAN_filter_table_build
+//              to the acceptance filter / mask registers. Unused filters are 
+//              disabled and every enabled filter stores into the receive FIFO.
+//              The node is put in configuration mode during the update then 
+//              returned to its previous mode (blocking, see CAN_set_mode)
+//
+//Function prototype : uint8_t CAN_filter_table_apply (STRUCT_CAN *node, STRUCT_CAN_FILTER_TABLE *table)
+//
+//Enter params       : STRUCT_CAN *node                : Pointer to a STRUCT_CAN item
+//                     STRUCT_CAN_FILTER_TABLE *table  : Table to apply
+//
+//Exit params        : uint8_t : 1 : Table applied
+//                               0 : Error
+//
+//Function call      : CAN_filter_table_apply(CAN1_struct, &can_table);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t CAN_filter_table_apply (STRUCT_CAN *node, STRUCT_CAN_FILTER_TABLE *table)
+{
+    // CxRXMnSID / CxRXMnEID and CxRXFnSID / CxRXFnEID pairs are consecutive in the SFR map
+    volatile uint16_t *rxm = &C1RXM0SID;
+    volatile uint16_t *rxf = &C1RXF0SID;
+    uint32_t mask_sel = 0;
+    uint16_t filter_en = 0;
+    uint8_t mode, i;
+    
+    if ((node->channel != CAN_1) || (table->filter_qty > CAN_FILTER_QTY)){return 0;}
+    mode = CAN_get_mode(node);
+    if (mode != CAN_MODE_CONFIG)
+    {
+        CAN_set_mode(node, CAN_MODE_CONFIG);
+    }
+    
+    C1CTRL1bits.WIN = 1;                        // Set at 1 to access CAN filter / mask registers
+    C1FEN1 = 0;                                 // Filters disabled while they are rewritten
+    for (i = 0; i < CAN_MASK_QTY; i++)
+    {
+        rxm[2*i] = CAN_filter_sid_reg(table->mask[i], 1);       // MIDE = 1, frame type must match EXIDE
+        rxm[(2*i)+1] = (uint16_t)table->mask[i];
+    }
+    for (i = 0; i < table->filter_qty; i++)
+    {
+        rxf[2*i] = CAN_filter_sid_reg(table->filter[i], table->filter_ide[i]);
+        rxf[(2*i)+1] = (uint16_t)table->filter[i];
+        mask_sel |= ((uint32_t)table->filter_mask[i] << (2*i));
+        filter_en |= (1 << i);
+    }
+    C1FMSKSEL1 = (uint16_t)mask_sel;            // Filters 0..7 mask select
+    C1FMSKSEL2 = (uint16_t)(mask_sel >> 16);    // Filters 8..15 mask select
+    C1BUFPNT1 = 0xFFFF;                         // Every acceptance filter stores into the receive FIFO
+    C1BUFPNT2 = 0xFFFF;
+    C1BUFPNT3 = 0xFFFF;
+    C1BUFPNT4 = 0xFFFF;
+    C1FEN1 = filter_en;
+    C1CTRL1bits.WIN = 0;                        // Set at 0 to access CAN control registers
+    
+    if (mode != CAN_MODE_CONFIG)
+    {
+        CAN_set_mode(node, mode);
+    }
+    return 1;
+}
+
 //********************uint8_t CAN_init (STRUCT_CAN *node)*********************//
 //Description : Function initialize CAN state machine and registers
+//              Message buffers 0..tx_buffer_qty-1 are transmit buffers, the 
+//              remaining buffers up to buffer_qty form the hardware receive
+//              FIFO drained by _C1Interrupt
 //
-//Function prototype : uint8_t CAN_init (STRUCT_CAN *node)
+//Function prototype : uint8_t CAN_init (STRUCT_CAN *node, uint8_t channel, uint32_t bus_freq, uint16_t tx_retry,
+//                                       uint8_t DMA_tx_channel, uint8_t DMA_rx_channel, uint8_t node_type,
+//                                       uint8_t buffer_qty, uint8_t tx_buffer_qty)
 //
-//Enter params       : STRUCT_CAN *node    : Pointer to a STRUCT_CAN item
+//Enter params       : STRUCT_CAN *node       : Pointer to a STRUCT_CAN item
+//                     uint8_t buffer_qty     : CAN_BUFFER_X4 to CAN_BUFFER_X32
+//                     uint8_t tx_buffer_qty  : 1 to CAN_MAX_TX_BUFFERS, less than buffer_qty
 //
 //Exit params        : uint8_t : CAN configuration status
 //                               1 : Configuration successful
 //                               0 : Error
-//Function call      : CAN_init(CAN_native);
+//Function call      : CAN_init(CAN1_struct, CAN_1, 500000, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX, CAN_BUFFER_X32, 8);
 //
 // Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
 // Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
@@ -328,8 +606,13 @@ uint8_t CAN_assign_rx_mask (STRUCT_CAN_MSG *msg, uint8_t mask_channel)
 // www.github.com/lecejeff/dspeak
 //****************************************************************************//
 uint8_t CAN_init (STRUCT_CAN *node, uint8_t channel, uint32_t bus_freq, uint16_t tx_retry,
-                uint8_t DMA_tx_channel, uint8_t DMA_rx_channel, uint8_t node_type)
+                uint8_t DMA_tx_channel, uint8_t DMA_rx_channel, uint8_t node_type,
+                uint8_t buffer_qty, uint8_t tx_buffer_qty)
 {
+    uint8_t i = 0;
+    if ((tx_buffer_qty == 0) || (tx_buffer_qty > CAN_MAX_TX_BUFFERS) || (tx_buffer_qty >= buffer_qty)){return 0;}
+    node->buffer_qty = buffer_qty;
+    node->tx_buffer_qty = tx_buffer_qty;
     node->channel = channel;
     node->bus_freq = bus_freq;
     node->DMA_tx_channel = DMA_tx_channel;
@@ -338,16 +621,30 @@ uint8_t CAN_init (STRUCT_CAN *node, uint8_t channel, uint32_t bus_freq, uint16_t
     node->tbif_flag = 0;                        // Transmit buffer interrupt flag reset
     node->rbif_flag = 0;                        // Receive buffer interrupt flag reset
     node->transmit_retry_counter = tx_retry;    // Transmit retry counter reset
+    node->rx_fifo_wr_ptr = 0;                   // Software receive FIFO reset
+    node->rx_fifo_rd_ptr = 0;
+    node->rx_fifo_max_level = 0;
+    node->rx_fifo_overflow = 0;
+    node->rx_hw_overflow = 0;
+    node->tx_queue_count = 0;                   // Software transmit queue reset
+    node->tx_buf_busy = 0;
+    node->tx_queue_overflow = 0;
+    for (i = 0; i < CAN_TX_PRIORITY_QTY; i++)
+    {
+        node->tx_latency_last[i] = 0;
+        node->tx_latency_max[i] = 0;
+    }
+    CAN_stat_reset(node);                       // Bus load / error statistics reset
     
     // Make sure node CAN physical channel is in config mode before initializing
     // the CAN registers, otherwise write to these registers will be discarded
     if (CAN_get_mode(node) != CAN_MODE_CONFIG)
     {
         CAN_set_mode (node, CAN_MODE_CONFIG);
-        if (CAN_get_mode(node) != CAN_MODE_CONFIG)
-        {
-            return 0;
-        }
+    }
+    if (CAN_get_mode(node) != CAN_MODE_CONFIG)
+    {
+        return 0;
     }    
     else
     {      
@@ -357,7 +654,7 @@ uint8_t CAN_init (STRUCT_CAN *node, uint8_t channel, uint32_t bus_freq, uint16_t
                 IEC2bits.C1IE = 0;                  // Disable CAN interrupt during initialization
                 IFS2bits.C1IF = 0;                  // Reset interrupt flag 
                 C1CTRL1bits.WIN = 0;                // Set at 0 to access CAN control registers                 
-                switch (NUM_OF_CAN_BUFFERS)
+                switch (node->buffer_qty)
                 {
                     case CAN_BUFFER_X32:
                         C1FCTRLbits.DMABS = 6;              // 32 message buffers in device RAM
@@ -386,6 +683,48 @@ uint8_t CAN_init (STRUCT_CAN *node, uint8_t channel, uint32_t bus_freq, uint16_t
                     case CAN_BUFFER_X4:
                         C1FCTRLbits.DMABS = 0;              // 4 message buffers in device RAM
                         break;
+                        
+                    default:
+                        return 0;
+                        break;
+                }
+                C1FCTRLbits.FSA = node->tx_buffer_qty;      // Receive FIFO starts after the transmit buffers
+                C1CTRL1bits.WIN = 1;                        // Set at 1 to access CAN filter / mask registers
+                C1BUFPNT1 = 0xFFFF;                         // Every acceptance filter stores into the receive FIFO
+                C1BUFPNT2 = 0xFFFF;
+                C1BUFPNT3 = 0xFFFF;
+                C1BUFPNT4 = 0xFFFF;
+                C1CTRL1bits.WIN = 0;                        // Set at 0 to access CAN control registers
+                
+                // Buffers below the FIFO region are transmit buffers. Only the
+                // receive region is reset, so the transmit buffer setup done by
+                // CAN_init_message() before CAN_init() is kept.
+                for (i = node->tx_buffer_qty; i < CAN_MAX_TX_BUFFERS; i++)
+                {
+                    switch (i)
+                    {
+                        case 1: C1TR01CONbits.TXEN1 = 0; break;
+                        case 2: C1TR23CONbits.TXEN2 = 0; break;
+                        case 3: C1TR23CONbits.TXEN3 = 0; break;
+                        case 4: C1TR45CONbits.TXEN4 = 0; break;
+                        case 5: C1TR45CONbits.TXEN5 = 0; break;
+                        case 6: C1TR67CONbits.TXEN6 = 0; break;
+                        case 7: C1TR67CONbits.TXEN7 = 0; break;
+                    }
+                }
+                for (i = 0; i < node->tx_buffer_qty; i++)
+                {
+                    switch (i)
+                    {
+                        case 0: C1TR01CONbits.TXEN0 = 1; break;
+                        case 1: C1TR01CONbits.TXEN1 = 1; break;
+                        case 2: C1TR23CONbits.TXEN2 = 1; break;
+                        case 3: C1TR23CONbits.TXEN3 = 1; break;
+                        case 4: C1TR45CONbits.TXEN4 = 1; break;
+                        case 5: C1TR45CONbits.TXEN5 = 1; break;
+                        case 6: C1TR67CONbits.TXEN6 = 1; break;
+                        case 7: C1TR67CONbits.TXEN7 = 1; break;
+                    }
                 }
                 
                 // CAN channel physical pin configuration
@@ -428,7 +767,7 @@ uint8_t CAN_init (STRUCT_CAN *node, uint8_t channel, uint32_t bus_freq, uint16_t
                 DMA_set_txfer_length(node->DMA_tx_channel, 7); 
                 
                 // DMA channel initialization, 1x channel for message reception
-                node->DMA_rx_channel = DMA_tx_channel;
+                node->DMA_rx_channel = DMA_rx_channel;
                 DMA_init(node->DMA_rx_channel);
                 DMA_set_control_register(node->DMA_rx_channel, (DMA_SIZE_WORD | DMA_TXFER_RD_PER | DMA_AMODE_PIA | DMA_CHMODE_CPPD));
                 DMA_set_request_source(node->DMA_rx_channel, DMAREQ_ECAN1RX);
@@ -440,6 +779,8 @@ uint8_t CAN_init (STRUCT_CAN *node, uint8_t channel, uint32_t bus_freq, uint16_t
                 IEC2bits.C1IE = 1;
                 C1INTEbits.TBIE = 1;
                 C1INTEbits.RBIE = 1;
+                C1INTEbits.RBOVIE = 1;              // Hardware buffer overflow, counted in rx_hw_overflow
+                C1INTEbits.ERRIE = 1;               // Error state changes, recorded in the error history
                
                 DMA_enable(node->DMA_tx_channel);                // Enable DMA channel and interrupt  
                 DMA_enable(node->DMA_rx_channel);                // Enable DMA channel and interrupt 
@@ -468,27 +809,29 @@ void CAN_msg_set_payload (STRUCT_CAN_MSG *msg, uint8_t *buf, uint8_t length)
     CAN_MSG_BUFFER[msg->tx_msg_channel][6] = (uint16_t)((msg->tx_payload[7]<<8) | msg->tx_payload[6]);
 }
 
+//******************uint8_t * CAN_receive_msg (STRUCT_CAN_MSG *msg)*****************//
+//Description : Not supported, kept for source compatibility. It read a 
+//              dedicated receive buffer (msg->rx_msg_channel), but CAN_init
+//              routes every acceptance filter to the receive FIFO region, 
+//              so no buffer holds the frames of a given filter. Received 
+//              frames are read in arrival order with CAN_rx_fifo_read
+//
+//Function prototype : uint8_t * CAN_receive_msg (STRUCT_CAN_MSG *msg)
+//
+//Enter params       : STRUCT_CAN_MSG *msg : Unused
+//
+//Exit params        : uint8_t * : Always 0
+//
+//Function call      : None, use CAN_rx_fifo_read(CAN1_struct, &frame);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
 uint8_t * CAN_receive_msg (STRUCT_CAN_MSG *msg)
 {
-    uint8_t i = 0;
-    if (((CAN_MSG_BUFFER[msg->rx_msg_channel][i] & 0x1FFC) >> 2) == msg->SID)
-    {
-        for (i = 0; i < 8; i++)
-        {
-            msg->rx_message[i] = CAN_MSG_BUFFER[msg->rx_msg_channel][i];
-        }
-        msg->rx_payload[0] = CAN_MSG_BUFFER[msg->rx_msg_channel][3];
-        msg->rx_payload[1] = (CAN_MSG_BUFFER[msg->rx_msg_channel][3] >> 8);
-        msg->rx_payload[2] = CAN_MSG_BUFFER[msg->rx_msg_channel][4];
-        msg->rx_payload[3] = (CAN_MSG_BUFFER[msg->rx_msg_channel][4] >> 8);
-        msg->rx_payload[4] = CAN_MSG_BUFFER[msg->rx_msg_channel][5];
-        msg->rx_payload[5] = (CAN_MSG_BUFFER[msg->rx_msg_channel][5] >> 8);
-        msg->rx_payload[6] = CAN_MSG_BUFFER[msg->rx_msg_channel][6];
-        msg->rx_payload[7] = (CAN_MSG_BUFFER[msg->rx_msg_channel][6] >> 8);             
-        return &msg->rx_payload[0];
-    }
-    else
-        return 0;                   // Receive message did not match SID, return 0
+    return 0;
 }
 
 // Returns 0 on successful execution
@@ -736,24 +1079,625 @@ uint8_t CAN_get_rxbuf_state (STRUCT_CAN *node)
         return 0;    
 }
 
+//***uint8_t CAN_rx_fifo_read (STRUCT_CAN *node, STRUCT_CAN_FRAME *frame)****//
+//Description : Function copies the oldest received frame out of the software
+//              receive FIFO. Frames are moved there by _C1Interrupt as soon 
+//              as a hardware buffer fills, so a burst is absorbed up to 
+//              CAN_RX_FIFO_SIZE - 1 frames between two calls
+//
+//Function prototype : uint8_t CAN_rx_fifo_read (STRUCT_CAN *node, STRUCT_CAN_FRAME *frame)
+//
+//Enter params       : STRUCT_CAN *node         : Pointer to a STRUCT_CAN item
+//                     STRUCT_CAN_FRAME *frame  : Destination frame
+//
+//Exit params        : uint8_t : 1 : Frame copied to *frame
+//                               0 : FIFO empty
+//
+//Function call      : if (CAN_rx_fifo_read(CAN1_struct, &frame) == 1){...}
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t CAN_rx_fifo_read (STRUCT_CAN *node, STRUCT_CAN_FRAME *frame)
+{
+    uint8_t rd_ptr = node->rx_fifo_rd_ptr;
+    if (rd_ptr == node->rx_fifo_wr_ptr)
+    {
+        return 0;
+    }
+    *frame = node->rx_fifo[rd_ptr];
+    // Single producer (ISR) / single consumer, the read pointer is only 
+    // released once the frame has been copied out
+    node->rx_fifo_rd_ptr = (rd_ptr + 1) & CAN_RX_FIFO_MASK;
+    return 1;
+}
+
+uint8_t CAN_rx_fifo_get_count (STRUCT_CAN *node)
+{
+    return (node->rx_fifo_wr_ptr - node->rx_fifo_rd_ptr) & CAN_RX_FIFO_MASK;
+}
+
+uint8_t CAN_rx_fifo_get_max_level (STRUCT_CAN *node)
+{
+    return node->rx_fifo_max_level;
+}
+
+uint16_t CAN_get_rx_overflow (STRUCT_CAN *node, uint8_t type)
+{
+    if (type == CAN_RX_OVERFLOW_FIFO)
+    {
+        return node->rx_fifo_overflow;
+    }
+    else if (type == CAN_RX_OVERFLOW_HW)
+    {
+        return node->rx_hw_overflow;
+    }
+    else
+        return 0;
+}
+
+void CAN_clear_rx_overflow (STRUCT_CAN *node)
+{
+    uint16_t cpu_ipl;
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    node->rx_fifo_overflow = 0;
+    node->rx_hw_overflow = 0;
+    node->rx_fifo_max_level = 0;
+    RESTORE_CPU_IPL(cpu_ipl);
+}
+
+// Nominal frame length on the bus from message buffer words 0 and 2 :
+// SOF to EOF plus 3 bits of interframe space, without stuff bits
+// Standard : 47 + 8 * data bytes, extended : 67 + 8 * data bytes
+static uint8_t CAN_frame_bits (uint16_t w0, uint16_t w2)
+{
+    uint8_t dlc = w2 & 0x000F;
+    if (dlc > 8){dlc = 8;}
+    if (w2 & 0x0200){dlc = 0;}              // Remote frame, no data field
+    return ((w0 & 0x0001) ? 67 : 47) + (dlc << 3);
+}
+
+// Copies one full hardware buffer into the software FIFO
+// Called from _C1Interrupt only
+static void CAN_rx_copy_buffer (STRUCT_CAN *node, uint8_t buf, uint32_t timestamp)
+{
+    uint16_t w0, w1, w2;
+    uint8_t wr_ptr, next, level, filter_hit;
+    STRUCT_CAN_FRAME *frame;
+    
+    w0 = CAN_MSG_BUFFER[buf][0];
+    w1 = CAN_MSG_BUFFER[buf][1];
+    w2 = CAN_MSG_BUFFER[buf][2];
+    filter_hit = (CAN_MSG_BUFFER[buf][7] >> 8) & 0x1F;     // FILHIT, 0 to 15 with 16 filters
+    node->stat.bits += CAN_frame_bits(w0, w2);
+    node->stat.rx_frames++;
+    if (filter_hit < CAN_FILTER_QTY)
+    {
+        node->stat.filter_hits[filter_hit]++;
+    }
+    
+    wr_ptr = node->rx_fifo_wr_ptr;
+    next = (wr_ptr + 1) & CAN_RX_FIFO_MASK;
+    if (next == node->rx_fifo_rd_ptr)
+    {
+        node->rx_fifo_overflow++;           // FIFO full, frame is dropped
+        return;
+    }
+
+    frame = &node->rx_fifo[wr_ptr];
+    frame->SID = (w0 >> 2) & 0x07FF;
+    frame->IDE = w0 & 0x0001;
+    frame->EID = ((uint32_t)(w1 & 0x0FFF) << 6) | ((w2 >> 10) & 0x003F);
+    frame->RTR = (w2 >> 9) & 0x0001;
+    frame->DLC = w2 & 0x000F;
+    if (frame->DLC > 8){frame->DLC = 8;}
+    frame->payload[0] = CAN_MSG_BUFFER[buf][3];
+    frame->payload[1] = (CAN_MSG_BUFFER[buf][3] >> 8);
+    frame->payload[2] = CAN_MSG_BUFFER[buf][4];
+    frame->payload[3] = (CAN_MSG_BUFFER[buf][4] >> 8);
+    frame->payload[4] = CAN_MSG_BUFFER[buf][5];
+    frame->payload[5] = (CAN_MSG_BUFFER[buf][5] >> 8);
+    frame->payload[6] = CAN_MSG_BUFFER[buf][6];
+    frame->payload[7] = (CAN_MSG_BUFFER[buf][6] >> 8);
+    frame->filter_hit = filter_hit;
+    frame->timestamp = timestamp;
+    node->rx_fifo_wr_ptr = next;
+
+    level = (next - node->rx_fifo_rd_ptr) & CAN_RX_FIFO_MASK;
+    if (level > node->rx_fifo_max_level)
+    {
+        node->rx_fifo_max_level = level;
+    }
+}
+
+// Empties the hardware receive FIFO region in arrival order
+// FNRB points to the next buffer to read and advances when its RXFUL bit is
+// cleared. RXFUL bits are cleared by writing 0, writing 1 leaves them 
+// untouched, so a buffer filled while draining is not released by mistake
+// Called from _C1Interrupt only
+static void CAN_rx_fifo_drain (STRUCT_CAN *node)
+{
+    uint32_t timestamp = TIMER_timebase_get();
+    uint8_t buf, n;
+    
+    for (n = node->tx_buffer_qty; n < node->buffer_qty; n++)
+    {
+        buf = C1FIFObits.FNRB;
+        if (buf < 16)
+        {
+            if ((C1RXFUL1 & (1U << buf)) == 0){break;}
+            CAN_rx_copy_buffer(node, buf, timestamp);
+            C1RXFUL1 = ~(1U << buf);
+        }
+        else
+        {
+            if ((C1RXFUL2 & (1U << (buf - 16))) == 0){break;}
+            CAN_rx_copy_buffer(node, buf, timestamp);
+            C1RXFUL2 = ~(1U << (buf - 16));
+        }
+    }
+}
+
+uint8_t CAN_get_hw_fifo_depth (STRUCT_CAN *node)
+{
+    return node->buffer_qty - node->tx_buffer_qty;
+}
+
+// CxTRmnCON holds 2 buffers, one per byte : buffer m in the low byte, 
+// buffer n in the high byte. Registers are consecutive in the SFR map
+#define CAN_TRCON_TXPRI             0x03
+#define CAN_TRCON_TXREQ             0x08
+
+// Writes a frame in a transmit buffer, layout per the ECAN message buffer format
+static void CAN_write_tx_buffer (uint8_t buf, STRUCT_CAN_FRAME *frame)
+{
+    CAN_MSG_BUFFER[buf][0] = (frame->SID << 2) | (frame->IDE << 1) | frame->IDE;    // SRR = IDE for extended frames
+    CAN_MSG_BUFFER[buf][1] = (uint16_t)(frame->EID >> 6) & 0x0FFF;
+    CAN_MSG_BUFFER[buf][2] = (((uint16_t)frame->EID & 0x003F) << 10) | (frame->RTR << 9) | (frame->DLC & 0x0F);
+    CAN_MSG_BUFFER[buf][3] = (uint16_t)((frame->payload[1]<<8) | frame->payload[0]);
+    CAN_MSG_BUFFER[buf][4] = (uint16_t)((frame->payload[3]<<8) | frame->payload[2]);
+    CAN_MSG_BUFFER[buf][5] = (uint16_t)((frame->payload[5]<<8) | frame->payload[4]);
+    CAN_MSG_BUFFER[buf][6] = (uint16_t)((frame->payload[7]<<8) | frame->payload[6]);
+}
+
+// Records the latency of completed buffers and loads idle transmit buffers
+// with the head of the queue. Among buffers of equal TXPRI the ECAN sends the
+// highest buffer number first, so a frame is only loaded below every buffer
+// still pending at its priority : buffers are walked from the highest down
+// and frames of one priority leave in queue order. A buffer skipped for that
+// reason is refilled at a later transmit complete interrupt.
+// Called from _C1Interrupt on TBIF and from CAN_tx_queue_push with the CPU 
+// IPL raised
+static void CAN_tx_queue_service (STRUCT_CAN *node)
+{
+    volatile uint8_t *trcon = (volatile uint8_t *)&C1TR01CON;
+    STRUCT_CAN_TX_ENTRY *entry;
+    uint32_t now = TIMER_timebase_get();
+    uint32_t latency;
+    uint8_t floor[CAN_TX_PRIORITY_QTY];     // Lowest pending buffer of each priority
+    uint8_t buf, mask, priority;
+    
+    for (priority = 0; priority < CAN_TX_PRIORITY_QTY; priority++)
+    {
+        floor[priority] = node->tx_buffer_qty;
+    }
+    for (buf = 0; buf < node->tx_buffer_qty; buf++)
+    {
+        mask = 1 << buf;
+        if (trcon[buf] & CAN_TRCON_TXREQ)
+        {
+            // Still pending on the bus
+            if ((node->tx_buf_busy & mask) && (buf < floor[node->tx_buf_priority[buf]]))
+            {
+                floor[node->tx_buf_priority[buf]] = buf;
+            }
+        }
+        else if (node->tx_buf_busy & mask)
+        {
+            latency = now - node->tx_buf_enqueue_time[buf];
+            node->tx_latency_last[node->tx_buf_priority[buf]] = latency;
+            if (latency > node->tx_latency_max[node->tx_buf_priority[buf]])
+            {
+                node->tx_latency_max[node->tx_buf_priority[buf]] = latency;
+            }
+            node->tx_buf_busy &= ~mask;
+            node->stat.bits += CAN_frame_bits(CAN_MSG_BUFFER[buf][0], CAN_MSG_BUFFER[buf][2]);
+            node->stat.tx_frames++;
+        }
+    }
+    
+    for (buf = node->tx_buffer_qty; (buf-- > 0) && (node->tx_queue_count > 0); )
+    {
+        mask = 1 << buf;
+        entry = &node->tx_queue[node->tx_queue_count - 1];
+        if (((trcon[buf] & CAN_TRCON_TXREQ) == 0) && (buf < floor[entry->priority]))
+        {
+            node->tx_queue_count--;
+            CAN_write_tx_buffer(buf, &entry->frame);
+            node->tx_buf_priority[buf] = entry->priority;
+            node->tx_buf_enqueue_time[buf] = entry->frame.timestamp;
+            node->tx_buf_busy |= mask;
+            floor[entry->priority] = buf;
+            trcon[buf] = (trcon[buf] & ~CAN_TRCON_TXPRI) | entry->priority;
+            trcon[buf] |= CAN_TRCON_TXREQ;
+        }
+    }
+}
+
+//*uint8_t CAN_tx_queue_push (STRUCT_CAN *node, STRUCT_CAN_FRAME *frame, uint8_t priority)*//
+//Description : Function inserts a frame in the software transmit queue. The
+//              queue is kept ordered by priority, then by arbitration ID 
+//              (lower ID first), frames of equal rank keep their push order.
+//              Idle hardware transmit buffers are refilled from the queue 
+//              here and from the transmit complete interrupt, so the
+//              application never waits on TXREQ. Once loaded, a frame stays in
+//              its buffer, so a higher priority frame can wait at most one
+//              frame time when every transmit buffer is busy.
+//              Do not mix with CAN_send_msg on the same transmit buffers
+//
+//Function prototype : uint8_t CAN_tx_queue_push (STRUCT_CAN *node, STRUCT_CAN_FRAME *frame, uint8_t priority)
+//
+//Enter params       : STRUCT_CAN *node         : Pointer to a STRUCT_CAN item
+//                     STRUCT_CAN_FRAME *frame  : Frame to send (SID, EID, IDE, RTR, DLC, payload)
+//                     uint8_t priority         : 0 (lowest) to 3 (highest)
+//
+//Exit params        : uint8_t : 1 : Frame queued
+//                               0 : Queue full, invalid priority or node not in normal mode
+//
+//Function call      : CAN_tx_queue_push(CAN1_struct, &frame, 3);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t CAN_tx_queue_push (STRUCT_CAN *node, STRUCT_CAN_FRAME *frame, uint8_t priority)
+{
+    uint16_t cpu_ipl;
+    uint32_t arb_id;
+    uint8_t pos = 0, i;
+    STRUCT_CAN_TX_ENTRY *entry;
+    
+    if (priority >= CAN_TX_PRIORITY_QTY){return 0;}
+    if (CAN_get_mode(node) != CAN_MODE_NORMAL){return 0;}
+    arb_id = ((uint32_t)(frame->SID & 0x07FF) << 18);
+    if (frame->IDE)
+    {
+        arb_id |= (frame->EID & 0x3FFFF);
+    }
+    
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    if (node->tx_queue_count >= CAN_TX_QUEUE_SIZE)
+    {
+        node->tx_queue_overflow++;
+        RESTORE_CPU_IPL(cpu_ipl);
+        return 0;
+    }
+    // Entries below pos are sent after the new frame
+    while ((pos < node->tx_queue_count) && 
+          ((priority > node->tx_queue[pos].priority) || 
+          ((priority == node->tx_queue[pos].priority) && (arb_id < node->tx_queue[pos].arb_id))))
+    {
+        pos++;
+    }
+    for (i = node->tx_queue_count; i > pos; i--)
+    {
+        node->tx_queue[i] = node->tx_queue[i - 1];
+    }
+    entry = &node->tx_queue[pos];
+    entry->frame = *frame;
+    entry->frame.timestamp = TIMER_timebase_get();
+    entry->priority = priority;
+    entry->arb_id = arb_id;
+    node->tx_queue_count++;
+    
+    CAN_tx_queue_service(node);
+    RESTORE_CPU_IPL(cpu_ipl);
+    return 1;
+}
+
+uint8_t CAN_tx_queue_get_count (STRUCT_CAN *node)
+{
+    return node->tx_queue_count;
+}
+
+uint16_t CAN_tx_queue_get_overflow (STRUCT_CAN *node)
+{
+    return node->tx_queue_overflow;
+}
+
+uint32_t CAN_get_tx_latency (STRUCT_CAN *node, uint8_t priority, uint8_t type)
+{
+    uint16_t cpu_ipl;
+    uint32_t value = 0;
+    if (priority >= CAN_TX_PRIORITY_QTY){return 0;}
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    if (type == CAN_TX_LATENCY_LAST)
+    {
+        value = node->tx_latency_last[priority];
+    }
+    else if (type == CAN_TX_LATENCY_MAX)
+    {
+        value = node->tx_latency_max[priority];
+    }
+    RESTORE_CPU_IPL(cpu_ipl);
+    return value;
+}
+
+void CAN_reset_tx_latency (STRUCT_CAN *node)
+{
+    uint16_t cpu_ipl;
+    uint8_t i = 0;
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    for (; i < CAN_TX_PRIORITY_QTY; i++)
+    {
+        node->tx_latency_last[i] = 0;
+        node->tx_latency_max[i] = 0;
+    }
+    node->tx_queue_overflow = 0;
+    RESTORE_CPU_IPL(cpu_ipl);
+}
+
+// Records a transition of the ECAN error state in the history
+// Called from _C1Interrupt on ERRIF and from CAN_stat_update, which catches
+// the return to error active after a bus-off recovery
+static void CAN_stat_check_state (STRUCT_CAN *node)
+{
+    STRUCT_CAN_ERR_EVENT *event;
+    uint8_t state;
+    uint16_t cpu_ipl;
+    
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    if (C1INTFbits.TXBO){state = CAN_STATE_BUS_OFF;}
+    else if (C1INTFbits.TXBP || C1INTFbits.RXBP){state = CAN_STATE_PASSIVE;}
+    else if (C1INTFbits.EWARN){state = CAN_STATE_WARNING;}
+    else {state = CAN_STATE_ACTIVE;}
+    
+    if (state != node->stat.state)
+    {
+        node->stat.state = state;
+        node->stat.state_count[state]++;
+        event = &node->stat.history[node->stat.history_wr_ptr];
+        event->state = state;
+        event->tec = C1ECbits.TERRCNT;
+        event->rec = C1ECbits.RERRCNT;
+        event->timestamp = TIMER_timebase_get();
+        node->stat.history_wr_ptr = (node->stat.history_wr_ptr + 1) & (CAN_ERR_HISTORY_SIZE - 1);
+    }
+    RESTORE_CPU_IPL(cpu_ipl);
+}
+
+//****************uint8_t CAN_stat_update (STRUCT_CAN *node)******************//
+//Description : Function closes the current statistics window and computes 
+//              the node traffic load, the receive / transmit frame rates and
+//              the frame rate of every acceptance filter over it. The load is
+//              the nominal bits of the frames received and of the frames 
+//              sent through the transmit queue, without stuff bits, over the
+//              bus bit rate, so it slightly under-reads a saturated bus.
+//              Frames rejected by the filter table, error frames and
+//              retransmissions are not counted : it is the traffic of this
+//              node, not the bus occupancy
+//              Call it at a fixed rate, ex. every 1s from a scheduler task
+//
+//Function prototype : uint8_t CAN_stat_update (STRUCT_CAN *node)
+//
+//Enter params       : STRUCT_CAN *node : Pointer to a STRUCT_CAN item
+//
+//Exit params        : uint8_t : 1 : Window computed
+//                               0 : No timebase or empty window
+//
+//Function call      : CAN_stat_update(CAN1_struct);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t CAN_stat_update (STRUCT_CAN *node)
+{
+    uint16_t hits[CAN_FILTER_QTY];
+    uint32_t now, elapsed, bits, freq = TIMER_timebase_get_freq();
+    uint16_t rx_frames, tx_frames, cpu_ipl;
+    uint64_t load;
+    uint8_t i = 0;
+    
+    CAN_stat_check_state(node);
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    now = TIMER_timebase_get();
+    elapsed = now - node->stat.window_start;
+    bits = node->stat.bits;
+    rx_frames = node->stat.rx_frames;
+    tx_frames = node->stat.tx_frames;
+    for (i = 0; i < CAN_FILTER_QTY; i++)
+    {
+        hits[i] = node->stat.filter_hits[i];
+        node->stat.filter_hits[i] = 0;
+    }
+    node->stat.bits = 0;
+    node->stat.rx_frames = 0;
+    node->stat.tx_frames = 0;
+    node->stat.window_start = now;
+    RESTORE_CPU_IPL(cpu_ipl);
+    
+    if ((freq == 0) || (elapsed == 0) || (node->bus_freq == 0)){return 0;}
+    
+    // load = bits / (bus_freq * elapsed / freq), in permille
+    load = ((uint64_t)bits * freq * 1000ULL) / ((uint64_t)node->bus_freq * elapsed);
+    node->stat.load_last = (load > 1000) ? 1000 : (uint16_t)load;
+    node->stat.load_avg = (uint16_t)((((uint32_t)node->stat.load_avg * 7) + node->stat.load_last) >> 3);
+    if (node->stat.load_last > node->stat.load_max)
+    {
+        node->stat.load_max = node->stat.load_last;
+    }
+    node->stat.rx_fps = (uint16_t)(((uint64_t)rx_frames * freq) / elapsed);
+    node->stat.tx_fps = (uint16_t)(((uint64_t)tx_frames * freq) / elapsed);
+    for (i = 0; i < CAN_FILTER_QTY; i++)
+    {
+        node->stat.filter_fps[i] = (uint16_t)(((uint64_t)hits[i] * freq) / elapsed);
+    }
+    return 1;
+}
+
+//*************uint16_t CAN_stat_get (STRUCT_CAN *node, uint8_t type)***********//
+//Description : Function returns a statistic of the last CAN_stat_update window
+//              CAN_STAT_LOAD_x is the node traffic load in permille of the 
+//              bus bit rate, only the frames accepted by the filter table 
+//              and the frames sent by this node are counted
+//
+//Function prototype : uint16_t CAN_stat_get (STRUCT_CAN *node, uint8_t type)
+//
+//Enter params       : STRUCT_CAN *node : Pointer to a STRUCT_CAN item
+//                     uint8_t type : CAN_STAT_x
+//
+//Exit params        : uint16_t : Statistic value, 0 if type is unknown
+//
+//Function call      : load = CAN_stat_get(CAN1_struct, CAN_STAT_LOAD_AVG);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint16_t CAN_stat_get (STRUCT_CAN *node, uint8_t type)
+{
+    switch (type)
+    {
+        case CAN_STAT_LOAD_LAST:
+            return node->stat.load_last;
+            break;
+            
+        case CAN_STAT_LOAD_AVG:
+            return node->stat.load_avg;
+            break;
+            
+        case CAN_STAT_LOAD_MAX:
+            return node->stat.load_max;
+            break;
+            
+        case CAN_STAT_RX_FPS:
+            return node->stat.rx_fps;
+            break;
+            
+        case CAN_STAT_TX_FPS:
+            return node->stat.tx_fps;
+            break;
+            
+        case CAN_STAT_STATE:
+            return node->stat.state;
+            break;
+            
+        case CAN_STAT_WARNING_CNT:
+            return node->stat.state_count[CAN_STATE_WARNING];
+            break;
+            
+        case CAN_STAT_PASSIVE_CNT:
+            return node->stat.state_count[CAN_STATE_PASSIVE];
+            break;
+            
+        case CAN_STAT_BUS_OFF_CNT:
+            return node->stat.state_count[CAN_STATE_BUS_OFF];
+            break;
+            
+        default:
+            return 0;
+            break;
+    }
+}
+
+uint16_t CAN_stat_get_filter_fps (STRUCT_CAN *node, uint8_t filter)
+{
+    if (filter < CAN_FILTER_QTY)
+    {
+        return node->stat.filter_fps[filter];
+    }
+    else
+        return 0;
+}
+
+// Copies an error state transition, age 0 is the most recent
+// Returns 0 when the history holds fewer events
+uint8_t CAN_stat_get_error_event (STRUCT_CAN *node, uint8_t age, STRUCT_CAN_ERR_EVENT *event)
+{
+    uint16_t cpu_ipl, events = 0;
+    uint8_t i = 0;
+    
+    if (age >= CAN_ERR_HISTORY_SIZE){return 0;}
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    for (; i < CAN_STATE_QTY; i++)
+    {
+        events += node->stat.state_count[i];
+    }
+    if (age >= events)
+    {
+        RESTORE_CPU_IPL(cpu_ipl);
+        return 0;
+    }
+    *event = node->stat.history[(node->stat.history_wr_ptr - 1 - age) & (CAN_ERR_HISTORY_SIZE - 1)];
+    RESTORE_CPU_IPL(cpu_ipl);
+    return 1;
+}
+
+void CAN_stat_reset (STRUCT_CAN *node)
+{
+    uint16_t cpu_ipl;
+    uint8_t i = 0;
+    
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    node->stat.bits = 0;
+    node->stat.rx_frames = 0;
+    node->stat.tx_frames = 0;
+    for (; i < CAN_FILTER_QTY; i++)
+    {
+        node->stat.filter_hits[i] = 0;
+        node->stat.filter_fps[i] = 0;
+    }
+    node->stat.window_start = TIMER_timebase_get();
+    node->stat.load_last = 0;
+    node->stat.load_avg = 0;
+    node->stat.load_max = 0;
+    node->stat.rx_fps = 0;
+    node->stat.tx_fps = 0;
+    node->stat.state = CAN_STATE_ACTIVE;
+    for (i = 0; i < CAN_STATE_QTY; i++)
+    {
+        node->stat.state_count[i] = 0;
+    }
+    node->stat.history_wr_ptr = 0;
+    RESTORE_CPU_IPL(cpu_ipl);
+}
+
 // ECAN1 event interrupt
 void __attribute__((__interrupt__, no_auto_psv))_C1Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_C1);
     IFS2bits.C1IF = 0;      // clear interrupt flag
     if(C1INTFbits.TBIF)     // Transmit buffer interrupt flag
     {
         CAN_struct[CAN_1].tbif_flag = 1;
         C1INTFbits.TBIF = 0;
+        CAN_tx_queue_service(&CAN_struct[CAN_1]);   // Refill idle transmit buffers from the queue
     }
 
     if(C1INTFbits.RBIF)     // Receive buffer interrupt flag
     {
-        CAN_struct[CAN_1].rbif_flag = 1;
         C1INTFbits.RBIF = 0;
+        CAN_rx_fifo_drain(&CAN_struct[CAN_1]);
+        CAN_struct[CAN_1].rbif_flag = 1;
+    }
+    
+    if (C1INTFbits.RBOVIF)  // A full hardware buffer was overwritten before the drain
+    {
+        CAN_struct[CAN_1].rx_hw_overflow++;
+        C1RXOVF1 = 0;
+        C1RXOVF2 = 0;
+        C1INTFbits.RBOVIF = 0;
     }
     
     if (C1INTFbits.ERRIF)
     {        
+        CAN_stat_check_state(&CAN_struct[CAN_1]);
         CAN_struct[CAN_1].ivr_flag = 1;
         if (C1INTFbits.IVRIF)   // Invalid message interrupt triggered?
         {
@@ -761,6 +1705,7 @@ void __attribute__((__interrupt__, no_auto_psv))_C1Interrupt(void)
         }
         C1INTFbits.ERRIF = 0;
     }
+    ISR_STAT_EXIT(ISR_VECT_C1);
 }
 
 //// ECAN1 Receive data ready interrupt
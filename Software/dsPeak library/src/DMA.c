@@ -1,4 +1,5 @@
 #include "DMA.h"
+#include "isr_stat.h"
 STRUCT_DMA DMA_struct[DMA_QTY];
 
 void DMA_init (uint8_t channel)
@@ -1051,90 +1052,120 @@ void DMA_set_txfer_state (uint8_t channel, uint8_t state)
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA0Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA0);
     IFS0bits.DMA0IF = 0;
     DMA_struct[DMA_CH0].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA0);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA1Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA1);
     IFS0bits.DMA1IF = 0;
     DMA_struct[DMA_CH1].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA1);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA2Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA2);
     IFS1bits.DMA2IF = 0;
     DMA_struct[DMA_CH2].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA2);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA3Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA3);
     IFS2bits.DMA3IF = 0;
     DMA_struct[DMA_CH3].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA3);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA4Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA4);
     IFS2bits.DMA4IF = 0;
     DMA_struct[DMA_CH4].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA4);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA5Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA5);
     IFS3bits.DMA5IF = 0;
     DMA_struct[DMA_CH5].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA5);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA6Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA6);
     IFS4bits.DMA6IF = 0;
     DMA_struct[DMA_CH6].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA6);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA7Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA7);
     IFS4bits.DMA7IF = 0;
     DMA_struct[DMA_CH7].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA7);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA8Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA8);
     IFS7bits.DMA8IF = 0;
     DMA_struct[DMA_CH8].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA8);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA9Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA9);
     IFS7bits.DMA9IF = 0;
     DMA_struct[DMA_CH9].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA9);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA10Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA10);
     IFS7bits.DMA10IF = 0;
     DMA_struct[DMA_CH10].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA10);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA11Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA11);
     IFS7bits.DMA11IF = 0;
     DMA_struct[DMA_CH11].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA11);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA12Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA12);
     IFS8bits.DMA12IF = 0;
     DMA_struct[DMA_CH12].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA12);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA13Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA13);
     IFS8bits.DMA13IF = 0;
     DMA_struct[DMA_CH13].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA13);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_DMA14Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DMA14);
     IFS8bits.DMA14IF = 0;
     DMA_struct[DMA_CH14].txfer_state = DMA_TXFER_DONE;
+    ISR_STAT_EXIT(ISR_VECT_DMA14);
 }
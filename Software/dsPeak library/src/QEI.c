@@ -13,6 +13,7 @@
 //              uint8_t QEI_get_event (uint8_t channel);
 //              uint8_t QEI_get_direction (uint8_t channel);
 //              uint16_t QEI_get_velocity (uint8_t channel);
+//              uint32_t QEI_get_speed_rpm_q16 (uint8_t channel);
 //              void QEI_calculate_velocity (uint8_t channel);
 //              void QEI_interrupt_handle (uint8_t channel);
 //
@@ -23,9 +24,94 @@
 //Jean-Francois Bilodeau    MPLab X v5.10    10/02/2020 
 //****************************************************************************//
 #include "QEI.h"
+#include "isr_stat.h"
 
 STRUCT_QEI QEI_struct[QEI_QTY];
 
+// Reads a 32-bit QEI counter that keeps running during the read (INTxTMR)
+static uint32_t QEI_read_32b (volatile uint16_t *high, volatile uint16_t *low)
+{
+    uint16_t msw = 0, lsw = 0;
+    do
+    {
+        msw = *high;
+        lsw = *low;
+    }while (msw != *high);   // Low word rolled over between the reads
+    return (((uint32_t)msw << 16) | lsw);
+}
+
+// Per channel RPM constant, called when the cpr or the gear derate changes
+// so the velocity path never divides by pulse_per_tour
+static void QEI_set_rpm_num (uint8_t channel)
+{
+    STRUCT_QEI *qei = &QEI_struct[channel];
+    
+    qei->pulse_per_tour = (uint32_t)qei->motor_gear_derate * qei->motor_cpr;
+    if (qei->pulse_per_tour == 0)
+    {
+        qei->rpm_num = 0;
+    }
+    else
+    {
+        qei->rpm_num = QEI_VEL_RPM_NUM / qei->pulse_per_tour;
+    }
+}
+
+// Q16.16 RPM of count edges over span FCY ticks, 32-bit math only
+// count x rpm_num is a 48-bit product, it is divided by span 4 bits at a 
+// time (long division) with 4 more steps for the 16 fraction bits
+static uint32_t QEI_rpm_q16 (uint8_t channel, uint16_t count, uint32_t span)
+{
+    uint32_t rpm_num = QEI_struct[channel].rpm_num;
+    uint32_t num_hi = 0, num_lo = 0, part = 0, rpm = 0, rem = 0;
+    uint8_t i = 0, nibble = 0;
+    
+    if ((span == 0) || (rpm_num == 0))
+    {
+        return 0;
+    }
+    // num_hi:num_lo = count x rpm_num
+    num_lo = (uint32_t)count * (rpm_num & 0xFFFF);
+    part = (uint32_t)count * (rpm_num >> 16);
+    num_hi = part >> 16;
+    part <<= 16;
+    num_lo += part;
+    if (num_lo < part)
+    {
+        num_hi++;
+    }
+    while (span > 0x0FFFFFFFUL)                 // rem << 4 must fit 32 bits
+    {
+        span >>= 1;
+        num_lo = (num_lo >> 1) | (num_hi << 31);
+        num_hi >>= 1;
+    }
+    // 4 nibbles of num_hi, 8 of num_lo, 4 fraction nibbles
+    for (i = 0; i < 16; i++)
+    {
+        if (i < 4)
+        {
+            nibble = (num_hi >> (12 - (i * 4))) & 0x0F;
+        }
+        else if (i < 12)
+        {
+            nibble = (num_lo >> (28 - ((i - 4) * 4))) & 0x0F;
+        }
+        else
+        {
+            nibble = 0;
+        }
+        if (rpm & 0xF0000000UL)
+        {
+            return 0xFFFFFFFFUL;                // Over 65535 RPM
+        }
+        rem = (rem << 4) | nibble;
+        rpm = (rpm << 4) | (rem / span);
+        rem = rem % span;
+    }
+    return rpm;
+}
+
 //*****************void QEI_init (uint8_t channel)**********************//
 //Description : Function initializes hardware QEI module (CNI pin, pos edge int)
 //
@@ -54,6 +140,7 @@ void QEI_init (uint8_t channel)
             RPINR14bits.QEA1R = 22;     // RA6 (RPI22) assigned to QEI_1A
             
             QEI1CONbits.PIMOD = 0;      // 
+            QEI1CONbits.INTDIV = QEI_VEL_INTDIV;  // Interval timer clock, edge timed velocity
             QEI1GECH = 0;               // Only use 32bit value for the Greather than or equal compare register
             QEI1GECL = QEI_MOT1_PPT;    // Set default pulse per revolution value
             QEI1STATbits.PCHEQIEN = 1;  // Enable position counter >= cmp interrupt enable
@@ -78,6 +165,7 @@ void QEI_init (uint8_t channel)
             RPINR16bits.QEA2R = 124;    // RG12 (RP124) assigned to QEI_2A   
             
             QEI2CONbits.PIMOD = 0;      // 
+            QEI2CONbits.INTDIV = QEI_VEL_INTDIV;  // Interval timer clock, edge timed velocity
             QEI2GECH = 0;               // Only use 32bit value for the Greather than or equal compare register
             QEI2GECL = QEI_MOT2_PPT;    // Set default pulse per revolution value
             QEI2STATbits.PCHEQIEN = 1;  // Enable position counter >= cmp interrupt enable
@@ -103,6 +191,8 @@ void QEI_init (uint8_t channel)
             break;
             
     }
+    QEI_struct[channel].speed_rpm_q16 = 0;
+    QEI_struct[channel].has_edge = 0;
 //    QEI_struct[channel].int_event = 0;          // Reset QEI vars on initialization
 //    QEI_struct[channel].pulse_getter = 0;       
 //    QEI_struct[channel].pulse_cnter_dist = 0;
@@ -236,7 +326,7 @@ void QEI_reset_pulse (uint8_t channel)
 void QEI_set_gear_derate (uint8_t channel, uint16_t new_gear_derate)
 {
     QEI_struct[channel].motor_gear_derate = new_gear_derate;
-    QEI_struct[channel].pulse_per_tour = QEI_struct[channel].motor_gear_derate * QEI_struct[channel].motor_cpr;
+    QEI_set_rpm_num(channel);           // pulse_per_tour and the velocity constant
     QEI_reset_tour(channel);
     QEI_reset_pulse(channel);    
 }
@@ -276,7 +366,7 @@ uint16_t QEI_get_gear_derate (uint8_t channel)
 void QEI_set_cpr (uint8_t channel, uint16_t new_cpr)
 {
     QEI_struct[channel].motor_cpr = new_cpr;
-    QEI_struct[channel].pulse_per_tour = QEI_struct[channel].motor_gear_derate * QEI_struct[channel].motor_cpr;
+    QEI_set_rpm_num(channel);           // pulse_per_tour and the velocity constant
     QEI_reset_tour(channel);
     QEI_reset_pulse(channel);
 }
@@ -407,8 +497,29 @@ uint16_t QEI_get_velocity (uint8_t channel)
     return QEI_struct[channel].velocity;
 }
 
+// Speed with fractional RPM, Q16.16 (65536 = 1 RPM)
+uint32_t QEI_get_speed_rpm_q16 (uint8_t channel)
+{
+    return QEI_struct[channel].speed_rpm_q16;
+}
+
 //*********void QEI_calculate_velocity (uint8_t channel)***********//
-//Description : Function computes and interpolates speed to cm/s
+//Description : Function computes the motor speed, called at refresh_freq
+//              The count of the period (VELxCNT) is divided by the time 
+//              between the last edge of this period and the last edge of 
+//              the previous period that had edges. An edge time is the
+//              timebase value minus the interval timer (time since the last
+//              edge). Resolution is 1 FCY tick at any speed instead of 
+//              1 count per period. A period without edge lowers the speed
+//              to 1 count / time since the last edge, the speed is 0 after
+//              QEI_VEL_TIMEOUT without edge. Direction changes within a 
+//              period are seen as the net count.
+//              VELxCNT and INTxTMR cannot be read at once, an edge between
+//              the reads would pair a count with the time of the edge
+//              before it. INTxTMR is read again after VELxCNT, an edge reset
+//              it, and the read is redone with the counts accumulated, up
+//              to QEI_VEL_READ_TRIES times. Past that (edges faster than 
+//              the reads) the one count error is accepted.
 //
 //Function prototype : void QEI_calculate_velocity (uint8_t channel)
 //
@@ -422,26 +533,110 @@ uint16_t QEI_get_velocity (uint8_t channel)
 //****************************************************************************//
 void QEI_calculate_velocity (uint8_t channel)
 {
+    STRUCT_QEI *qei = &QEI_struct[channel];
+    int16_t count = 0;
+    uint32_t now = 0, since = 0, hold = 0, edge = 0, scale = 0, bound = 0, after = 0;
+    uint32_t freq = TIMER_timebase_get_freq();
+    uint16_t cpu_ipl;
+    uint8_t tries = 0;
+    
+    if (freq != 0)
+    {
+        scale = FCY / freq;                 // FCY ticks per timebase tick
+    }
+    
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
     switch (channel)
     {
         case QEI_1:
-            // Update the actual speed
-            QEI_struct[channel].velocity = abs(VEL1CNT);
-            QEI_struct[channel].speed_rps = (uint16_t)(QEI_struct[channel].velocity * QEI_struct[channel].refresh_freq);
-            QEI_struct[channel].speed_rpm = (uint16_t)((QEI_struct[channel].velocity * 60 * QEI_struct[channel].refresh_freq) / QEI_struct[channel].pulse_per_tour);
+            do
+            {
+                now = TIMER_timebase_get();
+                since = QEI_read_32b(&INT1TMRH, &INT1TMRL);
+                count += (int16_t)VEL1CNT;                  // Cleared on read
+                hold = QEI_read_32b(&INT1HLDH, &INT1HLDL);  // Period before the last edge
+                after = QEI_read_32b(&INT1TMRH, &INT1TMRL);
+            }while ((after < since) && (++tries < QEI_VEL_READ_TRIES));   // Edge during the reads
             break; 
             
         case QEI_2:
-            // Update the actual speed
-            QEI_struct[channel].velocity = abs(VEL2CNT);
-            QEI_struct[channel].speed_rps = (uint16_t)(QEI_struct[channel].velocity * QEI_struct[channel].refresh_freq);
-            QEI_struct[channel].speed_rpm = (uint16_t)((QEI_struct[channel].velocity * 60 * QEI_struct[channel].refresh_freq) / QEI_struct[channel].pulse_per_tour);
-            break;          
+            do
+            {
+                now = TIMER_timebase_get();
+                since = QEI_read_32b(&INT2TMRH, &INT2TMRL);
+                count += (int16_t)VEL2CNT;
+                hold = QEI_read_32b(&INT2HLDH, &INT2HLDL);
+                after = QEI_read_32b(&INT2TMRH, &INT2TMRL);
+            }while ((after < since) && (++tries < QEI_VEL_READ_TRIES));
+            break;
+            
+        default:
+            RESTORE_CPU_IPL(cpu_ipl);
+            return;
+            break;
+    }
+    RESTORE_CPU_IPL(cpu_ipl);
+    
+    qei->velocity = abs(count);
+    qei->speed_rps = (uint16_t)(qei->velocity * qei->refresh_freq);
+    if (count != 0)
+    {
+        qei->direction = (count < 0) ? QEI_DIR_BACKWARD : QEI_DIR_FORWARD;
+    }
+    
+    if (scale == 0)
+    {
+        // No timebase, count per refresh period
+        if (qei->refresh_freq != 0)
+        {
+            qei->speed_rpm_q16 = QEI_rpm_q16(channel, (uint16_t)qei->velocity, FCY / qei->refresh_freq);
+        }
+    }
+    else if (count != 0)
+    {
+        edge = (now * scale) - since;       // Wraps with the timebase
+        if ((qei->has_edge == 1) && ((edge - qei->last_edge) <= QEI_VEL_TIMEOUT))
+        {
+            qei->speed_rpm_q16 = QEI_rpm_q16(channel, (uint16_t)qei->velocity, edge - qei->last_edge);
+        }
+        else
+        {
+            // Starting, only the period of the last edge is known
+            qei->speed_rpm_q16 = QEI_rpm_q16(channel, 1, hold);
+        }
+        qei->last_edge = edge;
+        qei->has_edge = 1;
+    }
+    else
+    {
+        if (since > QEI_VEL_TIMEOUT)
+        {
+            qei->speed_rpm_q16 = 0;
+            qei->has_edge = 0;
+        }
+        else
+        {
+            // The next edge is late, speed is at most 1 count / since
+            bound = QEI_rpm_q16(channel, 1, since);
+            if (bound < qei->speed_rpm_q16)
+            {
+                qei->speed_rpm_q16 = bound;
+            }
+        }
+    }
+    if (qei->speed_rpm_q16 >= 0xFFFF0000UL)
+    {
+        qei->speed_rpm = 0xFFFF;
+    }
+    else
+    {
+        qei->speed_rpm = (uint16_t)((qei->speed_rpm_q16 + 32768UL) >> 16);
     }
 }
 
 void __attribute__((__interrupt__, no_auto_psv)) _QEI1Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_QEI1);
     IFS3bits.QEI1IF = 0;
     if (QEI1STATbits.PCHEQIRQ == 1)
     {       
@@ -450,10 +645,12 @@ void __attribute__((__interrupt__, no_auto_psv)) _QEI1Interrupt(void)
         QEI_struct[QEI_1].tour_cnter_dist++;
         if(QEI_struct[QEI_1].tour_cnter_dist > MAX_TOUR_CNT){QEI_struct[QEI_1].tour_cnter_dist = 0;}
     }
+    ISR_STAT_EXIT(ISR_VECT_QEI1);
 }
 
 void __attribute__((__interrupt__, no_auto_psv)) _QEI2Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_QEI2);
     IFS4bits.QEI2IF = 0;
     if (QEI2STATbits.PCHEQIRQ == 1)
     {       
@@ -462,4 +659,5 @@ void __attribute__((__interrupt__, no_auto_psv)) _QEI2Interrupt(void)
         QEI_struct[QEI_2].tour_cnter_dist++;
         if(QEI_struct[QEI_2].tour_cnter_dist > MAX_TOUR_CNT){QEI_struct[QEI_2].tour_cnter_dist = 0;}
     }    
+    ISR_STAT_EXIT(ISR_VECT_QEI2);
 }
\ No newline at end of file
@@ -15,8 +15,50 @@
 // www.github.com/lecejeff/dspeak
 //****************************************************************************//
 #include "Timer.h"
+#include "isr_stat.h"
 
 STRUCT_TIMER TIMER_struct[TIMER_QTY];
+STRUCT_TIMER *TIMER_timebase = 0;     // Timer pair used as the 32-bit system timebase
+static const uint8_t TIMER_prescaler_shift[4] = {0, 3, 6, 8};
+
+// Instruction cycles elapsed since the period match that raised the interrupt
+#define TIMER_ISR_LATENCY(tmr, ch) (((uint32_t)(tmr)) << TIMER_prescaler_shift[TIMER_struct[ch].prescaler])
+
+#ifdef ISR_STAT_ENABLE
+// Same for the interrupt of a 32-bit timer pair, raised by the slave timer.
+// The pair counts with the master timer prescaler, reading TMRx latches 
+// the upper word into TMRyHLD.
+static uint32_t TIMER_isr_latency_32b (uint8_t master)
+{
+    uint32_t count = 0;
+    switch (master)
+    {
+        case TIMER_2:
+            count = TMR2;
+            count |= ((uint32_t)TMR3HLD << 16);
+            break;
+            
+        case TIMER_4:
+            count = TMR4;
+            count |= ((uint32_t)TMR5HLD << 16);
+            break;
+            
+        case TIMER_6:
+            count = TMR6;
+            count |= ((uint32_t)TMR7HLD << 16);
+            break;
+            
+        case TIMER_8:
+            count = TMR8;
+            count |= ((uint32_t)TMR9HLD << 16);
+            break;
+            
+        default:
+            break;
+    }
+    return (count << TIMER_prescaler_shift[TIMER_struct[master].prescaler]);
+}
+#endif
 
 //
 //Description : 
@@ -573,6 +615,9 @@ uint8_t TIMER_init (STRUCT_TIMER *timer, uint8_t channel, uint8_t mode, uint8_t
     timer->freq = freq;
     timer->prescaler = prescaler;
     timer->int_state = 0; 
+    timer->expiry_cnt = 0;
+    timer->elapsed = 0;
+    timer->overrun = 0;
     timer->mode = mode;
     return 1;
 }
@@ -1454,6 +1499,28 @@ uint8_t TIMER_stop (STRUCT_TIMER *timer)
     return 1;
 }
 
+// Atomically collects the periods counted by the ISR since the last read.
+// Every period beyond the first one was not seen by the caller and is 
+// accumulated in the overrun counter.
+static uint16_t TIMER_take_expiry (STRUCT_TIMER *timer)
+{
+    uint16_t cpu_ipl;
+    uint16_t expiry;
+    
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    expiry = timer->expiry_cnt;
+    timer->expiry_cnt = 0;
+    timer->int_state = 0;
+    RESTORE_CPU_IPL(cpu_ipl);
+    
+    timer->elapsed = expiry;
+    if (expiry > 1)
+    {
+        timer->overrun += (expiry - 1);
+    }
+    return expiry;
+}
+
 //***********uint8_t TIMER_get_state (uint8_t timer, uint8_t type)************//
 //Description : Function returns timer module state
 //
@@ -1481,7 +1548,7 @@ uint8_t TIMER_get_state (STRUCT_TIMER *timer, uint8_t type)
         case TIMER_INT_STATE:
             if (timer->int_state)
             {
-                timer->int_state = 0;
+                TIMER_take_expiry(timer);
                 return 1;
             }
             else return 0;
@@ -1493,72 +1560,514 @@ uint8_t TIMER_get_state (STRUCT_TIMER *timer, uint8_t type)
     }
 }
 
+//***********uint16_t TIMER_get_elapsed (STRUCT_TIMER *timer)*****************//
+//Description : Function returns the number of timer periods that expired 
+//              since the last call to TIMER_get_elapsed() or 
+//              TIMER_get_state(TIMER_INT_STATE), and clears the interrupt 
+//              state. A value greater than 1 means the caller was late and 
+//              (value - 1) periods were missed, those are also accumulated in 
+//              the timer overrun counter.
+//
+//Function prototype : uint16_t TIMER_get_elapsed (STRUCT_TIMER *timer)
+//
+//Enter params       : STRUCT_TIMER *timer : timer structure
+//
+//Exit params        : uint16_t : number of expired periods, 0 if none
+//
+//Function call      : uint16_t = TIMER_get_elapsed(TIMER7_struct);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint16_t TIMER_get_elapsed (STRUCT_TIMER *timer)
+{
+    if (timer->int_state)
+    {
+        return TIMER_take_expiry(timer);
+    }
+    return 0;
+}
+
+// Returns the number of periods the last TIMER_INT_STATE read collapsed into one
+uint16_t TIMER_get_last_elapsed (STRUCT_TIMER *timer)
+{
+    return timer->elapsed;
+}
+
+// Returns the total number of missed periods since init or last clear
+uint32_t TIMER_get_overrun (STRUCT_TIMER *timer)
+{
+    return timer->overrun;
+}
+
+void TIMER_clear_overrun (STRUCT_TIMER *timer)
+{
+    timer->overrun = 0;
+}
+
+//******uint32_t TIMER_get_ticks_to_expiry (STRUCT_TIMER *timer)***************//
+//Description : Function returns the number of instruction cycles left before 
+//              the timer reaches its period and raises its interrupt. 
+//              Returns 0 when the timer interrupt is already pending and 
+//              0xFFFFFFFF when the timer is not running or is the timebase,
+//              which raises no interrupt.
+//
+//Function prototype : uint32_t TIMER_get_ticks_to_expiry (STRUCT_TIMER *timer)
+//
+//Enter params       : STRUCT_TIMER *timer : timer structure
+//
+//Exit params        : uint32_t : instruction cycles until the next expiry
+//
+//Function call      : uint32_t = TIMER_get_ticks_to_expiry(TIMER1_struct);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint32_t TIMER_get_ticks_to_expiry (STRUCT_TIMER *timer)
+{
+    uint32_t count = 0, period = 0;
+    uint16_t cpu_ipl;
+    
+    if ((timer->running == 0) || (timer == TIMER_timebase))
+    {
+        return 0xFFFFFFFF;
+    }
+    if (timer->int_state)
+    {
+        return 0;
+    }
+    
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    switch (timer->TIMER_channel)
+    {
+        case TIMER_1:
+            count = TMR1;
+            period = PR1;
+            break;
+            
+        case TIMER_2:
+            if (timer->mode == TIMER_MODE_32B)
+            {
+                count = TMR2;
+                count |= ((uint32_t)TMR3HLD << 16);
+                period = ((uint32_t)PR3 << 16) | PR2;
+            }
+            else
+            {
+                count = TMR2;
+                period = PR2;
+            }
+            break;
+            
+        case TIMER_3:
+            count = TMR3;
+            period = PR3;
+            break;
+            
+        case TIMER_4:
+            if (timer->mode == TIMER_MODE_32B)
+            {
+                count = TMR4;
+                count |= ((uint32_t)TMR5HLD << 16);
+                period = ((uint32_t)PR5 << 16) | PR4;
+            }
+            else
+            {
+                count = TMR4;
+                period = PR4;
+            }
+            break;
+            
+        case TIMER_5:
+            count = TMR5;
+            period = PR5;
+            break;
+            
+        case TIMER_6:
+            if (timer->mode == TIMER_MODE_32B)
+            {
+                count = TMR6;
+                count |= ((uint32_t)TMR7HLD << 16);
+                period = ((uint32_t)PR7 << 16) | PR6;
+            }
+            else
+            {
+                count = TMR6;
+                period = PR6;
+            }
+            break;
+            
+        case TIMER_7:
+            count = TMR7;
+            period = PR7;
+            break;
+            
+        case TIMER_8:
+            if (timer->mode == TIMER_MODE_32B)
+            {
+                count = TMR8;
+                count |= ((uint32_t)TMR9HLD << 16);
+                period = ((uint32_t)PR9 << 16) | PR8;
+            }
+            else
+            {
+                count = TMR8;
+                period = PR8;
+            }
+            break;
+            
+        case TIMER_9:
+            count = TMR9;
+            period = PR9;
+            break;
+            
+        default:
+            break;
+    }
+    RESTORE_CPU_IPL(cpu_ipl);
+    
+    if (count >= period)
+    {
+        return 0;
+    }
+    // Saturate instead of overflowing for long 32b periods with a large prescaler
+    if ((period - count) > (0xFFFFFFFF >> TIMER_prescaler_shift[timer->prescaler]))
+    {
+        return 0xFFFFFFFF;
+    }
+    return ((period - count) << TIMER_prescaler_shift[timer->prescaler]);
+}
+
+//**uint8_t TIMER_timebase_init (STRUCT_TIMER *timer, uint8_t channel, uint8_t prescaler)**//
+//Description : Function configures a Type B / Type C timer pair as a 32-bit
+//              free-running counter used as the system timebase. The counter
+//              rolls over at 2^32 and does not generate any interrupt.
+//              At 70MIPS with TIMER_PRESCALER_1, the timebase wraps every 61s
+//              and has a resolution of 1 instruction cycle.
+//
+//Function prototype : uint8_t TIMER_timebase_init (STRUCT_TIMER *timer, uint8_t channel, uint8_t prescaler)
+//
+//Enter params       : STRUCT_TIMER *timer : timer structure
+//                     uint8_t channel : TIMER_2, TIMER_4, TIMER_6 or TIMER_8
+//                     uint8_t prescaler : TIMER_PRESCALER_x
+//
+//Exit params        : uint8_t : 1 if success, 0 otherwise
+//
+//Function call      : TIMER_timebase_init(TIMER8_struct, TIMER_8, TIMER_PRESCALER_1);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t TIMER_timebase_init (STRUCT_TIMER *timer, uint8_t channel, uint8_t prescaler)
+{
+    if (prescaler > TIMER_PRESCALER_256)
+    {
+        return 0;
+    }
+    
+    switch (channel)
+    {
+        case TIMER_2:
+            T2CON = 0;              // Clear Timer2 control register
+            T3CON = 0;              // Clear associated timer for 32b operation
+            IEC0bits.T3IE = 0;      // Timebase does not use interrupts
+            IFS0bits.T3IF = 0;
+            T2CONbits.T32 = 1;
+            T2CONbits.TCKPS = prescaler;
+            TMR3HLD = 0;            // Write MSW to holding register first
+            TMR2 = 0;
+            PR3 = 0xFFFF;           // Free-running, roll over at 2^32
+            PR2 = 0xFFFF;
+            T2CONbits.TON = 1;
+            break;
+            
+        case TIMER_4:
+            T4CON = 0;
+            T5CON = 0;
+            IEC1bits.T5IE = 0;
+            IFS1bits.T5IF = 0;
+            T4CONbits.T32 = 1;
+            T4CONbits.TCKPS = prescaler;
+            TMR5HLD = 0;
+            TMR4 = 0;
+            PR5 = 0xFFFF;
+            PR4 = 0xFFFF;
+            T4CONbits.TON = 1;
+            break;
+            
+        case TIMER_6:
+            T6CON = 0;
+            T7CON = 0;
+            IEC3bits.T7IE = 0;
+            IFS3bits.T7IF = 0;
+            T6CONbits.T32 = 1;
+            T6CONbits.TCKPS = prescaler;
+            TMR7HLD = 0;
+            TMR6 = 0;
+            PR7 = 0xFFFF;
+            PR6 = 0xFFFF;
+            T6CONbits.TON = 1;
+            break;
+            
+        case TIMER_8:
+            T8CON = 0;
+            T9CON = 0;
+            IEC3bits.T9IE = 0;
+            IFS3bits.T9IF = 0;
+            T8CONbits.T32 = 1;
+            T8CONbits.TCKPS = prescaler;
+            TMR9HLD = 0;
+            TMR8 = 0;
+            PR9 = 0xFFFF;
+            PR8 = 0xFFFF;
+            T8CONbits.TON = 1;
+            break;
+            
+        default:
+            return 0;   // Only Type B timers can be paired to a 32b timer
+            break;
+    }
+    
+    timer->TIMER_channel = channel;
+    timer->mode = TIMER_MODE_32B;
+    timer->prescaler = prescaler;
+    timer->freq = (FCY >> TIMER_prescaler_shift[prescaler]);  // Timebase tick frequency
+    timer->int_state = 0;
+    timer->running = 1;
+    TIMER_timebase = timer;
+    return 1;
+}
+
+//**********************uint32_t TIMER_timebase_get (void)*******************//
+//Description : Function returns the current value of the 32-bit timebase.
+//              Reading TMRx latches TMRy into TMRyHLD, so interrupts are
+//              masked during the read to prevent an ISR that also reads the
+//              timebase from corrupting the holding register.
+//
+//Function prototype : uint32_t TIMER_timebase_get (void)
+//
+//Enter params       : None
+//
+//Exit params        : uint32_t : timebase count, 0 if timebase not initialized
+//
+//Function call      : uint32_t = TIMER_timebase_get();
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint32_t TIMER_timebase_get (void)
+{
+    uint16_t lsw = 0, msw = 0;
+    uint16_t cpu_ipl;
+    
+    if (TIMER_timebase == 0)
+    {
+        return 0;
+    }
+    
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    switch (TIMER_timebase->TIMER_channel)
+    {
+        case TIMER_2:
+            lsw = TMR2;
+            msw = TMR3HLD;
+            break;
+            
+        case TIMER_4:
+            lsw = TMR4;
+            msw = TMR5HLD;
+            break;
+            
+        case TIMER_6:
+            lsw = TMR6;
+            msw = TMR7HLD;
+            break;
+            
+        case TIMER_8:
+            lsw = TMR8;
+            msw = TMR9HLD;
+            break;
+            
+        default:
+            break;
+    }
+    RESTORE_CPU_IPL(cpu_ipl);
+    return (((uint32_t)msw << 16) | lsw);
+}
+
+// Returns the timebase tick frequency in Hz, 0 if timebase not initialized
+uint32_t TIMER_timebase_get_freq (void)
+{
+    if (TIMER_timebase == 0)
+    {
+        return 0;
+    }
+    return TIMER_timebase->freq;
+}
+
+// Converts a duration expressed in microseconds to timebase ticks
+// 64-bit intermediate math, intended for init-time conversions
+uint32_t TIMER_timebase_us_to_ticks (uint32_t us)
+{
+    if (TIMER_timebase == 0)
+    {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)us * TIMER_timebase->freq) / 1000000ULL);
+}
+
+// Converts a duration expressed in timebase ticks to microseconds
+uint32_t TIMER_timebase_ticks_to_us (uint32_t ticks)
+{
+    if (TIMER_timebase == 0)
+    {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)ticks * 1000000ULL) / TIMER_timebase->freq);
+}
+
 void __attribute__((__interrupt__, no_auto_psv))_T1Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_T1);
+    ISR_STAT_LATENCY(ISR_VECT_T1, TIMER_ISR_LATENCY(TMR1, TIMER_1));
     IFS0bits.T1IF = 0;
     TIMER_struct[TIMER_1].int_state = 1;
+    TIMER_struct[TIMER_1].expiry_cnt++;
+    ISR_STAT_EXIT(ISR_VECT_T1);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_T2Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_T2);
+    ISR_STAT_LATENCY(ISR_VECT_T2, TIMER_ISR_LATENCY(TMR2, TIMER_2));
     IFS0bits.T2IF = 0;
     TIMER_struct[TIMER_2].int_state = 1;
+    TIMER_struct[TIMER_2].expiry_cnt++;
+    ISR_STAT_EXIT(ISR_VECT_T2);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_T3Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_T3);
+    if (TIMER_struct[TIMER_2].mode == TIMER_MODE_32B)
+    {
+        ISR_STAT_LATENCY(ISR_VECT_T3, TIMER_isr_latency_32b(TIMER_2));
+    }
+    else
+    {
+        ISR_STAT_LATENCY(ISR_VECT_T3, TIMER_ISR_LATENCY(TMR3, TIMER_3));
+    }
     IFS0bits.T3IF = 0;
     TIMER_struct[TIMER_3].int_state = 1;
+    TIMER_struct[TIMER_3].expiry_cnt++;
     if (TIMER_struct[TIMER_2].mode == TIMER_MODE_32B)
     {
         TIMER_struct[TIMER_2].int_state = 1;
+        TIMER_struct[TIMER_2].expiry_cnt++;
     }
+    ISR_STAT_EXIT(ISR_VECT_T3);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_T4Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_T4);
+    ISR_STAT_LATENCY(ISR_VECT_T4, TIMER_ISR_LATENCY(TMR4, TIMER_4));
     IFS1bits.T4IF = 0;
     TIMER_struct[TIMER_4].int_state = 1;
+    TIMER_struct[TIMER_4].expiry_cnt++;
+    ISR_STAT_EXIT(ISR_VECT_T4);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_T5Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_T5);
+    if (TIMER_struct[TIMER_4].mode == TIMER_MODE_32B)
+    {
+        ISR_STAT_LATENCY(ISR_VECT_T5, TIMER_isr_latency_32b(TIMER_4));
+    }
+    else
+    {
+        ISR_STAT_LATENCY(ISR_VECT_T5, TIMER_ISR_LATENCY(TMR5, TIMER_5));
+    }
     IFS1bits.T5IF = 0;
     TIMER_struct[TIMER_5].int_state = 1;
+    TIMER_struct[TIMER_5].expiry_cnt++;
     if (TIMER_struct[TIMER_4].mode == TIMER_MODE_32B)
     {
         TIMER_struct[TIMER_4].int_state = 1;
+        TIMER_struct[TIMER_4].expiry_cnt++;
     }
+    ISR_STAT_EXIT(ISR_VECT_T5);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_T6Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_T6);
+    ISR_STAT_LATENCY(ISR_VECT_T6, TIMER_ISR_LATENCY(TMR6, TIMER_6));
     IFS2bits.T6IF = 0;
     TIMER_struct[TIMER_6].int_state = 1;
+    TIMER_struct[TIMER_6].expiry_cnt++;
+    ISR_STAT_EXIT(ISR_VECT_T6);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_T7Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_T7);
+    if (TIMER_struct[TIMER_6].mode == TIMER_MODE_32B)
+    {
+        ISR_STAT_LATENCY(ISR_VECT_T7, TIMER_isr_latency_32b(TIMER_6));
+    }
+    else
+    {
+        ISR_STAT_LATENCY(ISR_VECT_T7, TIMER_ISR_LATENCY(TMR7, TIMER_7));
+    }
     IFS3bits.T7IF = 0;
     TIMER_struct[TIMER_7].int_state = 1;
+    TIMER_struct[TIMER_7].expiry_cnt++;
     if (TIMER_struct[TIMER_6].mode == TIMER_MODE_32B)
     {
         TIMER_struct[TIMER_6].int_state = 1;
+        TIMER_struct[TIMER_6].expiry_cnt++;
     }
+    ISR_STAT_EXIT(ISR_VECT_T7);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_T8Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_T8);
+    ISR_STAT_LATENCY(ISR_VECT_T8, TIMER_ISR_LATENCY(TMR8, TIMER_8));
     IFS3bits.T8IF = 0;    
     TIMER_struct[TIMER_8].int_state = 1;
+    TIMER_struct[TIMER_8].expiry_cnt++;
+    ISR_STAT_EXIT(ISR_VECT_T8);
 }
 
 void __attribute__((__interrupt__, no_auto_psv))_T9Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_T9);
+    if (TIMER_struct[TIMER_8].mode == TIMER_MODE_32B)
+    {
+        ISR_STAT_LATENCY(ISR_VECT_T9, TIMER_isr_latency_32b(TIMER_8));
+    }
+    else
+    {
+        ISR_STAT_LATENCY(ISR_VECT_T9, TIMER_ISR_LATENCY(TMR9, TIMER_9));
+    }
     IFS3bits.T9IF = 0;
     TIMER_struct[TIMER_9].int_state = 1;
+    TIMER_struct[TIMER_9].expiry_cnt++;
     if (TIMER_struct[TIMER_8].mode == TIMER_MODE_32B)
     {
         TIMER_struct[TIMER_8].int_state = 1;
+        TIMER_struct[TIMER_8].expiry_cnt++;
     }
+    ISR_STAT_EXIT(ISR_VECT_T9);
 }
\ No newline at end of file
@@ -19,6 +19,7 @@
 #include "UART.h"
 #include "string.h"
 #include "DMA.h"
+#include "isr_stat.h"
 
 STRUCT_UART UART_struct[UART_QTY];
 
@@ -869,6 +870,7 @@ uint8_t UART_tx_done (STRUCT_UART *uart)
 //****************************************************************************//
 void __attribute__((__interrupt__, auto_psv)) _U1RXInterrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_U1RX);
     IFS0bits.U1RXIF = 0;      // clear RX interrupt flag
     uint8_t temp;
     if (UART_struct[UART_1].rx_counter < UART_struct[UART_1].rx_buf_length)           // Waiting for more data?
@@ -889,6 +891,7 @@ void __attribute__((__interrupt__, auto_psv)) _U1RXInterrupt(void)
         UART_struct[UART_1].rx_done = UART_RX_COMPLETE;                                // Yes, set the RX done flag
         UART_struct[UART_1].rx_counter = 0;                                            // Clear the RX counter
     }
+    ISR_STAT_EXIT(ISR_VECT_U1RX);
 }
 
 //**********************UART1 transmit interrupt function*********************//
@@ -907,6 +910,7 @@ void __attribute__((__interrupt__, auto_psv)) _U1RXInterrupt(void)
 //****************************************************************************//
 void __attribute__((__interrupt__, auto_psv)) _U1TXInterrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_U1TX);
     IFS0bits.U1TXIF = 0;                                // clear TX interrupt flag
     if (UART_struct[UART_1].tx_length == 1)        // Single transmission
     {
@@ -929,6 +933,7 @@ void __attribute__((__interrupt__, auto_psv)) _U1TXInterrupt(void)
             }               
         }           
     }   
+    ISR_STAT_EXIT(ISR_VECT_U1TX);
 }
 
 //**********************UART2 receive interrupt function**********************//
@@ -947,6 +952,7 @@ void __attribute__((__interrupt__, auto_psv)) _U1TXInterrupt(void)
 //****************************************************************************//
 void __attribute__((__interrupt__, auto_psv)) _U2RXInterrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_U2RX);
     IFS1bits.U2RXIF = 0;      // clear RX interrupt flag
     uint8_t temp=0;
     if (UART_struct[UART_2].rx_counter < UART_struct[UART_2].rx_buf_length)           // Waiting for more data?
@@ -967,6 +973,7 @@ void __attribute__((__interrupt__, auto_psv)) _U2RXInterrupt(void)
         UART_struct[UART_2].rx_done = UART_RX_COMPLETE;                                // Yes, set the RX done flag
         UART_struct[UART_2].rx_counter = 0;                                            // Clear the RX counter
     }  
+    ISR_STAT_EXIT(ISR_VECT_U2RX);
 }
 
 //**********************UART2 transmit interrupt function*********************//
@@ -985,6 +992,7 @@ void __attribute__((__interrupt__, auto_psv)) _U2RXInterrupt(void)
 //****************************************************************************//
 void __attribute__((__interrupt__, auto_psv)) _U2TXInterrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_U2TX);
     IFS1bits.U2TXIF = 0;      
     if (UART_struct[UART_2].tx_length == 1)
     {
@@ -1014,6 +1022,7 @@ void __attribute__((__interrupt__, auto_psv)) _U2TXInterrupt(void)
             }               
         }           
     } 
+    ISR_STAT_EXIT(ISR_VECT_U2TX);
 }
 
 #ifdef UART_DEBUG_ENABLE
@@ -1033,6 +1042,7 @@ void __attribute__((__interrupt__, auto_psv)) _U2TXInterrupt(void)
 //****************************************************************************//
 void __attribute__((__interrupt__, auto_psv)) _U3RXInterrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_U3RX);
     IFS5bits.U3RXIF = 0;      // clear RX interrupt flag
     uint8_t temp=0;
     if (UART_struct[UART_3].rx_counter < UART_struct[UART_3].rx_buf_length)           // Waiting for more data?
@@ -1053,6 +1063,7 @@ void __attribute__((__interrupt__, auto_psv)) _U3RXInterrupt(void)
         UART_struct[UART_3].rx_done = UART_RX_COMPLETE;                                // Yes, set the RX done flag
         UART_struct[UART_3].rx_counter = 0;                                            // Clear the RX counter
     }  
+    ISR_STAT_EXIT(ISR_VECT_U3RX);
 }
 
 //**********************UART4 transmit interrupt function*********************//
@@ -1071,6 +1082,7 @@ void __attribute__((__interrupt__, auto_psv)) _U3RXInterrupt(void)
 //****************************************************************************//
 void __attribute__((__interrupt__, auto_psv)) _U3TXInterrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_U3TX);
     IFS5bits.U3TXIF = 0;      // clear TX interrupt flag
     if (UART_struct[UART_3].tx_length == 1)
     {
@@ -1092,6 +1104,7 @@ void __attribute__((__interrupt__, auto_psv)) _U3TXInterrupt(void)
             }               
         }           
     }   
+    ISR_STAT_EXIT(ISR_VECT_U3TX);
 }
 #endif
 
@@ -1111,6 +1124,7 @@ void __attribute__((__interrupt__, auto_psv)) _U3TXInterrupt(void)
 //****************************************************************************//
 void __attribute__((__interrupt__, auto_psv)) _U4RXInterrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_U4RX);
     IFS5bits.U4RXIF = 0;      // clear RX interrupt flag
     uint8_t temp;
     if (UART_struct[UART_4].rx_counter < UART_struct[UART_4].rx_buf_length)           // Waiting for more data?
@@ -1131,6 +1145,7 @@ void __attribute__((__interrupt__, auto_psv)) _U4RXInterrupt(void)
         UART_struct[UART_4].rx_done = UART_RX_COMPLETE;                                // Yes, set the RX done flag
         UART_struct[UART_4].rx_counter = 0;                                            // Clear the RX counter
     }
+    ISR_STAT_EXIT(ISR_VECT_U4RX);
 }
 
 //**********************UART4 transmit interrupt function*********************//
@@ -1149,6 +1164,7 @@ void __attribute__((__interrupt__, auto_psv)) _U4RXInterrupt(void)
 //****************************************************************************//
 void __attribute__((__interrupt__, auto_psv)) _U4TXInterrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_U4TX);
     IFS5bits.U4TXIF = 0;                                // clear TX interrupt flag
     if (UART_struct[UART_4].tx_length == 1)        // Single transmission
     {
@@ -1171,6 +1187,7 @@ void __attribute__((__interrupt__, auto_psv)) _U4TXInterrupt(void)
             }               
         }           
     }   
+    ISR_STAT_EXIT(ISR_VECT_U4TX);
 }
 
 void __attribute__((__interrupt__, auto_psv)) _U1ErrInterrupt(void)
@@ -0,0 +1,215 @@
+//****************************************************************************//
+// File      :  balance.c
+//
+// Functions :  void BALANCE_init (STRUCT_BALANCE *ctrl, int16_t kp, int16_t ki, int16_t kd);
+//              void BALANCE_set_setpoint (STRUCT_BALANCE *ctrl, int16_t angle);
+//              void BALANCE_set_tilt_limit (STRUCT_BALANCE *ctrl, int16_t angle);
+//              int16_t BALANCE_update (STRUCT_BALANCE *ctrl, int16_t angle,
+//                                      int32_t rate, uint32_t timestamp);
+//              void BALANCE_reset (STRUCT_BALANCE *ctrl);
+//              int16_t BALANCE_get_output (STRUCT_BALANCE *ctrl);
+//              int16_t BALANCE_get_error (STRUCT_BALANCE *ctrl);
+//
+// Includes  :  balance.h
+//
+// Purpose   :  Fixed-point tilt (balance) controller
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#include "balance.h"
+
+static int16_t BALANCE_sat16 (int32_t value)
+{
+    if (value > BALANCE_OUT_MAX)
+    {
+        return BALANCE_OUT_MAX;
+    }
+    if (value < -BALANCE_OUT_MAX)
+    {
+        return -BALANCE_OUT_MAX;
+    }
+    return (int16_t)value;
+}
+
+// Q16.16 rad/s to 16 binary angle LSB/s (x 32768 / pi / 16)
+static int16_t BALANCE_rate_scale (int32_t rate)
+{
+    rate = rate >> 6;                       // Q10 rad/s
+    if (rate > 205000L)
+    {
+        rate = 205000L;
+    }
+    if (rate < -205000L)
+    {
+        rate = -205000L;
+    }
+    rate = (rate * 10430L) >> (10 + BALANCE_RATE_SHIFT);
+    if (rate > 32767)
+    {
+        return 32767;
+    }
+    if (rate < -32767)
+    {
+        return -32767;
+    }
+    return (int16_t)rate;
+}
+
+//********void BALANCE_init (STRUCT_BALANCE *ctrl, int16_t kp, int16_t ki, int16_t kd)******//
+//Description : Function initializes the controller gains and clears its
+//              state. Setpoint is 0 (upright), tilt limit is 45 deg.
+//              The 32-bit timebase must be initialized first.
+//
+//Function prototype : void BALANCE_init (STRUCT_BALANCE *ctrl, int16_t kp, int16_t ki, int16_t kd)
+//
+//Enter params       : STRUCT_BALANCE *ctrl : controller structure
+//                     int16_t kp, ki, kd : Q8 gains, units in balance.h
+//
+//Exit params        : None
+//
+//Function call      : BALANCE_init(&balance, 8000, 6000, 3000);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+void BALANCE_init (STRUCT_BALANCE *ctrl, int16_t kp, int16_t ki, int16_t kd)
+{
+    ctrl->kp = kp;
+    ctrl->ki = ki;
+    ctrl->kd = kd;
+    ctrl->setpoint = 0;
+    ctrl->tilt_limit = BALANCE_TILT_LIMIT_DEFAULT;
+    ctrl->dt_max = TIMER_timebase_us_to_ticks(BALANCE_DT_MAX_US);
+    ctrl->dt_unit = (uint16_t)((TIMER_timebase_us_to_ticks(1000000UL) + 32768UL) >> 16);
+    if (ctrl->dt_unit == 0)
+    {
+        ctrl->dt_unit = 1;
+    }
+    BALANCE_reset(ctrl);
+}
+
+void BALANCE_set_setpoint (STRUCT_BALANCE *ctrl, int16_t angle)
+{
+    ctrl->setpoint = angle;
+}
+
+void BALANCE_set_tilt_limit (STRUCT_BALANCE *ctrl, int16_t angle)
+{
+    ctrl->tilt_limit = angle;
+}
+
+// Clears the integral and the sample time reference, output is 0
+void BALANCE_reset (STRUCT_BALANCE *ctrl)
+{
+    ctrl->error = 0;
+    ctrl->rate = 0;
+    ctrl->i_acc = 0;
+    ctrl->out = 0;
+    ctrl->has_time = 0;
+    ctrl->fallen = 0;
+}
+
+//*****int16_t BALANCE_update (STRUCT_BALANCE *ctrl, int16_t angle, int32_t rate, uint32_t timestamp)****//
+//Description : Function runs the controller on a new orientation sample.
+//              out = kp x error + ki x sum(error x dt) - kd x rate
+//              The integral is clamped to 100% duty and is not updated on
+//              the 1st sample or after a gap longer than BALANCE_DT_MAX_US.
+//              Past the tilt limit the output is 0 and the integral is
+//              cleared until the angle is back inside the limit.
+//
+//Function prototype : int16_t BALANCE_update (STRUCT_BALANCE *ctrl, int16_t angle, int32_t rate, uint32_t timestamp)
+//
+//Enter params       : STRUCT_BALANCE *ctrl : controller structure
+//                     int16_t angle : tilt, binary angle (32768 = 180 deg)
+//                     int32_t rate : tilt rate, Q16.16 rad/s
+//                     uint32_t timestamp : sample time, timebase ticks
+//
+//Exit params        : int16_t : signed duty, Q15
+//
+//Function call      : out = BALANCE_update(&balance, euler.roll, rate.x, report->timestamp);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+int16_t BALANCE_update (STRUCT_BALANCE *ctrl, int16_t angle, int32_t rate, uint32_t timestamp)
+{
+    int32_t i_rate = 0;
+    int32_t out = 0;
+    uint32_t dt = 0;
+
+    ctrl->error = (int16_t)(ctrl->setpoint - angle);    // Binary angles wrap around
+    ctrl->rate = BALANCE_rate_scale(rate);
+
+    if ((ctrl->error > ctrl->tilt_limit) || (ctrl->error < -ctrl->tilt_limit))
+    {
+        ctrl->fallen = 1;
+        ctrl->i_acc = 0;
+        ctrl->out = 0;
+        ctrl->last_time = timestamp;
+        ctrl->has_time = 1;
+        return 0;
+    }
+    ctrl->fallen = 0;
+
+    // Integral, error x dt with dt in 2^-16 s
+    if (ctrl->has_time == 1)
+    {
+        dt = timestamp - ctrl->last_time;
+        if (dt <= ctrl->dt_max)
+        {
+            dt = dt / ctrl->dt_unit;
+            if (dt > 8191)
+            {
+                dt = 8191;
+            }
+            i_rate = ((int32_t)ctrl->ki * ctrl->error) >> 8;     // Q15 duty / s
+            if (i_rate > BALANCE_I_RATE_MAX)
+            {
+                i_rate = BALANCE_I_RATE_MAX;
+            }
+            if (i_rate < -BALANCE_I_RATE_MAX)
+            {
+                i_rate = -BALANCE_I_RATE_MAX;
+            }
+            i_rate = i_rate * (int16_t)dt;                      // Fits, |i_rate| < 2^18 and dt < 2^13
+            if ((i_rate > 0) && (ctrl->i_acc > (((int32_t)BALANCE_OUT_MAX << 16) - i_rate)))
+            {
+                ctrl->i_acc = (int32_t)BALANCE_OUT_MAX << 16;
+            }
+            else if ((i_rate < 0) && (ctrl->i_acc < (-((int32_t)BALANCE_OUT_MAX << 16) - i_rate)))
+            {
+                ctrl->i_acc = -((int32_t)BALANCE_OUT_MAX << 16);
+            }
+            else
+            {
+                ctrl->i_acc += i_rate;
+            }
+        }
+    }
+    ctrl->last_time = timestamp;
+    ctrl->has_time = 1;
+
+    out = ((int32_t)ctrl->kp * ctrl->error) >> 8;
+    out -= ((int32_t)ctrl->kd * ctrl->rate) >> 8;
+    out += ctrl->i_acc >> 16;
+    ctrl->out = BALANCE_sat16(out);
+    return ctrl->out;
+}
+
+int16_t BALANCE_get_output (STRUCT_BALANCE *ctrl)
+{
+    return ctrl->out;
+}
+
+// Last setpoint - angle, binary angle
+int16_t BALANCE_get_error (STRUCT_BALANCE *ctrl)
+{
+    return ctrl->error;
+}
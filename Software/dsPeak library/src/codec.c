@@ -11,6 +11,7 @@
 //Jean-Francois Bilodeau    MPLab X v5.45   13/01/2021
 //****************************************************************************//
 #include "codec.h"
+#include "isr_stat.h"
 STRUCT_CODEC CODEC_struct[CODEC_QTY]; 
 
 #ifdef DCI0_DMA_ENABLE
@@ -889,6 +890,7 @@ uint8_t DCI_get_interrupt_state (STRUCT_CODEC *codec, uint8_t tx_rx)
 
 void __attribute__((__interrupt__, no_auto_psv)) _DCIInterrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_DCI);
     IFS3bits.DCIIF = 0;      // clear DCI interrupt flag
     // Without DMA
 #ifndef DCI0_DMA_ENABLE
@@ -897,4 +899,5 @@ void __attribute__((__interrupt__, no_auto_psv)) _DCIInterrupt(void)
     TXBUF1 = RXBUF1;     
 #endif
     CODEC_struct[DCI_0].interrupt_flag = 1;
+    ISR_STAT_EXIT(ISR_VECT_DCI);
 }
\ No newline at end of file
@@ -5,12 +5,23 @@
 //              void I2C_fill_transmit_buffer (uint8_t port, uint8_t *ptr, uint8_t length);
 //              void I2C_master_write (uint8_t port, uint8_t *data, uint8_t length);
 //              void I2C_master_read (uint8_t port, uint8_t *data, uint8_t w_length, uint8_t r_length);
+//              void I2C_master_write_buffer (STRUCT_I2C *i2c, uint8_t address, uint8_t *data, uint16_t length);
+//              void I2C_master_read_buffer (STRUCT_I2C *i2c, uint8_t mode, uint8_t address, uint8_t *tx,
+//                                           uint16_t w_length, uint8_t *rx, uint16_t r_length);
 //              uint8_t I2C_wait (uint8_t port);
 //              uint8_t I2C_read_state (uint8_t port);
 //              uint8_t * I2C_get_rx_buffer (uint8_t port);
 //              uint8_t I2C_rx_done (uint8_t port);
 //              void I2C_change_address (uint8_t adr);
 //              void I2C_clear_rx_buffer (uint8_t port);
+//              uint8_t I2C_queue_submit (STRUCT_I2C *i2c, STRUCT_I2C_TRANSACTION *t);
+//              uint8_t I2C_queue_get_count (STRUCT_I2C *i2c);
+//              uint32_t I2C_get_freq (STRUCT_I2C *i2c);
+//              void I2C_set_timeout (STRUCT_I2C *i2c, uint32_t timeout_us);
+//              uint8_t I2C_bus_recover (STRUCT_I2C *i2c);
+//              uint8_t I2C_get_fault (STRUCT_I2C *i2c);
+//              uint16_t I2C_get_fault_count (STRUCT_I2C *i2c);
+//              uint8_t I2C_task (STRUCT_I2C *i2c);
 //
 // Includes  :  i2c.h
 //           
@@ -18,6 +29,16 @@
 //              2x native channels on dsPeak :
 //              I2C_1 : MikroBus I2C port
 //              I2C_2 : On-board I2C rheostats for PWM RC-DAC function
+//              Master transactions can be queued with I2C_queue_submit, the
+//              next one is started from the master interrupt as soon as the
+//              previous STOP completes, without waiting on the main loop
+//              A transaction still running after its timeout is aborted by
+//              I2C_wait or I2C_task and the bus is recovered (9 SCL pulses
+//              + STOP). Call I2C_task periodically when the port is only used
+//              through the queue, nothing else polls it
+//              The _buffer transfers and the queue are zero-copy, the master
+//              interrupt reads and writes the caller buffers directly. The
+//              legacy transfers copy through the port i2c_tx/rx_data arrays
 //
 // Intellitrol                   MPLab X v5.45                        10/04/2021  
 // Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
@@ -25,9 +46,15 @@
 // www.github.com/lecejeff/dspeak
 //****************************************************************************//
 #include "i2c.h"
+#include "isr_stat.h"
 
 STRUCT_I2C i2c_struct[I2C_QTY];
 
+static void I2C_queue_start (STRUCT_I2C *i2c);
+static void I2C_queue_next (STRUCT_I2C *i2c, uint8_t status);
+static void I2C_abort (STRUCT_I2C *i2c);
+static void I2C_timeout_start (STRUCT_I2C *i2c);
+
 //void I2C_init (uint8_t port, uint8_t mode, uint8_t address)//
 //Description : Function initializes the i2c module in slave or master mode
 //              Since there are 2 I2C modules in the dsPIC, 2 instances of a
@@ -36,21 +63,36 @@ STRUCT_I2C i2c_struct[I2C_QTY];
 //Function prototype : void I2C_init (uint8_t port, uint8_t mode, uint8_t address)
 //
 //Enter params       : uint8_t port : Specify the I2C port to initialize
+//                   : uint32_t freq : Master bus clock in Hz, I2C_FREQ_MIN to I2C_FREQ_MAX
 //                   : uint8_t mode : Specify the working mode for the I2C port, slave or master
 //                   : uint8_t address : Specify the slave address if using the slave mode, otherwise put 0
 //
-//Exit params        : None
+//Exit params        : uint8_t : 0 if initialized, 1 if freq is out of range
+//                               (above I2C_FREQ_MAX, or below I2C_FREQ_MIN
+//                               where the 9-bit BRG overflows)
 //
-//Function call      : I2C_init(I2C_1, I2C_mode_slave, 0x22);
+//Function call      : I2C_init(&i2c_struct[I2C_1], I2C_1, I2C_FREQ_400k, I2C_mode_master, 0);
 //
 //Jean-Francois Bilodeau    MPLab X v5.10    10/02/2020 
 //****************************************************************************//
-uint8_t I2C_init (STRUCT_I2C *i2c, uint8_t port, uint16_t freq, uint8_t mode, uint8_t address)
+uint8_t I2C_init (STRUCT_I2C *i2c, uint8_t port, uint32_t freq, uint8_t mode, uint8_t address)
 {   
-    if (freq > 0x1FF)
+    uint32_t brg = 0;
+    
+    if ((freq == 0) || (freq > I2C_FREQ_MAX))
     {
         return 1;
     }
+    // BRG = ((1/Fscl - PGD) * FCY) - 2, rounded up so the bus never runs
+    // faster than requested. Below I2C_FREQ_MIN the 9-bit BRG overflows, 
+    // the port would run faster than requested, refuse it
+    brg = ((FCY + freq - 1) / freq) - I2C_PGD_CYCLES - 2;
+    if (brg > I2C_BRG_MAX)
+    {
+        return 1;
+    }
+    i2c->brg = (uint16_t)brg;
+    
     if (port == I2C_1)
     {   
         // Initialize I2C port struct variables
@@ -62,6 +104,13 @@ uint8_t I2C_init (STRUCT_I2C *i2c, uint8_t port, uint16_t freq, uint8_t mode, ui
         i2c->i2c_int_counter = 0;                   //
         i2c->i2c_done = 1;                          // Bus is free  
         i2c->ack_state = 1;                         // NACK by default
+        i2c->queue_wr_ptr = 0;                      // Empty transaction queue
+        i2c->queue_rd_ptr = 0;                      //
+        i2c->active = 0;                            //
+        i2c->timeout_us = I2C_TIMEOUT_US;           // Converted at the 1st transaction,
+        i2c->timeout = 0;                           // the timebase may start later
+        i2c->fault = I2C_FAULT_NONE;                //
+        i2c->fault_count = 0;                       //
         if (mode == I2C_mode_slave)
         {
             // Module register initializations
@@ -86,7 +135,7 @@ uint8_t I2C_init (STRUCT_I2C *i2c, uint8_t port, uint16_t freq, uint8_t mode, ui
         {
             I2C1CONbits.I2CEN = 0;      // Disable module if it was in use
             I2C1CONbits.DISSLW = 1;     // Disable slew rate control 
-            I2C1BRG = freq;             // Set I2C1 frequency     
+            I2C1BRG = i2c->brg;         // Set I2C1 frequency     
             IFS1bits.MI2C1IF = 0;       // Clear master I2C interrupt flag  
             IPC4bits.MI2C1IP = 1;       // Set default priority 
             IEC1bits.MI2C1IE = 0;       // Disable I2C master interrupt    
@@ -104,7 +153,14 @@ uint8_t I2C_init (STRUCT_I2C *i2c, uint8_t port, uint16_t freq, uint8_t mode, ui
         i2c->i2c_read_length = 0;                   //
         i2c->i2c_int_counter = 0;                   //
         i2c->i2c_done = 1;                          // Bus is free  
-        i2c->ack_state = 1;                         // NACK by default        
+        i2c->ack_state = 1;                         // NACK by default
+        i2c->queue_wr_ptr = 0;                      // Empty transaction queue
+        i2c->queue_rd_ptr = 0;                      //
+        i2c->active = 0;                            //
+        i2c->timeout_us = I2C_TIMEOUT_US;           // Converted at the 1st transaction,
+        i2c->timeout = 0;                           // the timebase may start later
+        i2c->fault = I2C_FAULT_NONE;                //
+        i2c->fault_count = 0;                       //
         if (mode == I2C_mode_slave)
         {
             // Module register initializations
@@ -127,9 +183,9 @@ uint8_t I2C_init (STRUCT_I2C *i2c, uint8_t port, uint16_t freq, uint8_t mode, ui
                 
         if (mode == I2C_mode_master)
         {
-            I2C1CONbits.I2CEN = 0;      // Disable module if it was in use
+            I2C2CONbits.I2CEN = 0;      // Disable module if it was in use
             I2C2CONbits.DISSLW = 1;     // Disable slew rate control      
-            I2C2BRG = freq;             // Set I2C2 brg    
+            I2C2BRG = i2c->brg;         // Set I2C2 brg    
             IFS3bits.MI2C2IF = 0;       // Clear master I2C interrupt flag  
             IPC12bits.MI2C2IP = 4;      // Set default priority to 4 
             IEC3bits.MI2C2IE = 0;       // Disable I2C master interrupt    
@@ -140,6 +196,29 @@ uint8_t I2C_init (STRUCT_I2C *i2c, uint8_t port, uint16_t freq, uint8_t mode, ui
 }
 
 
+//***************uint32_t I2C_get_freq (STRUCT_I2C *i2c)*********************//
+//Description : Function returns the actual master bus clock obtained from the
+//              BRG value computed in I2C_init, including the pulse gobbler delay
+//
+//Function prototype : uint32_t I2C_get_freq (STRUCT_I2C *i2c)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//
+//Exit params        : uint32_t : bus clock in Hz
+//
+//Function call      : freq = I2C_get_freq(&i2c_struct[I2C_1]);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+uint32_t I2C_get_freq (STRUCT_I2C *i2c)
+{
+    uint32_t period_ns;
+    
+    period_ns = ((uint32_t)(i2c->brg + 2) * 1000000UL) / (FCY / 1000) + I2C_PGD_NS;
+    return 1000000000UL / period_ns;
+}
+
 //************uint8_t I2C_rx_done (uint8_t port)******************//
 //Description : Function returns I2C bus state
 //
@@ -234,32 +313,109 @@ void I2C_fill_transmit_buffer (STRUCT_I2C *i2c, uint8_t *ptr, uint8_t length)
 //Description : Function writes an I2C message on the specified port
 //              This is an I2C MASTER-only function
 //              This is a blocking function
+//              data[0] is the slave address, the message is copied to the
+//              port transmit buffer so data may be reused on return
+//              A message longer than the buffer is refused, not truncated
 //
 //Enter params       : uint8_t port : I2C port number
 //                   : uint8_t *data : pointer to data array
-//                   : uint8_t length : data length in bytes
+//                   : uint8_t length : data length in bytes, address included
+//                                      up to I2C_TX_LENGTH + 1
 //
-//Exit params        : None
+//Exit params        : uint8_t : 0 if started, 1 if length is 0 or too long
 //
 //Function call      : I2C_master_write(I2C_2, data, 6);
 //
 //Jean-Francois Bilodeau    MPLab X v5.10    10/02/2020 
 //****************************************************************************//
-void I2C_master_write (STRUCT_I2C *i2c, uint8_t *data, uint16_t length)
+uint8_t I2C_master_write (STRUCT_I2C *i2c, uint8_t *data, uint16_t length)
 {
     uint16_t i = 0;
+    if ((length == 0) || (length > (I2C_TX_LENGTH + 1)))  // Address byte is not stored
+    {
+        return 1;
+    }
     while(I2C_wait(i2c));      // Check for disabled interrupt
-    for (i=0; i<length; i++)
+    for (i=1; i<length; i++)
+    {
+        i2c->i2c_tx_data[i - 1] = data[i];  // copy data to struct array
+    }
+    I2C_master_write_buffer(i2c, data[0], i2c->i2c_tx_data, length - 1);
+    return 0;
+}
+
+//void I2C_master_read (uint8_t port, uint8_t *data, uint8_t w_length, uint8_t r_length)//
+//Description : Function reads an I2C message on the specified port
+//              This is an I2C MASTER-only function
+//              This is a blocking function
+//              data[0] is the slave address, the bytes read are stored in
+//              the port receive buffer, see I2C_get_rx_buffer
+//              Lengths larger than the port buffers are refused, not truncated
+//
+//Enter params       : uint8_t port : I2C port number
+//                   : uint8_t *data : pointer to data array
+//                   : uint8_t w_length : write length in bytes, address included
+//                                        up to I2C_TX_LENGTH + 1
+//                   : uint8_t r_length : read length in bytes, up to I2C_RX_LENGTH
+//
+//Exit params        : uint8_t : 0 if started, 1 if w_length is 0 or a length is too long
+//
+//Function call      : I2C_read(I2C_2, data, 6);
+//
+//Jean-Francois Bilodeau    MPLab X v5.10    10/02/2020 
+//****************************************************************************//
+uint8_t I2C_master_read (STRUCT_I2C *i2c, uint8_t mode, uint8_t *data, uint16_t w_length, uint16_t r_length)
+{
+    uint16_t i = 0;
+    if ((w_length == 0) || (w_length > (I2C_TX_LENGTH + 1)))  // Address byte is not stored
+    {
+        return 1;
+    }
+    if (r_length > I2C_RX_LENGTH)
+    {
+        return 1;
+    }
+    while(I2C_wait(i2c));                          // Wait until previous transaction is over
+    for (i=1; i<w_length; i++)
     {
-        i2c->i2c_tx_data[i] = *data;    // copy data to struct array
-        data++;
+        i2c->i2c_tx_data[i - 1] = data[i];  // copy data to struct table
     }
+    I2C_master_read_buffer(i2c, mode, data[0], i2c->i2c_tx_data, w_length - 1, i2c->i2c_rx_data, r_length);
+    return 0;
+}
+
+//void I2C_master_write_buffer (STRUCT_I2C *i2c, uint8_t address, uint8_t *data, uint16_t length)//
+//Description : Function writes an I2C message on the specified port without
+//              copying it, the master interrupt reads data directly
+//              data must stay valid until I2C_wait returns 0
+//              This is an I2C MASTER-only function
+//
+//Function prototype : void I2C_master_write_buffer (STRUCT_I2C *i2c, uint8_t address, uint8_t *data, uint16_t length)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//                   : uint8_t address : 8-bit slave write address
+//                   : uint8_t *data : bytes sent after the address
+//                   : uint16_t length : number of bytes in data
+//
+//Exit params        : None
+//
+//Function call      : I2C_master_write_buffer(&i2c_struct[I2C_1], 0x94, cargo, 21);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+void I2C_master_write_buffer (STRUCT_I2C *i2c, uint8_t address, uint8_t *data, uint16_t length)
+{
+    while(I2C_wait(i2c));               // Wait until previous transaction is over
+    i2c->address = address;
+    i2c->tx_ptr = data;
     i2c->i2c_write_length = length;     // Set message length 
     i2c->i2c_message_mode = I2C_WRITE;  // Set message type to write
     i2c->i2c_int_counter = 0;           // Reset state machine variables
     i2c->i2c_tx_counter = 0;            //
     i2c->i2c_done = 0;                  // busy i2c flag set
     
+    I2C_timeout_start(i2c);             // Transaction timeout reference
     if (i2c->I2C_channel == I2C_1)
     {
         IEC1bits.MI2C1IE = 1;                           // Enable I2C master interrupt 
@@ -273,39 +429,47 @@ void I2C_master_write (STRUCT_I2C *i2c, uint8_t *data, uint16_t length)
     }
 }
 
-//void I2C_master_read (uint8_t port, uint8_t *data, uint8_t w_length, uint8_t r_length)//
-//Description : Function reads an I2C message on the specified port
+//void I2C_master_read_buffer (STRUCT_I2C *i2c, uint8_t mode, uint8_t address, uint8_t *tx,//
+//                             uint16_t w_length, uint8_t *rx, uint16_t r_length)
+//Description : Function reads an I2C message on the specified port without
+//              copying, the master interrupt stores the bytes read in rx
+//              tx and rx must stay valid until I2C_rx_done returns 1
 //              This is an I2C MASTER-only function
-//              This is a blocking function
 //
-//Enter params       : uint8_t port : I2C port number
-//                   : uint8_t *data : pointer to data array
-//                   : uint8_t w_length : write length in bytes
-//                   : uint8_t r_length : read length in bytes
+//Function prototype : void I2C_master_read_buffer (STRUCT_I2C *i2c, uint8_t mode, uint8_t address, uint8_t *tx,
+//                                                  uint16_t w_length, uint8_t *rx, uint16_t r_length)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//                   : uint8_t mode : I2C_READ_MODE_RESTART or I2C_READ_MODE_STOP_START
+//                   : uint8_t address : 8-bit slave write address
+//                   : uint8_t *tx : bytes written before the restart (RESTART mode)
+//                   : uint16_t w_length : number of bytes in tx
+//                   : uint8_t *rx : destination of the bytes read
+//                   : uint16_t r_length : number of bytes to read
 //
 //Exit params        : None
 //
-//Function call      : I2C_read(I2C_2, data, 6);
+//Function call      : I2C_master_read_buffer(&i2c_struct[I2C_1], I2C_READ_MODE_STOP_START, 0x94, 0, 0, cargo, 4);
 //
-//Jean-Francois Bilodeau    MPLab X v5.10    10/02/2020 
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
 //****************************************************************************//
-void I2C_master_read (STRUCT_I2C *i2c, uint8_t mode, uint8_t *data, uint16_t w_length, uint16_t r_length)
+void I2C_master_read_buffer (STRUCT_I2C *i2c, uint8_t mode, uint8_t address, uint8_t *tx,
+                             uint16_t w_length, uint8_t *rx, uint16_t r_length)
 {
-    uint16_t i = 0;
-    while(I2C_wait(i2c));                          // Wait until previous transaction is over
-    for (i=0; i<w_length; i++)
-    {
-        i2c->i2c_tx_data[i] = *data;// copy data to struct table
-        data++;
-    }
+    while(I2C_wait(i2c));               // Wait until previous transaction is over
+    i2c->address = address;
+    i2c->tx_ptr = tx;
+    i2c->rx_ptr = rx;
     i2c->i2c_message_mode = I2C_READ;   //  
     i2c->read_mode = mode;
     i2c->i2c_write_length = w_length;   // registers to write before reading
-    i2c->i2c_read_length = r_length;    // Read adr + number of bytes to read
+    i2c->i2c_read_length = r_length;    // number of bytes to read
     i2c->i2c_int_counter = 0;           // 
     i2c->i2c_tx_counter = 0;            //
     i2c->i2c_rx_counter = 0;            //
     i2c->i2c_done = 0;                  // I2C transaction has begun
+    I2C_timeout_start(i2c);             // Transaction timeout reference
     if (i2c->I2C_channel == I2C_1)
     {
         IEC1bits.MI2C1IE = 1;                     // Enable I2C master interrupt 
@@ -317,12 +481,196 @@ void I2C_master_read (STRUCT_I2C *i2c, uint8_t mode, uint8_t *data, uint16_t w_l
         IEC3bits.MI2C2IE = 1;                       // Enable I2C master interrupt 
         I2C2CONbits.SEN = 1;                        // Start I2C sequence        
     }
+}
+
+//uint8_t I2C_queue_submit (STRUCT_I2C *i2c, STRUCT_I2C_TRANSACTION *t)//
+//Description : Function adds a master transaction to the I2C port queue
+//              The transaction starts right away if the bus is free, otherwise
+//              it is started from the master interrupt when the transactions
+//              ahead of it are over. The master interrupt works directly in the
+//              caller buffers (no copy), the transaction structure and its
+//              buffers must stay valid until t->status is no longer
+//              I2C_STATUS_PENDING. The callback, if any, is called from the
+//              master interrupt and must be kept short
+//              This is an I2C MASTER-only function, non-blocking
+//
+//Function prototype : uint8_t I2C_queue_submit (STRUCT_I2C *i2c, STRUCT_I2C_TRANSACTION *t)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//                   : STRUCT_I2C_TRANSACTION *t : transaction to queue
+//
+//Exit params        : uint8_t : 1 if queued, 0 if the queue is full or a
+//                               read has no byte to read
+//
+//Function call      : I2C_queue_submit(&i2c_struct[I2C_1], &imu_read);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+uint8_t I2C_queue_submit (STRUCT_I2C *i2c, STRUCT_I2C_TRANSACTION *t)
+{
+    uint16_t old_ipl;
+    
+    if ((t->type != I2C_TRANSACTION_WRITE) && (t->rx_length == 0))
+    {
+        return 0;
+    }
     
-    //while(I2C_wait(i2c));                          // Wait until previous transaction is over   
+    SET_AND_SAVE_CPU_IPL(old_ipl, 7);
+    if (((i2c->queue_wr_ptr - i2c->queue_rd_ptr) & 0xFF) >= I2C_QUEUE_SIZE)
+    {
+        RESTORE_CPU_IPL(old_ipl);
+        return 0;                       // Rejected, t->status is left as it was
+    }
+    t->status = I2C_STATUS_PENDING;     // Slot reserved, the interrupt cannot run before the IPL is restored
+    i2c->queue[i2c->queue_wr_ptr & I2C_QUEUE_MASK] = t;
+    i2c->queue_wr_ptr++;
+    
+    // Bus is free, start now. Otherwise the master interrupt picks it up
+    if ((i2c->active == 0) && (I2C_wait(i2c) == 0))
+    {
+        I2C_queue_start(i2c);
+    }
+    RESTORE_CPU_IPL(old_ipl);
+    return 1;
+}
+
+//************uint8_t I2C_queue_get_count (STRUCT_I2C *i2c)******************//
+//Description : Function returns the number of queued transactions, including
+//              the one currently on the bus
+//
+//Function prototype : uint8_t I2C_queue_get_count (STRUCT_I2C *i2c)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//
+//Exit params        : uint8_t : transactions not yet completed
+//
+//Function call      : count = I2C_queue_get_count(&i2c_struct[I2C_1]);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+uint8_t I2C_queue_get_count (STRUCT_I2C *i2c)
+{
+    uint8_t count;
+    uint16_t old_ipl;
+    
+    SET_AND_SAVE_CPU_IPL(old_ipl, 7);
+    count = (i2c->queue_wr_ptr - i2c->queue_rd_ptr) & 0xFF;
+    if (i2c->active != 0)
+    {
+        count++;
+    }
+    RESTORE_CPU_IPL(old_ipl);
+    return count;
+}
+
+//**************static void I2C_queue_start (STRUCT_I2C *i2c)****************//
+//Description : Function pops the next queued transaction, points the port
+//              state machine at its buffers and issues the START condition
+//              Called with the master interrupt disabled (bus free)
+//
+//Function prototype : static void I2C_queue_start (STRUCT_I2C *i2c)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//
+//Exit params        : None
+//
+//Function call      : I2C_queue_start(i2c);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+static void I2C_queue_start (STRUCT_I2C *i2c)
+{
+    STRUCT_I2C_TRANSACTION *t;
+    
+    t = i2c->queue[i2c->queue_rd_ptr & I2C_QUEUE_MASK];
+    i2c->queue_rd_ptr++;
+    i2c->active = t;
+    
+    i2c->address = t->address;
+    i2c->tx_ptr = t->tx_buf;                // Transfer in place, no copy
+    i2c->rx_ptr = t->rx_buf;                //
+    i2c->i2c_write_length = t->tx_length;
+    i2c->i2c_read_length = t->rx_length;
+    if (t->type == I2C_TRANSACTION_WRITE)
+    {
+        i2c->i2c_message_mode = I2C_WRITE;
+    }
+    else
+    {
+        i2c->i2c_message_mode = I2C_READ;
+        if (t->type == I2C_TRANSACTION_WRITE_READ)
+        {
+            i2c->read_mode = I2C_READ_MODE_RESTART;
+        }
+        else
+        {
+            i2c->read_mode = I2C_READ_MODE_STOP_START;
+        }
+    }
+    i2c->i2c_int_counter = 0;
+    i2c->i2c_tx_counter = 0;
+    i2c->i2c_rx_counter = 0;
+    i2c->i2c_done = 0;
+    
+    I2C_timeout_start(i2c);             // Transaction timeout reference
+    if (i2c->I2C_channel == I2C_1)
+    {
+        IEC1bits.MI2C1IE = 1;               // Enable I2C master interrupt 
+        I2C1CONbits.SEN = 1;                // Start I2C sequence
+    }
+    
+    else if (i2c->I2C_channel == I2C_2)
+    {
+        IEC3bits.MI2C2IE = 1;               // Enable I2C master interrupt 
+        I2C2CONbits.SEN = 1;                // Start I2C sequence        
+    }
+}
+
+//*******static void I2C_queue_next (STRUCT_I2C *i2c, uint8_t status)********//
+//Description : Function completes the active transaction, if any, and chains
+//              the next queued one. Called from the master interrupt once the
+//              STOP condition is over, or from I2C_abort on a timeout
+//
+//Function prototype : static void I2C_queue_next (STRUCT_I2C *i2c, uint8_t status)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//                   : uint8_t status : I2C_STATUS_x given to the active transaction
+//
+//Exit params        : None
+//
+//Function call      : I2C_queue_next(&i2c_struct[I2C_1], I2C_STATUS_DONE);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+static void I2C_queue_next (STRUCT_I2C *i2c, uint8_t status)
+{
+    STRUCT_I2C_TRANSACTION *t = i2c->active;
+    
+    if (t != 0)
+    {
+        i2c->active = 0;
+        t->status = status;
+        if (t->callback != 0)
+        {
+            t->callback(t->context, status);
+        }
+    }
+    
+    // The callback may already have started a transaction it submitted
+    if ((i2c->active == 0) && (i2c->queue_rd_ptr != i2c->queue_wr_ptr))
+    {
+        I2C_queue_start(i2c);
+    }
 }
 
 //************uint8_t I2C_wait (uint8_t port)*********************//
 //Description : Wait for I2C interrupt to flag down (bus unused))
+//              A transaction running for longer than the port timeout is
+//              aborted here, so the while(I2C_wait()) loops are bounded
 //
 //Function prototype : uint8_t I2C_wait (uint8_t port)
 //
@@ -336,17 +684,289 @@ void I2C_master_read (STRUCT_I2C *i2c, uint8_t mode, uint8_t *data, uint16_t w_l
 //****************************************************************************//
 uint8_t I2C_wait (STRUCT_I2C *i2c)
 {
+    uint8_t busy = 0;
+    
     if (i2c->I2C_channel == I2C_1)
     {
-        return IEC1bits.MI2C1IE;    // Only used in master mode
+        busy = IEC1bits.MI2C1IE;    // Only used in master mode
     }
     
     else if (i2c->I2C_channel == I2C_2)
     {
-        return IEC3bits.MI2C2IE;    // Only used in master mode
+        busy = IEC3bits.MI2C2IE;    // Only used in master mode
     }
     
-    else return 0;
+    // Transaction stuck on the bus, abort it and recover
+    if ((busy == 1) && (i2c->timeout != 0))
+    {
+        if ((TIMER_timebase_get() - i2c->start_time) > i2c->timeout)
+        {
+            I2C_abort(i2c);
+            return I2C_wait(i2c);   // A queued transaction may have been started
+        }
+    }
+    return busy;
+}
+
+//********void I2C_set_timeout (STRUCT_I2C *i2c, uint32_t timeout_us)*********//
+//Description : Function sets the master transaction timeout of the I2C port
+//              The timeout is measured on the 32-bit timebase, it is disabled
+//              until the timebase is initialized
+//
+//Function prototype : void I2C_set_timeout (STRUCT_I2C *i2c, uint32_t timeout_us)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//                   : uint32_t timeout_us : timeout in us, 0 to disable
+//
+//Exit params        : None
+//
+//Function call      : I2C_set_timeout(&i2c_struct[I2C_1], 5000);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+void I2C_set_timeout (STRUCT_I2C *i2c, uint32_t timeout_us)
+{
+    i2c->timeout_us = timeout_us;
+    i2c->timeout = TIMER_timebase_us_to_ticks(timeout_us);  // 0 without timebase, redone at the next start
+}
+
+//*****************uint8_t I2C_task (STRUCT_I2C *i2c)*************************//
+//Description : Function services the master transaction timeout of the port
+//              A transaction stuck on the bus past its timeout is aborted, 
+//              the bus is recovered and the active queued transaction 
+//              completes with I2C_STATUS_TIMEOUT. Queued transactions are 
+//              chained from the master interrupt and nothing else polls the
+//              port, call it periodically from the main loop or a scheduler
+//              task, ex. every 1ms. Not from an interrupt : the recovery 
+//              takes about 130us
+//
+//Function prototype : uint8_t I2C_task (STRUCT_I2C *i2c)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//
+//Exit params        : uint8_t : 1 if a transaction was aborted, 0 otherwise
+//
+//Function call      : I2C_task(&i2c_struct[I2C_1]);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+uint8_t I2C_task (STRUCT_I2C *i2c)
+{
+    uint16_t fault_count = i2c->fault_count;
+    
+    I2C_wait(i2c);                      // Aborts a transaction past its timeout
+    return (i2c->fault_count != fault_count);
+}
+
+//**********static void I2C_timeout_start (STRUCT_I2C *i2c)*******************//
+//Description : Function takes the timeout reference of a transaction START
+//              The timeout is converted to ticks here rather than in I2C_init
+//              so a timebase initialized after the port still arms it. The 
+//              64-bit conversion runs once, the ticks are kept afterwards
+//
+//Function prototype : static void I2C_timeout_start (STRUCT_I2C *i2c)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//
+//Exit params        : None
+//
+//Function call      : I2C_timeout_start(i2c);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+static void I2C_timeout_start (STRUCT_I2C *i2c)
+{
+    if ((i2c->timeout == 0) && (i2c->timeout_us != 0))
+    {
+        i2c->timeout = TIMER_timebase_us_to_ticks(i2c->timeout_us);
+    }
+    i2c->start_time = TIMER_timebase_get();
+}
+
+//**************uint8_t I2C_bus_recover (STRUCT_I2C *i2c)*********************//
+//Description : Function frees a bus held by a slave stuck mid-byte
+//              The module is disabled and SCL is clocked as an open-drain
+//              GPIO until the slave releases SDA (9 pulses max), followed by
+//              a STOP condition. Takes about 130us, the module is then
+//              re-enabled. May also be called at boot, before the 1st transfer
+//
+//Function prototype : uint8_t I2C_bus_recover (STRUCT_I2C *i2c)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//
+//Exit params        : uint8_t : 1 if SDA is released, 0 if the bus is still stuck
+//
+//Function call      : I2C_bus_recover(&i2c_struct[I2C_2]);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+uint8_t I2C_bus_recover (STRUCT_I2C *i2c)
+{
+    uint8_t i = 0;
+    uint8_t sda = 0;
+    
+    if (i2c->I2C_channel == I2C_1)
+    {
+        I2C1CONbits.I2CEN = 0;              // Give the pins back to the port
+        DSPEAK_MKB_SCL_WR = 0;              // Pins are driven low through TRIS
+        DSPEAK_MKB_SDA_WR = 0;              // only, emulating open-drain
+        DSPEAK_MKB_SDA_DIR = 1;             // Release SDA
+        DSPEAK_MKB_SCL_DIR = 1;             // Release SCL
+        __delay_us(I2C_RECOVERY_HALF_US);
+        
+        // Clock out the byte the slave is stuck in
+        for (i=0; (i<I2C_RECOVERY_PULSES) && (DSPEAK_MKB_SDA_RD == 0); i++)
+        {
+            DSPEAK_MKB_SCL_DIR = 0;         // SCL low
+            __delay_us(I2C_RECOVERY_HALF_US);
+            DSPEAK_MKB_SCL_DIR = 1;         // SCL high
+            __delay_us(I2C_RECOVERY_HALF_US);
+        }
+        
+        // STOP condition, SDA rising while SCL is high
+        DSPEAK_MKB_SCL_DIR = 0;
+        __delay_us(I2C_RECOVERY_HALF_US);
+        DSPEAK_MKB_SDA_DIR = 0;
+        __delay_us(I2C_RECOVERY_HALF_US);
+        DSPEAK_MKB_SCL_DIR = 1;
+        __delay_us(I2C_RECOVERY_HALF_US);
+        DSPEAK_MKB_SDA_DIR = 1;
+        __delay_us(I2C_RECOVERY_HALF_US);
+        
+        sda = DSPEAK_MKB_SDA_RD;
+        I2C1CONbits.I2CEN = 1;              // Module takes the pins back
+    }
+    
+    else if (i2c->I2C_channel == I2C_2)
+    {
+        I2C2CONbits.I2CEN = 0;              // Give the pins back to the port
+        DSPEAK_I2C2_SCL_WR = 0;             // Pins are driven low through TRIS
+        DSPEAK_I2C2_SDA_WR = 0;             // only, emulating open-drain
+        DSPEAK_I2C2_SDA_DIR = 1;            // Release SDA
+        DSPEAK_I2C2_SCL_DIR = 1;            // Release SCL
+        __delay_us(I2C_RECOVERY_HALF_US);
+        
+        // Clock out the byte the slave is stuck in
+        for (i=0; (i<I2C_RECOVERY_PULSES) && (DSPEAK_I2C2_SDA_RD == 0); i++)
+        {
+            DSPEAK_I2C2_SCL_DIR = 0;        // SCL low
+            __delay_us(I2C_RECOVERY_HALF_US);
+            DSPEAK_I2C2_SCL_DIR = 1;        // SCL high
+            __delay_us(I2C_RECOVERY_HALF_US);
+        }
+        
+        // STOP condition, SDA rising while SCL is high
+        DSPEAK_I2C2_SCL_DIR = 0;
+        __delay_us(I2C_RECOVERY_HALF_US);
+        DSPEAK_I2C2_SDA_DIR = 0;
+        __delay_us(I2C_RECOVERY_HALF_US);
+        DSPEAK_I2C2_SCL_DIR = 1;
+        __delay_us(I2C_RECOVERY_HALF_US);
+        DSPEAK_I2C2_SDA_DIR = 1;
+        __delay_us(I2C_RECOVERY_HALF_US);
+        
+        sda = DSPEAK_I2C2_SDA_RD;
+        I2C2CONbits.I2CEN = 1;              // Module takes the pins back
+    }
+    return sda;
+}
+
+//***************uint8_t I2C_get_fault (STRUCT_I2C *i2c)**********************//
+//Description : Function returns the last fault of the I2C port and clears it
+//
+//Function prototype : uint8_t I2C_get_fault (STRUCT_I2C *i2c)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//
+//Exit params        : uint8_t : I2C_FAULT_x
+//
+//Function call      : fault = I2C_get_fault(&i2c_struct[I2C_1]);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+uint8_t I2C_get_fault (STRUCT_I2C *i2c)
+{
+    uint8_t fault = i2c->fault;
+    i2c->fault = I2C_FAULT_NONE;
+    return fault;
+}
+
+//************uint16_t I2C_get_fault_count (STRUCT_I2C *i2c)******************//
+//Description : Function returns the number of aborted transactions since init
+//
+//Function prototype : uint16_t I2C_get_fault_count (STRUCT_I2C *i2c)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//
+//Exit params        : uint16_t : aborted transactions
+//
+//Function call      : count = I2C_get_fault_count(&i2c_struct[I2C_1]);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+uint16_t I2C_get_fault_count (STRUCT_I2C *i2c)
+{
+    return i2c->fault_count;
+}
+
+//*****************static void I2C_abort (STRUCT_I2C *i2c)********************//
+//Description : Function aborts the transaction on the bus after a timeout
+//              The master interrupt is disabled, the bus is recovered, the
+//              active queued transaction completes with I2C_STATUS_TIMEOUT
+//              and the next queued one is started. i2c_done is set so legacy
+//              I2C_rx_done polling loops do not hang, check I2C_get_fault
+//
+//Function prototype : static void I2C_abort (STRUCT_I2C *i2c)
+//
+//Enter params       : STRUCT_I2C *i2c : I2C port structure
+//
+//Exit params        : None
+//
+//Function call      : I2C_abort(i2c);
+//
+//Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+//Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+//****************************************************************************//
+static void I2C_abort (STRUCT_I2C *i2c)
+{
+    uint16_t old_ipl;
+    
+    SET_AND_SAVE_CPU_IPL(old_ipl, 7);
+    if (i2c->I2C_channel == I2C_1)
+    {
+        IEC1bits.MI2C1IE = 0;
+        IFS1bits.MI2C1IF = 0;
+    }
+    else if (i2c->I2C_channel == I2C_2)
+    {
+        IEC3bits.MI2C2IE = 0;
+        IFS3bits.MI2C2IF = 0;
+    }
+    RESTORE_CPU_IPL(old_ipl);
+    
+    if (I2C_bus_recover(i2c) == 1)
+    {
+        i2c->fault = I2C_FAULT_TIMEOUT;
+    }
+    else
+    {
+        i2c->fault = I2C_FAULT_BUS_STUCK;
+    }
+    i2c->fault_count++;
+    i2c->i2c_int_counter = 0;
+    i2c->i2c_tx_counter = 0;
+    i2c->i2c_rx_counter = 0;
+    i2c->i2c_done = 1;
+    
+    SET_AND_SAVE_CPU_IPL(old_ipl, 7);
+    I2C_queue_next(i2c, I2C_STATUS_TIMEOUT);
+    RESTORE_CPU_IPL(old_ipl);
 }
 
 //************uint8_t * I2C_get_rx_buffer (uint8_t port)***************//
@@ -382,6 +1002,7 @@ uint8_t I2C_get_ack_state (STRUCT_I2C *i2c)
 void __attribute__((__interrupt__, no_auto_psv)) _SI2C1Interrupt(void)
 {   
     uint8_t temp = 0;
+    ISR_STAT_ENTER(ISR_VECT_SI2C1);
     // Address + W received, write data to slave
     if ((!I2C1STATbits.D_A) && (!I2C1STATbits.R_W))
     {
@@ -444,6 +1065,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _SI2C1Interrupt(void)
         }
     } 
     IFS1bits.SI2C1IF = 0;    
+    ISR_STAT_EXIT(ISR_VECT_SI2C1);
 }
 
 // I2C1 master interrupt routine 
@@ -451,15 +1073,15 @@ void __attribute__((__interrupt__, no_auto_psv)) _SI2C1Interrupt(void)
 void __attribute__((__interrupt__, no_auto_psv)) _MI2C1Interrupt(void)
 {
     static uint8_t ack_adr = 0;    
+    ISR_STAT_ENTER(ISR_VECT_MI2C1);
     if (i2c_struct[I2C_1].i2c_message_mode == I2C_WRITE) // write
     {
         if (i2c_struct[I2C_1].i2c_int_counter == 0)
         {
             IFS1bits.MI2C1IF = 0;   // Lower interrupt flag 
             ack_adr = 0;            // ack address flag low
-            I2C1TRN = i2c_struct[I2C_1].i2c_tx_data[i2c_struct[I2C_1].i2c_tx_counter]; //send adr
+            I2C1TRN = i2c_struct[I2C_1].address;  //send adr
             i2c_struct[I2C_1].i2c_int_counter++;
-            i2c_struct[I2C_1].i2c_tx_counter++;  
         }            
 
         else if (i2c_struct[I2C_1].i2c_int_counter == 1) // send data
@@ -474,7 +1096,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C1Interrupt(void)
             if (i2c_struct[I2C_1].i2c_tx_counter < i2c_struct[I2C_1].i2c_write_length)//send data
             {  
                 IFS1bits.MI2C1IF = 0;   // Lower interrupt flag  
-                I2C1TRN = i2c_struct[I2C_1].i2c_tx_data[i2c_struct[I2C_1].i2c_tx_counter];
+                I2C1TRN = i2c_struct[I2C_1].tx_ptr[i2c_struct[I2C_1].i2c_tx_counter];
                 i2c_struct[I2C_1].i2c_tx_counter++;
             }
 
@@ -506,9 +1128,8 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C1Interrupt(void)
             if (i2c_struct[I2C_1].i2c_int_counter == 0)    // send adr 
             {
                 IFS1bits.MI2C1IF = 0; 
-                I2C1TRN = i2c_struct[I2C_1].i2c_tx_data[i2c_struct[I2C_1].i2c_tx_counter];
+                I2C1TRN = i2c_struct[I2C_1].address;
                 i2c_struct[I2C_1].i2c_int_counter++;
-                i2c_struct[I2C_1].i2c_tx_counter++;
             }    
 
             else if (i2c_struct[I2C_1].i2c_int_counter == 1) //send register to read
@@ -516,7 +1137,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C1Interrupt(void)
                 IFS1bits.MI2C1IF = 0; 
                 if (i2c_struct[I2C_1].i2c_tx_counter < i2c_struct[I2C_1].i2c_write_length)
                 {
-                    I2C1TRN = i2c_struct[I2C_1].i2c_tx_data[i2c_struct[I2C_1].i2c_tx_counter];
+                    I2C1TRN = i2c_struct[I2C_1].tx_ptr[i2c_struct[I2C_1].i2c_tx_counter];
                     i2c_struct[I2C_1].i2c_tx_counter++;
                 }
 
@@ -531,7 +1152,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C1Interrupt(void)
             else if (i2c_struct[I2C_1].i2c_int_counter == 2)
             {
                 IFS1bits.MI2C1IF = 0; 
-                I2C1TRN = i2c_struct[I2C_1].i2c_tx_data[i2c_struct[I2C_1].i2c_rx_counter] + 1; //send adr + 1
+                I2C1TRN = i2c_struct[I2C_1].address + 1; //send adr + 1
                 i2c_struct[I2C_1].i2c_int_counter++;             
             }
 
@@ -550,7 +1171,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C1Interrupt(void)
                 if (i2c_struct[I2C_1].i2c_rx_counter < i2c_struct[I2C_1].i2c_read_length)
                 {   
                     // Get byte and store in rx buffer
-                    i2c_struct[I2C_1].i2c_rx_data[i2c_struct[I2C_1].i2c_rx_counter] = I2C1RCV;
+                    i2c_struct[I2C_1].rx_ptr[i2c_struct[I2C_1].i2c_rx_counter] = I2C1RCV;
 
                     // See if we wish to receive more data as set in i2c_read_length field
                     if (++i2c_struct[I2C_1].i2c_rx_counter < i2c_struct[I2C_1].i2c_read_length)
@@ -617,7 +1238,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C1Interrupt(void)
             if (i2c_struct[I2C_1].i2c_int_counter == 0)
             {
                 IFS1bits.MI2C1IF = 0; 
-                I2C1TRN = i2c_struct[I2C_1].i2c_tx_data[i2c_struct[I2C_1].i2c_rx_counter] + 1; //send adr + 1
+                I2C1TRN = i2c_struct[I2C_1].address + 1; //send adr + 1
                 i2c_struct[I2C_1].i2c_int_counter++;             
             }
 
@@ -636,7 +1257,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C1Interrupt(void)
                 if (i2c_struct[I2C_1].i2c_rx_counter < i2c_struct[I2C_1].i2c_read_length)
                 {   
                     // Get byte and store in rx buffer
-                    i2c_struct[I2C_1].i2c_rx_data[i2c_struct[I2C_1].i2c_rx_counter] = I2C1RCV;
+                    i2c_struct[I2C_1].rx_ptr[i2c_struct[I2C_1].i2c_rx_counter] = I2C1RCV;
 
                     // See if we wish to receive more data as set in i2c_read_length field
                     if (++i2c_struct[I2C_1].i2c_rx_counter < i2c_struct[I2C_1].i2c_read_length)
@@ -673,20 +1294,27 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C1Interrupt(void)
             } 
         }       
     }
+    
+    // Transaction over, chain the next queued one from here
+    if (IEC1bits.MI2C1IE == 0)
+    {
+        I2C_queue_next(&i2c_struct[I2C_1], I2C_STATUS_DONE);
+    }
+    ISR_STAT_EXIT(ISR_VECT_MI2C1);
 }
 
 // I2C2 master interrupt routine 
 // Uncomment these lines if the I2C2 is used as master
 void __attribute__((__interrupt__, no_auto_psv)) _MI2C2Interrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_MI2C2);
     if (i2c_struct[I2C_2].i2c_message_mode == I2C_WRITE) // write
     {
         if (i2c_struct[I2C_2].i2c_int_counter == 0)
         {
             IFS3bits.MI2C2IF = 0;   // Lower interrupt flag 
-            I2C2TRN = i2c_struct[I2C_2].i2c_tx_data[i2c_struct[I2C_2].i2c_tx_counter]; //send adr
+            I2C2TRN = i2c_struct[I2C_2].address;  //send adr
             i2c_struct[I2C_2].i2c_int_counter++;
-            i2c_struct[I2C_2].i2c_tx_counter++;  
         }            
 
         else if (i2c_struct[I2C_2].i2c_int_counter == 1) // send data
@@ -695,7 +1323,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C2Interrupt(void)
             if (i2c_struct[I2C_2].i2c_tx_counter < i2c_struct[I2C_2].i2c_write_length)//send data
             {  
                 IFS3bits.MI2C2IF = 0;   // Lower interrupt flag  
-                I2C2TRN = i2c_struct[I2C_2].i2c_tx_data[i2c_struct[I2C_2].i2c_tx_counter];
+                I2C2TRN = i2c_struct[I2C_2].tx_ptr[i2c_struct[I2C_2].i2c_tx_counter];
                 i2c_struct[I2C_2].i2c_tx_counter++;
             }
 
@@ -726,9 +1354,8 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C2Interrupt(void)
             if (i2c_struct[I2C_2].i2c_int_counter == 0)    // send adr 
             {
                 IFS3bits.MI2C2IF = 0; 
-                I2C2TRN = i2c_struct[I2C_2].i2c_tx_data[i2c_struct[I2C_2].i2c_tx_counter];
+                I2C2TRN = i2c_struct[I2C_2].address;
                 i2c_struct[I2C_2].i2c_int_counter++;
-                i2c_struct[I2C_2].i2c_tx_counter++;
             }    
 
             else if (i2c_struct[I2C_2].i2c_int_counter == 1) //send register to read
@@ -736,7 +1363,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C2Interrupt(void)
                 IFS3bits.MI2C2IF = 0; 
                 if (i2c_struct[I2C_2].i2c_tx_counter < i2c_struct[I2C_2].i2c_write_length)
                 {
-                    I2C2TRN = i2c_struct[I2C_2].i2c_tx_data[i2c_struct[I2C_2].i2c_tx_counter];
+                    I2C2TRN = i2c_struct[I2C_2].tx_ptr[i2c_struct[I2C_2].i2c_tx_counter];
                     i2c_struct[I2C_2].i2c_tx_counter++;
                 }
 
@@ -751,7 +1378,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C2Interrupt(void)
             else if (i2c_struct[I2C_2].i2c_int_counter == 2)
             {
                 IFS3bits.MI2C2IF = 0; 
-                I2C2TRN = i2c_struct[I2C_2].i2c_tx_data[i2c_struct[I2C_2].i2c_rx_counter] + 1; //send adr + 1
+                I2C2TRN = i2c_struct[I2C_2].address + 1; //send adr + 1
                 i2c_struct[I2C_2].i2c_int_counter++;             
             }
 
@@ -770,7 +1397,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C2Interrupt(void)
                 if (i2c_struct[I2C_2].i2c_rx_counter < i2c_struct[I2C_2].i2c_read_length)
                 {   
                     // Get byte and store in rx buffer
-                    i2c_struct[I2C_2].i2c_rx_data[i2c_struct[I2C_2].i2c_rx_counter] = I2C2RCV;
+                    i2c_struct[I2C_2].rx_ptr[i2c_struct[I2C_2].i2c_rx_counter] = I2C2RCV;
 
                     // See if we wish to receive more data as set in i2c_read_length field
                     if (++i2c_struct[I2C_2].i2c_rx_counter < i2c_struct[I2C_2].i2c_read_length)
@@ -837,7 +1464,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C2Interrupt(void)
             if (i2c_struct[I2C_2].i2c_int_counter == 0)
             {
                 IFS3bits.MI2C2IF = 0; 
-                I2C2TRN = i2c_struct[I2C_2].i2c_tx_data[i2c_struct[I2C_2].i2c_rx_counter] + 1; //send adr + 1
+                I2C2TRN = i2c_struct[I2C_2].address + 1; //send adr + 1
                 i2c_struct[I2C_2].i2c_int_counter++;             
             }
 
@@ -857,7 +1484,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C2Interrupt(void)
                 if (i2c_struct[I2C_2].i2c_rx_counter < i2c_struct[I2C_2].i2c_read_length)
                 {   
                     // Get byte and store in rx buffer
-                    i2c_struct[I2C_2].i2c_rx_data[i2c_struct[I2C_2].i2c_rx_counter] = I2C2RCV;
+                    i2c_struct[I2C_2].rx_ptr[i2c_struct[I2C_2].i2c_rx_counter] = I2C2RCV;
 
                     // See if we wish to receive more data as set in i2c_read_length field
                     if (++i2c_struct[I2C_2].i2c_rx_counter < i2c_struct[I2C_2].i2c_read_length)
@@ -894,4 +1521,11 @@ void __attribute__((__interrupt__, no_auto_psv)) _MI2C2Interrupt(void)
             } 
         }       
     }
+    
+    // Transaction over, chain the next queued one from here
+    if (IEC3bits.MI2C2IE == 0)
+    {
+        I2C_queue_next(&i2c_struct[I2C_2], I2C_STATUS_DONE);
+    }
+    ISR_STAT_EXIT(ISR_VECT_MI2C2);
 }
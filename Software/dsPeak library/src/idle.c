@@ -0,0 +1,218 @@
+//****************************************************************************//
+// File      :  idle.c
+//
+// Functions :  uint8_t IDLE_init (STRUCT_TIMER *wake_timer, uint8_t wake_channel);
+//              uint8_t IDLE_enter (uint32_t (*get_bound)(void));
+//              uint16_t IDLE_get_busy_permille (void);
+//              uint32_t IDLE_get_stat (uint8_t type);
+//              void IDLE_reset_stat (void);
+//
+// Includes  :  idle.h
+//
+// Purpose   :  CPU idle manager
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#include "idle.h"
+
+extern STRUCT_TIMER TIMER_struct[TIMER_QTY];
+STRUCT_IDLE IDLE_struct;
+
+//****uint8_t IDLE_init (STRUCT_TIMER *wake_timer, uint8_t wake_channel)******//
+//Description : Function initializes the idle manager. When wake_timer is 
+//              not 0, the timer is reserved as a one-shot wake-up source.
+//
+//Function prototype : uint8_t IDLE_init (STRUCT_TIMER *wake_timer, uint8_t wake_channel)
+//
+//Enter params       : STRUCT_TIMER *wake_timer : wake timer, 0 if none
+//                     uint8_t wake_channel : TIMER_x channel of the wake timer
+//
+//Exit params        : uint8_t : 1 if success, 0 otherwise
+//
+//Function call      : IDLE_init(TIMER1_struct, TIMER_1);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t IDLE_init (STRUCT_TIMER *wake_timer, uint8_t wake_channel)
+{
+    IDLE_struct.wake_timer = wake_timer;
+    IDLE_reset_stat();
+    IDLE_struct.wake_latency_max = 0;
+    if (wake_timer != 0)
+    {
+        // Timer is stopped until IDLE_enter() programs the sleep duration
+        return TIMER_init(wake_timer, wake_channel, TIMER_MODE_16B, TIMER_PRESCALER_256, 5);
+    }
+    return 1;
+}
+
+//************uint8_t IDLE_enter (uint32_t (*get_bound)(void))***************//
+//Description : Function raises the CPU IPL to 7, then computes the next 
+//              deadline as the minimum of the application bound and the time
+//              to expiry of every running timer. If it is long enough, the 
+//              CPU enters Idle mode with the IPL still raised. 
+//              Work made ready by an ISR before the IPL was raised is seen by
+//              get_bound (ex. 0 when a task is ready) and Idle is skipped. 
+//              An interrupt arriving after the IPL was raised stays pending, 
+//              a pending interrupt wakes the core even when masked, and the 
+//              ISR is serviced when the IPL is restored.
+//              get_bound runs with interrupts masked, it must be short.
+//
+//Function prototype : uint8_t IDLE_enter (uint32_t (*get_bound)(void))
+//
+//Enter params       : uint32_t (*get_bound)(void) : returns the upper bound of
+//                     the idle time in timebase ticks, 0 if work is ready,
+//                     0xFFFFFFFF if none. 0 if there is no application bound
+//
+//Exit params        : uint8_t : 1 if the CPU was put in Idle, 0 otherwise
+//
+//Function call      : IDLE_enter(SCHED_get_next_release);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t IDLE_enter (uint32_t (*get_bound)(void))
+{
+    uint32_t sleep_ticks = 0xFFFFFFFF;
+    uint32_t expiry, start, end;
+    uint16_t cpu_ipl;
+    uint8_t i = 0;
+    
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    if (get_bound != 0)
+    {
+        sleep_ticks = get_bound();
+    }
+    for (; i < TIMER_QTY; i++)
+    {
+        if (&TIMER_struct[i] != IDLE_struct.wake_timer)
+        {
+            expiry = TIMER_get_ticks_to_expiry(&TIMER_struct[i]);
+            if (expiry < sleep_ticks)
+            {
+                sleep_ticks = expiry;
+            }
+        }
+    }
+    
+    if (sleep_ticks < IDLE_MIN_SLEEP_TICKS)
+    {
+        RESTORE_CPU_IPL(cpu_ipl);
+        return 0;
+    }
+    
+    if (IDLE_struct.wake_timer != 0)
+    {
+        if (sleep_ticks > IDLE_MAX_SLEEP_TICKS)
+        {
+            sleep_ticks = IDLE_MAX_SLEEP_TICKS;
+        }
+        // Wake timer resolution is 256 cycles, an early wake-up simply re-enters Idle.
+        // Round the frequency up : FCY / sleep_ticks truncated would wake up 
+        // to a whole period late (e.g. 75Hz instead of 75.7Hz, 9k cycles)
+        TIMER_update_freq(IDLE_struct.wake_timer, TIMER_PRESCALER_256, ((FCY + sleep_ticks - 1) / sleep_ticks));
+    }
+    else if (sleep_ticks == 0xFFFFFFFF)
+    {
+        RESTORE_CPU_IPL(cpu_ipl);
+        return 0;       // Nothing would wake the CPU up
+    }
+    
+    start = TIMER_timebase_get();
+    Idle();
+    end = TIMER_timebase_get();
+    RESTORE_CPU_IPL(cpu_ipl);
+    
+    if (IDLE_struct.wake_timer != 0)
+    {
+        TIMER_stop(IDLE_struct.wake_timer);
+        TIMER_get_state(IDLE_struct.wake_timer, TIMER_INT_STATE);   // Discard wake-up flag
+    }
+    
+    IDLE_struct.idle_count++;
+    IDLE_struct.idle_ticks += (end - start);
+    if ((end - start) > sleep_ticks)
+    {
+        if (((end - start) - sleep_ticks) > IDLE_struct.wake_latency_max)
+        {
+            IDLE_struct.wake_latency_max = (end - start) - sleep_ticks;
+        }
+    }
+    return 1;
+}
+
+//*****************uint16_t IDLE_get_busy_permille (void)**********************//
+//Description : Function returns the fraction of time the CPU was not in Idle
+//              since the previous call, in 1/1000, and starts a new window. 
+//              Call it at least once every 30s so that the 32-bit timebase 
+//              does not wrap inside a window.
+//
+//Function prototype : uint16_t IDLE_get_busy_permille (void)
+//
+//Enter params       : None
+//
+//Exit params        : uint16_t : CPU busy ratio, 0 to 1000
+//
+//Function call      : uint16_t = IDLE_get_busy_permille();
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint16_t IDLE_get_busy_permille (void)
+{
+    uint32_t now = TIMER_timebase_get();
+    uint32_t window = now - IDLE_struct.window_start;
+    uint16_t idle_permille = 0;
+    
+    if (window > 0)
+    {
+        idle_permille = (uint16_t)(((uint64_t)IDLE_struct.idle_ticks * 1000ULL) / window);
+    }
+    IDLE_struct.window_start = now;
+    IDLE_struct.idle_ticks = 0;
+    if (idle_permille > 1000)
+    {
+        idle_permille = 1000;
+    }
+    return (1000 - idle_permille);
+}
+
+uint32_t IDLE_get_stat (uint8_t type)
+{
+    switch (type)
+    {
+        case IDLE_STAT_COUNT:
+            return IDLE_struct.idle_count;
+            break;
+            
+        case IDLE_STAT_IDLE_TICKS:
+            return IDLE_struct.idle_ticks;
+            break;
+            
+        case IDLE_STAT_WAKE_LATENCY_MAX:
+            return IDLE_struct.wake_latency_max;
+            break;
+            
+        default:
+            return 0;
+            break;
+    }
+}
+
+void IDLE_reset_stat (void)
+{
+    IDLE_struct.window_start = TIMER_timebase_get();
+    IDLE_struct.idle_ticks = 0;
+    IDLE_struct.idle_count = 0;
+    IDLE_struct.wake_latency_max = 0;
+}
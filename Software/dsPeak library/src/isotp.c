@@ -0,0 +1,479 @@
+//****************************************************************************//
+// File      :  isotp.c
+//
+// Functions :  uint8_t ISOTP_init (STRUCT_ISOTP *link, STRUCT_CAN *node, uint16_t tx_sid,
+//                                  uint16_t rx_sid, uint8_t *rx_buf, uint16_t rx_buf_size,
+//                                  uint8_t block_size, uint8_t st_min);
+//              uint8_t ISOTP_send (STRUCT_ISOTP *link, uint8_t *buf, uint16_t length);
+//              uint8_t ISOTP_rx_frame (STRUCT_ISOTP *link, STRUCT_CAN_FRAME *frame);
+//              void ISOTP_task (STRUCT_ISOTP *link);
+//              uint16_t ISOTP_rx_get_length (STRUCT_ISOTP *link);
+//              void ISOTP_rx_release (STRUCT_ISOTP *link);
+//              uint8_t ISOTP_get_tx_state (STRUCT_ISOTP *link);
+//              uint16_t ISOTP_get_error (STRUCT_ISOTP *link, uint8_t type);
+//
+// Includes  :  isotp.h
+//
+// Purpose   :  ISO 15765-2 (ISO-TP) segmented transport over CAN_1
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#include "isotp.h"
+
+static uint32_t ISOTP_timeout_ticks = 0;
+static uint32_t ISOTP_fc_wait_ticks = 0;
+
+// Queues one 8-byte frame on the link transmit identifier
+static uint8_t ISOTP_push (STRUCT_ISOTP *link, uint8_t *data)
+{
+    STRUCT_CAN_FRAME frame;
+    uint8_t i = 0;
+
+    frame.SID = link->tx_sid;
+    frame.EID = 0;
+    frame.IDE = 0;
+    frame.RTR = 0;
+    frame.DLC = 8;
+    for (; i < 8; i++)
+    {
+        frame.payload[i] = data[i];
+    }
+    return CAN_tx_queue_push(link->node, &frame, ISOTP_TX_PRIORITY);
+}
+
+// A refused flow control is kept in fc_pending, a newer one replaces it
+static uint8_t ISOTP_send_fc (STRUCT_ISOTP *link, uint8_t flow_status)
+{
+    uint8_t data[8] = {ISOTP_PADDING, ISOTP_PADDING, ISOTP_PADDING, ISOTP_PADDING,
+                       ISOTP_PADDING, ISOTP_PADDING, ISOTP_PADDING, ISOTP_PADDING};
+    data[0] = ISOTP_PCI_FC | flow_status;
+    data[1] = link->block_size;
+    data[2] = link->st_min;
+    if (ISOTP_push(link, data) == 0)
+    {
+        link->fc_pending = flow_status;             // CAN transmit queue full, retry in ISOTP_task
+        return 0;
+    }
+    link->fc_pending = ISOTP_FC_NONE;
+    return 1;
+}
+
+// STmin encoding : 0x00-0x7F = 0-127ms, 0xF1-0xF9 = 100-900us, reserved = 127ms
+static uint32_t ISOTP_st_min_to_ticks (uint8_t st_min)
+{
+    if (st_min <= 0x7F)
+    {
+        return TIMER_timebase_us_to_ticks((uint32_t)st_min * 1000UL);
+    }
+    else if ((st_min >= 0xF1) && (st_min <= 0xF9))
+    {
+        return TIMER_timebase_us_to_ticks((uint32_t)(st_min - 0xF0) * 100UL);
+    }
+    else
+        return TIMER_timebase_us_to_ticks(127000UL);
+}
+
+//*****************************uint8_t ISOTP_init*****************************//
+//Description : Function initializes an ISO-TP link between 2 standard
+//              identifiers. block_size and st_min are sent to the peer in
+//              every flow control frame and bound how fast it may send to us
+//
+//Function prototype : uint8_t ISOTP_init (STRUCT_ISOTP *link, STRUCT_CAN *node, uint16_t tx_sid,
+//                                         uint16_t rx_sid, uint8_t *rx_buf, uint16_t rx_buf_size,
+//                                         uint8_t block_size, uint8_t st_min)
+//
+//Enter params       : STRUCT_ISOTP *link   : Link to initialize
+//                     STRUCT_CAN *node     : Initialized CAN node
+//                     uint16_t tx_sid      : Identifier of the frames we send
+//                     uint16_t rx_sid      : Identifier of the frames we receive
+//                     uint8_t *rx_buf      : Reassembly buffer
+//                     uint16_t rx_buf_size : Reassembly buffer size, ISOTP_RX_BUF_MIN to ISOTP_MAX_LENGTH
+//                     uint8_t block_size   : Consecutive frames between flow controls, 0 = no limit
+//                     uint8_t st_min       : Minimum separation time, ISO-TP STmin encoding
+//
+//Exit params        : uint8_t : 1 : Link initialized
+//                               0 : Error
+//
+//Function call      : ISOTP_init(&isotp_link, CAN1_struct, 0x7E0, 0x7E8, isotp_rx_buf, 4095, 0, 0);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t ISOTP_init (STRUCT_ISOTP *link, STRUCT_CAN *node, uint16_t tx_sid,
+                    uint16_t rx_sid, uint8_t *rx_buf, uint16_t rx_buf_size,
+                    uint8_t block_size, uint8_t st_min)
+{
+    uint8_t i = 0;
+    if ((node == 0) || (rx_buf == 0) || (rx_buf_size < ISOTP_RX_BUF_MIN)){return 0;}
+    if ((tx_sid > 0x7FF) || (rx_sid > 0x7FF)){return 0;}
+
+    link->node = node;
+    link->tx_sid = tx_sid;
+    link->rx_sid = rx_sid;
+    link->tx_state = ISOTP_TX_IDLE;
+    link->tx_buf = 0;
+    link->tx_length = 0;
+    link->tx_index = 0;
+    link->rx_buf = rx_buf;
+    link->rx_buf_size = (rx_buf_size > ISOTP_MAX_LENGTH) ? ISOTP_MAX_LENGTH : rx_buf_size;
+    link->rx_state = ISOTP_RX_IDLE;
+    link->rx_length = 0;
+    link->rx_index = 0;
+    link->rx_wait = 0;
+    link->fc_pending = ISOTP_FC_NONE;
+    link->block_size = block_size;
+    link->st_min = st_min;
+    for (; i < ISOTP_ERROR_QTY; i++)
+    {
+        link->error[i] = 0;
+    }
+    ISOTP_timeout_ticks = TIMER_timebase_us_to_ticks(ISOTP_TIMEOUT_US);
+    ISOTP_fc_wait_ticks = TIMER_timebase_us_to_ticks(ISOTP_FC_WAIT_US);
+    return 1;
+}
+
+//*********uint8_t ISOTP_send (STRUCT_ISOTP *link, uint8_t *buf, uint16_t length)*********//
+//Description : Function starts the transfer of a message. Up to 7 bytes are
+//              sent in a single frame, longer messages send a first frame
+//              and the remaining consecutive frames are sent by ISOTP_task
+//              once the peer flow control is received. *buf must remain
+//              valid until ISOTP_get_tx_state returns ISOTP_TX_DONE / ERROR
+//
+//Function prototype : uint8_t ISOTP_send (STRUCT_ISOTP *link, uint8_t *buf, uint16_t length)
+//
+//Enter params       : STRUCT_ISOTP *link   : Link
+//                     uint8_t *buf         : Message
+//                     uint16_t length      : 1 to ISOTP_MAX_LENGTH
+//
+//Exit params        : uint8_t : 1 : Transfer started
+//                               0 : Link busy, invalid length or CAN transmit queue full
+//
+//Function call      : ISOTP_send(&isotp_link, param_block, 512);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t ISOTP_send (STRUCT_ISOTP *link, uint8_t *buf, uint16_t length)
+{
+    uint8_t data[8];
+    uint8_t i = 0;
+
+    if ((link->tx_state == ISOTP_TX_WAIT_FC) || (link->tx_state == ISOTP_TX_SENDING)){return 0;}
+    if ((length == 0) || (length > ISOTP_MAX_LENGTH)){return 0;}
+
+    if (length <= 7)
+    {
+        data[0] = ISOTP_PCI_SF | length;
+        for (i = 0; i < 7; i++)
+        {
+            data[i + 1] = (i < length) ? buf[i] : ISOTP_PADDING;
+        }
+        if (ISOTP_push(link, data) == 0){return 0;}
+        link->tx_state = ISOTP_TX_DONE;
+        return 1;
+    }
+
+    data[0] = ISOTP_PCI_FF | (length >> 8);
+    data[1] = (uint8_t)length;
+    for (i = 0; i < 6; i++)
+    {
+        data[i + 2] = buf[i];
+    }
+    if (ISOTP_push(link, data) == 0){return 0;}
+    link->tx_buf = buf;
+    link->tx_length = length;
+    link->tx_index = 6;
+    link->tx_sn = 1;
+    link->tx_timer = TIMER_timebase_get();
+    link->tx_state = ISOTP_TX_WAIT_FC;
+    return 1;
+}
+
+// Starts the reassembly of a message from its first frame payload
+static void ISOTP_rx_start (STRUCT_ISOTP *link, uint16_t length, uint8_t *data)
+{
+    uint8_t i = 0;
+    for (; i < 6; i++)
+    {
+        link->rx_buf[i] = data[i];
+    }
+    link->rx_length = length;
+    link->rx_index = 6;
+    link->rx_sn = 1;
+    link->rx_bs_counter = 0;
+    link->rx_timer = TIMER_timebase_get();
+    link->rx_state = ISOTP_RX_RECEIVING;
+    ISOTP_send_fc(link, ISOTP_FC_CTS);
+}
+
+//**uint8_t ISOTP_rx_frame (STRUCT_ISOTP *link, STRUCT_CAN_FRAME *frame)**//
+//Description : Function feeds a frame read from the CAN receive FIFO to the
+//              link. Frames of other identifiers are left to the caller
+//
+//Function prototype : uint8_t ISOTP_rx_frame (STRUCT_ISOTP *link, STRUCT_CAN_FRAME *frame)
+//
+//Enter params       : STRUCT_ISOTP *link       : Link
+//                     STRUCT_CAN_FRAME *frame  : Received frame
+//
+//Exit params        : uint8_t : 1 : Frame consumed by the link
+//                               0 : Frame not for this link
+//
+//Function call      : while (CAN_rx_fifo_read(CAN1_struct, &frame)){ISOTP_rx_frame(&isotp_link, &frame);}
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t ISOTP_rx_frame (STRUCT_ISOTP *link, STRUCT_CAN_FRAME *frame)
+{
+    uint8_t *data = frame->payload;
+    uint16_t length;
+    uint8_t i = 0, n;
+
+    if ((frame->IDE != 0) || (frame->SID != link->rx_sid) || (frame->DLC == 0)){return 0;}
+
+    switch (data[0] & 0xF0)
+    {
+        case ISOTP_PCI_FC:
+            if ((link->tx_state != ISOTP_TX_WAIT_FC) || (frame->DLC < 3)){break;}
+            switch (data[0] & 0x0F)
+            {
+                case ISOTP_FC_CTS:
+                    link->tx_bs = data[1];
+                    link->tx_bs_counter = 0;
+                    link->tx_st_min = ISOTP_st_min_to_ticks(data[2]);
+                    link->tx_last_time = TIMER_timebase_get() - link->tx_st_min;   // 1st CF goes out right away
+                    link->tx_state = ISOTP_TX_SENDING;
+                    break;
+
+                case ISOTP_FC_WAIT:
+                    link->tx_timer = TIMER_timebase_get();                         // Peer asks for more time
+                    break;
+
+                default:
+                    link->error[ISOTP_ERROR_OVERFLOW]++;
+                    link->tx_state = ISOTP_TX_ERROR;
+                    break;
+            }
+            break;
+
+        case ISOTP_PCI_SF:
+            if (link->rx_state == ISOTP_RX_DONE){break;}                           // Previous message not released
+            length = data[0] & 0x0F;
+            if ((length == 0) || (length > 7) || (length > (frame->DLC - 1)) || (length > link->rx_buf_size))
+            {
+                link->error[ISOTP_ERROR_OVERFLOW]++;
+                break;
+            }
+            for (i = 0; i < length; i++)
+            {
+                link->rx_buf[i] = data[i + 1];
+            }
+            link->rx_length = length;
+            link->rx_state = ISOTP_RX_DONE;
+            break;
+
+        case ISOTP_PCI_FF:
+            length = ((uint16_t)(data[0] & 0x0F) << 8) | data[1];
+            if ((length < 8) || (frame->DLC < 8))
+            {
+                break;                                                              // Invalid first frame, ignored
+            }
+            if (length > link->rx_buf_size)
+            {
+                link->error[ISOTP_ERROR_OVERFLOW]++;
+                ISOTP_send_fc(link, ISOTP_FC_OVERFLOW);
+                break;
+            }
+            if (link->rx_state == ISOTP_RX_DONE)
+            {
+                // Previous message not released, hold the peer off
+                for (i = 0; i < 6; i++)
+                {
+                    link->rx_wait_data[i] = data[i + 2];
+                }
+                link->rx_wait_length = length;
+                link->rx_wait_count = 1;
+                link->rx_wait_timer = TIMER_timebase_get();
+                link->rx_wait = 1;
+                ISOTP_send_fc(link, ISOTP_FC_WAIT);
+                break;
+            }
+            ISOTP_rx_start(link, length, &data[2]);
+            break;
+
+        case ISOTP_PCI_CF:
+            if (link->rx_state != ISOTP_RX_RECEIVING){break;}
+            if ((data[0] & 0x0F) != link->rx_sn)
+            {
+                link->error[ISOTP_ERROR_SEQUENCE]++;
+                link->rx_state = ISOTP_RX_IDLE;
+                break;
+            }
+            n = frame->DLC - 1;
+            if (n > (link->rx_length - link->rx_index)){n = link->rx_length - link->rx_index;}
+            if (n > (link->rx_buf_size - link->rx_index)){n = link->rx_buf_size - link->rx_index;}
+            for (i = 0; i < n; i++)
+            {
+                link->rx_buf[link->rx_index++] = data[i + 1];
+            }
+            link->rx_sn = (link->rx_sn + 1) & 0x0F;
+            link->rx_timer = TIMER_timebase_get();
+            if (link->rx_index >= link->rx_length)
+            {
+                link->rx_state = ISOTP_RX_DONE;
+            }
+            else if ((link->block_size != 0) && (++link->rx_bs_counter >= link->block_size))
+            {
+                link->rx_bs_counter = 0;
+                ISOTP_send_fc(link, ISOTP_FC_CTS);
+            }
+            break;
+
+        default:
+            break;
+    }
+    return 1;
+}
+
+//*********************void ISOTP_task (STRUCT_ISOTP *link)*******************//
+//Description : Function sends the consecutive frames allowed by the peer
+//              flow control and checks the N_Bs / N_Cr timeouts. With
+//              STmin = 0 it fills the CAN transmit queue up to the block
+//              size, call it at least once per frame time for full bus rate
+//
+//Function prototype : void ISOTP_task (STRUCT_ISOTP *link)
+//
+//Enter params       : STRUCT_ISOTP *link : Link
+//
+//Exit params        : None
+//
+//Function call      : ISOTP_task(&isotp_link);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+void ISOTP_task (STRUCT_ISOTP *link)
+{
+    uint32_t now = TIMER_timebase_get();
+    uint8_t data[8];
+    uint8_t i = 0, n;
+
+    // Flow control refused by a full transmit queue. The peer N_Cr runs from
+    // the CTS it receives, so does ours
+    if ((link->fc_pending != ISOTP_FC_NONE) && (ISOTP_send_fc(link, link->fc_pending) == 1))
+    {
+        link->rx_timer = now;
+    }
+
+    if (link->tx_state == ISOTP_TX_WAIT_FC)
+    {
+        if ((now - link->tx_timer) > ISOTP_timeout_ticks)
+        {
+            link->error[ISOTP_ERROR_TIMEOUT]++;
+            link->tx_state = ISOTP_TX_ERROR;
+        }
+    }
+
+    while ((link->tx_state == ISOTP_TX_SENDING) && ((now - link->tx_last_time) >= link->tx_st_min))
+    {
+        n = ((link->tx_length - link->tx_index) > 7) ? 7 : (link->tx_length - link->tx_index);
+        data[0] = ISOTP_PCI_CF | link->tx_sn;
+        for (i = 0; i < 7; i++)
+        {
+            data[i + 1] = (i < n) ? link->tx_buf[link->tx_index + i] : ISOTP_PADDING;
+        }
+        if (ISOTP_push(link, data) == 0){break;}           // CAN transmit queue full, retry next call
+        link->tx_index += n;
+        link->tx_sn = (link->tx_sn + 1) & 0x0F;
+        link->tx_last_time = now;
+
+        if (link->tx_index >= link->tx_length)
+        {
+            link->tx_state = ISOTP_TX_DONE;
+        }
+        else if ((link->tx_bs != 0) && (++link->tx_bs_counter >= link->tx_bs))
+        {
+            link->tx_timer = now;
+            link->tx_state = ISOTP_TX_WAIT_FC;
+        }
+        else if (link->tx_st_min != 0)
+        {
+            break;                                          // 1 CF per separation time
+        }
+    }
+
+    if (link->rx_state == ISOTP_RX_RECEIVING)
+    {
+        if ((now - link->rx_timer) > ISOTP_timeout_ticks)
+        {
+            link->error[ISOTP_ERROR_TIMEOUT]++;
+            link->rx_state = ISOTP_RX_IDLE;
+            link->fc_pending = ISOTP_FC_NONE;           // Transfer dropped, its CTS is not owed
+        }
+    }
+
+    // Held off first frame, keep the peer waiting until the buffer is released
+    if ((link->rx_wait == 1) && ((now - link->rx_wait_timer) >= ISOTP_fc_wait_ticks))
+    {
+        if (link->rx_wait_count >= ISOTP_WFT_MAX)
+        {
+            link->error[ISOTP_ERROR_TIMEOUT]++;
+            link->rx_wait = 0;                              // Peer gives up after our last FC_WAIT
+        }
+        else
+        {
+            link->rx_wait_count++;
+            link->rx_wait_timer = now;
+            ISOTP_send_fc(link, ISOTP_FC_WAIT);
+        }
+    }
+}
+
+// Returns the length of a complete received message, 0 while none is ready
+uint16_t ISOTP_rx_get_length (STRUCT_ISOTP *link)
+{
+    if (link->rx_state == ISOTP_RX_DONE)
+    {
+        return link->rx_length;
+    }
+    else
+        return 0;
+}
+
+// Frees the receive buffer once the application consumed the message, a
+// held off first frame is then accepted
+void ISOTP_rx_release (STRUCT_ISOTP *link)
+{
+    link->rx_state = ISOTP_RX_IDLE;
+    if (link->rx_wait == 1)
+    {
+        link->rx_wait = 0;
+        ISOTP_rx_start(link, link->rx_wait_length, link->rx_wait_data);
+    }
+}
+
+uint8_t ISOTP_get_tx_state (STRUCT_ISOTP *link)
+{
+    return link->tx_state;
+}
+
+uint16_t ISOTP_get_error (STRUCT_ISOTP *link, uint8_t type)
+{
+    if (type < ISOTP_ERROR_QTY)
+    {
+        return link->error[type];
+    }
+    else
+        return 0;
+}
@@ -0,0 +1,136 @@
+//****************************************************************************//
+// File      :  isr_stat.c
+//
+// Functions :  void ISR_STAT_init (void);
+//              void ISR_STAT_record (uint8_t vector, uint32_t entry);
+//              void ISR_STAT_latency (uint8_t vector, uint32_t latency);
+//              uint32_t ISR_STAT_get (uint8_t vector, uint8_t type);
+//              void ISR_STAT_reset (uint8_t vector);
+//
+// Includes  :  isr_stat.h
+//
+// Purpose   :  Opt-in interrupt service routine instrumentation
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#include "isr_stat.h"
+
+#ifdef ISR_STAT_ENABLE
+STRUCT_ISR_STAT ISR_STAT_struct[ISR_VECT_QTY];
+uint32_t ISR_STAT_overhead = 0;
+
+//*************************void ISR_STAT_init (void)**************************//
+//Description : Function clears the statistics of every vector and measures 
+//              the cost of an empty ENTER / EXIT pair, which is then removed
+//              from every recorded duration. The 32-bit timebase must be 
+//              initialized first.
+//
+//Function prototype : void ISR_STAT_init (void)
+//
+//Enter params       : None
+//
+//Exit params        : None
+//
+//Function call      : ISR_STAT_init();
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+void ISR_STAT_init (void)
+{
+    uint16_t cpu_ipl;
+    uint8_t i = 0;
+    
+    ISR_STAT_overhead = 0;
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    {
+        ISR_STAT_ENTER(ISR_VECT_T1);
+        ISR_STAT_EXIT(ISR_VECT_T1);
+    }
+    ISR_STAT_overhead = ISR_STAT_struct[ISR_VECT_T1].duration_max;
+    RESTORE_CPU_IPL(cpu_ipl);
+    
+    for (; i < ISR_VECT_QTY; i++)
+    {
+        ISR_STAT_reset(i);
+    }
+}
+
+// Called by ISR_STAT_EXIT() at the end of an ISR, nested interrupts are 
+// disabled on dsPeak so the update cannot be interrupted by another ISR
+void ISR_STAT_record (uint8_t vector, uint32_t entry)
+{
+    uint32_t duration = TIMER_timebase_get() - entry;
+    STRUCT_ISR_STAT *stat = &ISR_STAT_struct[vector];
+    
+    duration = (duration > ISR_STAT_overhead) ? (duration - ISR_STAT_overhead) : 0;
+    stat->count++;
+    if (duration > stat->duration_max)
+    {
+        stat->duration_max = duration;
+    }
+}
+
+// Latency in instruction cycles between the interrupt event and the ISR entry
+void ISR_STAT_latency (uint8_t vector, uint32_t latency)
+{
+    if (latency > ISR_STAT_struct[vector].latency_max)
+    {
+        ISR_STAT_struct[vector].latency_max = latency;
+    }
+}
+
+uint32_t ISR_STAT_get (uint8_t vector, uint8_t type)
+{
+    uint32_t value = 0;
+    uint16_t cpu_ipl;
+    
+    if (vector >= ISR_VECT_QTY)
+    {
+        return 0;
+    }
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);     // 32-bit read must not be split by the ISR
+    switch (type)
+    {
+        case ISR_STAT_COUNT:
+            value = ISR_STAT_struct[vector].count;
+            break;
+            
+        case ISR_STAT_DURATION_MAX:
+            value = ISR_STAT_struct[vector].duration_max;
+            break;
+            
+        case ISR_STAT_LATENCY_MAX:
+            value = ISR_STAT_struct[vector].latency_max;
+            break;
+            
+        default:
+            break;
+    }
+    RESTORE_CPU_IPL(cpu_ipl);
+    return value;
+}
+
+uint32_t ISR_STAT_get_overhead (void)
+{
+    return ISR_STAT_overhead;
+}
+
+void ISR_STAT_reset (uint8_t vector)
+{
+    uint16_t cpu_ipl;
+    if (vector < ISR_VECT_QTY)
+    {
+        SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+        ISR_STAT_struct[vector].count = 0;
+        ISR_STAT_struct[vector].duration_max = 0;
+        ISR_STAT_struct[vector].latency_max = 0;
+        RESTORE_CPU_IPL(cpu_ipl);
+    }
+}
+#endif
@@ -15,6 +15,7 @@ void MOTOR_init (STRUCT_PWM *pwm_h, STRUCT_PWM *pwm_l, uint8_t channel, uint16_t
             TRISGbits.TRISG14 = 1;              // RG14 configured as an input (nFAULT1)
             m_control[channel].direction = DIRECTION_FORWARD;
             m_control[channel].speed_perc = 0;    
+            m_control[channel].speed_duty = 0;
             m_control[channel].speed_rpm = 0;    
             m_control[channel].pwm_h_channel = PWM_1H;
             m_control[channel].pwm_l_channel = PWM_1L;
@@ -39,6 +40,7 @@ void MOTOR_init (STRUCT_PWM *pwm_h, STRUCT_PWM *pwm_l, uint8_t channel, uint16_t
             
             m_control[channel].direction = DIRECTION_FORWARD;
             m_control[channel].speed_perc = 0;    
+            m_control[channel].speed_duty = 0;
             m_control[channel].speed_rpm = 0;    
             m_control[channel].pwm_h_channel = PWM_2H;
             m_control[channel].pwm_l_channel = PWM_2L;
@@ -78,20 +80,34 @@ uint8_t MOTOR_get_speed_perc (uint8_t channel)
 
 void MOTOR_drive_perc (uint8_t channel, uint8_t direction, uint8_t perc)
 {
+    if (perc > 100){perc = 100;}
+    MOTOR_drive_duty(channel, direction, (uint16_t)((((uint32_t)perc * PWM_DUTY_MAX) + 50) / 100));
+}
+
+// Full resolution drive, duty is a fraction of PWM_DUTY_MAX (32768 = 100%)
+void MOTOR_drive_duty (uint8_t channel, uint8_t direction, uint16_t duty)
+{
+    if (duty > PWM_DUTY_MAX){duty = PWM_DUTY_MAX;}
     m_control[channel].direction = direction;
-    m_control[channel].speed_perc = perc;        
+    m_control[channel].speed_duty = duty;
+    m_control[channel].speed_perc = (uint8_t)((((uint32_t)duty * 100) + (PWM_DUTY_MAX >> 1)) >> 15);
     if (m_control[channel].direction == DIRECTION_FORWARD)
     {
-        PWM_change_duty_perc(m_control[channel].pwm_h_ref, m_control[channel].speed_perc);
-        PWM_change_duty_perc(m_control[channel].pwm_l_ref, 0);        
+        PWM_change_duty(m_control[channel].pwm_h_ref, m_control[channel].speed_duty);
+        PWM_change_duty(m_control[channel].pwm_l_ref, 0);        
     }
     if (m_control[channel].direction == DIRECTION_BACKWARD)
     {
-        PWM_change_duty_perc(m_control[channel].pwm_h_ref,  0);
-        PWM_change_duty_perc(m_control[channel].pwm_l_ref,  m_control[channel].speed_perc);        
+        PWM_change_duty(m_control[channel].pwm_h_ref,  0);
+        PWM_change_duty(m_control[channel].pwm_l_ref,  m_control[channel].speed_duty);        
     }
 }
 
+uint16_t MOTOR_get_speed_duty (uint8_t channel)
+{
+    return m_control[channel].speed_duty;
+}
+
 void MOTOR_set_rpm (uint8_t channel, uint16_t new_rpm)
 {
     m_control[channel].speed_rpm = new_rpm;
@@ -125,6 +141,7 @@ uint8_t MOTOR_drive_pid (uint8_t channel)
     if (m_control[channel].speed_rpm > 0)
     {           
         m_control[channel].actual_rpm = QEI_get_speed_rpm(channel);  
+        m_control[channel].actual_rpm_q16 = QEI_get_speed_rpm_q16(channel);
         // Get velocity
         if (m_control[channel].direction == DIRECTION_BACKWARD)
         {
@@ -135,12 +152,17 @@ uint8_t MOTOR_drive_pid (uint8_t channel)
         {
             m_control[channel].actual_rpm = m_control[channel].max_rpm;
         }
+        if (m_control[channel].actual_rpm_q16 > ((uint32_t)m_control[channel].max_rpm << 16))
+        {
+            m_control[channel].actual_rpm_q16 = (uint32_t)m_control[channel].max_rpm << 16;
+        }
         
         // Error = setpoint - input
         m_control[channel].test_error = (int32_t)m_control[channel].speed_rpm - m_control[channel].actual_rpm;  
                 
         //m_control[channel].error_rpm = (double)m_control[channel].speed_rpm - (double)m_control[channel].actual_rpm;
-        m_control[channel].error_rpm = (double)m_control[channel].test_error;
+        // Fractional RPM, the integer speed is too coarse at low speed
+        m_control[channel].error_rpm = (double)((int32_t)((uint32_t)m_control[channel].speed_rpm << 16) - (int32_t)m_control[channel].actual_rpm_q16) / 65536.0;
         
         // Limit the error to maximum motor error, between -MAX_RPM and MAX_RPM specified in datasheet
 //        if (m_control[channel].error_rpm > (double)m_control[channel].max_rpm)
@@ -163,7 +185,7 @@ uint8_t MOTOR_drive_pid (uint8_t channel)
         }
         
         // Calculate derivative term
-        m_control[channel].d_input = (double)(m_control[channel].actual_rpm - m_control[channel].last_actual_rpm);
+        m_control[channel].d_input = (double)((int32_t)(m_control[channel].actual_rpm_q16 - m_control[channel].last_actual_rpm_q16)) / 65536.0;
         m_control[channel].d_value = m_control[channel].d_calc_gain * m_control[channel].d_input;
 
         // Compute PID output
@@ -180,6 +202,7 @@ uint8_t MOTOR_drive_pid (uint8_t channel)
 //            
         // Remember some variables
         m_control[channel].last_actual_rpm = m_control[channel].actual_rpm; 
+        m_control[channel].last_actual_rpm_q16 = m_control[channel].actual_rpm_q16;
         m_control[channel].last_error_rpm = m_control[channel].error_rpm;  
         return m_control[channel].pid_out;
     }
@@ -0,0 +1,378 @@
+//****************************************************************************//
+// File      :  profiler.c
+//
+// Functions :  void PROF_init (void);
+//              uint8_t PROF_region_init (uint8_t region, const char *name);
+//              void PROF_enter (uint8_t region);
+//              void PROF_exit (uint8_t region);
+//              uint32_t PROF_get_stat (uint8_t region, uint8_t type);
+//              void PROF_reset_stat (uint8_t region);
+//              uint8_t PROF_export (STRUCT_UART *uart);
+//
+// Includes  :  profiler.h
+//
+// Purpose   :  Execution time profiler for tagged code regions
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#include "profiler.h"
+
+STRUCT_PROFILER PROF_struct;
+STRUCT_PROF_REGION PROF_region_struct[PROF_REGION_QTY];
+
+static STRUCT_PROF_RECORD PROF_discard;
+
+// Returns the record to timestamp, a scratch record while the ring is exported
+static STRUCT_PROF_RECORD * PROF_push_record (uint8_t region, uint8_t type)
+{
+    STRUCT_PROF_RECORD *rec = &PROF_discard;
+    if (PROF_struct.ring_freeze == 0)
+    {
+        rec = &PROF_struct.ring[PROF_struct.ring_wr_ptr];
+        rec->region = region;
+        rec->type = type;
+        PROF_struct.ring_wr_ptr = (PROF_struct.ring_wr_ptr + 1) & (PROF_RING_SIZE - 1);
+        if (PROF_struct.ring_count < PROF_RING_SIZE)
+        {
+            PROF_struct.ring_count++;
+        }
+    }
+    return rec;
+}
+
+// Writes the decimal representation of value in out, returns the number of chars
+static uint8_t PROF_u32_to_ascii (uint32_t value, char *out)
+{
+    char tmp[10];
+    uint8_t i = 0, j = 0;
+    do
+    {
+        tmp[i++] = (char)('0' + (value % 10));
+        value = value / 10;
+    }while (value > 0);
+    while (i > 0)
+    {
+        out[j++] = tmp[--i];
+    }
+    return j;
+}
+
+// Writes value as 8 hex digits in out
+static uint8_t PROF_u32_to_hex (uint32_t value, char *out)
+{
+    const char hex[16] = "0123456789ABCDEF";
+    uint8_t i = 0;
+    for (; i < 8; i++)
+    {
+        out[i] = hex[(value >> (28 - (4 * i))) & 0x0F];
+    }
+    return 8;
+}
+
+static uint8_t PROF_append (char *out, const char *str)
+{
+    uint8_t i = 0;
+    while (str[i] != 0)
+    {
+        out[i] = str[i];
+        i++;
+    }
+    return i;
+}
+
+//*****************************void PROF_init (void)**************************//
+//Description : Function clears the record ring and all regions, then 
+//              calibrates the probe overhead. The 32-bit timebase must be 
+//              initialized first (TIMER_timebase_init or SCHED_init).
+//
+//Function prototype : void PROF_init (void)
+//
+//Enter params       : None
+//
+//Exit params        : None
+//
+//Function call      : PROF_init();
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+void PROF_init (void)
+{
+    uint8_t i = 0;
+    memset(&PROF_struct, 0, sizeof(STRUCT_PROFILER));
+    for (; i < PROF_REGION_QTY; i++)
+    {
+        memset(&PROF_region_struct[i], 0, sizeof(STRUCT_PROF_REGION));
+        PROF_region_struct[i].min = 0xFFFFFFFF;
+    }
+    
+    // An empty enter / exit pair gives the fixed probe cost
+    PROF_enter(0);
+    PROF_exit(0);
+    PROF_struct.overhead = PROF_region_struct[0].last;
+    PROF_reset_stat(0);
+    PROF_struct.ring_wr_ptr = 0;
+    PROF_struct.ring_count = 0;
+}
+
+uint8_t PROF_region_init (uint8_t region, const char *name)
+{
+    uint8_t i = 0;
+    if (region >= PROF_REGION_QTY)
+    {
+        return 0;
+    }
+    for (; (i < (PROF_NAME_LENGTH - 1)) && (name[i] != 0); i++)
+    {
+        PROF_region_struct[region].name[i] = name[i];
+    }
+    PROF_region_struct[region].name[i] = 0;
+    PROF_reset_stat(region);
+    return 1;
+}
+
+//**********************void PROF_enter (uint8_t region)**********************//
+//Description : Function timestamps the entry of a tagged region. Regions 
+//              must not be nested within themselves. Called through the 
+//              PROF_ENTER() macro so the probe compiles out in release.
+//
+//Function prototype : void PROF_enter (uint8_t region)
+//
+//Enter params       : uint8_t region : 0 to PROF_REGION_QTY - 1
+//
+//Exit params        : None
+//
+//Function call      : PROF_ENTER(PROF_MOTOR_PID);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+void PROF_enter (uint8_t region)
+{
+    STRUCT_PROF_RECORD *rec;
+    if (region < PROF_REGION_QTY)
+    {
+        rec = PROF_push_record(region, PROF_RECORD_ENTER);
+        PROF_region_struct[region].entry_time = TIMER_timebase_get();   // Exclude record cost
+        rec->timestamp = PROF_region_struct[region].entry_time;
+    }
+}
+
+//***********************void PROF_exit (uint8_t region)**********************//
+//Description : Function timestamps the exit of a tagged region and updates 
+//              its statistics. The calibrated probe overhead is removed from 
+//              the measured duration.
+//
+//Function prototype : void PROF_exit (uint8_t region)
+//
+//Enter params       : uint8_t region : 0 to PROF_REGION_QTY - 1
+//
+//Exit params        : None
+//
+//Function call      : PROF_EXIT(PROF_MOTOR_PID);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+void PROF_exit (uint8_t region)
+{
+    uint32_t now = TIMER_timebase_get();
+    uint32_t duration;
+    STRUCT_PROF_REGION *reg;
+    
+    if (region < PROF_REGION_QTY)
+    {
+        reg = &PROF_region_struct[region];
+        duration = now - reg->entry_time;
+        if (duration > PROF_struct.overhead)
+        {
+            duration -= PROF_struct.overhead;
+        }
+        else
+        {
+            duration = 0;
+        }
+        reg->last = duration;
+        reg->count++;
+        reg->total += duration;
+        if (duration < reg->min)
+        {
+            reg->min = duration;
+        }
+        if (duration > reg->max)
+        {
+            reg->max = duration;
+        }
+        PROF_push_record(region, PROF_RECORD_EXIT)->timestamp = now;
+    }
+}
+
+uint32_t PROF_get_stat (uint8_t region, uint8_t type)
+{
+    STRUCT_PROF_REGION *reg;
+    if (region >= PROF_REGION_QTY)
+    {
+        return 0;
+    }
+    reg = &PROF_region_struct[region];
+    switch (type)
+    {
+        case PROF_STAT_COUNT:
+            return reg->count;
+            break;
+            
+        case PROF_STAT_MIN:
+            return (reg->count > 0) ? reg->min : 0;
+            break;
+            
+        case PROF_STAT_MAX:
+            return reg->max;
+            break;
+            
+        case PROF_STAT_AVG:
+            return (reg->count > 0) ? (uint32_t)(reg->total / reg->count) : 0;
+            break;
+            
+        case PROF_STAT_LAST:
+            return reg->last;
+            break;
+            
+        default:
+            return 0;
+            break;
+    }
+}
+
+uint32_t PROF_get_overhead (void)
+{
+    return PROF_struct.overhead;
+}
+
+void PROF_reset_stat (uint8_t region)
+{
+    if (region < PROF_REGION_QTY)
+    {
+        PROF_region_struct[region].count = 0;
+        PROF_region_struct[region].min = 0xFFFFFFFF;
+        PROF_region_struct[region].max = 0;
+        PROF_region_struct[region].last = 0;
+        PROF_region_struct[region].total = 0;
+    }
+}
+
+// Returns a ring record, age 0 being the most recent one
+STRUCT_PROF_RECORD * PROF_get_record (uint16_t age)
+{
+    return &PROF_struct.ring[(PROF_struct.ring_wr_ptr - 1 - age) & (PROF_RING_SIZE - 1)];
+}
+
+//*******************uint8_t PROF_export (STRUCT_UART *uart)******************//
+//Description : Function sends one line of the export on the UART using DMA 
+//              per call : the statistics of each named region, the ring 
+//              header, then PROF_EXPORT_RECORDS ring records per line, see 
+//              profiler.h for the format. Call it until it returns 
+//              PROF_EXPORT_DONE, the ring is frozen meanwhile. Durations are
+//              in timebase ticks, which are instruction cycles when the 
+//              timebase prescaler is 1.
+//
+//Function prototype : uint8_t PROF_export (STRUCT_UART *uart)
+//
+//Enter params       : STRUCT_UART *uart : UART used for export, usually UART_3
+//
+//Exit params        : uint8_t : PROF_EXPORT_DONE when the regions and the ring are sent
+//
+//Function call      : PROF_export(UART_DEBUG_struct);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t PROF_export (STRUCT_UART *uart)
+{
+    char line[80];
+    uint8_t i = 0, n = 0;
+    uint8_t region;
+    uint16_t record;
+    STRUCT_PROF_RECORD *rec;
+    
+    PROF_struct.ring_freeze = 1;
+    
+    // Skip unnamed regions
+    while ((PROF_struct.export_region < PROF_REGION_QTY) && 
+           (PROF_region_struct[PROF_struct.export_region].name[0] == 0))
+    {
+        PROF_struct.export_region++;
+    }
+    
+    region = PROF_struct.export_region;
+    record = PROF_struct.export_record;
+    if (region < PROF_REGION_QTY)
+    {
+        i += PROF_append(&line[i], "PROF ");
+        i += PROF_append(&line[i], PROF_region_struct[region].name);
+        i += PROF_append(&line[i], " r=");
+        i += PROF_u32_to_ascii(region, &line[i]);
+        i += PROF_append(&line[i], " n=");
+        i += PROF_u32_to_ascii(PROF_get_stat(region, PROF_STAT_COUNT), &line[i]);
+        i += PROF_append(&line[i], " min=");
+        i += PROF_u32_to_ascii(PROF_get_stat(region, PROF_STAT_MIN), &line[i]);
+        i += PROF_append(&line[i], " avg=");
+        i += PROF_u32_to_ascii(PROF_get_stat(region, PROF_STAT_AVG), &line[i]);
+        i += PROF_append(&line[i], " max=");
+        i += PROF_u32_to_ascii(PROF_get_stat(region, PROF_STAT_MAX), &line[i]);
+    }
+    else if (region == PROF_REGION_QTY)
+    {
+        i += PROF_append(&line[i], "PROFT n=");
+        i += PROF_u32_to_ascii(PROF_struct.ring_count, &line[i]);
+        i += PROF_append(&line[i], " ovh=");
+        i += PROF_u32_to_ascii(PROF_struct.overhead, &line[i]);
+        i += PROF_append(&line[i], " hz=");
+        i += PROF_u32_to_ascii(TIMER_timebase_get_freq(), &line[i]);
+    }
+    else if (record < PROF_struct.ring_count)
+    {
+        // Oldest record first
+        i += PROF_append(&line[i], "PROFR");
+        for (; (n < PROF_EXPORT_RECORDS) && ((record + n) < PROF_struct.ring_count); n++)
+        {
+            rec = PROF_get_record(PROF_struct.ring_count - 1 - (record + n));
+            line[i++] = ' ';
+            i += PROF_u32_to_ascii(rec->region, &line[i]);
+            line[i++] = (rec->type == PROF_RECORD_ENTER) ? 'E' : 'X';
+            i += PROF_u32_to_hex(rec->timestamp, &line[i]);
+        }
+    }
+    else
+    {
+        PROF_struct.export_region = 0;
+        PROF_struct.export_record = 0;
+        PROF_struct.ring_freeze = 0;
+        return PROF_EXPORT_DONE;
+    }
+    i += PROF_append(&line[i], "\r\n");
+    line[i] = 0;
+    
+    if (UART_putstr_dma(uart, line) == 1)
+    {
+        if (region <= PROF_REGION_QTY)
+        {
+            PROF_struct.export_region++;
+        }
+        else
+        {
+            PROF_struct.export_record += n;
+        }
+    }
+    return PROF_EXPORT_BUSY;
+}
@@ -2,7 +2,9 @@
 // File      : PWM.c
 //
 // Functions :  void PWM_init (void);
-//              void PWM_change_duty (uint8_t channel, uint8_t duty);
+//              void PWM_change_duty (STRUCT_PWM *pwm, uint16_t duty);
+//              void PWM_change_duty_perc (STRUCT_PWM *pwm, uint8_t duty);
+//              uint16_t PWM_get_duty (STRUCT_PWM *pwm);
 //              uint8_t PWM_get_position (uint8_t channel);
 //
 // Includes  : pwm.h
@@ -10,6 +12,36 @@
 //Jean-Francois Bilodeau    MPLab X v5.10    10/02/2020   
 //****************************************************************************//
 #include "pwm.h"
+
+// Each phase must fit the 16-bit PHASEx / SPHASEx register of its generator
+#if (FOSC / (PWM1L_PHASE * PWM_TB_PRESCALE(PWM1_MTBS))) > 65535
+    #error "PWM1L_PHASE overflows its period register, select the servo time base (PWM1_MTBS)"
+#endif
+#if (FOSC / (PWM1H_PHASE * PWM_TB_PRESCALE(PWM1_MTBS))) > 65535
+    #error "PWM1H_PHASE overflows its period register, select the servo time base (PWM1_MTBS)"
+#endif
+#if (FOSC / (PWM2L_PHASE * PWM_TB_PRESCALE(PWM2_MTBS))) > 65535
+    #error "PWM2L_PHASE overflows its period register, select the servo time base (PWM2_MTBS)"
+#endif
+#if (FOSC / (PWM2H_PHASE * PWM_TB_PRESCALE(PWM2_MTBS))) > 65535
+    #error "PWM2H_PHASE overflows its period register, select the servo time base (PWM2_MTBS)"
+#endif
+#if (FOSC / (PWM4H_PHASE * PWM_TB_PRESCALE(PWM4_MTBS))) > 65535
+    #error "PWM4H_PHASE overflows its period register, select the servo time base (PWM4_MTBS)"
+#endif
+#if (FOSC / (PWM5L_PHASE * PWM_TB_PRESCALE(PWM5_MTBS))) > 65535
+    #error "PWM5L_PHASE overflows its period register, select the servo time base (PWM5_MTBS)"
+#endif
+#if (FOSC / (PWM5H_PHASE * PWM_TB_PRESCALE(PWM5_MTBS))) > 65535
+    #error "PWM5H_PHASE overflows its period register, select the servo time base (PWM5_MTBS)"
+#endif
+#if (FOSC / (PWM6L_PHASE * PWM_TB_PRESCALE(PWM6_MTBS))) > 65535
+    #error "PWM6L_PHASE overflows its period register, select the servo time base (PWM6_MTBS)"
+#endif
+#if (FOSC / (PWM6H_PHASE * PWM_TB_PRESCALE(PWM6_MTBS))) > 65535
+    #error "PWM6H_PHASE overflows its period register, select the servo time base (PWM6_MTBS)"
+#endif
+
 STRUCT_PWM PWM_struct[PWM_QTY];
 
 ///**************************void PWM_init(void)****************************//
@@ -28,7 +60,8 @@ STRUCT_PWM PWM_struct[PWM_QTY];
 void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type)
 {
     PTCONbits.PTEN = 0;     // Shutdown PWM engine if it was on 
-    PTCON2bits.PCLKDIV = 6; // Clock divide by 1
+    PTCON2bits.PCLKDIV = PWM_CLOCK_PCLKDIV; // Clock divide by PWM_CLOCK_PRESCALE
+    STCON2bits.PCLKDIV = PWM_SERVO_CLOCK_PCLKDIV;   // Clock divide by PWM_SERVO_CLOCK_PRESCALE
     pwm->PWM_channel = channel;  
     pwm->pwm_type = type;
     
@@ -40,12 +73,13 @@ void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type)
             IOCON1bits.PENL = 1;    // Enable PWM_1L
             IOCON1bits.PMOD = 3;    // True independent PWM
             PWMCON1bits.ITB = 1;    // Independent time base for PWM_1L / PWM_1H pair
+            PWMCON1bits.MTBS = PWM1_MTBS; // Primary or servo time base, see pwm.h
             FCLCON1bits.FLTMOD = 3; // No PWM fault can occur
             
             TRISEbits.TRISE0 = 0;   // RE0 is an output
             // The phase is defined in pwm.h for each PWM channel
-            SPHASE1 = (uint16_t)(FOSC / (PWM1L_PHASE * PWM_CLOCK_PRESCALE));
-            SDC1 = (uint16_t)(FOSC / (PWM1L_PHASE * PWM_CLOCK_PRESCALE));
+            SPHASE1 = (uint16_t)(FOSC / (PWM1L_PHASE * PWM_TB_PRESCALE(PWM1_MTBS)));
+            SDC1 = (uint16_t)(FOSC / (PWM1L_PHASE * PWM_TB_PRESCALE(PWM1_MTBS)));
             
             // In load pwm->pwm_type, the PWM channel acts as a 0-100% variable duty cycle
             if (type == PWM_TYPE_LOAD)
@@ -69,12 +103,13 @@ void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type)
             IOCON1bits.PENH = 1;    // Enable PWM_1H
             IOCON1bits.PMOD = 3;    // True independent PWM
             PWMCON1bits.ITB = 1;    // Independent time base for PWM_1L / PWM_1H pair
+            PWMCON1bits.MTBS = PWM1_MTBS; // Primary or servo time base, see pwm.h
             FCLCON1bits.FLTMOD = 3; // No PWM fault can occur
             
             TRISEbits.TRISE1 = 0;   // RE1 is an output
             // The phase is defined in pwm.h for each PWM channel
-            PHASE1 = (uint16_t)(FOSC / (PWM1H_PHASE * PWM_CLOCK_PRESCALE));
-            PDC1 = (uint16_t)(FOSC / (PWM1H_PHASE * PWM_CLOCK_PRESCALE));
+            PHASE1 = (uint16_t)(FOSC / (PWM1H_PHASE * PWM_TB_PRESCALE(PWM1_MTBS)));
+            PDC1 = (uint16_t)(FOSC / (PWM1H_PHASE * PWM_TB_PRESCALE(PWM1_MTBS)));
             
             // In load type, the PWM channel acts as a 0-100% variable duty cycle
             if (pwm->pwm_type == PWM_TYPE_LOAD)
@@ -98,12 +133,13 @@ void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type)
             IOCON2bits.PENL = 1;    // Enable PWM_2L
             IOCON2bits.PMOD = 3;    // True independent PWM
             PWMCON2bits.ITB = 1;    // Independent time base for PWM_2L / PWM_2H pair
+            PWMCON2bits.MTBS = PWM2_MTBS; // Primary or servo time base, see pwm.h
             FCLCON2bits.FLTMOD = 3; // No PWM fault can occur
             
             TRISEbits.TRISE2 = 0;   // RE2 is an output
             // The phase is defined in pwm.h for each PWM channel
-            SPHASE2 = (uint16_t)(FOSC / (PWM2L_PHASE * PWM_CLOCK_PRESCALE));
-            SDC2 = (uint16_t)(FOSC / (PWM2L_PHASE * PWM_CLOCK_PRESCALE));
+            SPHASE2 = (uint16_t)(FOSC / (PWM2L_PHASE * PWM_TB_PRESCALE(PWM2_MTBS)));
+            SDC2 = (uint16_t)(FOSC / (PWM2L_PHASE * PWM_TB_PRESCALE(PWM2_MTBS)));
             
             // In load type, the PWM channel acts as a 0-100% variable duty cycle
             if (pwm->pwm_type == PWM_TYPE_LOAD)
@@ -127,12 +163,13 @@ void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type)
             IOCON2bits.PENH = 1;    // Enable PWM_2H
             IOCON2bits.PMOD = 3;    // True independent PWM
             PWMCON2bits.ITB = 1;    // Independent time base for PWM_2L / PWM_2H pair
+            PWMCON2bits.MTBS = PWM2_MTBS; // Primary or servo time base, see pwm.h
             FCLCON2bits.FLTMOD = 3; // No PWM fault can occur
             
             TRISEbits.TRISE3 = 0;   // RE3 is an output
             // The phase is defined in pwm.h for each PWM channel
-            PHASE2 = (uint16_t)(FOSC / (PWM2H_PHASE * PWM_CLOCK_PRESCALE));
-            PDC2 = (uint16_t)(FOSC / (PWM2H_PHASE * PWM_CLOCK_PRESCALE));
+            PHASE2 = (uint16_t)(FOSC / (PWM2H_PHASE * PWM_TB_PRESCALE(PWM2_MTBS)));
+            PDC2 = (uint16_t)(FOSC / (PWM2H_PHASE * PWM_TB_PRESCALE(PWM2_MTBS)));
             
             // In load type, the PWM channel acts as a 0-100% variable duty cycle
             if (pwm->pwm_type == PWM_TYPE_LOAD)
@@ -156,12 +193,13 @@ void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type)
             IOCON4bits.PENH = 1;    // Enable PWM_4H
             IOCON4bits.PMOD = 3;    // True independent PWM
             PWMCON4bits.ITB = 1;    // Independent time base for PWM_4L / PWM_4H pair
+            PWMCON4bits.MTBS = PWM4_MTBS; // Primary or servo time base, see pwm.h
             FCLCON4bits.FLTMOD = 3; // No PWM fault can occur
             
             TRISEbits.TRISE7 = 0;   // RE7 is an output
             // The phase is defined in pwm.h for each PWM channel
-            PHASE4 = (uint16_t)(FOSC / (PWM4H_PHASE * PWM_CLOCK_PRESCALE));
-            PDC4 = (uint16_t)(FOSC / (PWM4H_PHASE * PWM_CLOCK_PRESCALE));
+            PHASE4 = (uint16_t)(FOSC / (PWM4H_PHASE * PWM_TB_PRESCALE(PWM4_MTBS)));
+            PDC4 = (uint16_t)(FOSC / (PWM4H_PHASE * PWM_TB_PRESCALE(PWM4_MTBS)));
             
             // In load type, the PWM channel acts as a 0-100% variable duty cycle
             if (pwm->pwm_type == PWM_TYPE_LOAD)
@@ -185,12 +223,13 @@ void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type)
             IOCON5bits.PENL = 1;    // Enable PWM_5L
             IOCON5bits.PMOD = 3;    // True independent PWM
             PWMCON5bits.ITB = 1;    // Independent time base for PWM_5L / PWM_5H pair
+            PWMCON5bits.MTBS = PWM5_MTBS; // Primary or servo time base, see pwm.h
             FCLCON5bits.FLTMOD = 3; // No PWM fault can occur
             
             TRISCbits.TRISC1 = 0;   // RC1 is an output
             // The phase is defined in pwm.h for each PWM channel
-            SPHASE5 = (uint16_t)(FOSC / (PWM5L_PHASE * PWM_CLOCK_PRESCALE));
-            SDC5 = (uint16_t)(FOSC / (PWM5L_PHASE * PWM_CLOCK_PRESCALE));
+            SPHASE5 = (uint16_t)(FOSC / (PWM5L_PHASE * PWM_TB_PRESCALE(PWM5_MTBS)));
+            SDC5 = (uint16_t)(FOSC / (PWM5L_PHASE * PWM_TB_PRESCALE(PWM5_MTBS)));
             
             // In load type, the PWM channel acts as a 0-100% variable duty cycle
             if (pwm->pwm_type == PWM_TYPE_LOAD)
@@ -214,12 +253,13 @@ void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type)
             IOCON5bits.PENH = 1;    // Enable PWM_5H
             IOCON5bits.PMOD = 3;    // True independent PWM
             PWMCON5bits.ITB = 1;    // Independent time base for PWM_5L / PWM_5H pair
+            PWMCON5bits.MTBS = PWM5_MTBS; // Primary or servo time base, see pwm.h
             FCLCON5bits.FLTMOD = 3; // No PWM fault can occur
             
             TRISCbits.TRISC2 = 0;   // RC2 is an output
             // The phase is defined in pwm.h for each PWM channel
-            PHASE5 = (uint16_t)(FOSC / (PWM5H_PHASE * PWM_CLOCK_PRESCALE));
-            PDC5 = (uint16_t)(FOSC / (PWM5H_PHASE * PWM_CLOCK_PRESCALE));
+            PHASE5 = (uint16_t)(FOSC / (PWM5H_PHASE * PWM_TB_PRESCALE(PWM5_MTBS)));
+            PDC5 = (uint16_t)(FOSC / (PWM5H_PHASE * PWM_TB_PRESCALE(PWM5_MTBS)));
             
             // In load type, the PWM channel acts as a 0-100% variable duty cycle
             if (pwm->pwm_type == PWM_TYPE_LOAD)
@@ -243,12 +283,13 @@ void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type)
             IOCON6bits.PENL = 1;    // Enable PWM_6L
             IOCON6bits.PMOD = 3;    // True independent PWM
             PWMCON6bits.ITB = 1;    // Independent time base for PWM_6L / PWM_6H pair
+            PWMCON6bits.MTBS = PWM6_MTBS; // Primary or servo time base, see pwm.h
             FCLCON6bits.FLTMOD = 3; // No PWM fault can occur
             
             TRISCbits.TRISC3 = 0;   // RC3 is an output
             // The phase is defined in pwm.h for each PWM channel
-            SPHASE6 = (uint16_t)(FOSC / (PWM6L_PHASE * PWM_CLOCK_PRESCALE));
-            SDC6 = (uint16_t)(FOSC / (PWM6L_PHASE * PWM_CLOCK_PRESCALE));
+            SPHASE6 = (uint16_t)(FOSC / (PWM6L_PHASE * PWM_TB_PRESCALE(PWM6_MTBS)));
+            SDC6 = (uint16_t)(FOSC / (PWM6L_PHASE * PWM_TB_PRESCALE(PWM6_MTBS)));
             
             // In load type, the PWM channel acts as a 0-100% variable duty cycle
             if (pwm->pwm_type == PWM_TYPE_LOAD)
@@ -272,12 +313,13 @@ void PWM_init (STRUCT_PWM *pwm, uint8_t channel, uint8_t type)
             IOCON6bits.PENH = 1;    // Enable PWM_6H
             IOCON6bits.PMOD = 3;    // True independent PWM
             PWMCON6bits.ITB = 1;    // Independent time base for PWM_6L / PWM_6H pair
+            PWMCON6bits.MTBS = PWM6_MTBS; // Primary or servo time base, see pwm.h
             FCLCON6bits.FLTMOD = 3; // No PWM fault can occur
             
             TRISCbits.TRISC4 = 0;   // RC4 is an output
             // The phase is defined in pwm.h for each PWM channel
-            PHASE6 = (uint16_t)(FOSC / (PWM6H_PHASE * PWM_CLOCK_PRESCALE));
-            PDC6 = (uint16_t)(FOSC / (PWM6H_PHASE * PWM_CLOCK_PRESCALE));
+            PHASE6 = (uint16_t)(FOSC / (PWM6H_PHASE * PWM_TB_PRESCALE(PWM6_MTBS)));
+            PDC6 = (uint16_t)(FOSC / (PWM6H_PHASE * PWM_TB_PRESCALE(PWM6_MTBS)));
             
             // In load type, the PWM channel acts as a 0-100% variable duty cycle
             if (pwm->pwm_type == PWM_TYPE_LOAD)
@@ -321,33 +363,31 @@ uint8_t PWM_get_position (STRUCT_PWM *pwm)
     return pwm->value_p;
 }
 
-//*******void PWM_change_duty (uint8_t channel, uint8_t duty)*****//
+//*******void PWM_change_duty (STRUCT_PWM *pwm, uint16_t duty)*****//
 //Description : Function changes the duty cycle of the selected PWM channel
+//              with the full resolution of the duty cycle register. 
+//              duty is a fraction of PWM_DUTY_MAX (32768 = 100%), scaled to
+//              the channel range in integer math, rounded to nearest.
 //
-//Function prototype : void PWM_change_duty (uint8_t channel, uint8_t duty)
+//Function prototype : void PWM_change_duty (STRUCT_PWM *pwm, uint16_t duty)
 //
-//Enter params       : uint8_t channel : PWMx channel
-//                     uint8_t duty : new duty cycle
+//Enter params       : STRUCT_PWM *pwm : PWMx channel
+//                     uint16_t duty : new duty cycle, 0 to PWM_DUTY_MAX
 //
 //Exit params        : None 
 //
-//Function call      : PWM_change_duty(PWM_1H, 30);
+//Function call      : PWM_change_duty(PWM1H_struct, PWM_DUTY_MAX / 4);
 //
 //Jean-Francois Bilodeau    MPLab X v5.45    30/01/2021  
 ///*****************************************************************************
-void PWM_change_duty_perc (STRUCT_PWM *pwm, uint8_t duty)
+void PWM_change_duty (STRUCT_PWM *pwm, uint16_t duty)
 {
-    if (duty > 100){duty = 100;}
+    if (duty > PWM_DUTY_MAX){duty = PWM_DUTY_MAX;}
 
-    if (pwm->pwm_type == PWM_TYPE_LOAD)
-    {
-        pwm->new_duty = (uint16_t)((pwm->range * (float)duty/100.0));                   // Change duty percentage;
-    }
-    else
-    {
-        pwm->new_duty = (uint16_t)((pwm->range * ((float)duty/100.0)) + pwm->base_value);// Change duty percentage                     
-    }
-    pwm->value_p = duty;     // Update struct variable with new percentage
+    // base_value is 0 in load type
+    pwm->new_duty = pwm->base_value + (uint16_t)((((uint32_t)pwm->range * duty) + (PWM_DUTY_MAX >> 1)) >> 15);
+    pwm->value_q15 = duty;
+    pwm->value_p = (uint8_t)((((uint32_t)duty * 100) + (PWM_DUTY_MAX >> 1)) >> 15);
 
     switch (pwm->PWM_channel)
     {        
@@ -390,4 +430,31 @@ void PWM_change_duty_perc (STRUCT_PWM *pwm, uint8_t duty)
         default:    
             break;
     }
-}
\ No newline at end of file
+}
+
+//*******void PWM_change_duty_perc (STRUCT_PWM *pwm, uint8_t duty)*****//
+//Description : Function changes the duty cycle of the selected PWM channel
+//              in 1% steps, see PWM_change_duty
+//
+//Function prototype : void PWM_change_duty_perc (STRUCT_PWM *pwm, uint8_t duty)
+//
+//Enter params       : STRUCT_PWM *pwm : PWMx channel
+//                     uint8_t duty : new duty cycle, 0 to 100%
+//
+//Exit params        : None 
+//
+//Function call      : PWM_change_duty_perc(PWM1H_struct, 30);
+//
+//Jean-Francois Bilodeau    MPLab X v5.45    30/01/2021  
+///*****************************************************************************
+void PWM_change_duty_perc (STRUCT_PWM *pwm, uint8_t duty)
+{
+    if (duty > 100){duty = 100;}
+    PWM_change_duty(pwm, (uint16_t)((((uint32_t)duty * PWM_DUTY_MAX) + 50) / 100));
+}
+
+// Returns the last duty cycle, PWM_DUTY_MAX = 100%
+uint16_t PWM_get_duty (STRUCT_PWM *pwm)
+{
+    return pwm->value_q15;
+}
@@ -1,4 +1,5 @@
 #include "rot_encoder.h"
+#include "isr_stat.h"
 
 STRUCT_ENCODER ENCODER_struct[ENCODER_QTY];
 
@@ -119,6 +120,7 @@ void ENCODER_interrupt_handle (STRUCT_ENCODER *enc)
 // Encoder 1 interrupt handle
 void __attribute__((__interrupt__, no_auto_psv)) _CNInterrupt(void)
 {
+    ISR_STAT_ENTER(ISR_VECT_CN);
     IFS1bits.CNIF = 0;   
     if ((PORTAbits.RA15 == 1) && (ENCODER_struct[ENC_1].B_state == 0))
     {
@@ -128,4 +130,5 @@ void __attribute__((__interrupt__, no_auto_psv)) _CNInterrupt(void)
     }
     else
         ENCODER_struct[ENC_1].B_state = PORTAbits.RA15;
+    ISR_STAT_EXIT(ISR_VECT_CN);
 }
@@ -0,0 +1,375 @@
+//****************************************************************************//
+// File      :  scheduler.c
+//
+// Functions :  uint8_t SCHED_init (STRUCT_TIMER *timebase, uint8_t timebase_channel);
+//              uint8_t SCHED_task_init (STRUCT_TASK *task, uint8_t priority, 
+//                                       void (*handler)(uint16_t events), 
+//                                       uint32_t period_us, uint32_t deadline_us);
+//              uint8_t SCHED_task_enable (uint8_t priority, uint8_t state);
+//              void SCHED_post_event (uint8_t priority, uint16_t events);
+//              uint8_t SCHED_run (void);
+//              uint32_t SCHED_get_next_release (void);
+//              uint32_t SCHED_get_stat (uint8_t priority, uint8_t type);
+//              void SCHED_reset_stat (uint8_t priority);
+//
+// Includes  :  scheduler.h
+//
+// Purpose   :  Cooperative, run-to-completion, priority-ordered task scheduler
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+#include "scheduler.h"
+
+STRUCT_TASK SCHED_task_struct[SCHED_TASK_QTY];   // Default task storage
+STRUCT_TASK *SCHED_task[SCHED_TASK_QTY];        // Registered task of each priority slot, 0 = empty
+
+//*******uint8_t SCHED_init (STRUCT_TIMER *timebase, uint8_t timebase_channel)*****//
+//Description : Function initializes the scheduler and its 32-bit timebase. 
+//              All task slots are emptied.
+//
+//Function prototype : uint8_t SCHED_init (STRUCT_TIMER *timebase, uint8_t timebase_channel)
+//
+//Enter params       : STRUCT_TIMER *timebase : timer used as the timebase
+//                     uint8_t timebase_channel : TIMER_2, TIMER_4, TIMER_6 or TIMER_8
+//
+//Exit params        : uint8_t : 1 if success, 0 otherwise
+//
+//Function call      : SCHED_init(TIMER8_struct, TIMER_8);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t SCHED_init (STRUCT_TIMER *timebase, uint8_t timebase_channel)
+{
+    uint8_t i = 0;
+    for (; i < SCHED_TASK_QTY; i++)
+    {
+        memset(&SCHED_task_struct[i], 0, sizeof(STRUCT_TASK));
+        SCHED_task_struct[i].priority = i;
+        SCHED_task_struct[i].enable = SCHED_TASK_DISABLE;
+        SCHED_task[i] = 0;
+    }
+    // 1 tick = 1 instruction cycle, 61s wrap-around at 70MIPS
+    return TIMER_timebase_init(timebase, timebase_channel, TIMER_PRESCALER_1);
+}
+
+//**************************uint8_t SCHED_task_init (...)**********************//
+//Description : Function registers a task in the slot given by its priority.
+//              A task with a period of 0 is only released by posted events.
+//              The scheduler keeps a reference to the task structure, it can
+//              be &SCHED_task_struct[priority] or application storage that
+//              stays valid while the task is registered. A task registered 
+//              in an occupied slot replaces the previous one.
+//
+//Function prototype : uint8_t SCHED_task_init (STRUCT_TASK *task, uint8_t priority, 
+//                                              void (*handler)(uint16_t events), 
+//                                              uint32_t period_us, uint32_t deadline_us)
+//
+//Enter params       : STRUCT_TASK *task : task structure
+//                     uint8_t priority : 0 (highest) to SCHED_TASK_QTY - 1
+//                     void (*handler)(uint16_t) : task body
+//                     uint32_t period_us : periodic release in us, 0 = none
+//                     uint32_t deadline_us : release to completion deadline in us, 0 = none
+//
+//Exit params        : uint8_t : 1 if success, 0 otherwise
+//
+//Function call      : SCHED_task_init(TASK_pid_struct, 0, task_pid, 33333, 33333);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t SCHED_task_init (STRUCT_TASK *task, uint8_t priority, void (*handler)(uint16_t events), uint32_t period_us, uint32_t deadline_us)
+{
+    uint16_t cpu_ipl;
+    
+    if ((task == 0) || (priority >= SCHED_TASK_QTY) || (handler == 0))
+    {
+        return 0;
+    }
+    
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);   // SCHED_post_event() may run from an ISR
+    SCHED_task[priority] = 0;
+    RESTORE_CPU_IPL(cpu_ipl);
+    
+    memset(task, 0, sizeof(STRUCT_TASK));
+    task->handler = handler;
+    task->priority = priority;
+    task->period = TIMER_timebase_us_to_ticks(period_us);
+    task->deadline = TIMER_timebase_us_to_ticks(deadline_us);
+    task->next_release = TIMER_timebase_get() + task->period;
+    task->enable = SCHED_TASK_ENABLE;
+    SCHED_task[priority] = task;
+    return 1;
+}
+
+uint8_t SCHED_task_enable (uint8_t priority, uint8_t state)
+{
+    STRUCT_TASK *task;
+    if ((priority >= SCHED_TASK_QTY) || (SCHED_task[priority] == 0))
+    {
+        return 0;
+    }
+    task = SCHED_task[priority];
+    if ((state == SCHED_TASK_ENABLE) && (task->enable == SCHED_TASK_DISABLE))
+    {
+        task->events = 0;
+        task->next_release = TIMER_timebase_get() + task->period;
+    }
+    task->enable = state;
+    return 1;
+}
+
+//*************void SCHED_post_event (uint8_t priority, uint16_t events)*******//
+//Description : Function marks events pending for a task. Safe to call from 
+//              an ISR. The release time used for latency and deadline 
+//              accounting is the time of the first pending event.
+//
+//Function prototype : void SCHED_post_event (uint8_t priority, uint16_t events)
+//
+//Enter params       : uint8_t priority : task slot
+//                     uint16_t events : SCHED_EVENT_x bits
+//
+//Exit params        : None
+//
+//Function call      : SCHED_post_event(2, SCHED_EVENT_USER_1);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+void SCHED_post_event (uint8_t priority, uint16_t events)
+{
+    STRUCT_TASK *task;
+    uint16_t cpu_ipl;
+    
+    if ((priority >= SCHED_TASK_QTY) || (SCHED_task[priority] == 0))
+    {
+        return;
+    }
+    task = SCHED_task[priority];
+    SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+    if (task->events == 0)
+    {
+        task->release_time = TIMER_timebase_get();
+    }
+    task->events |= events;
+    RESTORE_CPU_IPL(cpu_ipl);
+}
+
+//***************************uint8_t SCHED_run (void)*************************//
+//Description : Function generates the periodic releases that are due, then 
+//              dispatches the highest priority ready task and updates its 
+//              statistics. Call it continuously from the main loop, each 
+//              call runs at most one task so that a newly released higher 
+//              priority task is served before lower priority ones.
+//
+//Function prototype : uint8_t SCHED_run (void)
+//
+//Enter params       : None
+//
+//Exit params        : uint8_t : 1 if a task was run, 0 if no task was ready
+//
+//Function call      : SCHED_run();
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint8_t SCHED_run (void)
+{
+    STRUCT_TASK *task;
+    uint32_t now, start, end, release;
+    uint16_t events, cpu_ipl;
+    uint8_t i = 0;
+    
+    // Periodic releases
+    now = TIMER_timebase_get();
+    for (i = 0; i < SCHED_TASK_QTY; i++)
+    {
+        task = SCHED_task[i];
+        if ((task != 0) && (task->enable == SCHED_TASK_ENABLE) && (task->period > 0))
+        {
+            if ((int32_t)(now - task->next_release) >= 0)
+            {
+                SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+                if (task->events & SCHED_EVENT_PERIOD)
+                {
+                    task->release_overrun++;            // Previous release not served yet
+                }
+                if (task->events == 0)
+                {
+                    task->release_time = task->next_release;
+                }
+                task->events |= SCHED_EVENT_PERIOD;
+                RESTORE_CPU_IPL(cpu_ipl);
+                
+                task->next_release += task->period;
+                // Skip the periods that elapsed while the CPU was busy, keep phase
+                while ((int32_t)(now - task->next_release) >= 0)
+                {
+                    task->next_release += task->period;
+                    task->release_overrun++;
+                }
+            }
+        }
+    }
+    
+    // Dispatch the highest priority ready task
+    for (i = 0; i < SCHED_TASK_QTY; i++)
+    {
+        task = SCHED_task[i];
+        if ((task != 0) && (task->enable == SCHED_TASK_ENABLE) && (task->events != 0))
+        {
+            SET_AND_SAVE_CPU_IPL(cpu_ipl, 7);
+            events = task->events;
+            release = task->release_time;
+            task->events = 0;
+            RESTORE_CPU_IPL(cpu_ipl);
+            
+            start = TIMER_timebase_get();
+            task->handler(events);
+            end = TIMER_timebase_get();
+            
+            task->run_count++;
+            task->run_time_last = end - start;
+            if (task->run_time_last > task->run_time_max)
+            {
+                task->run_time_max = task->run_time_last;
+            }
+            task->latency_last = start - release;
+            if (task->latency_last > task->latency_max)
+            {
+                task->latency_max = task->latency_last;
+            }
+            if ((task->deadline > 0) && ((end - release) > task->deadline))
+            {
+                task->deadline_miss++;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//*******************uint32_t SCHED_get_next_release (void)*******************//
+//Description : Function returns the number of timebase ticks before the next
+//              periodic release, 0 if a task is already ready to run and 
+//              0xFFFFFFFF if no periodic task is enabled. Used by the idle 
+//              manager to bound the CPU idle time, it is called with the CPU
+//              IPL raised so that an event posted after the check stays 
+//              pending and wakes the CPU.
+//
+//Function prototype : uint32_t SCHED_get_next_release (void)
+//
+//Enter params       : None
+//
+//Exit params        : uint32_t : ticks before the next release
+//
+//Function call      : IDLE_enter(SCHED_get_next_release);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021   
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+uint32_t SCHED_get_next_release (void)
+{
+    STRUCT_TASK *task;
+    uint32_t now = TIMER_timebase_get();
+    uint32_t next = 0xFFFFFFFF;
+    uint8_t i = 0;
+    
+    for (; i < SCHED_TASK_QTY; i++)
+    {
+        task = SCHED_task[i];
+        if ((task != 0) && (task->enable == SCHED_TASK_ENABLE))
+        {
+            if (task->events != 0)
+            {
+                return 0;
+            }
+            if (task->period > 0)
+            {
+                if ((int32_t)(task->next_release - now) <= 0)
+                {
+                    return 0;
+                }
+                if ((task->next_release - now) < next)
+                {
+                    next = task->next_release - now;
+                }
+            }
+        }
+    }
+    return next;
+}
+
+uint32_t SCHED_get_stat (uint8_t priority, uint8_t type)
+{
+    STRUCT_TASK *task;
+    if ((priority >= SCHED_TASK_QTY) || (SCHED_task[priority] == 0))
+    {
+        return 0;
+    }
+    task = SCHED_task[priority];
+    switch (type)
+    {
+        case SCHED_STAT_RUN_COUNT:
+            return task->run_count;
+            break;
+            
+        case SCHED_STAT_RUN_TIME_LAST:
+            return task->run_time_last;
+            break;
+            
+        case SCHED_STAT_RUN_TIME_MAX:
+            return task->run_time_max;
+            break;
+            
+        case SCHED_STAT_LATENCY_LAST:
+            return task->latency_last;
+            break;
+            
+        case SCHED_STAT_LATENCY_MAX:
+            return task->latency_max;
+            break;
+            
+        case SCHED_STAT_DEADLINE_MISS:
+            return task->deadline_miss;
+            break;
+            
+        case SCHED_STAT_RELEASE_OVERRUN:
+            return task->release_overrun;
+            break;
+            
+        default:
+            return 0;
+            break;
+    }
+}
+
+void SCHED_reset_stat (uint8_t priority)
+{
+    STRUCT_TASK *task;
+    if ((priority >= SCHED_TASK_QTY) || (SCHED_task[priority] == 0))
+    {
+        return;
+    }
+    task = SCHED_task[priority];
+    task->run_count = 0;
+    task->run_time_last = 0;
+    task->run_time_max = 0;
+    task->latency_last = 0;
+    task->latency_max = 0;
+    task->deadline_miss = 0;
+    task->release_overrun = 0;
+}
@@ -11,6 +11,7 @@
 //              void SPI_flush_txbuffer (uint8_t channel);
 //              void SPI_flush_rxbuffer (uint8_t channel);
 //              uint8_t SPI_module_busy (uint8_t channel); 
+//              void SPI_set_callback (STRUCT_SPI *spi, void (*callback)(void *context), void *context);
 //
 // Includes  :  spi.h
 //           
@@ -27,6 +28,7 @@
 // www.github.com/lecejeff/dspeak
 //****************************************************************************//
 #include "spi.h"
+#include "isr_stat.h"
 STRUCT_SPI SPI_struct[SPI_QTY];
 
 #ifdef SPI1_DMA_ENABLE
@@ -410,6 +412,8 @@ void SPI_init (STRUCT_SPI *spi, uint8_t spi_channel, uint8_t spi_mode, uint8_t p
     spi->tx_length = 0;
     spi->last_tx_length = 0;
     spi->tx_remaining = 0;
+    spi->callback = 0;
+    spi->context = 0;
 }
 
 //void SPI_write (uint8_t channel, uint8_t *data, uint8_t length, uint8_t chip)//
@@ -1095,6 +1099,32 @@ void SPI_flush_rxbuffer (STRUCT_SPI *spi)
     }    
 }
 
+//*****void SPI_set_callback (STRUCT_SPI *spi, void (*callback)(void *context), void *context)*****//
+//Description : Function sets a function called from the SPI interrupt once
+//              a SPI_write transfer is over (/CS deasserted, rx buffer filled)
+//              The callback must be kept short, 0 disables it
+//
+//Function prototype : void SPI_set_callback (STRUCT_SPI *spi, void (*callback)(void *context), void *context)
+//
+//Enter params       : STRUCT_SPI *spi : SPI port structure
+//                   : void (*callback)(void *context) : end of transfer function
+//                   : void *context : parameter given to the callback
+//
+//Exit params        : None
+//
+//Function call      : SPI_set_callback(&SPI_struct[SPI_4], imu_spi_done, &imu);
+//
+// Intellitrol           MPLab X v5.45            XC16 v1.61          05/04/2021  
+// Jean-Francois Bilodeau, B.E.Eng/CPI #6022173 
+// jeanfrancois.bilodeau@hotmail.fr
+// www.github.com/lecejeff/dspeak
+//****************************************************************************//
+void SPI_set_callback (STRUCT_SPI *spi, void (*callback)(void *context), void *context)
+{
+    spi->callback = callback;
+    spi->context = context;
+}
+
 //**************************SPI1 interrupt function***************************//
 //Description : SPI interrupt with enhanced buffer.
 //
@@ -1113,6 +1143,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _SPI1Interrupt(void)
 {                
     uint16_t i=0;  
     uint8_t temp;
+    ISR_STAT_ENTER(ISR_VECT_SPI1);
     // Based on last transfer length, read SPI RXFIFO and put value in struct rx buffer
     for (i=0; i<SPI_struct[SPI_1].last_tx_length; i++)
     {
@@ -1155,9 +1186,14 @@ void __attribute__((__interrupt__, no_auto_psv)) _SPI1Interrupt(void)
             SPI_deassert_cs(&SPI_struct[SPI_1]);
             SPI_struct[SPI_1].txfer_state = SPI_TX_COMPLETE;       
             IEC0bits.SPI1IE = 0;             
+            if (SPI_struct[SPI_1].callback != 0)
+            {
+                SPI_struct[SPI_1].callback(SPI_struct[SPI_1].context);
+            }
         }
     } 
     IFS0bits.SPI1IF = 0;
+    ISR_STAT_EXIT(ISR_VECT_SPI1);
 }
 
 //**************************SPI2interrupt function***************************//
@@ -1176,6 +1212,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _SPI1Interrupt(void)
 //****************************************************************************//
 void __attribute__((__interrupt__, no_auto_psv)) _SPI2Interrupt(void)
 {  
+    ISR_STAT_ENTER(ISR_VECT_SPI2);
 #ifndef SPI2_DMA_ENABLE
     uint16_t i=0;  
     uint8_t temp;
@@ -1221,10 +1258,15 @@ void __attribute__((__interrupt__, no_auto_psv)) _SPI2Interrupt(void)
             SPI_deassert_cs(&SPI_struct[SPI_2]);
             SPI_struct[SPI_2].txfer_state = SPI_TX_COMPLETE;       
             IEC2bits.SPI2IE = 0;             
+            if (SPI_struct[SPI_2].callback != 0)
+            {
+                SPI_struct[SPI_2].callback(SPI_struct[SPI_2].context);
+            }
         }
     } 
 #endif
     IFS2bits.SPI2IF = 0;
+    ISR_STAT_EXIT(ISR_VECT_SPI2);
 }
 
 //**************************SPI3 interrupt function***************************//
@@ -1245,6 +1287,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _SPI3Interrupt(void)
 {
     uint16_t i=0;
     uint8_t temp;
+    ISR_STAT_ENTER(ISR_VECT_SPI3);
     // Based on last transfer length, read SPI RXFIFO and put value in struct rx buffer
     for (i=0; i<SPI_struct[SPI_3].last_tx_length; i++)
     {
@@ -1287,9 +1330,14 @@ void __attribute__((__interrupt__, no_auto_psv)) _SPI3Interrupt(void)
             SPI_deassert_cs(&SPI_struct[SPI_3]);
             SPI_struct[SPI_3].txfer_state = SPI_TX_COMPLETE;       
             IEC5bits.SPI3IE = 0;             
+            if (SPI_struct[SPI_3].callback != 0)
+            {
+                SPI_struct[SPI_3].callback(SPI_struct[SPI_3].context);
+            }
         }
     } 
     IFS5bits.SPI3IF = 0; 
+    ISR_STAT_EXIT(ISR_VECT_SPI3);
 }
 
 //**************************SPI4 interrupt function***************************//
@@ -1310,6 +1358,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _SPI4Interrupt(void)
 {
     uint8_t temp; 
     uint16_t i=0;
+    ISR_STAT_ENTER(ISR_VECT_SPI4);
     // Based on last transfer length, read SPI RXFIFO and put value in struct rx buffer
     for (i=0; i<SPI_struct[SPI_4].last_tx_length; i++)
     {
@@ -1352,9 +1401,14 @@ void __attribute__((__interrupt__, no_auto_psv)) _SPI4Interrupt(void)
             SPI_deassert_cs(&SPI_struct[SPI_4]);
             SPI_struct[SPI_4].txfer_state = SPI_TX_COMPLETE;       
             IEC7bits.SPI4IE = 0;             
+            if (SPI_struct[SPI_4].callback != 0)
+            {
+                SPI_struct[SPI_4].callback(SPI_struct[SPI_4].context);
+            }
         }                      
     }
     IFS7bits.SPI4IF = 0;
+    ISR_STAT_EXIT(ISR_VECT_SPI4);
 }
 
 void __attribute__((__interrupt__, no_auto_psv)) _SPI1ErrInterrupt(void)
@@ -75,6 +75,7 @@
 #include "ividac_driver.h"
 #include "ft8xx.h"
 #include "bno080.h"
+#include "balance.h"
 
 // Access to CAN struct members
 extern STRUCT_CAN CAN_struct[CAN_QTY];
@@ -162,10 +163,10 @@ STRUCT_BT8XX *eve = &BT8XX_struct[BT8XX_1];
 extern STRUCT_BNO08X BNO08X_struct[BNO08X_QTY];
 STRUCT_BNO08X *BNO_struct = &BNO08X_struct[BNO08X_1];
 
-void pid_func (void);
+void bno_orientation_handler (STRUCT_BNO08X_REPORT *report);
+void balance_drive (int16_t out);
 
 // Debug variables related to functions under development
-uint8_t new_pid_out1 = 0, new_pid_out2 = 0;
 uint8_t direction_1 = 0, direction_2 = 0;
 uint8_t state = 0;
 uint16_t counter_5sec  = 0;
@@ -227,34 +228,28 @@ uint32_t tracker = 0;
 uint8_t track_counter = 0;
 uint8_t key = 0;
 
-uint16_t bno_rd_length = 0;
-uint8_t *i2c_buf;
-uint8_t BNO08X_read = 0;
-uint8_t BNO08X_flag = 0;
 uint8_t BNO08X_state = 0;
 
 uint8_t dummy = 0;
 uint8_t bno08x_advertise[2] = {BNO08X_CHANNEL0_SHTP, BNO08X_SHTP_ADVERTISE_HOST};
-uint8_t data[1] = {BNO08X_DEFAULT_ADDRESS};
-uint8_t set_feature_acc[21] = {0};
+// Gyro-integrated rotation vector every 5ms : orientation and angular rate
+STRUCT_BNO08X_FEATURE bno_orientation_feature = {BNO08X_SENSOR_ID_GYRO_INT_RV, 0, 0, 5000, 0, 0};
 uint8_t UART_debug_flag = 0;
-uint8_t y_axis_flag = 0;
-int16_t y_axis = 0;
-int16_t y_axis_setpoint = 0;
-double p_gain = 0.03;
-double i_gain = 0.0005;
-double d_gain = 0;
 
-double p_value;
-double i_value;
-double d_value;
-
-uint16_t pid;
-uint16_t pid_out = 0;
-uint8_t pid_flag = 0;
-uint8_t direction = 0;
-
-int16_t y_error = 0;
+// Latest orientation sample, written by bno_orientation_handler
+STRUCT_BNO08X_QUATERNION bno_quat;
+STRUCT_BNO08X_VECTOR bno_rate;
+uint32_t bno_sample_time = 0;
+volatile uint8_t bno_sample_flag = 0;
+
+// Tilt controller, roll axis. Q8 gains, see balance.h
+STRUCT_BALANCE balance;
+STRUCT_BNO08X_QUATERNION tilt_quat;
+STRUCT_BNO08X_VECTOR tilt_rate;
+uint32_t tilt_time = 0;
+STRUCT_BNO08X_EULER tilt;
+int16_t balance_out = 0;
+uint16_t old_ipl;
 
 int main() 
 {
@@ -284,38 +279,27 @@ int main()
     //Physical rotary encoder initialization
     //ENCODER_init(ENC1_struct, ENC_1, 30); 
 
+    // TIMER8/9 32-bit timebase : I2C timeouts and BNO08X INTn to report latency
+    TIMER_timebase_init(TIMER8_struct, TIMER_8, TIMER_PRESCALER_1);
     BNO08X_init(BNO_struct, I2C1_struct, BNO08X_MKB2);  
+    BNO08X_register_handler(BNO_struct, BNO08X_SENSOR_ID_GYRO_INT_RV, bno_orientation_handler);
+    BNO08X_irq_read_enable(BNO_struct, 1);
     while(BNO08X_has_reset(BNO_struct) == 0);
+    BALANCE_init(&balance, 8000, 6000, 3000);
        
     // Timers init / start should be the last function calls made before while(1) 
     TIMER_init(TIMER1_struct, TIMER_1, TIMER_MODE_16B, TIMER_PRESCALER_256, 10);
     TIMER_init(TIMER2_struct, TIMER_2, TIMER_MODE_16B, TIMER_PRESCALER_256, 10);
     TIMER_init(TIMER3_struct, TIMER_3, TIMER_MODE_16B, TIMER_PRESCALER_256, 30);   
     TIMER_init(TIMER4_struct, TIMER_4, TIMER_MODE_16B, TIMER_PRESCALER_1, 900000);
-    TIMER_init(TIMER5_struct, TIMER_5, TIMER_MODE_16B, TIMER_PRESCALER_256, 30);   
-    TIMER_init(TIMER6_struct, TIMER_6, TIMER_MODE_16B, TIMER_PRESCALER_256, 30);   
-    TIMER_init(TIMER7_struct, TIMER_7, TIMER_MODE_16B, TIMER_PRESCALER_256, 30);    // Motor driver refresh timer     
-    TIMER_init(TIMER8_struct, TIMER_8, TIMER_MODE_16B, TIMER_PRESCALER_1, 900000);      // 
-    TIMER_init(TIMER9_struct, TIMER_9, TIMER_MODE_16B, TIMER_PRESCALER_1, 900000);  // BNO08X state machine   
 
     TIMER_start(TIMER1_struct);
     TIMER_start(TIMER2_struct);
     TIMER_start(TIMER3_struct);   
     TIMER_start(TIMER4_struct);
-    TIMER_start(TIMER5_struct);
-    TIMER_start(TIMER6_struct);
-    TIMER_start(TIMER7_struct);
-    TIMER_start(TIMER8_struct);
-    TIMER_start(TIMER9_struct);
     
     while (1)
     {      
-        // BNO08X is ready for a new data transfer
-        if (BNO08X_int_state(BNO_struct) == 1)
-        {
-            BNO08X_flag = 1;
-        }
-        
         // dsPeak on-board button debouncer state machine
         if (TIMER_get_state(TIMER1_struct, TIMER_INT_STATE) == 1)
         { 
@@ -397,238 +381,86 @@ int main()
             if (UART_debug_flag == 1)
             {
                 UART_debug_flag = 0;
-                i2c_buf+=13;
                 // Send BNO08X data to serial port
                 motor_debug_buf[0] = 0xAE;
                 motor_debug_buf[1] = 0xAE;
-                motor_debug_buf[2] = *i2c_buf++;    // X axis LSB   
-                motor_debug_buf[3] = *i2c_buf++;    // X axis MSB
-                y_axis = *i2c_buf;
-                motor_debug_buf[4] = *i2c_buf++;    // Y axis LSB  
-                y_axis = *i2c_buf << 8 | y_axis;
-                y_axis_flag = 1;
-                motor_debug_buf[5] = *i2c_buf++;    // Y axis MSB
-                motor_debug_buf[6] = *i2c_buf++;    // Z axis LSB   
-                motor_debug_buf[7] = *i2c_buf;      // Z axis MSB
-                motor_debug_buf[8] = pid_out;
-                motor_debug_buf[9] = ((pid_out & 0xFF00) >> 8);
-                motor_debug_buf[10] = y_error;
-                motor_debug_buf[11] = ((y_error & 0xFF00) >> 8);
+                motor_debug_buf[2] = tilt.roll;                 // Roll LSB, binary angle   
+                motor_debug_buf[3] = ((tilt.roll & 0xFF00) >> 8);   // Roll MSB
+                motor_debug_buf[4] = tilt.pitch;                // Pitch LSB  
+                motor_debug_buf[5] = ((tilt.pitch & 0xFF00) >> 8);  // Pitch MSB
+                motor_debug_buf[6] = tilt.yaw;                  // Yaw LSB   
+                motor_debug_buf[7] = ((tilt.yaw & 0xFF00) >> 8);    // Yaw MSB
+                motor_debug_buf[8] = balance_out;               // Q15 duty
+                motor_debug_buf[9] = ((balance_out & 0xFF00) >> 8);
+                motor_debug_buf[10] = BALANCE_get_error(&balance);
+                motor_debug_buf[11] = ((BALANCE_get_error(&balance) & 0xFF00) >> 8);
                 UART_putbuf_dma(UART_DEBUG_struct, motor_debug_buf, 12);
             }
         }  
       
-        if (TIMER_get_state(TIMER5_struct, TIMER_INT_STATE) == 1)
+        // Balance controller, once per orientation sample
+        if (bno_sample_flag == 1)
         {
-            pid_func();
-        } 
+            SET_AND_SAVE_CPU_IPL(old_ipl, 7);
+            tilt_quat = bno_quat;
+            tilt_rate = bno_rate;
+            tilt_time = bno_sample_time;
+            bno_sample_flag = 0;
+            RESTORE_CPU_IPL(old_ipl);
+            
+            BNO08X_quaternion_to_euler(&tilt_quat, &tilt);
+            balance_out = BALANCE_update(&balance, tilt.roll, tilt_rate.x, tilt_time);
+            balance_drive(balance_out);
+            UART_debug_flag = 1;
+        }
         
-        // QEI velocity refresh rate
-        if (TIMER_get_state(TIMER6_struct, TIMER_INT_STATE) == 1)
-        {   
-            QEI_calculate_velocity(QEI_2);  
-            new_pid_out2 = MOTOR_drive_pid(MOTOR_2); 
-            MOTOR_drive_perc(MOTOR_2, MOTOR_get_direction(MOTOR_2), pid_out);
-        }        
+        // Timeout of the queued BNO08X reads, a stuck bus is recovered and
+        // the read completes with I2C_STATUS_TIMEOUT
+        I2C_task(I2C1_struct);
         
-        // QEI velocity refresh rate
-        if (TIMER_get_state(TIMER7_struct, TIMER_INT_STATE) == 1)
-        {              
-            QEI_calculate_velocity(QEI_1);  
-            new_pid_out1 = MOTOR_drive_pid(MOTOR_1);
-            MOTOR_drive_perc(MOTOR_1, MOTOR_get_direction(MOTOR_1), pid_out);
-        }
-
-        if (TIMER_get_state(TIMER9_struct, TIMER_INT_STATE) == 1)
-        { 
-            dummy = 1;
-        }
-
-        if (TIMER_get_state(TIMER8_struct, TIMER_INT_STATE) == 1)
-        {   
-            switch (BNO08X_state)
-            {
-                case 0: // Reset procedure, shtp advertisement from BNO to host
-                    if (BNO08X_flag == 1)
-                    {
-                        // Is BNO I2C bus free?
-                        if (I2C_rx_done(BNO_struct->i2c_ref) == 1)
-                        {
-                            // Send 1st request to BNO08x, determine the amount of bytes to read
-                            I2C_master_read(BNO_struct->i2c_ref, I2C_READ_MODE_STOP_START, data, 1, 4);
-                            BNO08X_state = 1;
-                            BNO08X_flag = 0;
-                        }                        
-                    }
-                    break;
-
-                case 1: // Get SHTP advertisement length and process message
-                    if (I2C_rx_done(BNO_struct->i2c_ref) == 1)
-                    {
-                        i2c_buf = I2C_get_rx_buffer(I2C1_struct);
-                        BNO08X_parse_shtp(BNO_struct, i2c_buf);
-                        bno_rd_length = BNO08X_get_cargo_length(BNO_struct);
-                        if (bno_rd_length > 0)
-                        {
-                            BNO08X_state = 2;                           
-                        }
-                        else
-                        {
-                            // Error 
-                        }
-                    }
-                    break;
-
-                case 2:
-                    if (BNO08X_flag == 1)
-                    {
-                        I2C_master_read(I2C1_struct, I2C_READ_MODE_STOP_START, data, 1, bno_rd_length);
-                        BNO08X_flag = 0;
-                        BNO08X_state = 3;
-                    }
-                    break;
-                    
-                case 3: 
-                    if (I2C_rx_done(BNO_struct->i2c_ref) == 1)
-                    {
-                        i2c_buf = I2C_get_rx_buffer(I2C1_struct);
-                        BNO08X_parse_shtp(BNO_struct, i2c_buf);
-                        bno_rd_length = BNO08X_get_cargo_length(BNO_struct);
-                        if (BNO_struct->channel == 0x01)    // executable channel
-                        {
-                            i2c_buf += 4;
-                            if (*i2c_buf == 0x01)
-                            {
-                                BNO08X_state = 4;   // Device idle
-                            }
-                        }
-                        
-                        else 
-                        {
-                            if (bno_rd_length > 0)
-                            {
-                                BNO08X_state = 2;
-                            } 
-                            else
-                            {
-                                BNO08X_state = 4;
-                            }
-                        }
-                    }                    
-                    break;
-                    
-                case 4:
-                    // Idle after reset SHTP advertisement completed
-                    dsPeak_led_write(LED1_struct, HIGH);
-                    
-                    // Issue set feature command to SHCC
-                    set_feature_acc[0] = BNO08X_SHCC_SET_FEAT_COM;      // Report ID
-                    set_feature_acc[1] = BNO08X_SENSOR_ID_GRAVITY;         // Feature report ID
-                    set_feature_acc[2] = 0x00;                          // Feature flags (0x04 -> wake-up enabled)
-                    set_feature_acc[3] = 0;        // Change sensitivity (abs / rel) LSB
-                    set_feature_acc[4] = 0;        // Change sensitivity (abs / rel) MSB
-                    set_feature_acc[5] = 0xA0;        // Report interval LSB  (in uSec) (1s = 100000us = 0x186A0
-                    set_feature_acc[6] = 0x86;        // Report interval      (in uSec)
-                    set_feature_acc[7] = 0x01;        // Report interval      (in uSec)
-                    set_feature_acc[8] = 0x00;        // Report interval MSB  (in uSec)
-                    set_feature_acc[9] = 0xFF;        // Batch interval LSB   (in uSec)
-                    set_feature_acc[10] = 0xFF;       // Batch interval       (in uSec)
-                    set_feature_acc[11] = 0xFF;       // Batch interval       (in uSec)
-                    set_feature_acc[12] = 0xFF;       // Batch interval MSB   (in uSec)
-                    set_feature_acc[13] = 0;       // Sensor-specific config LSB
-                    set_feature_acc[14] = 0;       // Sensor-specific config
-                    set_feature_acc[15] = 0;       // Sensor-specific config
-                    set_feature_acc[16] = 0;       // Sensor-specific config MSB
-                    
-                    BNO08X_write(BNO_struct, BNO08X_CHANNEL2_SHCC, set_feature_acc, 17);
-                    BNO08X_state = 5;
-                    bno_rd_length = 4;
-                    break;
-                    
-                case 5:
-                    if (BNO08X_flag == 1)
-                    {
-                        I2C_master_read(I2C1_struct, I2C_READ_MODE_STOP_START, data, 1, bno_rd_length); // See response need how many bytes
-                        BNO08X_flag = 0;
-                        BNO08X_state = 6;
-                    }
-                    break;
-                    
-                case 6: 
-                    if (I2C_rx_done(BNO_struct->i2c_ref) == 1)
-                    {
-                        i2c_buf = I2C_get_rx_buffer(I2C1_struct);
-                        BNO08X_parse_shtp(BNO_struct, i2c_buf);
-                        bno_rd_length = BNO08X_get_cargo_length(BNO_struct);
-                        if (BNO_struct->channel == 0x03)    // sensor report channel
-                        {
-                            i2c_buf = I2C_get_rx_buffer_index(I2C1_struct, 9);
-                            if (*i2c_buf == 0x06) // Magnetometer report
-                            {
-                                UART_debug_flag = 1;
-                                i2c_buf = I2C_get_rx_buffer(I2C1_struct);
-                            }
-                        }
-                        
-                        if (bno_rd_length > 0)
-                        {
-                            BNO08X_state = 5;
-                        } 
-                        else
-                        {
-                            BNO08X_state = 7;
-                        }
-                    } 
-                    break;
-                    
-                case 7:
-                    break;
-                    
-                default:
-                    break;
-            }
+        // Sensor hub reset complete, enable the orientation report once
+        // Reads are started by the BNO08X INTn interrupt, reports reach
+        // bno_orientation_handler from the I2C master interrupt
+        if ((BNO08X_state == 0) && (BNO08X_get_exec_event(BNO_struct) == BNO08X_EXEC_RD_RESET))
+        {
+            dsPeak_led_write(LED1_struct, HIGH);
+            
+            // Gyro-integrated rotation vector every 5ms
+            BNO08X_set_features(BNO_struct, &bno_orientation_feature, 1);
+            BNO08X_state = 1;
         } 
+        
+        // Orientation report accepted by the sensor hub (get feature response)
+        if ((BNO08X_state == 1) && (BNO08X_get_feature_state(BNO_struct, BNO08X_SENSOR_ID_GYRO_INT_RV) == BNO08X_FEATURE_CONFIRMED))
+        {
+            dsPeak_led_write(LED2_struct, HIGH);
+            BNO08X_state = 2;
+        }
     }
     return 0;
 }
 
-void pid_func (void)
+// Gyro-integrated rotation vector, called from BNO08X_shtp_feed
+// Orientation, angular rate and sample time are kept for the main loop
+void bno_orientation_handler (STRUCT_BNO08X_REPORT *report)
 {
-    // Error = setpoint - input
-    y_error = (y_axis_setpoint - y_axis);
-    
-    if (y_error >= 0)
+    BNO08X_decode_quaternion(report, &bno_quat);
+    BNO08X_decode_vector(report, &bno_rate);
+    bno_sample_time = report->timestamp;
+    bno_sample_flag = 1;
+}
+
+// Signed Q15 duty to both motors, mounted facing each other
+void balance_drive (int16_t out)
+{
+    if (out >= 0)
     {
-        MOTOR_set_direction(MOTOR_1, DIRECTION_FORWARD);
-        MOTOR_set_direction(MOTOR_2, DIRECTION_BACKWARD);
+        MOTOR_drive_duty(MOTOR_1, DIRECTION_FORWARD, (uint16_t)out);
+        MOTOR_drive_duty(MOTOR_2, DIRECTION_BACKWARD, (uint16_t)out);
     }
     else
     {
-        MOTOR_set_direction(MOTOR_1, DIRECTION_BACKWARD);
-        MOTOR_set_direction(MOTOR_2, DIRECTION_FORWARD);            
+        MOTOR_drive_duty(MOTOR_1, DIRECTION_BACKWARD, (uint16_t)(-out));
+        MOTOR_drive_duty(MOTOR_2, DIRECTION_FORWARD, (uint16_t)(-out));
     }
-    y_error = abs(y_error);
-    
-    if (y_error < 100)
-    {
-        pid_out = 0;
-    }    
-    else
-    {   
-        // Calculate proportional term
-        p_value = (double)p_gain * (double)y_error;
-        //m_control[channel].p_value = m_control[channel].p_calc_gain * m_control[channel].error_rpm;
-
-        // Calculate integral term
-        i_value += (double)((i_gain * 0.33) * (double)y_error);
-        if (i_value > QEI_MOT1_MAX_RPM){i_value = i_value;}
-
-        // Calculate derivative term
-        // Compute PID output
-        pid = (uint16_t)(p_value + i_value);
-        if (pid > QEI_MOT1_MAX_RPM){pid = QEI_MOT1_MAX_RPM;}
-        if (pid < 0){pid = 0;}
-        pid_out = pid;
-        pid_flag = 1;
-    }
-}
\ No newline at end of file
+}
@@ -74,6 +74,10 @@
 #include "rot_encoder.h"
 #include "ividac_driver.h"
 #include "ft8xx.h"
+#include "scheduler.h"
+#include "profiler.h"
+#include "idle.h"
+#include "isr_stat.h"
 
 // Access to CAN struct members
 extern STRUCT_CAN CAN_struct[CAN_QTY];
@@ -153,6 +157,17 @@ STRUCT_ENCODER *ENC1_struct = &ENCODER_struct[ENC_1];
 extern STRUCT_RTCC RTCC_struct[RTC_QTY];
 STRUCT_RTCC *RTC1_struct = &RTCC_struct[RTC_1];
 
+// Access to SCHEDULER task struct members
+extern STRUCT_TASK SCHED_task_struct[SCHED_TASK_QTY];
+STRUCT_TASK *TASK_motor1_pid_struct = &SCHED_task_struct[0];
+STRUCT_TASK *TASK_motor2_pid_struct = &SCHED_task_struct[1];
+STRUCT_TASK *TASK_uart1_tx_struct = &SCHED_task_struct[2];
+STRUCT_TASK *TASK_uart2_tx_struct = &SCHED_task_struct[3];
+STRUCT_TASK *TASK_button_struct = &SCHED_task_struct[4];
+STRUCT_TASK *TASK_motor_debug_struct = &SCHED_task_struct[5];
+STRUCT_TASK *TASK_5sec_struct = &SCHED_task_struct[6];
+STRUCT_TASK *TASK_eve_refresh_struct = &SCHED_task_struct[7];
+
 // Access to Bridgetek EVE struct member
 extern STRUCT_BT8XX BT8XX_struct[BT8XX_QTY];
 STRUCT_BT8XX *eve = &BT8XX_struct[BT8XX_1];
@@ -219,6 +234,38 @@ uint32_t tracker = 0;
 uint8_t track_counter = 0;
 uint8_t key = 0;
 
+// Scheduler tasks, the task slot index is the task priority (0 = highest)
+#define TASK_PRIO_MOTOR1_PID    0
+#define TASK_PRIO_MOTOR2_PID    1
+#define TASK_PRIO_UART1_TX      2
+#define TASK_PRIO_UART2_TX      3
+#define TASK_PRIO_BUTTON        4
+#define TASK_PRIO_MOTOR_DEBUG   5
+#define TASK_PRIO_5SEC          6
+#define TASK_PRIO_EVE_REFRESH   7
+
+void TASK_motor1_pid (uint16_t events);
+void TASK_motor2_pid (uint16_t events);
+void TASK_uart1_tx (uint16_t events);
+void TASK_uart2_tx (uint16_t events);
+void TASK_button (uint16_t events);
+void TASK_motor_debug (uint16_t events);
+void TASK_5sec (uint16_t events);
+void TASK_eve_refresh (uint16_t events);
+uint32_t idle_bound (void);
+
+// Idle bound while the RS-485 click driver is enabled : one character at 
+// 460800bps, so the main loop releases DE soon after TRMT sets
+#define RS485_DE_POLL_TICKS     (FCY / 46080)
+
+// Profiler regions
+#define PROF_MOTOR_PID          0
+#define PROF_QEI_VELOCITY       1
+#define PROF_EVE_KEYS           2
+uint8_t prof_export_flag = 0;
+
+uint16_t cpu_busy_permille = 0;
+
 int main() 
 {
     dsPeak_init(); 
@@ -349,7 +396,7 @@ int main()
     //ENCODER_init(ENC1_struct, ENC_1, 30); 
     
     //CAN_init_message(&CAN_MSG_DSPEAK, 0x0123, 0, 0, 0, 0, 0, 0, 0x0300, 0, 1, 8, 8, CAN_NODE_TYPE_TX_RX);
-    //CAN_init(CAN1_struct, CAN_1, 500000, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX);
+    //CAN_init(CAN1_struct, CAN_1, 500000, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX, CAN_BUFFER_X32, 8);
     
 //#ifdef BRINGUP_DSPEAK_1    
 //    CAN_init_struct(&CAN_native, CAN_1, 500000, 0x0123, 0, 0x0300, 0x0300);
@@ -392,26 +439,29 @@ int main()
     //MOTOR_set_rpm(MOTOR_1, speed_rpm_table[0]);
     //MOTOR_set_rpm(MOTOR_2, speed_rpm_table[0]);
     
-    // Timers init / start should be the last function calls made before while(1) 
-    TIMER_init(TIMER1_struct, TIMER_1, TIMER_MODE_16B, TIMER_PRESCALER_256, 10);
-    TIMER_init(TIMER2_struct, TIMER_2, TIMER_MODE_16B, TIMER_PRESCALER_256, 10);
-    TIMER_init(TIMER3_struct, TIMER_3, TIMER_MODE_16B, TIMER_PRESCALER_256, 30);   
-    TIMER_init(TIMER4_struct, TIMER_4, TIMER_MODE_16B, TIMER_PRESCALER_256, 30);
-    TIMER_init(TIMER5_struct, TIMER_5, TIMER_MODE_16B, TIMER_PRESCALER_256, 5);   
-    TIMER_init(TIMER6_struct, TIMER_6, TIMER_MODE_16B, TIMER_PRESCALER_256, 30);   
-    TIMER_init(TIMER7_struct, TIMER_7, TIMER_MODE_16B, TIMER_PRESCALER_256, 30);                    // Motor driver refresh timer     
-    //TIMER_init(TIMER8_struct, TIMER_8, TIMER_MODE_16B, TIMER_PRESCALER_256, 60);    // Eve refresh timer 
-    //TIMER_init(TIMER9_struct, TIMER_9, TIMER_MODE_16B, TIMER_PRESCALER_256, 30);    
-
-    TIMER_start(TIMER1_struct);
-    TIMER_start(TIMER2_struct);
-    TIMER_start(TIMER3_struct);   
-    TIMER_start(TIMER4_struct);
-    TIMER_start(TIMER5_struct);
-    TIMER_start(TIMER6_struct);
-    TIMER_start(TIMER7_struct);
-    //TIMER_start(TIMER8_struct);
-    //TIMER_start(TIMER9_struct);
+    // Scheduler init / task registration should be the last function calls made before while(1) 
+    // TIMER_8 / TIMER_9 pair is used as the 32-bit scheduler timebase
+    SCHED_init(TIMER8_struct, TIMER_8);
+#ifdef ISR_STAT_ENABLE
+    ISR_STAT_init();                    // ISR statistics use the scheduler timebase
+#endif
+#ifdef PROFILER_ENABLE
+    PROF_init();
+    PROF_region_init(PROF_MOTOR_PID, "motor_pid");
+    PROF_region_init(PROF_QEI_VELOCITY, "qei_vel");
+    PROF_region_init(PROF_EVE_KEYS, "eve_keys");
+#endif
+    SCHED_task_init(TASK_motor1_pid_struct, TASK_PRIO_MOTOR1_PID, TASK_motor1_pid, 33333, 33333);       // Motor driver refresh
+    SCHED_task_init(TASK_motor2_pid_struct, TASK_PRIO_MOTOR2_PID, TASK_motor2_pid, 33333, 33333);    
+    SCHED_task_init(TASK_uart1_tx_struct, TASK_PRIO_UART1_TX, TASK_uart1_tx, 100000, 100000);
+    SCHED_task_init(TASK_uart2_tx_struct, TASK_PRIO_UART2_TX, TASK_uart2_tx, 100000, 100000);
+    SCHED_task_init(TASK_button_struct, TASK_PRIO_BUTTON, TASK_button, 33333, 33333);
+    SCHED_task_init(TASK_motor_debug_struct, TASK_PRIO_MOTOR_DEBUG, TASK_motor_debug, 33333, 33333);
+    SCHED_task_init(TASK_5sec_struct, TASK_PRIO_5SEC, TASK_5sec, 200000, 200000);
+#ifdef EVE_SCREEN_ENABLE
+    SCHED_task_init(TASK_eve_refresh_struct, TASK_PRIO_EVE_REFRESH, TASK_eve_refresh, 16667, 16667);    // Eve refresh
+#endif
+    IDLE_init(TIMER1_struct, TIMER_1);      // TIMER_1 wakes the CPU for the next task release
     
     while (1)
     {   
@@ -454,239 +504,279 @@ int main()
         }
 #endif    
         
-        // Handle UART_1 TX
-        if (TIMER_get_state(TIMER1_struct, TIMER_INT_STATE) == 1)
+        // Dispatch the highest priority ready task, Idle until the next event otherwise
+        if (SCHED_run() == 0)
+        {
+            IDLE_enter(idle_bound);
+        }
+    }
+    return 0;
+}
+
+// Idle until the next task release. A transmit on the RS-485 click ends 
+// without any interrupt (TRMT), bound the sleep while DE is set
+uint32_t idle_bound (void)
+{
+#ifdef RS485_CLICK_UART2
+    if ((LATDbits.LATD0 == 1) && (RS485_DE_POLL_TICKS < SCHED_get_next_release()))
+    {
+        return RS485_DE_POLL_TICKS;
+    }
+#endif
+    return SCHED_get_next_release();
+}
+
+// Motor 1 QEI velocity refresh and PID, 30Hz
+void TASK_motor1_pid (uint16_t events)
+{
+    PROF_ENTER(PROF_QEI_VELOCITY);
+    QEI_calculate_velocity(QEI_1);  
+    PROF_EXIT(PROF_QEI_VELOCITY);
+    PROF_ENTER(PROF_MOTOR_PID);
+    new_pid_out1 = MOTOR_drive_pid(MOTOR_1);
+    PROF_EXIT(PROF_MOTOR_PID);
+    MOTOR_drive_perc(MOTOR_1, MOTOR_get_direction(MOTOR_1), new_pid_out1);
+}
+
+// Motor 2 QEI velocity refresh and PID, 30Hz
+void TASK_motor2_pid (uint16_t events)
+{
+    PROF_ENTER(PROF_QEI_VELOCITY);
+    QEI_calculate_velocity(QEI_2);  
+    PROF_EXIT(PROF_QEI_VELOCITY);
+    PROF_ENTER(PROF_MOTOR_PID);
+    new_pid_out2 = MOTOR_drive_pid(MOTOR_2);
+    PROF_EXIT(PROF_MOTOR_PID);
+    MOTOR_drive_perc(MOTOR_2, MOTOR_get_direction(MOTOR_2), new_pid_out2);
+}
+
+// Handle UART_1 TX, 10Hz
+void TASK_uart1_tx (uint16_t events)
+{
+    if (u485_1_data_flag == 1)
+    {                              
+        if (UART_putstr_dma(UART_485_struct, "Message sent from native port!\r\n") == 1)
         {
-            if (u485_1_data_flag == 1)
-            {                              
-                if (UART_putstr_dma(UART_485_struct, "Message sent from native port!\r\n") == 1)
-                {
-                    u485_1_data_flag = 0;
-                    counter_485_native = 0;
-                    dsPeak_led_write(LED1_struct, HIGH);
-                }             
-            }
-            else
-            {
-                if (++counter_485_native > 25)
-                {
-                    counter_485_native = 0;
-                    u485_1_data_flag = 1;   // Auto-retry transmission after 5s
-                }
-            }
-        }       
-
-        // Handle UART_2 TX
-        if (TIMER_get_state(TIMER2_struct, TIMER_INT_STATE) == 1)
+            u485_1_data_flag = 0;
+            counter_485_native = 0;
+            dsPeak_led_write(LED1_struct, HIGH);
+        }             
+    }
+    else
+    {
+        if (++counter_485_native > 25)
         {
+            counter_485_native = 0;
+            u485_1_data_flag = 1;   // Auto-retry transmission after 5s
+        }
+    }
+}
+
+// Handle UART_2 TX, 10Hz
+void TASK_uart2_tx (uint16_t events)
+{
 #ifdef RS485_CLICK_UART2               
-            if (u485_2_data_flag == 1)
-            {        
-                if (UART_putstr_dma(UART_MKB_struct, "Message sent from MikroB port!\r\n") == 1)
-                {
-                    u485_2_data_flag = 0;
-                    dsPeak_led_write(LED2_struct, HIGH);
-                }
-            }
+    if (u485_2_data_flag == 1)
+    {        
+        if (UART_putstr_dma(UART_MKB_struct, "Message sent from MikroB port!\r\n") == 1)
+        {
+            u485_2_data_flag = 0;
+            dsPeak_led_write(LED2_struct, HIGH);
+        }
+    }
 #endif      
-        }         
-        
-        // dsPeak on-board button debouncer state machine
-        if (TIMER_get_state(TIMER3_struct, TIMER_INT_STATE) == 1)
-        { 
-            dsPeak_button_debounce(BTN1_struct);
-            dsPeak_button_debounce(BTN2_struct);
-            dsPeak_button_debounce(BTN3_struct);
-            dsPeak_button_debounce(BTN4_struct); 
-            
-            if (dsPeak_button_get_state(BTN1_struct) == LOW)
-            {
-                if (BTN1_struct->do_once == 0) 
-                {
-                    BTN1_struct->do_once = 1;
-                    UART_putstr_dma(UART_DEBUG_struct, "BTN1 pressed\r\n");
-                }
-            }
-            else
-            {
-                BTN1_struct->do_once = 0;
-            }
-
-            if (dsPeak_button_get_state(BTN2_struct) == LOW)
-            {
-                if (BTN2_struct->do_once == 0) 
-                {
-                    BTN2_struct->do_once = 1;
-                    UART_putstr_dma(UART_DEBUG_struct, "BTN2 pressed\r\n");
-                    record_flag = 1;            // CODEC record audio flag
-                    //flash_state_machine = 6;
-                }
-            }
-            else
-            {
-                BTN2_struct->do_once = 0;
-            }
-
-            if (dsPeak_button_get_state(BTN3_struct) == LOW)
-            {
-                if (BTN3_struct->do_once == 0) 
-                {
-                    BTN3_struct->do_once = 1;
-                    UART_putstr_dma(UART_DEBUG_struct, "BTN3 pressed\r\n");
-                    playback_flag = 1;
-                    //flash_state_machine = 6;
-                }
-            }
-            else
-            {
-                BTN3_struct->do_once = 0;
-            }
-
-            if (dsPeak_button_get_state(BTN4_struct) == LOW)
-            {
-                if (BTN4_struct->do_once == 0) 
-                {                   
-                    BTN4_struct->do_once = 1;
-                    UART_putstr_dma(UART_DEBUG_struct, "BTN4 pressed\r\n");
-                    erase_flag = 1;
-                    //flash_state_machine = 6;
-                }
-            }
-            else
-            {
-                BTN4_struct->do_once = 0;
-            }               
-        }   
-        
-        // Motor debug port
-        if (TIMER_get_state(TIMER4_struct, TIMER_INT_STATE) == 1)
-        {   
-            setpoint_rpm = MOTOR_get_setpoint_rpm(MOTOR_1);
-            actual_rpm = QEI_get_speed_rpm(QEI_1);
-            error_rpm = setpoint_rpm - actual_rpm;
-            motor_debug_buf[0] = 0xAE;
-            motor_debug_buf[1] = 0xAE;
-            motor_debug_buf[2] = ((setpoint_rpm & 0xFF00)>>8);
-            motor_debug_buf[3] = setpoint_rpm&0x00FF;    
-            motor_debug_buf[4] = ((error_rpm & 0xFF00)>>8);
-            motor_debug_buf[5] = error_rpm&0x00FF;    
-            motor_debug_buf[6] = ((actual_rpm & 0xFF00)>>8);
-            motor_debug_buf[7] = actual_rpm&0x00FF; 
-            motor_debug_buf[8] = 0;
-            motor_debug_buf[9] = new_pid_out1;
-            setpoint_rpm = MOTOR_get_setpoint_rpm(MOTOR_2);
-            actual_rpm = QEI_get_speed_rpm(QEI_2);
-            error_rpm = setpoint_rpm - actual_rpm;            
-            motor_debug_buf[10] = ((setpoint_rpm & 0xFF00)>>8);
-            motor_debug_buf[11] = setpoint_rpm&0x00FF;    
-            motor_debug_buf[12] = ((error_rpm & 0xFF00)>>8);
-            motor_debug_buf[13] = error_rpm&0x00FF;    
-            motor_debug_buf[14] = ((actual_rpm & 0xFF00)>>8);
-            motor_debug_buf[15] = actual_rpm&0x00FF; 
-            motor_debug_buf[16] = 0;
-            motor_debug_buf[17] = new_pid_out2;            
-            UART_putbuf_dma(UART_DEBUG_struct, motor_debug_buf, 18);
-        }  
-//        
-        if (TIMER_get_state(TIMER5_struct, TIMER_INT_STATE) == 1)
+}
+
+// dsPeak on-board button debouncer state machine, 30Hz
+void TASK_button (uint16_t events)
+{
+    dsPeak_button_debounce(BTN1_struct);
+    dsPeak_button_debounce(BTN2_struct);
+    dsPeak_button_debounce(BTN3_struct);
+    dsPeak_button_debounce(BTN4_struct); 
+    
+    if (dsPeak_button_get_state(BTN1_struct) == LOW)
+    {
+        if (BTN1_struct->do_once == 0) 
         {
-            if (++counter_5sec >= 10)
-            {                  
-                counter_5sec = 0;
-                state++;
-                if (state > 4){state = 0;}
-                //MOTOR_set_rpm(MOTOR_1, speed_rpm_table[state]);
-                //MOTOR_set_rpm(MOTOR_2, speed_rpm_table[state]);
-            }
-        } 
-        
-        // QEI velocity refresh rate
-        if (TIMER_get_state(TIMER6_struct, TIMER_INT_STATE) == 1)
-        {           
-            QEI_calculate_velocity(QEI_2);  
-            new_pid_out2 = MOTOR_drive_pid(MOTOR_2);
-            MOTOR_drive_perc(MOTOR_2, MOTOR_get_direction(MOTOR_2), new_pid_out2);
-        }        
-        
-        // QEI velocity refresh rate
-        if (TIMER_get_state(TIMER7_struct, TIMER_INT_STATE) == 1)
-        {           
-            QEI_calculate_velocity(QEI_1);  
-            new_pid_out1 = MOTOR_drive_pid(MOTOR_1);
-            MOTOR_drive_perc(MOTOR_1, MOTOR_get_direction(MOTOR_1), new_pid_out1);
+            BTN1_struct->do_once = 1;
+            UART_putstr_dma(UART_DEBUG_struct, "BTN1 pressed\r\n");
+            prof_export_flag = 1;       // Dump profiler statistics on the debug port
         }
+    }
+    else
+    {
+        BTN1_struct->do_once = 0;
+    }
 
-#ifdef EVE_SCREEN_ENABLE        
-        if (TIMER_get_state(TIMER8_struct, TIMER_INT_STATE) == 1)
-        {           
-            // DisplayList write to BT8XX
-
-            FT8XX_start_new_dl(eve);					// Start a new display list, reset ring buffer and ring pointer
-            FT8XX_write_dl_long(eve, TAG_MASK(1));
-            FT8XX_write_dl_long(eve, CMD_COLDSTART);
-
-            FT8XX_write_dl_long(eve, TAG(st_Gradient[0].touch_tag));
-            FT8XX_draw_gradient(eve, &st_Gradient[0]);
-
-            FT8XX_draw_text(eve, &st_Text[0]);    
-            FT8XX_draw_text(eve, &st_Text[1]);    
-            FT8XX_draw_text(eve, &st_Text[2]);    
-            FT8XX_draw_text(eve, &st_Text[3]);     
-
-            FT8XX_write_dl_long(eve, COLOR_RGB(85, 170, 0));
-            FT8XX_set_context_fcolor(eve, 0xFDFF59);
-            FT8XX_write_dl_long(eve, COLOR_RGB(0, 0, 0));
-            
-            FT8XX_CMD_tracker(eve, st_Slider[0].x, st_Slider[0].y, st_Slider[0].w, st_Slider[0].h, st_Slider[0].touch_tag);
-            FT8XX_write_dl_long(eve, TAG(st_Slider[0].touch_tag));
-            FT8XX_draw_slider(eve, &st_Slider[0]); 
-
-            FT8XX_write_dl_long(eve, TAG(st_Keys[0].touch_tag));
-            FT8XX_draw_keys(eve, &st_Keys[0]);
-            FT8XX_write_dl_long(eve, TAG(st_Keys[1].touch_tag));
-            FT8XX_draw_keys(eve, &st_Keys[1]);
-            FT8XX_write_dl_long(eve, TAG(st_Keys[2].touch_tag));
-            FT8XX_draw_keys(eve, &st_Keys[2]);
-            FT8XX_write_dl_long(eve, TAG(st_Keys[3].touch_tag));
-            FT8XX_draw_keys(eve, &st_Keys[3]);
-
-            FT8XX_write_dl_long(eve, BEGIN(RECTS));
-            FT8XX_write_dl_long(eve, COLOR_RGB(0, 0, 0));
-            FT8XX_write_dl_long(eve, VERTEX2II(250, 30, 0, 0));
-            FT8XX_write_dl_long(eve, VERTEX2II(460, 230, 0, 0));
-            FT8XX_write_dl_long(eve, END());
-
-            FT8XX_update_screen_dl(eve);         		// Update display list 
-                       
-            tag = FT8XX_read_touch_tag(eve);         
-            tracker = FT8XX_rd32(eve, REG_TRACKER); 
-            
-            if (tag != 0)
-            {               
-                if ((tracker & 0x0000FFFF) == st_Slider[0].touch_tag)
-                {
-                    track_upd = ((tracker&0xFFFF0000)>>16);
-                    FT8XX_modify_slider(&st_Slider[0], SLIDER_VAL, track_upd);
-                    track_upd = (track_upd >> 9); // Divide by 512 to get a range of 0-128
-                    if (track_upd < 10){track_upd = 10;}
-                    FT8XX_wr8(eve, REG_PWM_DUTY, track_upd);
-                }
-                
-                if (((tag >= 0x41) && (tag <= 0x5A)) || ((tag >= 0x30) && (tag <= 0x39)) )   // On-screen keyboard key pressed 
-                {
-                    key = tag;                                      // save tag value as key press
-                    FT8XX_modify_keys(&st_Keys[0], KEYS_OPT, OPT_FLAT | OPT_CENTERX | key);  // Setting option to tag value will show key depressed
-                    FT8XX_modify_keys(&st_Keys[1], KEYS_OPT, OPT_FLAT | OPT_CENTERX | key);  // Setting option to tag value will show key depressed
-                    FT8XX_modify_keys(&st_Keys[2], KEYS_OPT, OPT_FLAT | OPT_CENTERX | key);  // Setting option to tag value will show key depressed
-                    FT8XX_modify_keys(&st_Keys[3], KEYS_OPT, OPT_FLAT | OPT_CENTERX | key);  // Setting option to tag value will show key depressed
-                }
-            }
+    if (dsPeak_button_get_state(BTN2_struct) == LOW)
+    {
+        if (BTN2_struct->do_once == 0) 
+        {
+            BTN2_struct->do_once = 1;
+            UART_putstr_dma(UART_DEBUG_struct, "BTN2 pressed\r\n");
+            record_flag = 1;            // CODEC record audio flag
+            //flash_state_machine = 6;
         }
+    }
+    else
+    {
+        BTN2_struct->do_once = 0;
+    }
+
+    if (dsPeak_button_get_state(BTN3_struct) == LOW)
+    {
+        if (BTN3_struct->do_once == 0) 
+        {
+            BTN3_struct->do_once = 1;
+            UART_putstr_dma(UART_DEBUG_struct, "BTN3 pressed\r\n");
+            playback_flag = 1;
+            //flash_state_machine = 6;
+        }
+    }
+    else
+    {
+        BTN3_struct->do_once = 0;
+    }
+
+    if (dsPeak_button_get_state(BTN4_struct) == LOW)
+    {
+        if (BTN4_struct->do_once == 0) 
+        {                   
+            BTN4_struct->do_once = 1;
+            UART_putstr_dma(UART_DEBUG_struct, "BTN4 pressed\r\n");
+            erase_flag = 1;
+            //flash_state_machine = 6;
+        }
+    }
+    else
+    {
+        BTN4_struct->do_once = 0;
+    }               
+}
+
+// Motor debug port, 30Hz
+void TASK_motor_debug (uint16_t events)
+{
+    setpoint_rpm = MOTOR_get_setpoint_rpm(MOTOR_1);
+    actual_rpm = QEI_get_speed_rpm(QEI_1);
+    error_rpm = setpoint_rpm - actual_rpm;
+    motor_debug_buf[0] = 0xAE;
+    motor_debug_buf[1] = 0xAE;
+    motor_debug_buf[2] = ((setpoint_rpm & 0xFF00)>>8);
+    motor_debug_buf[3] = setpoint_rpm&0x00FF;    
+    motor_debug_buf[4] = ((error_rpm & 0xFF00)>>8);
+    motor_debug_buf[5] = error_rpm&0x00FF;    
+    motor_debug_buf[6] = ((actual_rpm & 0xFF00)>>8);
+    motor_debug_buf[7] = actual_rpm&0x00FF; 
+    motor_debug_buf[8] = 0;
+    motor_debug_buf[9] = new_pid_out1;
+    setpoint_rpm = MOTOR_get_setpoint_rpm(MOTOR_2);
+    actual_rpm = QEI_get_speed_rpm(QEI_2);
+    error_rpm = setpoint_rpm - actual_rpm;            
+    motor_debug_buf[10] = ((setpoint_rpm & 0xFF00)>>8);
+    motor_debug_buf[11] = setpoint_rpm&0x00FF;    
+    motor_debug_buf[12] = ((error_rpm & 0xFF00)>>8);
+    motor_debug_buf[13] = error_rpm&0x00FF;    
+    motor_debug_buf[14] = ((actual_rpm & 0xFF00)>>8);
+    motor_debug_buf[15] = actual_rpm&0x00FF; 
+    motor_debug_buf[16] = 0;
+    motor_debug_buf[17] = new_pid_out2;            
+    UART_putbuf_dma(UART_DEBUG_struct, motor_debug_buf, 18);
+}
+
+// Motor setpoint sequencer, 5Hz
+void TASK_5sec (uint16_t events)
+{
+    if (++counter_5sec >= 10)
+    {                  
+        counter_5sec = 0;
+        cpu_busy_permille = IDLE_get_busy_permille();   // CPU load over the last 2s
+        state++;
+        if (state > 4){state = 0;}
+        //MOTOR_set_rpm(MOTOR_1, speed_rpm_table[state]);
+        //MOTOR_set_rpm(MOTOR_2, speed_rpm_table[state]);
+    }
+    
+#ifdef PROFILER_ENABLE
+    // One region per call, until all regions are sent on UART_3
+    if (prof_export_flag == 1)
+    {
+        if (PROF_export(UART_DEBUG_struct) == PROF_EXPORT_DONE)
+        {
+            prof_export_flag = 0;
+        }
+    }
 #endif
+}
 
-        if (TIMER_get_state(TIMER9_struct, TIMER_INT_STATE) == 1)
-        {   
-        } 
+#ifdef EVE_SCREEN_ENABLE
+// EVE display list refresh and touch handling, 60Hz
+void TASK_eve_refresh (uint16_t events)
+{
+    // DisplayList write to BT8XX
+
+    FT8XX_start_new_dl(eve);					// Start a new display list, reset ring buffer and ring pointer
+    FT8XX_write_dl_long(eve, TAG_MASK(1));
+    FT8XX_write_dl_long(eve, CMD_COLDSTART);
+
+    FT8XX_write_dl_long(eve, TAG(st_Gradient[0].touch_tag));
+    FT8XX_draw_gradient(eve, &st_Gradient[0]);
+
+    FT8XX_draw_text(eve, &st_Text[0]);    
+    FT8XX_draw_text(eve, &st_Text[1]);    
+    FT8XX_draw_text(eve, &st_Text[2]);    
+    FT8XX_draw_text(eve, &st_Text[3]);     
+
+    FT8XX_write_dl_long(eve, COLOR_RGB(85, 170, 0));
+    FT8XX_set_context_fcolor(eve, 0xFDFF59);
+    FT8XX_write_dl_long(eve, COLOR_RGB(0, 0, 0));
+    
+    FT8XX_CMD_tracker(eve, st_Slider[0].x, st_Slider[0].y, st_Slider[0].w, st_Slider[0].h, st_Slider[0].touch_tag);
+    FT8XX_write_dl_long(eve, TAG(st_Slider[0].touch_tag));
+    FT8XX_draw_slider(eve, &st_Slider[0]); 
+
+    PROF_ENTER(PROF_EVE_KEYS);
+    FT8XX_write_dl_long(eve, TAG(st_Keys[0].touch_tag));
+    FT8XX_draw_keys(eve, &st_Keys[0]);
+    FT8XX_write_dl_long(eve, TAG(st_Keys[1].touch_tag));
+    FT8XX_draw_keys(eve, &st_Keys[1]);
+    FT8XX_write_dl_long(eve, TAG(st_Keys[2].touch_tag));
+    FT8XX_draw_keys(eve, &st_Keys[2]);
+    FT8XX_write_dl_long(eve, TAG(st_Keys[3].touch_tag));
+    FT8XX_draw_keys(eve, &st_Keys[3]);
+    PROF_EXIT(PROF_EVE_KEYS);
+
+    FT8XX_write_dl_long(eve, BEGIN(RECTS));
+    FT8XX_write_dl_long(eve, COLOR_RGB(0, 0, 0));
+    FT8XX_write_dl_long(eve, VERTEX2II(250, 30, 0, 0));
+    FT8XX_write_dl_long(eve, VERTEX2II(460, 230, 0, 0));
+    FT8XX_write_dl_long(eve, END());
+
+    FT8XX_update_screen_dl(eve);         		// Update display list 
+               
+    tag = FT8XX_read_touch_tag(eve);         
+    tracker = FT8XX_rd32(eve, REG_TRACKER); 
+    
+    if (tag != 0)
+    {               
+        if ((tracker & 0x0000FFFF) == st_Slider[0].touch_tag)
+        {
+            track_upd = ((tracker&0xFFFF0000)>>16);
+            FT8XX_modify_slider(&st_Slider[0], SLIDER_VAL, track_upd);
+            track_upd = (track_upd >> 9); // Divide by 512 to get a range of 0-128
+            if (track_upd < 10){track_upd = 10;}
+            FT8XX_wr8(eve, REG_PWM_DUTY, track_upd);
+        }
+        
+        if (((tag >= 0x41) && (tag <= 0x5A)) || ((tag >= 0x30) && (tag <= 0x39)) )   // On-screen keyboard key pressed 
+        {
+            key = tag;                                      // save tag value as key press
+            FT8XX_modify_keys(&st_Keys[0], KEYS_OPT, OPT_FLAT | OPT_CENTERX | key);  // Setting option to tag value will show key depressed
+            FT8XX_modify_keys(&st_Keys[1], KEYS_OPT, OPT_FLAT | OPT_CENTERX | key);  // Setting option to tag value will show key depressed
+            FT8XX_modify_keys(&st_Keys[2], KEYS_OPT, OPT_FLAT | OPT_CENTERX | key);  // Setting option to tag value will show key depressed
+            FT8XX_modify_keys(&st_Keys[3], KEYS_OPT, OPT_FLAT | OPT_CENTERX | key);  // Setting option to tag value will show key depressed
+        }
     }
-    return 0;
 }
+#endif
@@ -0,0 +1,174 @@
+//****************************************************************************//
+// File      :  ecan_sim.c
+//
+// Includes  :  ecan_sim.h
+//
+// Purpose   :  Model of the ECAN1 receive FIFO and transmit buffers, see
+//              ecan_sim.h
+//****************************************************************************//
+#include "ecan_sim.h"
+
+void _C1Interrupt (void);
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+extern __eds__ uint16_t CAN_MSG_BUFFER[NUM_OF_CAN_BUFFERS][8];
+
+void (*SIM_ecan_tx_hook)(uint8_t buf) = 0;
+uint16_t SIM_ecan_rx_lost = 0;
+
+static STRUCT_CAN *sim_node;
+static uint32_t rxful;                      // Buffer full bits, as the module sees them
+static uint8_t wr_buf, rd_buf;              // FIFO write buffer and FNRB
+static uint8_t rx_level;                    // Full buffers from FNRB on
+static uint8_t tx_busy, tx_buf;
+static uint32_t tx_end;
+
+static uint8_t next_buf (uint8_t buf)
+{
+    return (buf + 1 < sim_node->buffer_qty) ? buf + 1 : sim_node->tx_buffer_qty;
+}
+
+// Nominal frame length, 47 + 8 * data bytes (standard), 67 + 8 * data bytes (extended)
+static uint32_t bits_to_ticks (uint8_t ide, uint8_t rtr, uint8_t dlc)
+{
+    if (dlc > 8){dlc = 8;}
+    if (rtr){dlc = 0;}
+    return ((ide ? 67 : 47) + (8 * dlc)) * (HOST_timebase_freq / sim_node->bus_freq);
+}
+
+uint32_t SIM_ecan_frame_ticks (STRUCT_CAN_FRAME *frame)
+{
+    return bits_to_ticks(frame->IDE, frame->RTR, frame->DLC);
+}
+
+void SIM_ecan_init (STRUCT_CAN *node)
+{
+    sim_node = node;
+    rxful = 0;
+    wr_buf = node->tx_buffer_qty;
+    rd_buf = node->tx_buffer_qty;
+    rx_level = 0;
+    tx_busy = 0;
+    SIM_ecan_rx_lost = 0;
+    C1RXFUL1 = 0;
+    C1RXFUL2 = 0;
+}
+
+uint8_t SIM_ecan_receive (STRUCT_CAN_FRAME *frame, uint8_t filter_hit)
+{
+    uint8_t buf = wr_buf;
+
+    if (rxful & (1UL << buf))
+    {
+        // Next FIFO buffer not read yet, the frame is lost
+        if (buf < 16){C1RXOVF1 |= (1U << buf);}
+        else {C1RXOVF2 |= (1U << (buf - 16));}
+        C1INTFbits.RBOVIF = 1;
+        IFS2bits.C1IF = 1;
+        SIM_ecan_rx_lost++;
+        SIM_ecan_irq();
+        return 0;
+    }
+    CAN_MSG_BUFFER[buf][0] = (frame->SID << 2) | (frame->IDE << 1) | frame->IDE;
+    CAN_MSG_BUFFER[buf][1] = (uint16_t)(frame->EID >> 6) & 0x0FFF;
+    CAN_MSG_BUFFER[buf][2] = (((uint16_t)frame->EID & 0x003F) << 10) | (frame->RTR << 9) | (frame->DLC & 0x0F);
+    CAN_MSG_BUFFER[buf][3] = (uint16_t)((frame->payload[1] << 8) | frame->payload[0]);
+    CAN_MSG_BUFFER[buf][4] = (uint16_t)((frame->payload[3] << 8) | frame->payload[2]);
+    CAN_MSG_BUFFER[buf][5] = (uint16_t)((frame->payload[5] << 8) | frame->payload[4]);
+    CAN_MSG_BUFFER[buf][6] = (uint16_t)((frame->payload[7] << 8) | frame->payload[6]);
+    CAN_MSG_BUFFER[buf][7] = (uint16_t)(filter_hit & 0x1F) << 8;
+    rxful |= (1UL << buf);
+    rx_level++;
+    wr_buf = next_buf(buf);
+    C1INTFbits.RBIF = 1;
+    IFS2bits.C1IF = 1;
+    SIM_ecan_irq();
+    return 1;
+}
+
+void SIM_ecan_irq (void)
+{
+    uint8_t guard;
+
+    for (guard = 0; guard < 2 * NUM_OF_CAN_BUFFERS; guard++)
+    {
+        if ((IFS2bits.C1IF == 0) || (IEC2bits.C1IE == 0) || (HOST_cpu_ipl >= SIM_ECAN_IPL))
+        {
+            return;
+        }
+        C1FIFObits.FNRB = rd_buf;
+        C1RXFUL1 = (uint16_t)rxful;
+        C1RXFUL2 = (uint16_t)(rxful >> 16);
+        _C1Interrupt();
+
+        // Writing 0 clears a full bit, writing 1 leaves it, FNRB follows
+        rxful &= ((uint32_t)C1RXFUL2 << 16) | C1RXFUL1;
+        while ((rx_level > 0) && ((rxful & (1UL << rd_buf)) == 0))
+        {
+            rd_buf = next_buf(rd_buf);
+            rx_level--;
+        }
+        if (rx_level > 0)
+        {
+            // The host drain stops after one buffer as FNRB does not move
+            // during the call, the next frames raise RBIF again
+            C1INTFbits.RBIF = 1;
+            IFS2bits.C1IF = 1;
+        }
+    }
+}
+
+// Highest TXPRI, then highest buffer number
+static uint8_t tx_select (void)
+{
+    volatile uint8_t *trcon = (volatile uint8_t *)&C1TR01CON;
+    uint8_t buf, best = 0xFF;
+
+    for (buf = 0; buf < sim_node->tx_buffer_qty; buf++)
+    {
+        if ((trcon[buf] & 0x08) && ((best == 0xFF) || ((trcon[buf] & 0x03) >= (trcon[best] & 0x03))))
+        {
+            best = buf;
+        }
+    }
+    return best;
+}
+
+uint16_t SIM_ecan_run (uint32_t ticks)
+{
+    volatile uint8_t *trcon = (volatile uint8_t *)&C1TR01CON;
+    uint32_t end = HOST_timebase_now + ticks;
+    uint16_t sent = 0;
+
+    while (1)
+    {
+        if (tx_busy == 0)
+        {
+            tx_buf = tx_select();
+            if (tx_buf == 0xFF)
+            {
+                break;
+            }
+            tx_busy = 1;
+            tx_end = HOST_timebase_now + bits_to_ticks(CAN_MSG_BUFFER[tx_buf][0] & 0x0001,
+                     (CAN_MSG_BUFFER[tx_buf][2] >> 9) & 0x0001, CAN_MSG_BUFFER[tx_buf][2] & 0x000F);
+        }
+        if ((int32_t)(end - tx_end) < 0)
+        {
+            break;
+        }
+        HOST_timebase_now = tx_end;
+        trcon[tx_buf] &= ~0x08;
+        tx_busy = 0;
+        sent++;
+        if (SIM_ecan_tx_hook != 0)
+        {
+            SIM_ecan_tx_hook(tx_buf);
+        }
+        C1INTFbits.TBIF = 1;
+        IFS2bits.C1IF = 1;
+        SIM_ecan_irq();
+    }
+    HOST_timebase_now = end;
+    return sent;
+}
@@ -0,0 +1,43 @@
+//****************************************************************************//
+// File      :  ecan_sim.h
+//
+// Functions :  void SIM_ecan_init (STRUCT_CAN *node);
+//              uint8_t SIM_ecan_receive (STRUCT_CAN_FRAME *frame, uint8_t filter_hit);
+//              void SIM_ecan_irq (void);
+//              uint16_t SIM_ecan_run (uint32_t ticks);
+//              uint32_t SIM_ecan_frame_ticks (STRUCT_CAN_FRAME *frame);
+//
+// Includes  :  CAN.h
+//
+// Purpose   :  Model of the ECAN1 message buffers as CAN.c programs them,
+//              on the host timebase (HOST_timebase_now) :
+//              - Receive : a frame accepted by a filter is stored in the
+//                next buffer of the FIFO region (FSA to buffer_qty - 1) with
+//                RXFUL set, RBIF and C1IF raised. When that buffer is still
+//                full the frame is lost, RXOVF and RBOVIF are set.
+//              - Transmit : at each bus idle the buffer with TXREQ set and the
+//                highest TXPRI wins, the highest buffer number among equal
+//                TXPRI. The frame takes its nominal bit count on the bus,
+//                then TXREQ clears and TBIF / C1IF are raised.
+//              _C1Interrupt runs while C1IE is set and the CPU IPL is below
+//              SIM_ECAN_IPL. Host registers are plain variables, so the
+//              model sets FNRB and C1RXFULx before each call and applies the
+//              write-0-clears rule of C1RXFULx after it. Transmit requests
+//              are read from the C1TRxxCON bytes used by the transmit queue,
+//              the C1TRxxCONbits view of CAN_send_msg is not modelled
+//****************************************************************************//
+#ifndef __ECAN_SIM_H_
+#define __ECAN_SIM_H_
+#include "CAN.h"
+
+#define SIM_ECAN_IPL        4               // Default interrupt priority
+
+extern void (*SIM_ecan_tx_hook)(uint8_t buf);   // Called when a transmit buffer completes
+extern uint16_t SIM_ecan_rx_lost;               // Frames lost on a full FIFO buffer
+
+void SIM_ecan_init (STRUCT_CAN *node);
+uint8_t SIM_ecan_receive (STRUCT_CAN_FRAME *frame, uint8_t filter_hit);
+void SIM_ecan_irq (void);
+uint16_t SIM_ecan_run (uint32_t ticks);
+uint32_t SIM_ecan_frame_ticks (STRUCT_CAN_FRAME *frame);
+#endif
@@ -0,0 +1,221 @@
+//****************************************************************************//
+// File      :  i2c_sim.c
+//
+// Includes  :  i2c_sim.h
+//
+// Purpose   :  Model of the I2C1 master module and one slave, see i2c_sim.h
+//****************************************************************************//
+#include "i2c_sim.h"
+
+void _MI2C1Interrupt (void);
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+extern void (*HOST_delay_hook)(uint32_t us);
+
+#define EVENT_NONE      0
+#define EVENT_START     1
+#define EVENT_RESTART   2
+#define EVENT_STOP      3
+#define EVENT_SEND      4
+#define EVENT_RECEIVE   5
+#define EVENT_ACK       6
+
+uint32_t SIM_i2c_bytes = 0;
+uint32_t SIM_i2c_stops = 0;
+uint8_t SIM_i2c_hold = 0;
+uint8_t SIM_i2c_sda_stuck = 0;
+uint8_t SIM_i2c_scl_pulses = 0;
+
+static STRUCT_SIM_I2C_DEVICE *sim_device;
+static uint32_t bit_ticks;
+static uint8_t event, addressing, selected;
+static uint32_t event_end;
+static uint8_t scl_last, sda_last, recovering;
+
+// Open-drain MikroBus pins during I2C_bus_recover : a line is high when
+// nothing drives it low, the master drives low through TRIS = 0. A
+// recovery starts at the 1st delay with the module disabled and ends at the
+// STOP condition, or at the 1st delay with the module enabled
+static void pins (uint32_t us)
+{
+    uint8_t scl = DSPEAK_MKB_SCL_DIR, sda = DSPEAK_MKB_SDA_DIR;
+
+    HOST_timebase_now += (uint32_t)(((uint64_t)us * HOST_timebase_freq) / 1000000ULL);
+    if (I2C1CONbits.I2CEN != 0)
+    {
+        recovering = 0;
+        return;
+    }
+    if (recovering == 0)
+    {
+        // Module disabled : the bus event in progress is lost
+        recovering = 1;
+        SIM_i2c_scl_pulses = 0;
+        scl_last = scl;
+        sda_last = sda;
+        event = EVENT_NONE;
+        addressing = 0;
+        selected = 0;
+        I2C1CONbits.SEN = 0;
+        I2C1CONbits.RSEN = 0;
+        I2C1CONbits.PEN = 0;
+        I2C1CONbits.RCEN = 0;
+        I2C1CONbits.ACKEN = 0;
+        I2C1TRN = SIM_I2C_TRN_IDLE;
+    }
+    if ((scl == 1) && (scl_last == 0) && (sda == 1))      // Clock-out pulse, SDA released by the master
+    {
+        SIM_i2c_scl_pulses++;
+    }
+    DSPEAK_MKB_SCL_RD = scl;
+    if ((SIM_i2c_sda_stuck != SIM_I2C_STUCK_FOREVER) && (SIM_i2c_scl_pulses >= SIM_i2c_sda_stuck))
+    {
+        SIM_i2c_hold = 0;                                   // Slave is out of its byte
+        DSPEAK_MKB_SDA_RD = sda;
+    }
+    else
+    {
+        DSPEAK_MKB_SDA_RD = 0;
+    }
+    if ((sda == 1) && (sda_last == 0) && (scl == 1) && (scl_last == 1))
+    {
+        recovering = 0;                                     // STOP, the next disable is a new recovery
+    }
+    scl_last = scl;
+    sda_last = sda;
+}
+
+void SIM_i2c_init (STRUCT_SIM_I2C_DEVICE *device, uint32_t bus_freq)
+{
+    sim_device = device;
+    bit_ticks = HOST_timebase_freq / bus_freq;
+    event = EVENT_NONE;
+    addressing = 0;
+    selected = 0;
+    SIM_i2c_bytes = 0;
+    SIM_i2c_stops = 0;
+    SIM_i2c_hold = 0;
+    SIM_i2c_sda_stuck = 0;
+    SIM_i2c_scl_pulses = 0;
+    recovering = 0;
+    I2C1TRN = SIM_I2C_TRN_IDLE;
+    HOST_delay_hook = pins;
+}
+
+void SIM_i2c_irq (void)
+{
+    uint8_t guard;
+
+    // One event per interrupt, the ISR lowers MI2C1IF itself
+    for (guard = 0; guard < 2; guard++)
+    {
+        if ((IFS1bits.MI2C1IF == 0) || (IEC1bits.MI2C1IE == 0) || (HOST_cpu_ipl >= SIM_I2C_IPL))
+        {
+            return;
+        }
+        _MI2C1Interrupt();
+    }
+}
+
+// Bus event requested by the driver, with its length in bit times
+static uint8_t next_event (uint32_t *bits)
+{
+    if (I2C1CONbits.SEN){*bits = 1; return EVENT_START;}
+    if (I2C1CONbits.RSEN){*bits = 1; return EVENT_RESTART;}
+    if (I2C1CONbits.PEN){*bits = 1; return EVENT_STOP;}
+    if (I2C1CONbits.RCEN){*bits = 8; return EVENT_RECEIVE;}
+    if (I2C1CONbits.ACKEN){*bits = 1; return EVENT_ACK;}
+    if (I2C1TRN != SIM_I2C_TRN_IDLE){*bits = 9; return EVENT_SEND;}
+    return EVENT_NONE;
+}
+
+static void complete (uint8_t done)
+{
+    uint8_t byte;
+
+    switch (done)
+    {
+        case EVENT_START:
+            I2C1CONbits.SEN = 0;
+            addressing = 1;
+            break;
+
+        case EVENT_RESTART:
+            I2C1CONbits.RSEN = 0;
+            addressing = 1;
+            break;
+
+        case EVENT_STOP:
+            I2C1CONbits.PEN = 0;
+            if (selected && (sim_device->on_stop != 0)){sim_device->on_stop();}
+            selected = 0;
+            SIM_i2c_stops++;
+            break;
+
+        case EVENT_SEND:
+            byte = (uint8_t)I2C1TRN;
+            I2C1TRN = SIM_I2C_TRN_IDLE;
+            SIM_i2c_bytes++;
+            if (addressing)
+            {
+                addressing = 0;
+                selected = (sim_device != 0) && ((byte & 0xFE) == sim_device->address);
+                I2C1STATbits.ACKSTAT = 1;                   // Nobody answers
+                if (selected)
+                {
+                    I2C1STATbits.ACKSTAT = (sim_device->on_address != 0) ? sim_device->on_address(byte & 0x01) : 0;
+                }
+            }
+            else
+            {
+                I2C1STATbits.ACKSTAT = 1;
+                if (selected && (sim_device->on_write != 0))
+                {
+                    I2C1STATbits.ACKSTAT = sim_device->on_write(byte);
+                }
+            }
+            break;
+
+        case EVENT_RECEIVE:
+            I2C1CONbits.RCEN = 0;
+            SIM_i2c_bytes++;
+            I2C1RCV = (selected && (sim_device->on_read != 0)) ? sim_device->on_read() : 0xFF;
+            break;
+
+        case EVENT_ACK:
+            I2C1CONbits.ACKEN = 0;
+            break;
+
+        default:
+            break;
+    }
+}
+
+uint32_t SIM_i2c_run (uint32_t ticks)
+{
+    uint32_t end = HOST_timebase_now + ticks, bits, bytes = SIM_i2c_bytes;
+
+    while (SIM_i2c_hold == 0)
+    {
+        if (event == EVENT_NONE)
+        {
+            event = next_event(&bits);
+            if (event == EVENT_NONE)
+            {
+                break;
+            }
+            event_end = HOST_timebase_now + (bits * bit_ticks);
+        }
+        if ((int32_t)(end - event_end) < 0)
+        {
+            break;
+        }
+        HOST_timebase_now = event_end;
+        complete(event);
+        event = EVENT_NONE;
+        IFS1bits.MI2C1IF = 1;
+        SIM_i2c_irq();
+    }
+    HOST_timebase_now = end;
+    return SIM_i2c_bytes - bytes;
+}
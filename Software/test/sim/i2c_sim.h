@@ -0,0 +1,58 @@
+//****************************************************************************//
+// File      :  i2c_sim.h
+//
+// Functions :  void SIM_i2c_init (STRUCT_SIM_I2C_DEVICE *device, uint32_t bus_freq);
+//              void SIM_i2c_irq (void);
+//              uint32_t SIM_i2c_run (uint32_t ticks);
+//
+// Includes  :  i2c.h
+//
+// Purpose   :  Model of the I2C1 master module as the master interrupt of
+//              i2c.c drives it, with one slave device on the bus, on the
+//              host timebase (HOST_timebase_now) :
+//              - SEN, RSEN, PEN, RCEN and ACKEN clear when their bus event
+//                is over, a byte written to I2C1TRN is shifted out and the
+//                ACK of the slave is returned in ACKSTAT. Each event then
+//                raises MI2C1IF
+//              - START, STOP, RESTART and ACK take 1 bit time, a byte sent
+//                with its ACK 9, a byte received 8, at bus_freq
+//              _MI2C1Interrupt runs while MI2C1IE is set and the CPU IPL is
+//              below SIM_I2C_IPL. Host registers are plain variables : a
+//              write to I2C1TRN is seen as I2C1TRN leaving SIM_I2C_TRN_IDLE.
+//              SIM_i2c_hold freezes the bus (a slave stretching SCL forever),
+//              the transaction on it never completes
+//              - Recovery : while I2CEN is clear the SCL / SDA pins are the
+//                open-drain GPIO of I2C_bus_recover. They are evaluated at
+//                each __delay_us (HOST_delay_hook), which also advances the
+//                timebase. A slave stuck mid-byte holds SDA low for
+//                SIM_i2c_sda_stuck SCL pulses, SIM_I2C_STUCK_FOREVER never
+//                lets go. Once it lets go the held bus is freed. Disabling
+//                the module drops the bus event in progress
+//****************************************************************************//
+#ifndef __I2C_SIM_H_
+#define __I2C_SIM_H_
+#include "i2c.h"
+
+#define SIM_I2C_IPL         1               // IPC4bits.MI2C1IP of I2C_init
+#define SIM_I2C_TRN_IDLE    0xFFFF          // I2C1TRN holds no byte to send
+#define SIM_I2C_STUCK_FOREVER   0xFF
+
+typedef struct
+{
+    uint8_t address;                        // Write address, as given to the driver (7-bit address << 1)
+    uint8_t (*on_address)(uint8_t rw);      // Addressed after a START, returns the ACKSTAT, 0 = ACK
+    uint8_t (*on_write)(uint8_t byte);      // Byte from the master, returns the ACKSTAT
+    uint8_t (*on_read)(void);               // Next byte to the master
+    void (*on_stop)(void);
+}STRUCT_SIM_I2C_DEVICE;
+
+extern uint32_t SIM_i2c_bytes;              // Bytes on the bus, address bytes included
+extern uint32_t SIM_i2c_stops;              // STOP conditions, one per transaction
+extern uint8_t SIM_i2c_hold;                // 1 : bus frozen
+extern uint8_t SIM_i2c_sda_stuck;           // SCL pulses before the slave releases SDA
+extern uint8_t SIM_i2c_scl_pulses;          // SCL pulses of the last recovery
+
+void SIM_i2c_init (STRUCT_SIM_I2C_DEVICE *device, uint32_t bus_freq);
+void SIM_i2c_irq (void);
+uint32_t SIM_i2c_run (uint32_t ticks);
+#endif
@@ -0,0 +1,129 @@
+//****************************************************************************//
+// File      :  spi_sim.c
+//
+// Includes  :  spi_sim.h
+//
+// Purpose   :  Model of the SPI4 module and one slave, see spi_sim.h
+//****************************************************************************//
+#include "spi_sim.h"
+
+void _SPI4Interrupt (void);
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+extern STRUCT_SPI SPI_struct[SPI_QTY];
+
+#define FIFO_MASK       (HOST_FIFO_DEPTH - 1)
+
+uint32_t SIM_spi_bytes = 0;
+uint32_t SIM_spi_transfers = 0;
+
+static STRUCT_SIM_SPI_DEVICE *sim_device;
+static uint16_t head;                       // 1st word written and not shifted yet
+static uint16_t batch;
+static uint8_t shifting, selected;
+static uint32_t batch_end;
+
+void SIM_spi_init (STRUCT_SIM_SPI_DEVICE *device)
+{
+    sim_device = device;
+    HOST_SPI4BUF_fifo.index = 0;
+    head = 0;
+    shifting = 0;
+    selected = 0;
+    SIM_spi_bytes = 0;
+    SIM_spi_transfers = 0;
+}
+
+void SIM_spi_irq (void)
+{
+    if ((IFS7bits.SPI4IF == 0) || (IEC7bits.SPI4IE == 0) || (HOST_cpu_ipl >= SIM_SPI_IPL))
+    {
+        return;
+    }
+    _SPI4Interrupt();
+}
+
+// Timebase ticks of n bytes, Fsck = FCY / (PPRE x SPRE)
+static uint32_t batch_ticks (uint16_t n)
+{
+    static const uint8_t ppre[4] = {64, 16, 4, 1};
+    uint32_t cycles = 8UL * n * ppre[SPI4CON1bits.PPRE & 3] * (8 - (SPI4CON1bits.SPRE & 7));
+
+    return (uint32_t)(((uint64_t)cycles * HOST_timebase_freq) / FCY);
+}
+
+static void release (void)
+{
+    if (selected && (sim_device->on_release != 0))
+    {
+        sim_device->on_release();
+    }
+    selected = 0;
+}
+
+static void shift (void)
+{
+    uint8_t rx[HOST_FIFO_DEPTH];
+    uint16_t i;
+
+    if (SPI_struct[SPI_4].rx_cnt == 0)      // 1st batch of a SPI_write
+    {
+        release();
+        SIM_spi_transfers++;
+        selected = (sim_device != 0) && (SPI_struct[SPI_4].chip == sim_device->chip);
+        if (selected && (sim_device->on_select != 0))
+        {
+            sim_device->on_select();
+        }
+    }
+    for (i = 0; i < batch; i++)
+    {
+        rx[i] = 0xFF;
+        if (selected && (sim_device->on_exchange != 0))
+        {
+            rx[i] = sim_device->on_exchange((uint8_t)HOST_SPI4BUF_fifo.word[(head + i) & FIFO_MASK]);
+        }
+    }
+    for (i = 0; i < batch; i++)
+    {
+        HOST_SPI4BUF_fifo.word[i] = rx[i];
+    }
+    SIM_spi_bytes += batch;
+    HOST_SPI4BUF_fifo.index = 0;
+    head = batch;
+    SPI4STATbits.SRXMPT = 1;
+    IFS7bits.SPI4IF = 1;
+    SIM_spi_irq();
+    if (IEC7bits.SPI4IE == 0)
+    {
+        release();                          // Transfer over, none started from its callback
+    }
+}
+
+uint32_t SIM_spi_run (uint32_t ticks)
+{
+    uint32_t end = HOST_timebase_now + ticks, bytes = SIM_spi_bytes;
+
+    while (1)
+    {
+        if (shifting == 0)
+        {
+            batch = (uint16_t)(HOST_SPI4BUF_fifo.index - head);
+            if ((batch == 0) || (IEC7bits.SPI4IE == 0) || (SPI4STATbits.SPIEN == 0))
+            {
+                break;
+            }
+            shifting = 1;
+            batch_end = HOST_timebase_now + batch_ticks(batch);
+        }
+        if ((int32_t)(end - batch_end) < 0)
+        {
+            break;
+        }
+        HOST_timebase_now = batch_end;
+        shifting = 0;
+        shift();
+    }
+    HOST_timebase_now = end;
+    return SIM_spi_bytes - bytes;
+}
@@ -0,0 +1,46 @@
+//****************************************************************************//
+// File      :  spi_sim.h
+//
+// Functions :  void SIM_spi_init (STRUCT_SIM_SPI_DEVICE *device);
+//              void SIM_spi_irq (void);
+//              uint32_t SIM_spi_run (uint32_t ticks);
+//
+// Includes  :  spi.h
+//
+// Purpose   :  Model of the SPI4 module in enhanced buffer mode as the SPI4
+//              interrupt of spi.c drives it, with one slave device on its
+//              chip select, on the host timebase (HOST_timebase_now) :
+//              - The words written to SPI4BUF are shifted out at the SCK rate
+//                of PPRE / SPRE, 8 bits each, the slave answers each byte.
+//                Once the batch is out the answers are queued in SPI4BUF,
+//                SRXMPT is set and SPI4IF raised
+//              - SPI4BUF is a fifo register (stubs/sfr_fifo.txt), each access
+//                moves to the next word : the interrupt reads the answers,
+//                the words it writes next are the following batch
+//              - A transfer starts with the 1st batch after SPI_write, the
+//                slave is selected when the chip of the transfer is its own,
+//                it is released at the end of the transfer
+//              _SPI4Interrupt runs while SPI4IE is set and the CPU IPL is
+//              below SIM_SPI_IPL
+//****************************************************************************//
+#ifndef __SPI_SIM_H_
+#define __SPI_SIM_H_
+#include "spi.h"
+
+#define SIM_SPI_IPL         4               // IPC30bits.SPI4IP of SPI_init
+
+typedef struct
+{
+    uint8_t chip;                           // SPI_write chip select, MIKROBUSx_CS
+    void (*on_select)(void);
+    uint8_t (*on_exchange)(uint8_t byte);   // Byte from the master, returns the byte to it
+    void (*on_release)(void);
+}STRUCT_SIM_SPI_DEVICE;
+
+extern uint32_t SIM_spi_bytes;              // Bytes shifted, any chip
+extern uint32_t SIM_spi_transfers;          // SPI_write transfers, any chip
+
+void SIM_spi_init (STRUCT_SIM_SPI_DEVICE *device);
+void SIM_spi_irq (void);
+uint32_t SIM_spi_run (uint32_t ticks);
+#endif
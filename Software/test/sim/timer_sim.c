@@ -0,0 +1,142 @@
+//****************************************************************************//
+// File      :  timer_sim.c
+//
+// Includes  :  timer_sim.h
+//
+// Purpose   :  Instruction cycle model of TIMER_1, TIMER_2/3 and TIMER_8/9,
+//              see timer_sim.h
+//****************************************************************************//
+#include "timer_sim.h"
+
+void _T1Interrupt (void);
+void _T3Interrupt (void);
+
+uint32_t SIM_timer_cycles = 0;
+
+static const uint8_t prescaler_shift[4] = {0, 3, 6, 8};
+static uint16_t t1_pre, t2_pre, t8_pre;
+
+// Cycles to the next period match, 0xFFFFFFFF when stopped
+static uint32_t to_match (uint32_t count, uint32_t period, uint8_t tckps, uint16_t pre)
+{
+    uint64_t cycles;
+
+    if (count > period)
+    {
+        count = 0;
+    }
+    cycles = ((uint64_t)(period - count) + 1) << prescaler_shift[tckps];
+    cycles -= pre;
+    return (cycles > 0xFFFFFFFFULL) ? 0xFFFFFFFF : (uint32_t)cycles;
+}
+
+// Advances a counter by cycles, returns 1 on a period match
+static uint8_t count_up (uint32_t *count, uint32_t period, uint8_t tckps, uint16_t *pre, uint32_t cycles)
+{
+    uint32_t ticks;
+
+    ticks = (*pre + cycles) >> prescaler_shift[tckps];
+    *pre = (*pre + cycles) & ((1U << prescaler_shift[tckps]) - 1);
+    if ((uint64_t)*count + ticks > period)
+    {
+        *count = (uint32_t)(((uint64_t)*count + ticks) - period - 1);
+        return 1;
+    }
+    *count += ticks;
+    return 0;
+}
+
+void SIM_timer_irq (void)
+{
+    if (HOST_cpu_ipl >= SIM_TIMER_IPL)
+    {
+        return;
+    }
+    if ((IFS0bits.T1IF == 1) && (IEC0bits.T1IE == 1))
+    {
+        _T1Interrupt();
+    }
+    if ((IFS0bits.T3IF == 1) && (IEC0bits.T3IE == 1))
+    {
+        _T3Interrupt();
+    }
+}
+
+void SIM_timer_run (uint32_t cycles)
+{
+    uint32_t step, next, count;
+
+    SIM_timer_irq();
+    while (cycles > 0)
+    {
+        // Up to the next match of an interrupt timer, one match per step
+        step = cycles;
+        if (T1CONbits.TON == 1)
+        {
+            next = to_match(TMR1, PR1, T1CONbits.TCKPS, t1_pre);
+            if (next < step){step = next;}
+        }
+        if ((T2CONbits.TON == 1) && (T2CONbits.T32 == 1))
+        {
+            next = to_match(((uint32_t)TMR3 << 16) | TMR2, ((uint32_t)PR3 << 16) | PR2, T2CONbits.TCKPS, t2_pre);
+            if (next < step){step = next;}
+        }
+
+        if (T1CONbits.TON == 1)
+        {
+            count = TMR1;
+            if (count_up(&count, PR1, T1CONbits.TCKPS, &t1_pre, step))
+            {
+                IFS0bits.T1IF = 1;
+            }
+            TMR1 = count;
+        }
+        if ((T2CONbits.TON == 1) && (T2CONbits.T32 == 1))
+        {
+            count = ((uint32_t)TMR3 << 16) | TMR2;
+            if (count_up(&count, ((uint32_t)PR3 << 16) | PR2, T2CONbits.TCKPS, &t2_pre, step))
+            {
+                IFS0bits.T3IF = 1;
+            }
+            TMR2 = count & 0xFFFF;
+            TMR3 = count >> 16;
+            TMR3HLD = TMR3;
+        }
+        if ((T8CONbits.TON == 1) && (T8CONbits.T32 == 1))
+        {
+            count = ((uint32_t)TMR9HLD << 16) | TMR8;
+            count_up(&count, 0xFFFFFFFF, T8CONbits.TCKPS, &t8_pre, step);
+            TMR8 = count & 0xFFFF;
+            TMR9HLD = count >> 16;
+        }
+        SIM_timer_cycles += step;
+        cycles -= step;
+        SIM_timer_irq();
+    }
+}
+
+// Returns 0 when no enabled timer would ever raise its flag
+uint8_t SIM_timer_wait (void)
+{
+    uint32_t next, n;
+
+    while (!(((IFS0bits.T1IF == 1) && (IEC0bits.T1IE == 1)) || ((IFS0bits.T3IF == 1) && (IEC0bits.T3IE == 1))))
+    {
+        next = 0xFFFFFFFF;
+        if ((T1CONbits.TON == 1) && (IEC0bits.T1IE == 1))
+        {
+            next = to_match(TMR1, PR1, T1CONbits.TCKPS, t1_pre);
+        }
+        if ((T2CONbits.TON == 1) && (T2CONbits.T32 == 1) && (IEC0bits.T3IE == 1))
+        {
+            n = to_match(((uint32_t)TMR3 << 16) | TMR2, ((uint32_t)PR3 << 16) | PR2, T2CONbits.TCKPS, t2_pre);
+            if (n < next){next = n;}
+        }
+        if (next == 0xFFFFFFFF)
+        {
+            return 0;
+        }
+        SIM_timer_run(next);
+    }
+    return 1;
+}
@@ -0,0 +1,31 @@
+//****************************************************************************//
+// File      :  timer_sim.h
+//
+// Functions :  void SIM_timer_run (uint32_t cycles);
+//              void SIM_timer_irq (void);
+//              uint8_t SIM_timer_wait (void);
+//
+// Includes  :  xc.h
+//
+// Purpose   :  Instruction cycle model of the timers used by the host tests :
+//              TIMER_1 (16-bit), the TIMER_2 / TIMER_3 pair in 32-bit mode
+//              and the TIMER_8 / TIMER_9 pair as the free-running timebase.
+//              Counters follow TxCON, TMRx and PRx as Timer.c programs them.
+//              A period match sets TxIF, the ISR runs when TxIE is set and
+//              the CPU IPL is below SIM_TIMER_IPL, otherwise it stays pending
+//              until SIM_timer_irq() or the next SIM_timer_run() call.
+//              SIM_timer_wait() is the Idle() of the CPU : it runs up to the
+//              first enabled timer flag, whatever the IPL
+//****************************************************************************//
+#ifndef __TIMER_SIM_H_
+#define __TIMER_SIM_H_
+#include <xc.h>
+
+#define SIM_TIMER_IPL       4               // Default interrupt priority
+
+extern uint32_t SIM_timer_cycles;           // Instruction cycles since start
+
+void SIM_timer_run (uint32_t cycles);
+void SIM_timer_irq (void);
+uint8_t SIM_timer_wait (void);
+#endif
@@ -0,0 +1,2 @@
+// Library sources include DMA.h as "dma.h", the XC16 toolchain is not case sensitive
+#include "../../dsPeak library/inc/DMA.h"
@@ -0,0 +1 @@
+// XC16 DSP library header, nothing of it is used by the host tests
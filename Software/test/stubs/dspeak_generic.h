@@ -0,0 +1,2 @@
+// Library sources include dsPeak_generic.h as "dspeak_generic.h", the XC16 toolchain is not case sensitive
+#include "../../dsPeak library/inc/dsPeak_generic.h"
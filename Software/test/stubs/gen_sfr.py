@@ -0,0 +1,74 @@
+# Generates the host register file of the library tests
+#
+# usage : python3 gen_sfr.py <library dir> <sfr_plain.txt> <sfr_block.txt> <sfr_fifo.txt> <output dir>
+#
+# Every REGbits.FIELD access found in the library sources and headers becomes
+# a REGBITS struct with one unsigned member per field. Registers accessed as a
+# whole are listed in sfr_plain.txt, add a name there when the host build
+# reports it undeclared. Registers the library walks with a pointer from the
+# first one, as the consecutive ECAN filter registers, are listed in
+# sfr_block.txt with their word count and are laid out as one array. Buffer
+# registers read or written several times in a row, as the SPI enhanced
+# buffer, are listed in sfr_fifo.txt : each access of the register moves to
+# the next word of HOST_<register>_fifo, a peripheral model queues the words
+# received before the interrupt and collects the ones written after it.
+# Writes sfr.h (declarations, included by stubs/xc.h) and sfr.c (definitions)
+import os
+import re
+import sys
+
+lib, plain_list, block_list, fifo_list, out = sys.argv[1], sys.argv[2], sys.argv[3], sys.argv[4], sys.argv[5]
+
+bits = {}
+for sub in ("src", "inc"):
+    for name in sorted(os.listdir(os.path.join(lib, sub))):
+        if not name.endswith((".c", ".h")):
+            continue
+        with open(os.path.join(lib, sub, name), errors="ignore") as f:
+            text = f.read()
+        for reg, field in re.findall(r"\b([A-Za-z][A-Za-z0-9]*)bits\.([A-Za-z0-9_]+)", text):
+            bits.setdefault(reg, set()).add(field)
+
+with open(plain_list) as f:
+    plain = sorted(set(f.read().split()))
+blocks = []
+with open(block_list) as f:
+    for line in f:
+        line = line.split("#")[0].split()
+        if line:
+            blocks.append((line[0], int(line[1])))
+fifos = []
+with open(fifo_list) as f:
+    for line in f:
+        line = line.split("#")[0].split()
+        if line:
+            fifos.append(line[0])
+
+h = ["// Generated by gen_sfr.py, do not edit", "#ifndef __HOST_SFR_H_", "#define __HOST_SFR_H_"]
+c = ["// Generated by gen_sfr.py, do not edit", "#include <xc.h>"]
+for reg in sorted(bits):
+    fields = " ".join("unsigned %s;" % x for x in sorted(bits[reg]))
+    h.append("typedef struct { %s } %sBITS;" % (fields, reg))
+    h.append("extern volatile %sBITS %sbits;" % (reg, reg))
+    c.append("volatile %sBITS %sbits;" % (reg, reg))
+for reg in plain:
+    h.append("extern volatile uint16_t %s;" % reg)
+    c.append("volatile uint16_t %s;" % reg)
+for reg, words in blocks:
+    h.append("extern volatile uint16_t HOST_%s_block[%d];" % (reg, words))
+    h.append("#define %s (HOST_%s_block[0])" % (reg, reg))
+    c.append("volatile uint16_t HOST_%s_block[%d];" % (reg, words))
+if fifos:
+    h.append("#define HOST_FIFO_DEPTH 64")
+    h.append("typedef struct { uint16_t word[HOST_FIFO_DEPTH]; uint16_t index; } HOST_FIFO;")
+for reg in fifos:
+    h.append("extern volatile HOST_FIFO HOST_%s_fifo;" % reg)
+    h.append("#define %s (HOST_%s_fifo.word[HOST_%s_fifo.index++ & (HOST_FIFO_DEPTH - 1)])" % (reg, reg, reg))
+    c.append("volatile HOST_FIFO HOST_%s_fifo;" % reg)
+h.append("#endif")
+
+os.makedirs(out, exist_ok=True)
+with open(os.path.join(out, "sfr.h"), "w") as f:
+    f.write("\n".join(h) + "\n")
+with open(os.path.join(out, "sfr.c"), "w") as f:
+    f.write("\n".join(c) + "\n")
@@ -0,0 +1,31 @@
+//****************************************************************************//
+// File      :  host.c
+//
+// Includes  :  xc.h
+//
+// Purpose   :  CPU of the host tests. Idle() returns at once unless the test
+//              installs HOST_idle_hook, which stands for the interrupt that
+//              wakes the CPU (advance the timebase, call the timer ISR).
+//              __delay_us() returns at once unless HOST_delay_hook is set
+//****************************************************************************//
+#include <xc.h>
+
+uint16_t HOST_cpu_ipl = 0;
+void (*HOST_idle_hook)(void) = 0;
+void (*HOST_delay_hook)(uint32_t us) = 0;
+
+void Idle (void)
+{
+    if (HOST_idle_hook != 0)
+    {
+        HOST_idle_hook();
+    }
+}
+
+void HOST_delay_us (uint32_t us)
+{
+    if (HOST_delay_hook != 0)
+    {
+        HOST_delay_hook(us);
+    }
+}
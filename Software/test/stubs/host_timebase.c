@@ -0,0 +1,57 @@
+//****************************************************************************//
+// File      :  host_timebase.c
+//
+// Includes  :  xc.h, Timer.h
+//
+// Purpose   :  Timebase of the host tests. The timebase is driven by the test
+//              through HOST_timebase_now / HOST_timebase_freq instead of the
+//              TMR8 / TMR9 pair. HOST_timebase_step models the cost of a read,
+//              the timebase advances by it after each TIMER_timebase_get().
+//              Tests that build Timer.c leave this file out
+//****************************************************************************//
+#include <xc.h>
+#include "Timer.h"
+
+uint32_t HOST_timebase_now = 0;
+uint32_t HOST_timebase_freq = 0;
+uint32_t HOST_timebase_step = 0;
+
+// No timer is started, the 32-bit count is HOST_timebase_now at FCY
+uint8_t TIMER_timebase_init (STRUCT_TIMER *timer, uint8_t channel, uint8_t prescaler)
+{
+    const uint16_t div[4] = {1, 8, 64, 256};
+
+    if ((prescaler > TIMER_PRESCALER_256) ||
+        ((channel != TIMER_2) && (channel != TIMER_4) && (channel != TIMER_6) && (channel != TIMER_8)))
+    {
+        return 0;
+    }
+    HOST_timebase_freq = FCY / div[prescaler];
+    return 1;
+}
+
+uint32_t TIMER_timebase_get (void)
+{
+    uint32_t now = HOST_timebase_now;
+    HOST_timebase_now += HOST_timebase_step;
+    return now;
+}
+
+uint32_t TIMER_timebase_get_freq (void)
+{
+    return HOST_timebase_freq;
+}
+
+uint32_t TIMER_timebase_us_to_ticks (uint32_t us)
+{
+    return (uint32_t)(((uint64_t)us * HOST_timebase_freq) / 1000000ULL);
+}
+
+uint32_t TIMER_timebase_ticks_to_us (uint32_t ticks)
+{
+    if (HOST_timebase_freq == 0)
+    {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)ticks * 1000000ULL) / HOST_timebase_freq);
+}
@@ -0,0 +1,6 @@
+// XC16 delays, the host tests do not wait. A test may install
+// HOST_delay_hook (host.c) to model what happens on the pins meanwhile
+#include <stdint.h>
+void HOST_delay_us (uint32_t us);
+#define __delay_ms(x)               ((void)(x))
+#define __delay_us(x)               HOST_delay_us(x)
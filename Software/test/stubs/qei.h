@@ -0,0 +1,2 @@
+// Library sources include QEI.h as "qei.h", the XC16 toolchain is not case sensitive
+#include "../../dsPeak library/inc/QEI.h"
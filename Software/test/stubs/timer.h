@@ -0,0 +1,2 @@
+// Library sources include Timer.h as "timer.h", the XC16 toolchain is not case sensitive
+#include "../../dsPeak library/inc/Timer.h"
@@ -0,0 +1,2 @@
+// Library sources include UART.h as "uart.h", the XC16 toolchain is not case sensitive
+#include "../../dsPeak library/inc/UART.h"
@@ -0,0 +1,38 @@
+//****************************************************************************//
+// File      :  xc.h
+//
+// Includes  :  sfr.h (generated by gen_sfr.py)
+//
+// Purpose   :  Host replacement of the XC16 device header. Special function
+//              registers are plain variables the tests can read and write,
+//              attributes and builtins of the PIC toolchain are neutralized
+//              and the CPU IPL is a variable
+//****************************************************************************//
+#ifndef __HOST_XC_H_
+#define __HOST_XC_H_
+#include <stdint.h>
+#include <stdlib.h>
+
+// Compiler extensions
+#define __interrupt__               __unused__
+#define no_auto_psv                 __unused__
+#define eds                         __unused__
+#define __eds__
+#define space(x)                    __unused__
+#define __builtin_dmaoffset(x)      ((uint16_t)(uintptr_t)(x))
+#define __builtin_dmapage(x)        0
+#define __builtin_write_OSCCONH(x)  ((void)(x))
+#define __builtin_write_OSCCONL(x)  ((void)(x))
+#define __builtin_write_RTCWEN()    ((void)0)
+
+// CPU
+extern uint16_t HOST_cpu_ipl;
+#define SET_AND_SAVE_CPU_IPL(save, ipl) do {(save) = HOST_cpu_ipl; HOST_cpu_ipl = (ipl);} while (0)
+#define RESTORE_CPU_IPL(save)           do {HOST_cpu_ipl = (save);} while (0)
+#define SET_CPU_IPL(ipl)                do {HOST_cpu_ipl = (ipl);} while (0)
+void Idle (void);
+#define Nop()                       ((void)0)
+#define ClrWdt()                    ((void)0)
+
+#include "sfr.h"
+#endif
@@ -0,0 +1,34 @@
+//****************************************************************************//
+// File      :  test.h
+//
+// Purpose   :  Checks of the host tests. A failed check prints its location
+//              and the test goes on, TEST_end returns the exit code
+//****************************************************************************//
+#ifndef __TEST_H_
+#define __TEST_H_
+#include <stdio.h>
+
+static int TEST_checks = 0;
+static int TEST_failures = 0;
+
+#define TEST_CHECK(cond) \
+    do {TEST_checks++; if (!(cond)) {TEST_failures++; \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);}} while (0)
+
+#define TEST_CHECK_EQ(a, b) \
+    do {long long _a = (long long)(a), _b = (long long)(b); TEST_checks++; \
+        if (_a != _b) {TEST_failures++; \
+        printf("%s:%d: %s == %s failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b);}} while (0)
+
+// |a - b| <= tol
+#define TEST_CHECK_NEAR(a, b, tol) \
+    do {double _a = (double)(a), _b = (double)(b); TEST_checks++; \
+        if (((_a - _b) > (tol)) || ((_b - _a) > (tol))) {TEST_failures++; \
+        printf("%s:%d: %s ~ %s failed: %g != %g +/- %g\n", __FILE__, __LINE__, #a, #b, _a, _b, (double)(tol));}} while (0)
+
+static int TEST_end (const char *name)
+{
+    printf("%s: %d checks, %d failed\n", name, TEST_checks, TEST_failures);
+    return (TEST_failures == 0) ? 0 : 1;
+}
+#endif
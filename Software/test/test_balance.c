@@ -0,0 +1,281 @@
+//****************************************************************************//
+// File      :  test_balance.c
+//
+// Includes  :  balance.h, QEI.h, test.h
+//
+// Purpose   :  BALANCE_update terms against the gain units documented in
+//              balance.h, integral clamp and gaps, tilt limit, angle and
+//              timebase wrap. Timebase at FCY as on the board.
+//              Closed loop on an inverted pendulum on wheels : CoM 0.12m
+//              above the axle, velocity-mode motors (1.5m/s at 100% duty,
+//              50ms time constant). BALANCE_update on 200Hz orientation
+//              samples settles from 1 to 8 deg, the double-based pid_func
+//              it replaced (10Hz gravity Y, 30Hz timer) lets it fall
+//****************************************************************************//
+#include <math.h>
+#include "balance.h"
+#include "QEI.h"
+#include "test.h"
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+
+#define DEG             182                     // Binary angle LSB per degree
+#define RAD_S           65536L                  // 1 rad/s, Q16.16
+#define PERCENT(x)      ((x) * 100.0 / BALANCE_OUT_MAX)
+#define MS              (FCY / 1000UL)          // Timebase ticks
+
+static void test_proportional (void)
+{
+    STRUCT_BALANCE bal;
+
+    BALANCE_init(&bal, 256, 0, 0);              // 1.0
+    TEST_CHECK_EQ(BALANCE_update(&bal, -100, 0, 0), 100);
+    TEST_CHECK_EQ(BALANCE_get_error(&bal), 100);
+    TEST_CHECK_EQ(BALANCE_update(&bal, 100, 0, MS), -100);
+    TEST_CHECK_EQ(BALANCE_get_output(&bal), -100);
+
+    // 8000 = 17.4% duty per degree
+    BALANCE_init(&bal, 8000, 0, 0);
+    TEST_CHECK_NEAR(PERCENT(BALANCE_update(&bal, -DEG, 0, 0)), 17.4, 0.1);
+
+    // Setpoint, the error wraps with the binary angle
+    BALANCE_init(&bal, 256, 0, 0);
+    BALANCE_set_setpoint(&bal, 32000);
+    TEST_CHECK_EQ(BALANCE_update(&bal, -32000, 0, 0), -1536);
+
+    // Saturation
+    BALANCE_init(&bal, 32767, 0, 0);
+    TEST_CHECK_EQ(BALANCE_update(&bal, -40 * DEG, 0, 0), BALANCE_OUT_MAX);
+    TEST_CHECK_EQ(BALANCE_update(&bal, 40 * DEG, 0, 0), -BALANCE_OUT_MAX);
+}
+
+static void test_derivative (void)
+{
+    STRUCT_BALANCE bal;
+
+    // 3000 = 0.4% duty per deg/s, against the rate : 1 rad/s = 57.3 deg/s
+    BALANCE_init(&bal, 0, 0, 3000);
+    TEST_CHECK_NEAR(PERCENT(BALANCE_update(&bal, 0, RAD_S, 0)), -0.407 * 57.3, 0.3);
+    TEST_CHECK_NEAR(PERCENT(BALANCE_update(&bal, 0, -RAD_S / 2, MS)), 0.407 * 28.65, 0.2);
+    // Rates past the 16-bit range saturate
+    BALANCE_init(&bal, 0, 0, 256);
+    TEST_CHECK_EQ(BALANCE_update(&bal, 0, 1000L * RAD_S, 0), -BALANCE_OUT_MAX);
+}
+
+static void test_integral (void)
+{
+    STRUCT_BALANCE bal;
+    uint32_t t = 0;
+    uint16_t i;
+    int16_t out;
+
+    // 6000 = 13% duty per degree x second, 1s of 10ms samples
+    BALANCE_init(&bal, 0, 6000, 0);
+    TEST_CHECK_EQ(BALANCE_update(&bal, -DEG, 0, t), 0);     // 1st sample, no dt
+    for (i = 0; i < 100; i++)
+    {
+        t += 10 * MS;
+        out = BALANCE_update(&bal, -DEG, 0, t);
+    }
+    TEST_CHECK_NEAR(PERCENT(out), 13.0, 0.3);
+
+    // Gaps longer than BALANCE_DT_MAX_US are not integrated
+    t += 2 * BALANCE_DT_MAX_US * (MS / 1000);
+    TEST_CHECK_EQ(BALANCE_update(&bal, -DEG, 0, t), out);
+
+    // Timebase wrap
+    BALANCE_init(&bal, 0, 6000, 0);
+    t = 0xFFFFFFFFUL - (5 * MS);
+    BALANCE_update(&bal, -DEG, 0, t);
+    t += 10 * MS;
+    TEST_CHECK_NEAR(PERCENT(BALANCE_update(&bal, -DEG, 0, t)), 0.13, 0.02);
+
+    // Clamped at 100%, unwinds right away when the error reverses
+    BALANCE_init(&bal, 0, 32767, 0);
+    t = 0;
+    for (i = 0; i < 200; i++)
+    {
+        t += 10 * MS;
+        out = BALANCE_update(&bal, -30 * DEG, 0, t);
+    }
+    TEST_CHECK_EQ(out, BALANCE_OUT_MAX);
+    TEST_CHECK_EQ(bal.i_acc, (int32_t)BALANCE_OUT_MAX << 16);
+    t += 10 * MS;
+    TEST_CHECK(BALANCE_update(&bal, 30 * DEG, 0, t) < BALANCE_OUT_MAX);
+    for (i = 0; i < 200; i++)
+    {
+        t += 10 * MS;
+        out = BALANCE_update(&bal, 30 * DEG, 0, t);
+    }
+    TEST_CHECK_EQ(out, -BALANCE_OUT_MAX);
+}
+
+static void test_tilt_limit (void)
+{
+    STRUCT_BALANCE bal;
+
+    BALANCE_init(&bal, 8000, 6000, 3000);
+    BALANCE_update(&bal, -10 * DEG, 0, 0);
+    BALANCE_update(&bal, -10 * DEG, 0, 10 * MS);
+    TEST_CHECK(bal.i_acc != 0);
+
+    // Fallen past 45 deg : output cut, integral cleared
+    TEST_CHECK_EQ(BALANCE_update(&bal, -46 * DEG, 0, 20 * MS), 0);
+    TEST_CHECK_EQ(bal.fallen, 1);
+    TEST_CHECK_EQ(bal.i_acc, 0);
+    TEST_CHECK_EQ(BALANCE_update(&bal, 50 * DEG, 0, 30 * MS), 0);
+    TEST_CHECK(BALANCE_update(&bal, 44 * DEG, 0, 40 * MS) < 0);
+    TEST_CHECK_EQ(bal.fallen, 0);
+
+    BALANCE_set_tilt_limit(&bal, 20 * DEG);
+    TEST_CHECK_EQ(BALANCE_update(&bal, 21 * DEG, 0, 50 * MS), 0);
+
+    // Reset clears the state, the next sample is not integrated
+    BALANCE_update(&bal, 10 * DEG, 0, 60 * MS);
+    BALANCE_reset(&bal);
+    TEST_CHECK_EQ(BALANCE_get_output(&bal), 0);
+    BALANCE_init(&bal, 0, 6000, 0);
+    TEST_CHECK_EQ(BALANCE_update(&bal, -DEG, 0, 70 * MS), 0);
+}
+
+#define PLANT_G         9.81                    // m/s2
+#define PLANT_L         0.12                    // Axle to CoM, m
+#define PLANT_VMAX      1.5                     // Wheel speed at 100% duty, m/s
+#define PLANT_TAU       0.05                    // Motor speed time constant, s
+#define PLANT_DT        0.0001                  // Integration step, s
+#define PLANT_STEPS(s)  ((uint32_t)((s) / PLANT_DT + 0.5))
+#define SETTLE_DEG      0.5                     // Settled within
+#define FALLEN_DEG      45.0
+
+typedef struct
+{
+    double theta;                               // Tilt, rad, sign of the sensor angle
+    double omega;                               // Tilt rate, rad/s
+    double v;                                   // Wheel speed, m/s
+}STRUCT_PLANT;
+
+// Positive duty accelerates the wheels under a negative tilt
+static void plant_step (STRUCT_PLANT *p, double duty)
+{
+    double a = ((duty * PLANT_VMAX) - p->v) / PLANT_TAU;
+    double alpha = ((PLANT_G * sin(p->theta)) + (a * cos(p->theta))) / PLANT_L;
+
+    p->v += a * PLANT_DT;
+    p->omega += alpha * PLANT_DT;
+    p->theta += p->omega * PLANT_DT;
+}
+
+// pid_func of the BNO080 motor control project before the balance module :
+// gravity Y in Q8 m/s2, duty in percent through MOTOR_drive_perc
+static double p_gain = 0.03, i_gain = 0.0005, i_value;
+
+static double pid_func (int16_t y_axis)
+{
+    int16_t y_error = 0 - y_axis;
+    double direction = (y_error >= 0) ? 1.0 : -1.0;
+    uint16_t pid;
+
+    y_error = abs(y_error);
+    if (y_error < 100)
+    {
+        return 0;
+    }
+    i_value += (double)((i_gain * 0.33) * (double)y_error);
+    pid = (uint16_t)(((double)p_gain * (double)y_error) + i_value);
+    if (pid > QEI_MOT1_MAX_RPM){pid = QEI_MOT1_MAX_RPM;}
+    if (pid > 100){pid = 100;}                  // MOTOR_drive_perc
+    return direction * pid / 100.0;
+}
+
+#define LOOP_BALANCE    0                       // BALANCE_update, 5ms gyro-integrated rotation vector
+#define LOOP_PID_FUNC   1                       // pid_func, 100ms gravity report, 30Hz TIMER5
+
+// 2s from deg at rest. Returns the time the tilt enters SETTLE_DEG for
+// good in ms, -1 if it never does. fall_ms is the time it passes
+// FALLEN_DEG, -1 if it does not
+static int32_t simulate (uint8_t loop, double deg, int32_t *fall_ms)
+{
+    STRUCT_PLANT p = {deg * M_PI / 180.0, 0, 0};
+    STRUCT_BALANCE bal;
+    int32_t settled = -1;
+    uint32_t k;
+    int16_t y_axis = 0;
+    double duty = 0;
+
+    BALANCE_init(&bal, 8000, 6000, 3000);
+    i_value = 0;
+    *fall_ms = -1;
+    for (k = 0; k < PLANT_STEPS(2.0); k++)
+    {
+        if ((loop == LOOP_BALANCE) && ((k % PLANT_STEPS(0.005)) == 0))
+        {
+            // Roll as a binary angle, rate Q16.16 rad/s, sample time in ticks
+            duty = BALANCE_update(&bal, (int16_t)lround(p.theta * 32768.0 / M_PI), lround(p.omega * RAD_S),
+                                  (uint32_t)(((uint64_t)k * FCY) / PLANT_STEPS(1.0))) / (double)BALANCE_OUT_MAX;
+        }
+        if (loop == LOOP_PID_FUNC)
+        {
+            if ((k % PLANT_STEPS(0.1)) == 0)
+            {
+                y_axis = (int16_t)lround(PLANT_G * sin(p.theta) * 256.0);
+            }
+            if ((k % PLANT_STEPS(1.0 / 30.0)) == 0)
+            {
+                duty = pid_func(y_axis);
+            }
+        }
+        plant_step(&p, duty);
+        if (fabs(p.theta) > (FALLEN_DEG * M_PI / 180.0))
+        {
+            *fall_ms = (int32_t)lround(k * PLANT_DT * 1000.0);
+            return -1;
+        }
+        if (fabs(p.theta) > (SETTLE_DEG * M_PI / 180.0))
+        {
+            settled = -1;
+        }
+        else if (settled < 0)
+        {
+            settled = (int32_t)k;
+        }
+    }
+    return (settled < 0) ? -1 : (int32_t)lround(settled * PLANT_DT * 1000.0);
+}
+
+// Gains of the project. pid_func has no rate term and integrates |error|
+// whatever its sign, it falls over from any start. BALANCE_update settles
+// within 6 to 13 samples
+static void test_pendulum (void)
+{
+    const double start[4] = {1, 2, 4, 8};
+    int32_t balance_ms, balance_fall, pid_ms, pid_fall;
+    uint8_t i;
+
+    printf("  %-6s %22s %22s\n", "start", "BALANCE_update settle", "pid_func falls");
+    for (i = 0; i < 4; i++)
+    {
+        balance_ms = simulate(LOOP_BALANCE, start[i], &balance_fall);
+        pid_ms = simulate(LOOP_PID_FUNC, start[i], &pid_fall);
+        printf("  %3.0f deg %19ld ms %19ld ms\n", start[i], (long)balance_ms, (long)pid_fall);
+        TEST_CHECK_EQ(balance_fall, -1);
+        TEST_CHECK(balance_ms > 0);
+        TEST_CHECK(balance_ms <= 70);
+        TEST_CHECK_EQ(pid_ms, -1);
+        TEST_CHECK(pid_fall > 0);
+        TEST_CHECK(pid_fall < 600);
+    }
+    // Far from upright, still caught
+    TEST_CHECK(simulate(LOOP_BALANCE, 20, &balance_fall) > 0);
+    TEST_CHECK(simulate(LOOP_BALANCE, -20, &balance_fall) > 0);
+}
+
+int main (void)
+{
+    HOST_timebase_freq = FCY;
+    test_proportional();
+    test_derivative();
+    test_integral();
+    test_tilt_limit();
+    test_pendulum();
+    return TEST_end("test_balance");
+}
@@ -0,0 +1,922 @@
+//****************************************************************************//
+// File      :  test_bno08x.c
+//
+// Includes  :  BNO080.h, i2c_sim.h, spi_sim.h, test.h
+//
+// Purpose   :  BNO08X SHTP parser (BNO08X_shtp_feed), report decoders and
+//              the integer quaternion to Euler conversion. Cargos are built
+//              as read on the bus, the conversion is compared to libm.
+//              The interrupt-driven read path runs against a simulated hub
+//              on the I2C1 model : INTn starts the reads from _INT4Interrupt,
+//              the reports are dispatched from the I2C master interrupt and
+//              the INTn to report latency is the bus time of the reads.
+//              The bus cost per report of both read modes is counted, the
+//              set feature writes are checked against the SH-2 layout.
+//              Over SPI_4 (sim/spi_sim.c) the same cargos give the same
+//              reports, the bus time per report is compared
+//****************************************************************************//
+#include <math.h>
+#include <string.h>
+#include "BNO080.h"
+#include "i2c_sim.h"
+#include "spi_sim.h"
+#include "test.h"
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+extern STRUCT_BNO08X BNO08X_struct[BNO08X_QTY];
+extern STRUCT_I2C i2c_struct[I2C_QTY];
+extern STRUCT_SPI SPI_struct[SPI_QTY];
+void _INT4Interrupt (void);
+
+#define BIT_TICKS       (FCY / I2C_FREQ_400k)
+#define US(x)           ((uint32_t)(x) * (FCY / 1000000UL))
+
+#define LOG_SIZE        16
+
+static STRUCT_BNO08X bno;
+static STRUCT_BNO08X_REPORT report_log[LOG_SIZE];
+static uint8_t report_qty = 0;
+static uint8_t raw_id = 0;
+
+static void log_report (STRUCT_BNO08X_REPORT *report)
+{
+    raw_id = report->raw[0];
+    if (report_qty < LOG_SIZE)
+    {
+        report_log[report_qty++] = *report;
+    }
+}
+
+// SHTP transfer : 4-byte header then cargo, length includes the header
+static uint16_t shtp (uint8_t *out, uint8_t channel, uint8_t seq, uint8_t cont, const uint8_t *cargo, uint16_t length)
+{
+    out[0] = (uint8_t)(length + 4);
+    out[1] = (uint8_t)((length + 4) >> 8) | (cont << 7);
+    out[2] = channel;
+    out[3] = seq;
+    memcpy(&out[4], cargo, length);
+    return length + 4;
+}
+
+static void reset_parser (void)
+{
+    memset(&bno, 0, sizeof(bno));
+    BNO08X_register_handler(&bno, BNO08X_REPORT_ANY, log_report);
+    report_qty = 0;
+}
+
+static void test_sensor_cargo (void)
+{
+    // Base timestamp 1ms before INTn, accelerometer 0.4ms after the base,
+    // gyroscope, then a rebase of 0.2ms later for the gravity report
+    const uint8_t cargo[] =
+    {
+        BNO08X_REPORT_BASE_TIMESTAMP, 10, 0, 0, 0,
+        BNO08X_SENSOR_ID_ACCEL, 7, 0x03, 4, 0x00, 0x01, 0x80, 0xFF, 0x00, 0x02,
+        BNO08X_SENSOR_ID_GYRO, 8, 0x02, 4, 0x00, 0x02, 0x00, 0xFE, 0x01, 0x00,
+        BNO08X_REPORT_TIMESTAMP_REBASE, 0xFE, 0xFF, 0xFF, 0xFF,
+        BNO08X_SENSOR_ID_GRAVITY, 9, 0x01, 0, 0x33, 0x09, 0, 0, 0, 0
+    };
+    uint8_t data[64];
+    uint16_t length = shtp(data, BNO08X_CHANNEL3_SNSREP, 0, 0, cargo, sizeof(cargo));
+    STRUCT_BNO08X_VECTOR vector;
+
+    reset_parser();
+    bno.int_time = 100000;
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, length), 5);    // 3 reports, 2 timestamp records
+    TEST_CHECK_EQ(report_qty, 3);
+    TEST_CHECK_EQ(BNO08X_get_bytes_parsed(&bno), length);
+
+    TEST_CHECK_EQ(report_log[0].id, BNO08X_SENSOR_ID_ACCEL);
+    TEST_CHECK_EQ(report_log[0].sequence, 7);
+    TEST_CHECK_EQ(report_log[0].status, 3);
+    TEST_CHECK_EQ(report_log[0].delay, 4);
+    TEST_CHECK_EQ(report_log[0].value_qty, 3);
+    TEST_CHECK_EQ(report_log[0].value[0], 256);
+    TEST_CHECK_EQ(report_log[0].value[1], -128);
+    TEST_CHECK_EQ(report_log[0].timestamp, 100000 - 600);    // 1 tick = 1us
+    TEST_CHECK_EQ(BNO08X_decode_vector(&report_log[0], &vector), 1);
+    TEST_CHECK_EQ(vector.x, 65536L);                        // 1 m/s^2, Q8 to Q16.16
+    TEST_CHECK_EQ(vector.y, -32768L);
+    TEST_CHECK_EQ(vector.z, 131072L);
+    TEST_CHECK_EQ(vector.accuracy, 3);
+
+    TEST_CHECK_EQ(BNO08X_decode_vector(&report_log[1], &vector), 1);
+    TEST_CHECK_EQ(vector.x, 65536L);                        // 1 rad/s, Q9
+    TEST_CHECK_EQ(vector.y, -65536L);
+    TEST_CHECK_EQ(vector.z, 128L);
+
+    // Rebase of -2 moves the base 0.2ms later
+    TEST_CHECK_EQ(report_log[2].id, BNO08X_SENSOR_ID_GRAVITY);
+    TEST_CHECK_EQ(report_log[2].base_timestamp, 12);
+    TEST_CHECK_EQ(report_log[2].timestamp, 100000 - 1200);
+    TEST_CHECK_EQ(report_log[2].value[0], 0x0933);
+    TEST_CHECK_EQ(BNO08X_get_error(&bno, BNO08X_ERROR_SEQUENCE), 0);
+}
+
+static void test_sequence_and_unknown (void)
+{
+    const uint8_t accel[10] = {BNO08X_SENSOR_ID_ACCEL, 0, 0, 0, 1, 0, 2, 0, 3, 0};
+    uint8_t cargo[24];
+    uint8_t data[64];
+    uint16_t length;
+
+    reset_parser();
+    length = shtp(data, BNO08X_CHANNEL3_SNSREP, 5, 0, accel, 10);
+    BNO08X_shtp_feed(&bno, data, length);
+    length = shtp(data, BNO08X_CHANNEL3_SNSREP, 6, 0, accel, 10);
+    BNO08X_shtp_feed(&bno, data, length);
+    TEST_CHECK_EQ(BNO08X_get_error(&bno, BNO08X_ERROR_SEQUENCE), 0);
+    length = shtp(data, BNO08X_CHANNEL3_SNSREP, 8, 0, accel, 10);
+    BNO08X_shtp_feed(&bno, data, length);
+    TEST_CHECK_EQ(BNO08X_get_error(&bno, BNO08X_ERROR_SEQUENCE), 1);
+    // Sequence numbers are per channel
+    length = shtp(data, BNO08X_CHANNEL2_SHCC, 0, 0, accel, 1);
+    BNO08X_shtp_feed(&bno, data, length);
+    TEST_CHECK_EQ(BNO08X_get_error(&bno, BNO08X_ERROR_SEQUENCE), 1);
+    TEST_CHECK_EQ(report_qty, 3);
+
+    // Unknown ID, the rest of the cargo is dropped
+    report_qty = 0;
+    memcpy(cargo, accel, 10);
+    cargo[10] = 0x17;
+    memcpy(&cargo[11], accel, 10);
+    length = shtp(data, BNO08X_CHANNEL3_SNSREP, 9, 0, cargo, 21);
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, length), 1);
+    TEST_CHECK_EQ(BNO08X_get_error(&bno, BNO08X_ERROR_UNKNOWN), 1);
+    // Also its continuation
+    length = shtp(data, BNO08X_CHANNEL3_SNSREP, 10, 1, accel, 10);
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, length), 0);
+    TEST_CHECK_EQ(report_qty, 1);
+}
+
+static void test_fragments (void)
+{
+    const uint8_t accel[10] = {BNO08X_SENSOR_ID_ACCEL, 1, 0, 0, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+    uint8_t data[64];
+    uint8_t cargo[20];
+    uint16_t length;
+
+    // Report cut after 4 bytes, completed by the continuation fragment
+    reset_parser();
+    memcpy(cargo, accel, 10);
+    memcpy(&cargo[10], accel, 4);
+    length = shtp(data, BNO08X_CHANNEL3_SNSREP, 0, 0, cargo, 14);
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, length), 1);
+    length = shtp(data, BNO08X_CHANNEL3_SNSREP, 1, 1, &accel[4], 6);
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, length), 1);
+    TEST_CHECK_EQ(report_qty, 2);
+    TEST_CHECK_EQ(report_log[1].value[0], 0x2211);
+    TEST_CHECK_EQ(report_log[1].value[2], 0x6655);
+    TEST_CHECK_EQ(BNO08X_get_error(&bno, BNO08X_ERROR_TRUNCATED), 0);
+
+    // A new cargo ends the cut report
+    length = shtp(data, BNO08X_CHANNEL3_SNSREP, 2, 0, accel, 4);
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, length), 0);
+    length = shtp(data, BNO08X_CHANNEL3_SNSREP, 3, 0, accel, 10);
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, length), 1);
+    TEST_CHECK_EQ(BNO08X_get_error(&bno, BNO08X_ERROR_TRUNCATED), 1);
+    TEST_CHECK_EQ(report_qty, 3);
+
+    // Read longer than the cargo : the extra bytes are not data
+    length = shtp(data, BNO08X_CHANNEL3_SNSREP, 4, 0, accel, 10);
+    memcpy(&data[length], accel, 10);
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, length + 10), 1);
+
+    // Header only read
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, 4), 0);
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, 3), 0);
+}
+
+static void test_control_channels (void)
+{
+    const uint8_t flush[12] = {BNO08X_SHCC_FLUSH_COMPLETED, BNO08X_SENSOR_ID_ACCEL,
+                               BNO08X_SENSOR_ID_ACCEL, 0, 0, 0, 1, 0, 2, 0, 3, 0};
+    const uint8_t reset = BNO08X_EXEC_RD_RESET;
+    uint8_t data[64];
+    uint16_t length;
+
+    reset_parser();
+    // Executable channel event, a header only read has no event byte
+    length = shtp(data, BNO08X_CHANNEL1_EXEC, 0, 0, &reset, 1);
+    BNO08X_shtp_feed(&bno, data, 4);
+    TEST_CHECK_EQ(BNO08X_get_exec_event(&bno), 0);
+    BNO08X_shtp_feed(&bno, data, length);
+    TEST_CHECK_EQ(BNO08X_get_exec_event(&bno), BNO08X_EXEC_RD_RESET);
+    TEST_CHECK_EQ(report_qty, 0);
+
+    // Flush completed is 2 bytes, the report after it is kept
+    length = shtp(data, BNO08X_CHANNEL2_SHCC, 0, 0, flush, sizeof(flush));
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, length), 2);
+    TEST_CHECK_EQ(report_log[0].id, BNO08X_SHCC_FLUSH_COMPLETED);
+    TEST_CHECK_EQ(report_log[0].length, 2);
+    TEST_CHECK_EQ(report_log[1].id, BNO08X_SENSOR_ID_ACCEL);
+    TEST_CHECK_EQ(report_log[1].value[2], 3);
+    TEST_CHECK_EQ(raw_id, BNO08X_SENSOR_ID_ACCEL);
+}
+
+static void test_gyro_integrated (void)
+{
+    // i, j, k, real (Q14), angular velocity x, y, z (Q10), no report header
+    const int16_t value[7] = {0, 0, 11585, 11585, 1024, -512, 0};
+    uint8_t cargo[BNO08X_GYRO_INT_RV_LENGTH * 2];
+    uint8_t data[64];
+    uint16_t length;
+    uint8_t i;
+    STRUCT_BNO08X_QUATERNION quat;
+    STRUCT_BNO08X_VECTOR vector;
+    STRUCT_BNO08X_EULER euler;
+
+    for (i = 0; i < 14; i++)
+    {
+        cargo[2 * i] = (uint8_t)value[i % 7];
+        cargo[(2 * i) + 1] = (uint8_t)((uint16_t)value[i % 7] >> 8);
+    }
+    reset_parser();
+    BNO08X_fifo_enable(&bno, 1);
+    length = shtp(data, BNO08X_CHANNEL5_GYRVEC, 0, 0, cargo, sizeof(cargo));
+    TEST_CHECK_EQ(BNO08X_shtp_feed(&bno, data, length), 2);
+    TEST_CHECK_EQ(report_log[0].id, BNO08X_SENSOR_ID_GYRO_INT_RV);
+    TEST_CHECK_EQ(report_log[0].value_qty, 7);
+    TEST_CHECK_EQ(BNO08X_fifo_get_count(&bno), 2);
+
+    TEST_CHECK_EQ(BNO08X_decode_quaternion(&report_log[0], &quat), 1);
+    TEST_CHECK_EQ(quat.k, 11585);
+    TEST_CHECK_EQ(quat.real, 11585);
+    TEST_CHECK_EQ(quat.accuracy, 0);
+    TEST_CHECK_EQ(BNO08X_decode_vector(&report_log[0], &vector), 1);
+    TEST_CHECK_EQ(vector.x, 65536L);
+    TEST_CHECK_EQ(vector.y, -32768L);
+    BNO08X_quaternion_to_euler(&quat, &euler);
+    TEST_CHECK_NEAR(euler.yaw, BNO08X_ANGLE_DEG(90), 8);   // 90 deg around Z
+    TEST_CHECK_NEAR(euler.roll, 0, 8);
+    TEST_CHECK_NEAR(euler.pitch, 0, 8);
+
+    // Rotation vector carries the heading accuracy, others have no vector
+    report_log[0].id = BNO08X_SENSOR_ID_GYRO_ROT_VECT;
+    report_log[0].value[4] = 0x0800;
+    TEST_CHECK_EQ(BNO08X_decode_quaternion(&report_log[0], &quat), 1);
+    TEST_CHECK_EQ(quat.accuracy, 0x0800);
+    report_log[0].value_qty = 4;
+    TEST_CHECK_EQ(BNO08X_decode_quaternion(&report_log[0], &quat), 0);
+    TEST_CHECK_EQ(BNO08X_decode_vector(&report_log[0], &vector), 0);
+    report_log[0].id = BNO08X_SENSOR_ID_ACCEL;
+    TEST_CHECK_EQ(BNO08X_decode_quaternion(&report_log[0], &quat), 0);
+}
+
+static double to_bin (double rad)
+{
+    return rad * 32768.0 / M_PI;
+}
+
+// Binary angle difference, wrapped
+static double bin_diff (int16_t a, double b)
+{
+    double d = fmod((double)a - b, 65536.0);
+    if (d > 32768.0){d -= 65536.0;}
+    if (d < -32768.0){d += 65536.0;}
+    return fabs(d);
+}
+
+static void test_euler (void)
+{
+    STRUCT_BNO08X_QUATERNION quat;
+    STRUCT_BNO08X_EULER euler;
+    double w, x, y, z, n, pitch, worst = 0;
+    uint32_t k;
+
+    // Exact cases
+    memset(&quat, 0, sizeof(quat));
+    quat.real = 16384;
+    BNO08X_quaternion_to_euler(&quat, &euler);
+    TEST_CHECK_EQ(euler.roll, 0);
+    TEST_CHECK_EQ(euler.pitch, 0);
+    TEST_CHECK_EQ(euler.yaw, 0);
+    quat.real = 0;
+    quat.k = 16384;                                         // 180 deg around Z
+    BNO08X_quaternion_to_euler(&quat, &euler);
+    TEST_CHECK_EQ(euler.yaw, -32768);
+    quat.k = 0;
+    quat.i = 11585;
+    quat.real = 11585;                                      // 90 deg around X
+    BNO08X_quaternion_to_euler(&quat, &euler);
+    TEST_CHECK_NEAR(euler.roll, 16384, 8);
+    quat.i = 0;
+    quat.j = 11585;                                         // 90 deg around Y
+    BNO08X_quaternion_to_euler(&quat, &euler);
+    TEST_CHECK_NEAR(euler.pitch, 16384, 8);
+
+    // Random orientations against libm. Roll and yaw are checked up to 85 deg
+    // of pitch, where Q14 rounding alone moves them by up to 0.08 deg
+    srand(1);
+    for (k = 0; k < 100000; k++)
+    {
+        w = (rand() / (double)RAND_MAX) - 0.5;
+        x = (rand() / (double)RAND_MAX) - 0.5;
+        y = (rand() / (double)RAND_MAX) - 0.5;
+        z = (rand() / (double)RAND_MAX) - 0.5;
+        n = sqrt((w * w) + (x * x) + (y * y) + (z * z));
+        quat.real = (int16_t)lrint(w / n * 16384);
+        quat.i = (int16_t)lrint(x / n * 16384);
+        quat.j = (int16_t)lrint(y / n * 16384);
+        quat.k = (int16_t)lrint(z / n * 16384);
+        // Reference on the rounded quaternion, renormalized as the
+        // conversion takes it as unit length
+        n = sqrt(((double)quat.real * quat.real) + ((double)quat.i * quat.i) + 
+                 ((double)quat.j * quat.j) + ((double)quat.k * quat.k));
+        w = quat.real / n;
+        x = quat.i / n;
+        y = quat.j / n;
+        z = quat.k / n;
+        pitch = 2 * ((w * y) - (z * x));
+        if (pitch > 1){pitch = 1;}
+        if (pitch < -1){pitch = -1;}
+        pitch = asin(pitch);
+        BNO08X_quaternion_to_euler(&quat, &euler);
+        n = bin_diff(euler.pitch, to_bin(pitch));
+        if (n > worst){worst = n;}
+        if (fabs(pitch) > (85.0 * M_PI / 180.0))
+        {
+            continue;                                       // Roll and yaw are ill-conditioned
+        }
+        n = bin_diff(euler.roll, to_bin(atan2(2 * ((w * x) + (y * z)), 1 - 2 * ((x * x) + (y * y)))));
+        if (n > worst){worst = n;}
+        n = bin_diff(euler.yaw, to_bin(atan2(2 * ((w * z) + (x * y)), 1 - 2 * ((y * y) + (z * z)))));
+        if (n > worst){worst = n;}
+    }
+    TEST_CHECK_NEAR(worst, 0, BNO08X_ANGLE_DEG(1) / 10);
+}
+
+// Simulated hub : hub_cargo is the transfer waiting behind INTn. Every read
+// is a transfer of its own, a header with the length left, the continuation
+// bit once part of the cargo went out and the next sequence number of the
+// channel, then the cargo bytes, zeros past them. INTn is released once the
+// whole cargo was read. An empty one only asserts INTn, as the hub does
+// when WAKE asks for a SPI transfer
+static uint8_t hub_cargo[BNO08X_RX_BUF_LENGTH];
+static uint16_t hub_length, hub_sent;
+static uint8_t hub_channel, hub_seq[BNO08X_SENSOR_CHANNELS];
+static uint8_t hub_header[BNO08X_SHTP_HEADER_LENGTH], hub_pos;
+
+static void hub_begin (void)
+{
+    uint16_t left = hub_length - hub_sent;
+
+    memset(hub_header, 0, sizeof(hub_header));
+    if (left != 0)
+    {
+        hub_header[0] = (uint8_t)(left + BNO08X_SHTP_HEADER_LENGTH);
+        hub_header[1] = (uint8_t)((left + BNO08X_SHTP_HEADER_LENGTH) >> 8) | ((hub_sent != 0) << 7);
+        hub_header[2] = hub_channel;
+        hub_header[3] = hub_seq[hub_channel]++;
+    }
+    hub_pos = 0;
+}
+
+static uint8_t hub_next (void)
+{
+    if (hub_pos < BNO08X_SHTP_HEADER_LENGTH)
+    {
+        return hub_header[hub_pos++];
+    }
+    if ((hub_header[0] | hub_header[1]) && (hub_sent < hub_length))
+    {
+        return hub_cargo[hub_sent++];
+    }
+    return 0;
+}
+
+static void hub_end (void)
+{
+    if (hub_sent == hub_length)
+    {
+        hub_length = 0;
+        hub_sent = 0;
+        DSPEAK_MKB2_INT_RD = 1;
+    }
+}
+
+// Cargo ready : INTn falls, the edge interrupt fires at once
+static void hub_post (uint8_t channel, const uint8_t *cargo, uint16_t length)
+{
+    memcpy(hub_cargo, cargo, length);
+    hub_length = length;
+    hub_sent = 0;
+    hub_channel = channel;
+    DSPEAK_MKB2_INT_RD = 0;
+    IFS3bits.INT4IF = 1;
+    if (IEC3bits.INT4IE == 1)
+    {
+        _INT4Interrupt();
+    }
+}
+
+// Last SHTP transfer written by the host, and the number of writes
+static uint8_t hub_write[BNO08X_TX_CARGO_LENGTH];
+static uint16_t hub_write_length;
+static uint8_t hub_writes;
+static uint8_t hub_reading;
+
+static uint8_t hub_i2c_address (uint8_t rw)
+{
+    hub_reading = rw;
+    if (rw == 1)
+    {
+        hub_begin();
+    }
+    else
+    {
+        hub_write_length = 0;
+    }
+    return 0;
+}
+
+static uint8_t hub_i2c_write (uint8_t byte)
+{
+    if (hub_write_length < sizeof(hub_write))
+    {
+        hub_write[hub_write_length++] = byte;
+    }
+    return 0;
+}
+
+static void hub_i2c_stop (void)
+{
+    if (hub_reading == 1)
+    {
+        hub_end();
+    }
+    else
+    {
+        hub_writes++;
+    }
+}
+
+static STRUCT_SIM_I2C_DEVICE hub_i2c = {BNO08X_DEFAULT_ADDRESS, hub_i2c_address, hub_i2c_write, hub_next, hub_i2c_stop};
+
+// SPI is full-duplex : the host write of a transfer, zeros without one
+static void hub_spi_select (void)
+{
+    hub_begin();
+    hub_write_length = 0;
+}
+
+static uint8_t hub_spi_exchange (uint8_t byte)
+{
+    hub_i2c_write(byte);
+    return hub_next();
+}
+
+static void hub_spi_release (void)
+{
+    hub_end();
+    if ((hub_write_length >= BNO08X_SHTP_HEADER_LENGTH) && ((hub_write[0] | hub_write[1]) != 0))
+    {
+        hub_writes++;
+    }
+}
+
+static STRUCT_SIM_SPI_DEVICE hub_spi = {MIKROBUS2_CS, hub_spi_select, hub_spi_exchange, hub_spi_release};
+
+static void hub_run (STRUCT_BNO08X *b, uint32_t ticks)
+{
+    if (b->transport == BNO08X_TRANSPORT_SPI)
+    {
+        SIM_spi_run(ticks);
+    }
+    else
+    {
+        SIM_i2c_run(ticks);
+    }
+}
+
+// BNO08X_1 on MikroBus 2 over I2C_1 or SPI_4, past the reset interrupt,
+// reads started from INTn
+static STRUCT_BNO08X *hub_init (uint8_t transport)
+{
+    STRUCT_BNO08X *b = &BNO08X_struct[BNO08X_1];
+
+    HOST_timebase_freq = FCY;
+    HOST_timebase_now = 0;
+    DSPEAK_MKB2_INT_RD = 1;
+    hub_length = 0;
+    hub_writes = 0;
+    memset(hub_seq, 0, sizeof(hub_seq));
+    if (transport == BNO08X_TRANSPORT_SPI)
+    {
+        BNO08X_init_spi(b, &SPI_struct[SPI_4], BNO08X_MKB2);
+        SIM_spi_init(&hub_spi);
+    }
+    else
+    {
+        BNO08X_init(b, &i2c_struct[I2C_1], BNO08X_MKB2);
+        SIM_i2c_init(&hub_i2c, I2C_FREQ_400k);
+    }
+    b->has_reset = 1;
+    BNO08X_register_handler(b, BNO08X_REPORT_ANY, log_report);
+    BNO08X_irq_read_enable(b, 1);
+    report_qty = 0;
+    return b;
+}
+
+// Base timestamp and accelerometer report, 15 bytes of cargo
+static const uint8_t accel_cargo[] =
+{
+    BNO08X_REPORT_BASE_TIMESTAMP, 0, 0, 0, 0,
+    BNO08X_SENSOR_ID_ACCEL, 0, 0x03, 0, 0x00, 0x01, 0x80, 0xFF, 0x00, 0x02
+};
+
+// Nothing but INTn and the bus : the 1st report reads the header, then the
+// cargo, the next ones read the expected cargo at once. Reads of n bytes
+// take START, address, n bytes with their ACK and STOP
+static void test_irq_latency (void)
+{
+    STRUCT_BNO08X *b = hub_init(BNO08X_TRANSPORT_I2C);
+    uint32_t first = 1 + 9 + (4 * 9) + 1 + 1 + 9 + ((4 + sizeof(accel_cargo)) * 9) + 1;
+    uint32_t single = 1 + 9 + ((4 + sizeof(accel_cargo)) * 9) + 1;
+    uint32_t edge, stops;
+    uint8_t k;
+
+    hub_post(BNO08X_CHANNEL3_SNSREP, accel_cargo, sizeof(accel_cargo));
+    TEST_CHECK_EQ(BNO08X_report_ready(b), 0);
+    SIM_i2c_run(US(2000));
+    TEST_CHECK_EQ(BNO08X_report_ready(b), 1);
+    TEST_CHECK_EQ(report_qty, 1);
+    TEST_CHECK_EQ(report_log[0].id, BNO08X_SENSOR_ID_ACCEL);
+    TEST_CHECK_EQ(report_log[0].value[1], -128);
+    TEST_CHECK_EQ(b->latency, first * BIT_TICKS);
+    TEST_CHECK_EQ(DSPEAK_MKB2_INT_RD, 1);
+    printf("  INTn to report, header then cargo : %lu us\n", (unsigned long)BNO08X_get_latency(b));
+
+    for (k = 0; k < 4; k++)
+    {
+        HOST_timebase_now += US(1000) + 17;
+        hub_post(BNO08X_CHANNEL3_SNSREP, accel_cargo, sizeof(accel_cargo));
+        SIM_i2c_run(US(1000));
+        TEST_CHECK_EQ(BNO08X_report_ready(b), 1);
+        TEST_CHECK_EQ(b->latency, single * BIT_TICKS);
+    }
+    TEST_CHECK_EQ(report_qty, 5);
+    TEST_CHECK_EQ(BNO08X_get_error(b, BNO08X_ERROR_SEQUENCE), 0);
+    TEST_CHECK_EQ(BNO08X_get_error(b, BNO08X_ERROR_BUS), 0);
+    printf("  INTn to report, single read : %lu us at 400kHz\n", (unsigned long)BNO08X_get_latency(b));
+
+    // INTn asserted again during a read (no cargo behind it here) : read
+    // right after the one in progress, timed from the 2nd edge
+    HOST_timebase_now += US(1000);
+    hub_post(BNO08X_CHANNEL3_SNSREP, accel_cargo, sizeof(accel_cargo));
+    SIM_i2c_run(US(100));
+    edge = HOST_timebase_now;
+    stops = SIM_i2c_stops;
+    _INT4Interrupt();
+    TEST_CHECK_EQ(b->int_pending, 1);
+    SIM_i2c_run(US(1000));
+    TEST_CHECK_EQ(report_qty, 6);
+    TEST_CHECK_EQ(SIM_i2c_stops - stops, 2);
+    TEST_CHECK_EQ(b->int_time, edge);
+    TEST_CHECK_EQ(b->int_pending, 0);
+    TEST_CHECK_EQ(b->rx_state, BNO08X_RX_IDLE);
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+// Reads the same report stream in mode, returns the bus bytes of the
+// reports after the 1st one
+static uint32_t stream (STRUCT_BNO08X *b, uint8_t mode, uint8_t reports, uint32_t *transactions)
+{
+    uint32_t bytes = 0, t0 = 0, b0 = 0;
+    uint8_t k;
+
+    BNO08X_set_read_mode(b, mode);
+    for (k = 0; k < reports; k++)
+    {
+        if (k == 1)
+        {
+            t0 = BNO08X_get_rx_stat(b, BNO08X_RX_STAT_TRANSACTIONS);
+            b0 = BNO08X_get_rx_stat(b, BNO08X_RX_STAT_BYTES);
+            SIM_i2c_bytes = 0;
+        }
+        hub_post(BNO08X_CHANNEL3_SNSREP, accel_cargo, sizeof(accel_cargo));
+        SIM_i2c_run(US(1000));
+    }
+    *transactions = BNO08X_get_rx_stat(b, BNO08X_RX_STAT_TRANSACTIONS) - t0;
+    bytes = BNO08X_get_rx_stat(b, BNO08X_RX_STAT_BYTES) - b0;
+    TEST_CHECK_EQ(bytes, SIM_i2c_bytes);
+    return bytes;
+}
+
+// Bus cost of a report : header then cargo reads (before), single read of
+// the expected cargo (after). A longer cargo costs a follow-up read of the
+// rest, a shorter one the bytes read past it
+static void test_read_modes (void)
+{
+    uint8_t longer[sizeof(accel_cargo) + 10];
+    STRUCT_BNO08X *b;
+    uint32_t bytes, transactions;
+
+    b = hub_init(BNO08X_TRANSPORT_I2C);
+    bytes = stream(b, BNO08X_READ_HEADER_FIRST, 11, &transactions);
+    TEST_CHECK_EQ(transactions, 2 * 10);
+    TEST_CHECK_EQ(bytes, 10 * ((1 + 4) + (1 + 4 + sizeof(accel_cargo))));
+    TEST_CHECK_EQ(report_qty, 11);
+    printf("  header first : %lu transactions, %lu bytes per report\n", (unsigned long)(transactions / 10), (unsigned long)(bytes / 10));
+
+    b = hub_init(BNO08X_TRANSPORT_I2C);
+    bytes = stream(b, BNO08X_READ_SINGLE, 11, &transactions);
+    TEST_CHECK_EQ(transactions, 10);
+    TEST_CHECK_EQ(bytes, 10 * (1 + 4 + sizeof(accel_cargo)));
+    TEST_CHECK_EQ(report_qty, 11);
+    printf("  single read  : %lu transactions, %lu bytes per report\n", (unsigned long)(transactions / 10), (unsigned long)(bytes / 10));
+
+    // Accelerometer then gyroscope, 10 bytes past the expected cargo : the
+    // rest comes as a continuation with its own header
+    memcpy(longer, accel_cargo, sizeof(accel_cargo));
+    memcpy(&longer[sizeof(accel_cargo)], &accel_cargo[5], 10);
+    longer[sizeof(accel_cargo)] = BNO08X_SENSOR_ID_GYRO;
+    report_qty = 0;
+    SIM_i2c_bytes = 0;
+    hub_post(BNO08X_CHANNEL3_SNSREP, longer, sizeof(longer));
+    SIM_i2c_run(US(2000));
+    TEST_CHECK_EQ(report_qty, 2);
+    TEST_CHECK_EQ(report_log[0].id, BNO08X_SENSOR_ID_ACCEL);
+    TEST_CHECK_EQ(report_log[1].id, BNO08X_SENSOR_ID_GYRO);
+    TEST_CHECK_EQ(report_log[1].value[1], -128);
+    TEST_CHECK_EQ(SIM_i2c_bytes, (1 + 4 + sizeof(accel_cargo)) + (1 + 4 + 10));
+
+    // The next read expects the longer cargo, the short one is read in one
+    // go with 10 bytes past it
+    report_qty = 0;
+    SIM_i2c_bytes = 0;
+    hub_post(BNO08X_CHANNEL3_SNSREP, accel_cargo, sizeof(accel_cargo));
+    SIM_i2c_run(US(2000));
+    TEST_CHECK_EQ(report_qty, 1);
+    TEST_CHECK_EQ(SIM_i2c_bytes, 1 + 4 + sizeof(longer));
+    TEST_CHECK_EQ(BNO08X_get_error(b, BNO08X_ERROR_SEQUENCE), 0);
+    TEST_CHECK_EQ(BNO08X_get_error(b, BNO08X_ERROR_TRUNCATED), 0);
+    TEST_CHECK_EQ(b->rx_state, BNO08X_RX_IDLE);
+}
+
+// Five typical reports, one of each field in use
+static STRUCT_BNO08X_FEATURE features[5] =
+{
+    {BNO08X_SENSOR_ID_ACCEL, 0, 0, 10000, 0, 0},
+    {BNO08X_SENSOR_ID_GYRO, 0, 0, 2500, 20000, 0},
+    {BNO08X_SENSOR_ID_MAGNETO, BNO08X_FEATURE_FLAG_SENS_ENABLE | BNO08X_FEATURE_FLAG_SENS_RELATIVE, 0x0100, 50000, 0, 0},
+    {BNO08X_SENSOR_ID_GAME_ROT_VECT, 0, 0, 5000, 0, 0},
+    {BNO08X_SENSOR_ID_GYRO_ROT_VECT, BNO08X_FEATURE_FLAG_ALWAYS_ON, 0, 1000000, 0, 0x12345678}
+};
+
+// SH-2 reference manual 6.5.4 : report ID, feature report ID, flags,
+// change sensitivity, report interval, batch interval, sensor-specific
+// configuration, little endian
+static const uint8_t set_feature[5][BNO08X_SET_FEATURE_LENGTH] =
+{
+    {0xFD, 0x01, 0x00, 0x00, 0x00, 0x10, 0x27, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0xFD, 0x02, 0x00, 0x00, 0x00, 0xC4, 0x09, 0x00, 0x00, 0x20, 0x4E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0xFD, 0x03, 0x03, 0x00, 0x01, 0x50, 0xC3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0xFD, 0x08, 0x00, 0x00, 0x00, 0x88, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0xFD, 0x05, 0x08, 0x00, 0x00, 0x40, 0x42, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x56, 0x34, 0x12}
+};
+
+// Set feature commands of five reports packed in one write, checked byte
+// for byte, against one write per command. The get feature responses
+// confirm them. A write refused by a full I2C queue leaves the entries as
+// they were and the channel sequence without a hole
+static void test_set_features (void)
+{
+    STRUCT_I2C_TRANSACTION busy[I2C_QUEUE_SIZE + 2];
+    uint8_t response[5 * BNO08X_SET_FEATURE_LENGTH];
+    STRUCT_BNO08X *b = hub_init(BNO08X_TRANSPORT_I2C);
+    uint32_t packed;
+    uint8_t k, queued;
+
+    SIM_i2c_bytes = 0;
+    TEST_CHECK_EQ(BNO08X_set_features(b, features, 5), 1);
+    for (k = 0; k < 5; k++)
+    {
+        TEST_CHECK_EQ(BNO08X_get_feature_state(b, features[k].id), BNO08X_FEATURE_PENDING);
+    }
+    SIM_i2c_run(US(5000));
+    TEST_CHECK_EQ(hub_writes, 1);
+    TEST_CHECK_EQ(hub_write_length, 4 + (5 * BNO08X_SET_FEATURE_LENGTH));
+    TEST_CHECK_EQ(hub_write[0], 4 + (5 * BNO08X_SET_FEATURE_LENGTH));
+    TEST_CHECK_EQ(hub_write[1], 0);
+    TEST_CHECK_EQ(hub_write[2], BNO08X_CHANNEL2_SHCC);
+    TEST_CHECK_EQ(hub_write[3], 0);
+    TEST_CHECK_EQ(memcmp(&hub_write[4], set_feature, sizeof(set_feature)), 0);
+    TEST_CHECK_EQ(SIM_i2c_bytes, 1 + hub_write_length);
+    packed = SIM_i2c_bytes;
+
+    // One write per command, each waits for the cargo of the previous one
+    SIM_i2c_bytes = 0;
+    hub_writes = 0;
+    for (k = 0; k < 5; k++)
+    {
+        TEST_CHECK_EQ(BNO08X_write(b, BNO08X_CHANNEL2_SHCC, (uint8_t *)set_feature[k], BNO08X_SET_FEATURE_LENGTH), 1);
+        SIM_i2c_run(US(1000));                              // Cargo free again
+    }
+    TEST_CHECK_EQ(hub_writes, 5);
+    TEST_CHECK_EQ(SIM_i2c_bytes, 5 * (1 + 4 + BNO08X_SET_FEATURE_LENGTH));
+    TEST_CHECK_EQ(hub_write[3], 5);
+    printf("  5 reports : 1 write of %lu bytes packed, %u writes of %lu bytes one by one\n",
+           (unsigned long)packed, hub_writes, (unsigned long)(SIM_i2c_bytes / hub_writes));
+
+    // Get feature responses, the magnetometer gets a shorter interval
+    for (k = 0; k < 5; k++)
+    {
+        memcpy(&response[k * BNO08X_SET_FEATURE_LENGTH], set_feature[k], BNO08X_SET_FEATURE_LENGTH);
+        response[k * BNO08X_SET_FEATURE_LENGTH] = BNO08X_SHCC_GET_FEAT_RES;
+    }
+    response[(2 * BNO08X_SET_FEATURE_LENGTH) + 5] = 0x40;        // 40000us
+    response[(2 * BNO08X_SET_FEATURE_LENGTH) + 6] = 0x9C;
+    hub_post(BNO08X_CHANNEL2_SHCC, response, sizeof(response));
+    SIM_i2c_run(US(5000));
+    for (k = 0; k < 5; k++)
+    {
+        TEST_CHECK_EQ(BNO08X_get_feature_state(b, features[k].id), BNO08X_FEATURE_CONFIRMED);
+    }
+    TEST_CHECK_EQ(BNO08X_get_feature_interval(b, BNO08X_SENSOR_ID_GYRO), 2500);
+    TEST_CHECK_EQ(BNO08X_get_feature_interval(b, BNO08X_SENSOR_ID_MAGNETO), 40000);
+    TEST_CHECK_EQ(BNO08X_get_feature_interval(b, BNO08X_SENSOR_ID_GYRO_ROT_VECT), 1000000);
+
+    // I2C queue full : nothing is sent, the confirmed entry keeps its
+    // interval, the new one is not tracked
+    memset(busy, 0, sizeof(busy));
+    for (queued = 0; queued < (I2C_QUEUE_SIZE + 2); queued++)
+    {
+        busy[queued].type = I2C_TRANSACTION_WRITE;
+        busy[queued].address = 0x52;
+        if (I2C_queue_submit(&i2c_struct[I2C_1], &busy[queued]) == 0)
+        {
+            break;
+        }
+    }
+    TEST_CHECK(queued < (I2C_QUEUE_SIZE + 2));
+    features[0].interval_us = 20000;
+    features[1].id = BNO08X_SENSOR_ID_ACCEL_LIN;
+    TEST_CHECK_EQ(BNO08X_set_features(b, features, 2), 0);
+    TEST_CHECK_EQ(BNO08X_get_feature_state(b, BNO08X_SENSOR_ID_ACCEL), BNO08X_FEATURE_CONFIRMED);
+    TEST_CHECK_EQ(BNO08X_get_feature_interval(b, BNO08X_SENSOR_ID_ACCEL), 10000);
+    TEST_CHECK_EQ(BNO08X_get_feature_state(b, BNO08X_SENSOR_ID_ACCEL_LIN), BNO08X_FEATURE_NONE);
+
+    // Once the queue drained the same call goes through
+    hub_writes = 0;
+    SIM_i2c_run(US(5000));
+    TEST_CHECK_EQ(hub_writes, 0);
+    TEST_CHECK_EQ(BNO08X_set_features(b, features, 2), 1);
+    TEST_CHECK_EQ(BNO08X_get_feature_state(b, BNO08X_SENSOR_ID_ACCEL), BNO08X_FEATURE_PENDING);
+    TEST_CHECK_EQ(BNO08X_get_feature_state(b, BNO08X_SENSOR_ID_ACCEL_LIN), BNO08X_FEATURE_PENDING);
+    SIM_i2c_run(US(5000));
+    TEST_CHECK_EQ(hub_writes, 1);
+    TEST_CHECK_EQ(hub_write[3], 6);
+    features[0].interval_us = 10000;
+    features[1].id = BNO08X_SENSOR_ID_GYRO;
+
+    // More reports than tracked
+    TEST_CHECK_EQ(BNO08X_set_features(b, features, BNO08X_FEATURE_QTY + 1), 0);
+}
+
+// Report mix of every path : sensor cargos with timestamps, a cargo longer
+// than the expected one, the gyro-integrated channel, a get feature response
+static const uint8_t rv_cargo[] =
+{
+    BNO08X_REPORT_BASE_TIMESTAMP, 10, 0, 0, 0,
+    BNO08X_SENSOR_ID_GYRO_ROT_VECT, 1, 0x0B, 2, 0x00, 0x10, 0x00, 0xF0, 0x34, 0x12, 0xFF, 0x2C, 0x10, 0x00
+};
+static const uint8_t mix_cargo[] =
+{
+    BNO08X_REPORT_BASE_TIMESTAMP, 20, 0, 0, 0,
+    BNO08X_SENSOR_ID_ACCEL, 2, 0x03, 4, 0x00, 0x01, 0x80, 0xFF, 0x00, 0x02,
+    BNO08X_SENSOR_ID_GYRO, 3, 0x06, 5, 0x00, 0x02, 0x00, 0xFE, 0x01, 0x00,
+    BNO08X_SENSOR_ID_GAME_ROT_VECT, 4, 0x02, 6, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x08
+};
+static const uint8_t gyro_int_cargo[BNO08X_GYRO_INT_RV_LENGTH] =
+{
+    0x00, 0x00, 0x00, 0x00, 0x41, 0x2D, 0x41, 0x2D, 0x00, 0x04, 0x00, 0xFE, 0x00, 0x00
+};
+static const uint8_t feature_cargo[BNO08X_SET_FEATURE_LENGTH] =
+{
+    BNO08X_SHCC_GET_FEAT_RES, BNO08X_SENSOR_ID_ACCEL, 0, 0, 0, 0x10, 0x27, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+#define MIX_REPORTS     8
+
+// Posts the mix every 2ms, reports logged in report_log
+static void mix (STRUCT_BNO08X *b)
+{
+    HOST_timebase_now = US(2000);
+    hub_post(BNO08X_CHANNEL3_SNSREP, accel_cargo, sizeof(accel_cargo));
+    hub_run(b, US(1900));
+    HOST_timebase_now = US(4000);
+    hub_post(BNO08X_CHANNEL3_SNSREP, rv_cargo, sizeof(rv_cargo));
+    hub_run(b, US(1900));
+    HOST_timebase_now = US(6000);
+    hub_post(BNO08X_CHANNEL3_SNSREP, mix_cargo, sizeof(mix_cargo));
+    hub_run(b, US(1900));
+    HOST_timebase_now = US(8000);
+    hub_post(BNO08X_CHANNEL5_GYRVEC, gyro_int_cargo, sizeof(gyro_int_cargo));
+    hub_run(b, US(1900));
+    HOST_timebase_now = US(10000);
+    hub_post(BNO08X_CHANNEL2_SHCC, feature_cargo, sizeof(feature_cargo));
+    hub_run(b, US(1900));
+    HOST_timebase_now = US(12000);
+    hub_post(BNO08X_CHANNEL3_SNSREP, accel_cargo, sizeof(accel_cargo));
+    hub_run(b, US(1900));
+}
+
+// Bus time of one rotation vector report read in a single transfer, the
+// 1st one sets the expected cargo
+static uint32_t rv_latency (STRUCT_BNO08X *b)
+{
+    uint32_t bytes;
+
+    HOST_timebase_now += US(2000);
+    hub_post(BNO08X_CHANNEL3_SNSREP, rv_cargo, sizeof(rv_cargo));
+    hub_run(b, US(1900));
+    bytes = BNO08X_get_rx_stat(b, BNO08X_RX_STAT_BYTES);
+    HOST_timebase_now += US(2000);
+    hub_post(BNO08X_CHANNEL3_SNSREP, rv_cargo, sizeof(rv_cargo));
+    hub_run(b, US(1900));
+    TEST_CHECK_EQ(BNO08X_get_rx_stat(b, BNO08X_RX_STAT_BYTES) - bytes,
+                  (b->transport == BNO08X_TRANSPORT_I2C) + 4 + sizeof(rv_cargo));
+    return b->latency;
+}
+
+// The same hub cargos over I2C_1 and SPI_4 decode to the same reports, with
+// the same sample times. The SPI read of a report takes its bytes at
+// FCY / 24, no address, START or ACK. A set feature write goes out with
+// the INTn transfer WAKE asked for, framed as on I2C
+static void test_spi_transport (void)
+{
+    STRUCT_BNO08X_REPORT i2c_log[MIX_REPORTS];
+    uint8_t i2c_write[4 + (5 * BNO08X_SET_FEATURE_LENGTH)];
+    STRUCT_BNO08X *b;
+    uint32_t i2c_ticks, spi_ticks;
+    uint8_t k;
+
+    b = hub_init(BNO08X_TRANSPORT_I2C);
+    mix(b);
+    TEST_CHECK_EQ(report_qty, MIX_REPORTS);
+    memcpy(i2c_log, report_log, sizeof(i2c_log));
+    i2c_ticks = rv_latency(b);
+    TEST_CHECK_EQ(BNO08X_set_features(b, features, 5), 1);
+    SIM_i2c_run(US(5000));
+    memcpy(i2c_write, hub_write, sizeof(i2c_write));
+
+    b = hub_init(BNO08X_TRANSPORT_SPI);
+    mix(b);
+    TEST_CHECK_EQ(report_qty, MIX_REPORTS);
+    for (k = 0; k < MIX_REPORTS; k++)
+    {
+        TEST_CHECK_EQ(report_log[k].id, i2c_log[k].id);
+        TEST_CHECK_EQ(report_log[k].channel, i2c_log[k].channel);
+        TEST_CHECK_EQ(report_log[k].sequence, i2c_log[k].sequence);
+        TEST_CHECK_EQ(report_log[k].status, i2c_log[k].status);
+        TEST_CHECK_EQ(report_log[k].delay, i2c_log[k].delay);
+        TEST_CHECK_EQ(report_log[k].timestamp, i2c_log[k].timestamp);
+        TEST_CHECK_EQ(report_log[k].value_qty, i2c_log[k].value_qty);
+        TEST_CHECK_EQ(memcmp(report_log[k].value, i2c_log[k].value, report_log[k].value_qty * sizeof(int16_t)), 0);
+    }
+    TEST_CHECK_EQ(report_log[2].id, BNO08X_SENSOR_ID_ACCEL);
+    TEST_CHECK_EQ(report_log[4].id, BNO08X_SENSOR_ID_GAME_ROT_VECT);
+    TEST_CHECK_EQ(report_log[5].id, BNO08X_SENSOR_ID_GYRO_INT_RV);
+    TEST_CHECK_EQ(report_log[6].id, BNO08X_SHCC_GET_FEAT_RES);
+    TEST_CHECK_EQ(BNO08X_get_error(b, BNO08X_ERROR_SEQUENCE), 0);
+    TEST_CHECK_EQ(BNO08X_get_error(b, BNO08X_ERROR_BUS), 0);
+    spi_ticks = rv_latency(b);
+    TEST_CHECK_EQ(spi_ticks, (4 + sizeof(rv_cargo)) * 8 * 24 * (HOST_timebase_freq / FCY));
+    TEST_CHECK_EQ(i2c_ticks, (1 + 9 + ((4 + sizeof(rv_cargo)) * 9) + 1) * BIT_TICKS);
+    printf("  rotation vector report : I2C %lu us (%lu Hz max), SPI %lu us (%lu Hz max)\n",
+           (unsigned long)(i2c_ticks / US(1)), (unsigned long)(FCY / i2c_ticks),
+           (unsigned long)(spi_ticks / US(1)), (unsigned long)(FCY / spi_ticks));
+
+    // WAKE low, the hub asserts INTn, the write is clocked out with the read
+    hub_writes = 0;
+    TEST_CHECK_EQ(BNO08X_set_features(b, features, 5), 1);
+    TEST_CHECK_EQ(DSPEAK_MKB2_AIN1_WR, 0);
+    TEST_CHECK_EQ(b->tx_transaction.status, I2C_STATUS_PENDING);
+    hub_post(BNO08X_CHANNEL2_SHCC, 0, 0);
+    SIM_spi_run(US(1000));
+    TEST_CHECK_EQ(hub_writes, 1);
+    TEST_CHECK_EQ(memcmp(hub_write, i2c_write, sizeof(i2c_write)), 0);
+    TEST_CHECK_EQ(DSPEAK_MKB2_AIN1_WR, 1);
+    TEST_CHECK_EQ(b->tx_transaction.status, I2C_STATUS_DONE);
+    TEST_CHECK_EQ(DSPEAK_MKB2_INT_RD, 1);
+    TEST_CHECK_EQ(b->rx_state, BNO08X_RX_IDLE);
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+int main (void)
+{
+    HOST_timebase_freq = 1000000;           // 1 tick = 1us
+    test_sensor_cargo();
+    test_sequence_and_unknown();
+    test_fragments();
+    test_control_channels();
+    test_gyro_integrated();
+    test_euler();
+    test_irq_latency();
+    test_read_modes();
+    test_set_features();
+    test_spi_transport();
+    return TEST_end("test_bno08x");
+}
@@ -0,0 +1,300 @@
+//****************************************************************************//
+// File      :  test_can_fifo.c
+//
+// Includes  :  CAN.h, ecan_sim.h, test.h
+//
+// Purpose   :  Receive path of CAN.c on the ECAN model at 500kbps : the
+//              FIFO region of CAN_init(..., CAN_BUFFER_X32, 8) absorbs 24
+//              back-to-back frames while _C1Interrupt is held, the next one
+//              is lost and counted. A 1s flood at full bus load is received
+//              without loss by a reader polling every 5ms. Frames keep their
+//              order, identifiers, payload and filter hit. The message buffer
+//              and DMA layout of every CAN_BUFFER_Xn is checked against the
+//              ECAN addressing and the frames each one absorbs are reported
+//****************************************************************************//
+#include "CAN.h"
+#include "ecan_sim.h"
+#include "test.h"
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+extern STRUCT_CAN CAN_struct[CAN_QTY];
+extern uint16_t CAN_MSG_BUFFER[NUM_OF_CAN_BUFFERS][8];
+
+#define BUS_FREQ        500000UL
+#define TX_BUFFERS      8
+#define US(x)           ((uint32_t)(x) * (FCY / 1000000UL))
+
+static STRUCT_CAN *node = &CAN_struct[CAN_1];
+static uint16_t next_sid;
+
+static void node_init (void)
+{
+    C1CTRL1bits.OPMODE = CAN_MODE_CONFIG;
+    TEST_CHECK_EQ(CAN_init(node, CAN_1, BUS_FREQ, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX, CAN_BUFFER_X32, TX_BUFFERS), 1);
+    TEST_CHECK_EQ(C1FCTRLbits.FSA, TX_BUFFERS);
+    TEST_CHECK_EQ(C1FCTRLbits.DMABS, 6);
+    C1CTRL1bits.OPMODE = CAN_MODE_NORMAL;
+    CAN_set_mode(node, CAN_MODE_NORMAL);
+    SIM_ecan_init(node);
+    next_sid = 0x100;
+}
+
+// Frame n of a flood : 8 bytes, standard, one extended every 7th
+static void make_frame (STRUCT_CAN_FRAME *frame, uint16_t sid)
+{
+    uint8_t i;
+
+    memset(frame, 0, sizeof(*frame));
+    frame->SID = sid & 0x07FF;
+    frame->IDE = ((sid % 7) == 0);
+    frame->EID = frame->IDE ? ((uint32_t)sid * 37) & 0x3FFFF : 0;
+    frame->DLC = 8;
+    for (i = 0; i < 8; i++)
+    {
+        frame->payload[i] = (uint8_t)(sid + i);
+    }
+}
+
+// Next frame on the bus, back-to-back : returns 1 when the ECAN stored it
+static uint8_t bus_frame (void)
+{
+    STRUCT_CAN_FRAME frame;
+    uint8_t stored;
+
+    make_frame(&frame, next_sid);
+    HOST_timebase_now += SIM_ecan_frame_ticks(&frame);
+    stored = SIM_ecan_receive(&frame, next_sid % CAN_FILTER_QTY);
+    next_sid++;
+    return stored;
+}
+
+// Reads the software FIFO, frames must follow sid on
+static uint16_t read_all (uint16_t *sid)
+{
+    STRUCT_CAN_FRAME frame, expected;
+    uint16_t n = 0;
+
+    while (CAN_rx_fifo_read(node, &frame) == 1)
+    {
+        make_frame(&expected, *sid);
+        TEST_CHECK_EQ(frame.SID, expected.SID);
+        TEST_CHECK_EQ(frame.IDE, expected.IDE);
+        TEST_CHECK_EQ(frame.EID, expected.EID);
+        TEST_CHECK_EQ(frame.DLC, 8);
+        TEST_CHECK_EQ(frame.filter_hit, *sid % CAN_FILTER_QTY);
+        TEST_CHECK_EQ(memcmp(frame.payload, expected.payload, 8), 0);
+        (*sid)++;
+        n++;
+    }
+    return n;
+}
+
+// Burst while the ISR is held by IPL 7 : the hardware FIFO is the only buffer
+static void test_held_burst (void)
+{
+    uint16_t depth, k, sid;
+    uint32_t t0;
+
+    node_init();
+    depth = CAN_get_hw_fifo_depth(node);
+    TEST_CHECK_EQ(depth, CAN_BUFFER_X32 - TX_BUFFERS);
+    TEST_CHECK(depth < CAN_RX_FIFO_SIZE);
+
+    sid = next_sid;
+    t0 = HOST_timebase_now;
+    HOST_cpu_ipl = 7;
+    for (k = 0; k < depth; k++)
+    {
+        TEST_CHECK_EQ(bus_frame(), 1);
+    }
+    TEST_CHECK_EQ(CAN_rx_fifo_get_count(node), 0);
+    printf("  %u buffers absorb %lu us of back-to-back 8-byte frames at %lukbps\n", depth,
+           (unsigned long)((HOST_timebase_now - t0) / (FCY / 1000000UL)), (unsigned long)(BUS_FREQ / 1000));
+    HOST_cpu_ipl = 0;
+    SIM_ecan_irq();
+    TEST_CHECK_EQ(CAN_rx_fifo_get_count(node), depth);
+    TEST_CHECK_EQ(CAN_rx_fifo_get_max_level(node), depth);
+    TEST_CHECK_EQ(CAN_get_rx_overflow(node, CAN_RX_OVERFLOW_HW), 0);
+    TEST_CHECK_EQ(CAN_get_rx_overflow(node, CAN_RX_OVERFLOW_FIFO), 0);
+    TEST_CHECK_EQ(read_all(&sid), depth);
+
+    // One more than the depth : the newest frame is lost and counted
+    sid = next_sid;
+    HOST_cpu_ipl = 7;
+    for (k = 0; k < depth; k++)
+    {
+        TEST_CHECK_EQ(bus_frame(), 1);
+    }
+    TEST_CHECK_EQ(bus_frame(), 0);
+    TEST_CHECK_EQ(SIM_ecan_rx_lost, 1);
+    HOST_cpu_ipl = 0;
+    SIM_ecan_irq();
+    TEST_CHECK_EQ(CAN_get_rx_overflow(node, CAN_RX_OVERFLOW_HW), 1);
+    TEST_CHECK_EQ(CAN_get_rx_overflow(node, CAN_RX_OVERFLOW_FIFO), 0);
+    TEST_CHECK_EQ(C1RXOVF1, 0);
+    TEST_CHECK_EQ(C1RXOVF2, 0);
+    TEST_CHECK_EQ(read_all(&sid), depth);
+    TEST_CHECK_EQ(C1INTFbits.RBOVIF, 0);
+    TEST_CHECK_EQ(IFS2bits.C1IF, 0);
+
+    // Receive goes on after the loss
+    sid = next_sid;
+    TEST_CHECK_EQ(bus_frame(), 1);
+    TEST_CHECK_EQ(read_all(&sid), 1);
+}
+
+// 1s of back-to-back frames, IPL 7 sections of up to 2ms in the main code,
+// the reader polls every 5ms
+static void test_flood (void)
+{
+    uint32_t start, next_read, hold_end = 0;
+    uint32_t received = 0;
+    uint16_t sid;
+
+    node_init();
+    CAN_clear_rx_overflow(node);
+    sid = next_sid;
+    start = HOST_timebase_now;
+    next_read = start + US(5000);
+    while ((HOST_timebase_now - start) < FCY)
+    {
+        if ((HOST_cpu_ipl == 0) && ((next_sid % 40) == 0))
+        {
+            HOST_cpu_ipl = 7;
+            hold_end = HOST_timebase_now + US(2000);
+        }
+        bus_frame();
+        if ((HOST_cpu_ipl == 7) && ((int32_t)(HOST_timebase_now - hold_end) >= 0))
+        {
+            HOST_cpu_ipl = 0;
+            SIM_ecan_irq();
+        }
+        if ((int32_t)(HOST_timebase_now - next_read) >= 0)
+        {
+            received += read_all(&sid);
+            next_read += US(5000);
+        }
+    }
+    HOST_cpu_ipl = 0;
+    SIM_ecan_irq();
+    received += read_all(&sid);
+
+    printf("  1s flood : %lu frames, software FIFO peak %u, lost %u\n", (unsigned long)received,
+           CAN_rx_fifo_get_max_level(node), SIM_ecan_rx_lost);
+    TEST_CHECK_EQ(received, (uint32_t)(uint16_t)(next_sid - 0x100));
+    TEST_CHECK(received > 4000);
+    TEST_CHECK_EQ(SIM_ecan_rx_lost, 0);
+    TEST_CHECK_EQ(CAN_get_rx_overflow(node, CAN_RX_OVERFLOW_HW), 0);
+    TEST_CHECK_EQ(CAN_get_rx_overflow(node, CAN_RX_OVERFLOW_FIFO), 0);
+    TEST_CHECK(CAN_rx_fifo_get_max_level(node) < CAN_RX_FIFO_SIZE);
+}
+
+// Peripheral indirect addressing : the ECAN puts the buffer number in the
+// low address bits, buffer n is 8 words from DMAxSTA
+static void test_layout (void)
+{
+    static const uint8_t qty[7] = {CAN_BUFFER_X4, CAN_BUFFER_X6, CAN_BUFFER_X8, CAN_BUFFER_X12,
+                                   CAN_BUFFER_X16, CAN_BUFFER_X24, CAN_BUFFER_X32};
+    STRUCT_CAN_FRAME frame;
+    STRUCT_CAN_MSG msg;
+    uint16_t depth, k, sid;
+    uint8_t i, tx;
+
+    TEST_CHECK_EQ(((uintptr_t)CAN_MSG_BUFFER) % (NUM_OF_CAN_BUFFERS * 16), 0);
+    for (k = 0; k < NUM_OF_CAN_BUFFERS; k++)
+    {
+        TEST_CHECK_EQ((uintptr_t)&CAN_MSG_BUFFER[k][0] - (uintptr_t)CAN_MSG_BUFFER, k * 16);
+    }
+
+    printf("  %-8s %4s %6s %12s %12s\n", "buffers", "tx", "fifo", "8-byte us", "0-byte us");
+    for (i = 0; i < 7; i++)
+    {
+        tx = (qty[i] > 8) ? 8 : qty[i] / 2;
+        C1CTRL1bits.OPMODE = CAN_MODE_CONFIG;
+        TEST_CHECK_EQ(CAN_init(node, CAN_1, BUS_FREQ, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX, qty[i], tx), 1);
+        TEST_CHECK_EQ(C1FCTRLbits.DMABS, i);
+        TEST_CHECK_EQ(C1FCTRLbits.FSA, tx);
+        TEST_CHECK_EQ(C1BUFPNT1, 0xFFFF);
+        TEST_CHECK_EQ(C1BUFPNT4, 0xFFFF);
+        TEST_CHECK_EQ(C1TR01CONbits.TXEN0, 1);
+        TEST_CHECK_EQ(C1TR67CONbits.TXEN7, (tx == 8));
+        TEST_CHECK_EQ(C1TR23CONbits.TXEN2, (tx > 2));
+
+        // Transmit DMA : RAM to C1TXD, receive DMA : C1RXD to RAM, 8 words per buffer
+        TEST_CHECK_EQ(DMA2STAL, __builtin_dmaoffset(CAN_MSG_BUFFER));
+        TEST_CHECK_EQ(DMA3STAL, __builtin_dmaoffset(CAN_MSG_BUFFER));
+        TEST_CHECK_EQ(DMA2PAD, (uint16_t)(uintptr_t)&C1TXD);
+        TEST_CHECK_EQ(DMA3PAD, (uint16_t)(uintptr_t)&C1RXD);
+        TEST_CHECK_EQ(DMA2REQ, DMAREQ_ECAN1TX);
+        TEST_CHECK_EQ(DMA3REQ, DMAREQ_ECAN1RX);
+        TEST_CHECK_EQ(DMA2CON, DMA_SIZE_WORD | DMA_TXFER_WR_PER | DMA_AMODE_PIA | DMA_CHMODE_CPPD);
+        TEST_CHECK_EQ(DMA3CON, DMA_SIZE_WORD | DMA_TXFER_RD_PER | DMA_AMODE_PIA | DMA_CHMODE_CPPD);
+        TEST_CHECK_EQ(DMA2CNT, 7);
+        TEST_CHECK_EQ(DMA3CNT, 7);
+
+        // Frames absorbed while the ISR is held, stored from FSA on
+        C1CTRL1bits.OPMODE = CAN_MODE_NORMAL;
+        CAN_set_mode(node, CAN_MODE_NORMAL);
+        SIM_ecan_init(node);
+        memset(CAN_MSG_BUFFER, 0, sizeof(CAN_MSG_BUFFER));
+        depth = CAN_get_hw_fifo_depth(node);
+        TEST_CHECK_EQ(depth, qty[i] - tx);
+        HOST_cpu_ipl = 7;
+        next_sid = 0x100;
+        for (k = 0; k < depth; k++)
+        {
+            TEST_CHECK_EQ(bus_frame(), 1);
+            TEST_CHECK_EQ(CAN_MSG_BUFFER[tx + k][0] >> 2, 0x100 + k);
+        }
+        for (k = 0; k < tx; k++)
+        {
+            TEST_CHECK_EQ(CAN_MSG_BUFFER[k][0], 0);     // Transmit buffers untouched
+        }
+        TEST_CHECK_EQ(bus_frame(), 0);
+        HOST_cpu_ipl = 0;
+        SIM_ecan_irq();
+        sid = 0x100;
+        TEST_CHECK_EQ(read_all(&sid), depth);
+        TEST_CHECK_EQ(CAN_get_rx_overflow(node, CAN_RX_OVERFLOW_HW), 1);
+
+        make_frame(&frame, 0x100);
+        frame.IDE = 0;
+        printf("  %-8u %4u %6u %12lu %12lu\n", qty[i], tx, depth,
+               (unsigned long)((depth * SIM_ecan_frame_ticks(&frame)) / (FCY / 1000000UL)),
+               (unsigned long)((depth * (47 * (FCY / BUS_FREQ))) / (FCY / 1000000UL)));
+    }
+
+    // Invalid layouts
+    C1CTRL1bits.OPMODE = CAN_MODE_CONFIG;
+    TEST_CHECK_EQ(CAN_init(node, CAN_1, BUS_FREQ, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX, CAN_BUFFER_X8, 8), 0);
+    TEST_CHECK_EQ(CAN_init(node, CAN_1, BUS_FREQ, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX, CAN_BUFFER_X32, 9), 0);
+    TEST_CHECK_EQ(CAN_init(node, CAN_1, BUS_FREQ, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX, CAN_BUFFER_X32, 0), 0);
+    TEST_CHECK_EQ(CAN_init(node, CAN_1, BUS_FREQ, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX, 10, 4), 0);
+
+    // Mask selection keeps the filter on the FIFO, dedicated buffers are not supported
+    msg.node_type = CAN_NODE_TYPE_TX_RX;
+    msg.rx_msg_channel = 1;
+    C1FMSKSEL1 = 0;
+    C1FMSKSEL2 = 0;
+    TEST_CHECK_EQ(CAN_set_rx_filter_sid(&msg, 3, 0x123), 1);
+    TEST_CHECK_EQ(CAN_assign_rx_mask(&msg, 2), 1);
+    TEST_CHECK_EQ(C1FMSKSEL1, 2 << 6);
+    TEST_CHECK_EQ(CAN_set_rx_filter_sid(&msg, 9, 0x321), 1);
+    TEST_CHECK_EQ(CAN_assign_rx_mask(&msg, 1), 1);
+    TEST_CHECK_EQ(C1FMSKSEL2, 1 << 2);
+    TEST_CHECK_EQ(CAN_assign_rx_mask(&msg, 3), 0);
+    TEST_CHECK_EQ(C1BUFPNT1, 0xFFFF);
+    TEST_CHECK_EQ(C1BUFPNT3, 0xFFFF);
+    TEST_CHECK(CAN_receive_msg(&msg) == 0);
+    TEST_CHECK_EQ(C1CTRL1bits.WIN, 0);
+}
+
+int main (void)
+{
+    HOST_timebase_freq = FCY;
+    HOST_timebase_now = 0xFFFFFFFFUL - US(100000);      // Wraps during the tests
+    test_held_burst();
+    test_flood();
+    test_layout();
+    return TEST_end("test_can_fifo");
+}
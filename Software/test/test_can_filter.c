@@ -0,0 +1,171 @@
+//****************************************************************************//
+// File      :  test_can_filter.c
+//
+// Includes  :  CAN.h, test.h
+//
+// Purpose   :  CAN_filter_table_build. Each table is checked against the
+//              ECAN acceptance rule for every standard identifier : wanted
+//              identifiers always pass and the unwanted ones that pass stay
+//              within false_accept. CAN_filter_table_apply writes the
+//              consecutive filter registers of the device SFR map and is not
+//              run on the host
+//****************************************************************************//
+#include "CAN.h"
+#include "test.h"
+
+#define SID_QTY     2048
+
+// ECAN acceptance : (id ^ filter) & mask == 0 on the bits of the frame type
+static uint8_t accepts (STRUCT_CAN_FILTER_TABLE *table, uint32_t id, uint8_t ide)
+{
+    uint32_t bits = (ide == 1) ? 0x1FFFFFFFUL : (0x07FFUL << 18);
+    uint8_t i;
+
+    for (i = 0; i < table->filter_qty; i++)
+    {
+        if ((table->filter_ide[i] == ide) &&
+            ((((id ^ table->filter[i]) & table->mask[table->filter_mask[i]]) & bits) == 0))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Standard identifiers accepted by the table
+static uint16_t accepted_sid (STRUCT_CAN_FILTER_TABLE *table)
+{
+    uint16_t sid, qty = 0;
+    for (sid = 0; sid < SID_QTY; sid++)
+    {
+        qty += accepts(table, (uint32_t)sid << 18, 0);
+    }
+    return qty;
+}
+
+static void check_table (STRUCT_CAN_FILTER_TABLE *table, const uint32_t *id, uint8_t id_qty, uint8_t unique_sid)
+{
+    uint8_t i;
+
+    TEST_CHECK(table->filter_qty <= CAN_FILTER_QTY);
+    for (i = 0; i < table->filter_qty; i++)
+    {
+        TEST_CHECK(table->filter_mask[i] < CAN_MASK_QTY);
+    }
+    for (i = 0; i < id_qty; i++)
+    {
+        if (id[i] & CAN_ID_EXTENDED)
+        {
+            TEST_CHECK(accepts(table, id[i] & 0x1FFFFFFFUL, 1));
+        }
+        else
+        {
+            TEST_CHECK(accepts(table, id[i] << 18, 0));
+        }
+    }
+    TEST_CHECK(accepted_sid(table) - unique_sid <= table->false_accept);
+}
+
+static void test_invalid (void)
+{
+    STRUCT_CAN_FILTER_TABLE table;
+    uint32_t id[CAN_FILTER_TABLE_MAX_ID + 1] = {0};
+
+    TEST_CHECK_EQ(CAN_filter_table_build(&table, id, 0), 0);
+    TEST_CHECK_EQ(CAN_filter_table_build(&table, id, CAN_FILTER_TABLE_MAX_ID + 1), 0);
+}
+
+static void test_exact (void)
+{
+    STRUCT_CAN_FILTER_TABLE table;
+    const uint32_t id[12] = {0x7E0, 0x7E8, 0x100, 0x123, 0x000, 0x7FF, 0x555, 0x2AA, 0x100, 0x7E8, 0x321, 0x456};
+    uint8_t i;
+
+    // 10 distinct identifiers, duplicates share a filter
+    TEST_CHECK_EQ(CAN_filter_table_build(&table, id, 12), 1);
+    TEST_CHECK_EQ(table.filter_qty, 10);
+    TEST_CHECK_EQ(table.false_accept, 0);
+    for (i = 0; i < CAN_MASK_QTY; i++)
+    {
+        TEST_CHECK_EQ(table.mask[i], 0x1FFFFFFFUL);
+    }
+    check_table(&table, id, 12, 10);
+    TEST_CHECK_EQ(accepted_sid(&table), 10);
+    TEST_CHECK(!accepts(&table, 0x7E1UL << 18, 0));
+    TEST_CHECK(!accepts(&table, 0x7E0UL << 18, 1));     // Extended frame with the same SID
+}
+
+static void test_merge (void)
+{
+    STRUCT_CAN_FILTER_TABLE table;
+    uint32_t id[CAN_FILTER_TABLE_MAX_ID];
+    uint8_t i;
+
+    // 32 aligned consecutive identifiers merge without letting another one
+    // through. Filters overlap after the mask merge, false_accept counts
+    // them twice and is only an upper bound
+    for (i = 0; i < 32; i++)
+    {
+        id[i] = 0x200 + i;
+    }
+    TEST_CHECK_EQ(CAN_filter_table_build(&table, id, 32), 1);
+    check_table(&table, id, 32, 32);
+    TEST_CHECK_EQ(accepted_sid(&table), 32);
+
+    // 17 scattered identifiers : 1 merge, unwanted identifiers are counted
+    for (i = 0; i < 17; i++)
+    {
+        id[i] = (uint32_t)((i * 0x79) + 3) & 0x7FF;
+    }
+    TEST_CHECK_EQ(CAN_filter_table_build(&table, id, 17), 1);
+    TEST_CHECK_EQ(table.filter_qty, CAN_FILTER_QTY);
+    TEST_CHECK(table.false_accept > 0);
+    check_table(&table, id, 17, 17);
+    TEST_CHECK_EQ(accepted_sid(&table) - 17, table.false_accept);
+
+    // 32 scattered identifiers, filters and masks both merged
+    for (i = 0; i < 32; i++)
+    {
+        id[i] = (uint32_t)((i * 0x3B5) ^ (i << 7)) & 0x7FF;
+    }
+    TEST_CHECK_EQ(CAN_filter_table_build(&table, id, 32), 1);
+    check_table(&table, id, 32, 32);
+    TEST_CHECK(accepted_sid(&table) < SID_QTY);
+}
+
+static void test_extended (void)
+{
+    STRUCT_CAN_FILTER_TABLE table;
+    uint32_t id[20];
+    uint8_t i;
+
+    // 4 standard and 16 extended identifiers
+    for (i = 0; i < 4; i++)
+    {
+        id[i] = 0x100 + (i * 0x40);
+    }
+    for (i = 0; i < 16; i++)
+    {
+        id[4 + i] = CAN_EXT_ID(0x18F, 0x0F000 + i);
+    }
+    TEST_CHECK_EQ(CAN_filter_table_build(&table, id, 20), 1);
+    check_table(&table, id, 20, 4);
+    for (i = 0; i < table.filter_qty; i++)
+    {
+        if (table.filter_ide[i] == 1)
+        {
+            TEST_CHECK(table.filter[i] >> 18 == 0x18F);
+        }
+    }
+    TEST_CHECK(!accepts(&table, 0x18FUL << 18, 0));     // Standard frame with the SID of the extended IDs
+    TEST_CHECK(!accepts(&table, (0x18FUL << 18) | 0x1F000, 1));
+}
+
+int main (void)
+{
+    test_invalid();
+    test_exact();
+    test_merge();
+    test_extended();
+    return TEST_end("test_can_filter");
+}
@@ -0,0 +1,262 @@
+//****************************************************************************//
+// File      :  test_can_stat.c
+//
+// Includes  :  CAN.h, ecan_sim.h, test.h
+//
+// Purpose   :  CAN_stat_update on the ECAN model at 500kbps. Frames of
+//              every length, standard and extended, data and remote, are
+//              received through the filters and sent through the transmit
+//              queue for 1s windows. The node traffic load must match the
+//              nominal bit count of the same traffic computed here, the
+//              frame rates and filter rates the frames generated. The error
+//              state counters and history follow the C1INTF flags
+//****************************************************************************//
+#include "CAN.h"
+#include "ecan_sim.h"
+#include "test.h"
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+extern STRUCT_CAN CAN_struct[CAN_QTY];
+
+#define BUS_FREQ        500000UL
+#define TX_BUFFERS      8
+#define US(x)           ((uint32_t)(x) * (FCY / 1000000UL))
+#define STEP_US         50
+
+typedef struct
+{
+    uint32_t period_us;
+    uint32_t phase_us;
+    uint8_t ide;
+    uint8_t rtr;
+    uint8_t dlc;
+    uint8_t filter;                     // Filter hit, 0xFF : transmitted frame
+}STRUCT_TRAFFIC;
+
+static STRUCT_CAN *node = &CAN_struct[CAN_1];
+static uint64_t bits_sent;
+static uint32_t rx_count, tx_count;
+static uint32_t filter_count[CAN_FILTER_QTY];
+
+static void node_init (void)
+{
+    C1CTRL1bits.OPMODE = CAN_MODE_CONFIG;
+    TEST_CHECK_EQ(CAN_init(node, CAN_1, BUS_FREQ, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX, CAN_BUFFER_X32, TX_BUFFERS), 1);
+    C1CTRL1bits.OPMODE = CAN_MODE_NORMAL;
+    CAN_set_mode(node, CAN_MODE_NORMAL);
+    SIM_ecan_init(node);
+    CAN_stat_reset(node);
+}
+
+// Nominal bits of the frame, computed here from the CAN 2.0 field lengths :
+// SOF 1, arbitration 12 (standard) / 32 (extended), control 6, data,
+// CRC 16, ACK 2, EOF 7, interframe space 3
+static uint32_t frame_bits (uint8_t ide, uint8_t rtr, uint8_t dlc)
+{
+    uint32_t data = rtr ? 0 : 8UL * ((dlc > 8) ? 8 : dlc);
+    return 1 + (ide ? 32 : 12) + 6 + data + 16 + 2 + 7 + 3;
+}
+
+static void make_frame (STRUCT_CAN_FRAME *frame, const STRUCT_TRAFFIC *t, uint32_t n)
+{
+    uint8_t i;
+
+    memset(frame, 0, sizeof(*frame));
+    frame->SID = (0x100 + n) & 0x07FF;
+    frame->IDE = t->ide;
+    frame->EID = t->ide ? (n & 0x3FFFF) : 0;
+    frame->RTR = t->rtr;
+    frame->DLC = t->dlc;
+    for (i = 0; i < 8; i++)
+    {
+        frame->payload[i] = (uint8_t)(n + i);
+    }
+}
+
+// Runs the traffic for one window, the reader empties the receive FIFO
+// every step as a 20kHz task would
+static void run_window (const STRUCT_TRAFFIC *traffic, uint8_t qty, uint32_t window_us)
+{
+    STRUCT_CAN_FRAME frame;
+    uint32_t t, n = 0;
+    uint8_t k;
+
+    for (t = 0; t < window_us; t += STEP_US)
+    {
+        for (k = 0; k < qty; k++)
+        {
+            if ((t % traffic[k].period_us) != traffic[k].phase_us){continue;}
+            make_frame(&frame, &traffic[k], n++);
+            if (traffic[k].filter == 0xFF)
+            {
+                TEST_CHECK_EQ(CAN_tx_queue_push(node, &frame, 1), 1);
+                tx_count++;
+            }
+            else
+            {
+                TEST_CHECK_EQ(SIM_ecan_receive(&frame, traffic[k].filter), 1);
+                filter_count[traffic[k].filter]++;
+                rx_count++;
+            }
+            bits_sent += frame_bits(frame.IDE, frame.RTR, frame.DLC);
+        }
+        SIM_ecan_run(US(STEP_US));
+        while (CAN_rx_fifo_read(node, &frame) == 1){}
+    }
+}
+
+static void window_reset (void)
+{
+    uint8_t k;
+
+    bits_sent = 0;
+    rx_count = 0;
+    tx_count = 0;
+    for (k = 0; k < CAN_FILTER_QTY; k++)
+    {
+        filter_count[k] = 0;
+    }
+}
+
+// Expected load in permille, the truncation of CAN_stat_update
+static uint16_t analytic_load (uint32_t window_us)
+{
+    uint64_t load = (bits_sent * 1000000ULL * 1000ULL) / ((uint64_t)BUS_FREQ * window_us);
+    return (load > 1000) ? 1000 : (uint16_t)load;
+}
+
+static void check_window (const char *name, uint32_t window_us)
+{
+    uint16_t load;
+    uint8_t k;
+
+    TEST_CHECK_EQ(CAN_stat_update(node), 1);
+    load = analytic_load(window_us);
+    printf("  %-10s load %4u permille, analytic %4u, rx %5u fps, tx %5u fps\n", name,
+           CAN_stat_get(node, CAN_STAT_LOAD_LAST), load, CAN_stat_get(node, CAN_STAT_RX_FPS), CAN_stat_get(node, CAN_STAT_TX_FPS));
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_LOAD_LAST), load);
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_RX_FPS), (uint16_t)(((uint64_t)rx_count * 1000000ULL) / window_us));
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_TX_FPS), (uint16_t)(((uint64_t)tx_count * 1000000ULL) / window_us));
+    for (k = 0; k < CAN_FILTER_QTY; k++)
+    {
+        TEST_CHECK_EQ(CAN_stat_get_filter_fps(node, k), (uint16_t)(((uint64_t)filter_count[k] * 1000000ULL) / window_us));
+    }
+    TEST_CHECK_EQ(CAN_tx_queue_get_overflow(node), 0);
+    TEST_CHECK_EQ(CAN_get_rx_overflow(node, CAN_RX_OVERFLOW_FIFO), 0);
+    TEST_CHECK_EQ(CAN_get_rx_overflow(node, CAN_RX_OVERFLOW_HW), 0);
+    TEST_CHECK_EQ(SIM_ecan_rx_lost, 0);
+}
+
+static void test_load (void)
+{
+    // Light : control and status traffic, every frame format
+    static const STRUCT_TRAFFIC light[] =
+    {
+        {1000,    0, 0, 0, 8,    0},
+        {2000,  100, 0, 0, 2,    3},
+        {5000,  250, 1, 0, 8,    5},
+        {10000, 400, 0, 1, 8,    7},            // Remote frame, DLC 8 but no data field
+        {10000, 600, 1, 1, 0,    9},
+        {1000,  500, 0, 0, 4, 0xFF},
+        {5000,  800, 1, 0, 6, 0xFF},
+    };
+    // Heavy : the same plus a bulk stream in both directions, about 90%
+    static const STRUCT_TRAFFIC heavy[] =
+    {
+        {1000,    0, 0, 0, 8,    0},
+        {2000,  100, 0, 0, 2,    3},
+        {5000,  250, 1, 0, 8,    5},
+        {10000, 400, 0, 1, 8,    7},
+        {10000, 600, 1, 1, 0,    9},
+        {1000,  500, 0, 0, 4, 0xFF},
+        {5000,  800, 1, 0, 6, 0xFF},
+        {1000,  150, 0, 0, 8,   12},
+        {4000,  350, 1, 0, 8,   15},
+        {5000,   50, 0, 0, 8, 0xFF},
+    };
+    uint16_t avg;
+
+    node_init();
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_LOAD_LAST), 0);
+
+    window_reset();
+    run_window(light, sizeof(light) / sizeof(light[0]), 1000000UL);
+    check_window("light", 1000000UL);
+    avg = CAN_stat_get(node, CAN_STAT_LOAD_LAST) >> 3;
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_LOAD_AVG), avg);
+
+    window_reset();
+    run_window(heavy, sizeof(heavy) / sizeof(heavy[0]), 1000000UL);
+    check_window("heavy", 1000000UL);
+    avg = ((avg * 7) + CAN_stat_get(node, CAN_STAT_LOAD_LAST)) >> 3;
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_LOAD_AVG), avg);
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_LOAD_MAX), CAN_stat_get(node, CAN_STAT_LOAD_LAST));
+    TEST_CHECK(CAN_stat_get(node, CAN_STAT_LOAD_LAST) > 800);
+    TEST_CHECK(CAN_stat_get(node, CAN_STAT_LOAD_LAST) < 1000);
+
+    // Shorter window, the rates scale with it
+    window_reset();
+    run_window(light, sizeof(light) / sizeof(light[0]), 200000UL);
+    check_window("light 200ms", 200000UL);
+    TEST_CHECK(CAN_stat_get(node, CAN_STAT_LOAD_MAX) > CAN_stat_get(node, CAN_STAT_LOAD_LAST));
+
+    // No traffic
+    window_reset();
+    SIM_ecan_run(US(100000));
+    check_window("idle", 100000UL);
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_LOAD_LAST), 0);
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_RX_FPS), 0);
+}
+
+static void test_error_state (void)
+{
+    STRUCT_CAN_ERR_EVENT event;
+
+    node_init();
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_STATE), CAN_STATE_ACTIVE);
+    TEST_CHECK_EQ(CAN_stat_get_error_event(node, 0, &event), 0);
+
+    C1ECbits.TERRCNT = 100;
+    C1INTFbits.EWARN = 1;
+    SIM_ecan_run(US(1000));
+    CAN_stat_update(node);
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_STATE), CAN_STATE_WARNING);
+    C1ECbits.TERRCNT = 200;
+    C1INTFbits.TXBP = 1;
+    SIM_ecan_run(US(1000));
+    CAN_stat_update(node);
+    C1INTFbits.TXBO = 1;
+    SIM_ecan_run(US(1000));
+    CAN_stat_update(node);
+    CAN_stat_update(node);                  // No transition, no event
+    C1ECbits.TERRCNT = 0;
+    C1INTFbits.EWARN = 0;
+    C1INTFbits.TXBP = 0;
+    C1INTFbits.TXBO = 0;
+    SIM_ecan_run(US(1000));
+    CAN_stat_update(node);
+
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_STATE), CAN_STATE_ACTIVE);
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_WARNING_CNT), 1);
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_PASSIVE_CNT), 1);
+    TEST_CHECK_EQ(CAN_stat_get(node, CAN_STAT_BUS_OFF_CNT), 1);
+    TEST_CHECK_EQ(CAN_stat_get_error_event(node, 0, &event), 1);
+    TEST_CHECK_EQ(event.state, CAN_STATE_ACTIVE);
+    TEST_CHECK_EQ(CAN_stat_get_error_event(node, 1, &event), 1);
+    TEST_CHECK_EQ(event.state, CAN_STATE_BUS_OFF);
+    TEST_CHECK_EQ(event.tec, 200);
+    TEST_CHECK_EQ(CAN_stat_get_error_event(node, 3, &event), 1);
+    TEST_CHECK_EQ(event.state, CAN_STATE_WARNING);
+    TEST_CHECK_EQ(event.tec, 100);
+    TEST_CHECK_EQ(CAN_stat_get_error_event(node, 4, &event), 0);
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+int main (void)
+{
+    HOST_timebase_freq = FCY;
+    HOST_timebase_now = 0xFFFFFFFFUL - US(500000);      // Wraps during the tests
+    test_load();
+    test_error_state();
+    return TEST_end("test_can_stat");
+}
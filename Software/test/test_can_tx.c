@@ -0,0 +1,215 @@
+//****************************************************************************//
+// File      :  test_can_tx.c
+//
+// Includes  :  CAN.h, ecan_sim.h, test.h
+//
+// Purpose   :  Transmit queue of CAN.c on the ECAN model at 500kbps, where
+//              the bus takes the pending buffer of highest TXPRI, then of
+//              highest buffer number. Frames of one priority must leave in
+//              push order, a higher priority frame overtakes the queue and
+//              the loaded buffers after at most the frame on the bus. A
+//              mixed-priority node replays 1s of traffic, the queueing
+//              latency of each priority is reported and bounded
+//****************************************************************************//
+#include "CAN.h"
+#include "ecan_sim.h"
+#include "test.h"
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+extern STRUCT_CAN CAN_struct[CAN_QTY];
+extern uint16_t CAN_MSG_BUFFER[NUM_OF_CAN_BUFFERS][8];
+
+#define BUS_FREQ        500000UL
+#define TX_BUFFERS      8
+#define US(x)           ((uint32_t)(x) * (FCY / 1000000UL))
+#define LOG_SIZE        8192
+
+typedef struct
+{
+    uint16_t sid;
+    uint16_t seq;
+    uint8_t priority;
+    uint32_t time;
+}STRUCT_SENT;
+
+static STRUCT_CAN *node = &CAN_struct[CAN_1];
+static STRUCT_SENT sent[LOG_SIZE];
+static uint16_t sent_count;
+static uint16_t push_seq[CAN_TX_PRIORITY_QTY];
+
+// Bus side : every frame that completes, in bus order
+static void tx_done (uint8_t buf)
+{
+    volatile uint8_t *trcon = (volatile uint8_t *)&C1TR01CON;
+
+    if (sent_count < LOG_SIZE)
+    {
+        sent[sent_count].sid = (CAN_MSG_BUFFER[buf][0] >> 2) & 0x07FF;
+        sent[sent_count].seq = CAN_MSG_BUFFER[buf][3];
+        sent[sent_count].priority = trcon[buf] & 0x03;
+        sent[sent_count].time = HOST_timebase_now;
+        sent_count++;
+    }
+}
+
+static void node_init (void)
+{
+    uint8_t k;
+
+    C1CTRL1bits.OPMODE = CAN_MODE_CONFIG;
+    TEST_CHECK_EQ(CAN_init(node, CAN_1, BUS_FREQ, 8, DMA_CH2, DMA_CH3, CAN_NODE_TYPE_TX_RX, CAN_BUFFER_X32, TX_BUFFERS), 1);
+    C1CTRL1bits.OPMODE = CAN_MODE_NORMAL;
+    CAN_set_mode(node, CAN_MODE_NORMAL);
+    SIM_ecan_init(node);
+    for (k = 0; k < TX_BUFFERS; k++)
+    {
+        ((volatile uint8_t *)&C1TR01CON)[k] = 0;
+    }
+    SIM_ecan_tx_hook = tx_done;
+    sent_count = 0;
+    memset(push_seq, 0, sizeof(push_seq));
+}
+
+// 8-byte standard frame, payload word 0 is the push number of its priority
+static uint8_t push (uint16_t sid, uint8_t priority)
+{
+    STRUCT_CAN_FRAME frame;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.SID = sid;
+    frame.DLC = 8;
+    frame.payload[0] = (uint8_t)push_seq[priority];
+    frame.payload[1] = (uint8_t)(push_seq[priority] >> 8);
+    if (CAN_tx_queue_push(node, &frame, priority) == 0)
+    {
+        return 0;
+    }
+    push_seq[priority]++;
+    return 1;
+}
+
+static uint32_t frame_ticks (void)
+{
+    STRUCT_CAN_FRAME frame;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.DLC = 8;
+    return SIM_ecan_frame_ticks(&frame);
+}
+
+// More frames of one priority than transmit buffers : push order on the bus
+static void test_equal_priority (void)
+{
+    uint16_t k;
+
+    node_init();
+    for (k = 0; k < 14; k++)
+    {
+        TEST_CHECK_EQ(push(0x200 + k, 1), 1);
+    }
+    TEST_CHECK_EQ(CAN_tx_queue_get_count(node), 14 - TX_BUFFERS);
+    TEST_CHECK_EQ(SIM_ecan_run(20 * frame_ticks()), 14);
+    TEST_CHECK_EQ(sent_count, 14);
+    for (k = 0; k < 14; k++)
+    {
+        TEST_CHECK_EQ(sent[k].sid, 0x200 + k);
+        TEST_CHECK_EQ(sent[k].seq, k);
+    }
+    TEST_CHECK_EQ(node->tx_buf_busy, 0);
+    TEST_CHECK_EQ(CAN_tx_queue_get_count(node), 0);
+}
+
+// Every buffer busy with priority 0, then a mixed batch : the batch goes out
+// by priority, then ID, right after the frame on the bus
+static void test_overtake (void)
+{
+    static const uint16_t expected[] = {0x400, 0x081, 0x082, 0x110, 0x300, 0x401, 0x402, 0x403, 0x404, 0x405, 0x406, 0x407, 0x408};
+    uint16_t k;
+
+    node_init();
+    for (k = 0; k < 9; k++)
+    {
+        push(0x400 + k, 0);
+    }
+    TEST_CHECK_EQ(SIM_ecan_run(frame_ticks() / 2), 0);
+    push(0x300, 1);
+    push(0x082, 3);
+    push(0x110, 2);
+    push(0x081, 3);
+    TEST_CHECK_EQ(SIM_ecan_run(20 * frame_ticks()), 13);
+    for (k = 0; k < 13; k++)
+    {
+        TEST_CHECK_EQ(sent[k].sid, expected[k]);
+    }
+    // Pushed half a frame into the first one : the rest of it, then 0x081,
+    // then its own frame for 0x082
+    TEST_CHECK_EQ(CAN_get_tx_latency(node, 3, CAN_TX_LATENCY_MAX), (5 * frame_ticks()) / 2);
+    TEST_CHECK_EQ(CAN_get_tx_latency(node, 2, CAN_TX_LATENCY_LAST), (7 * frame_ticks()) / 2);
+}
+
+// 1s of a node : 1kHz control frame, 2 status frames every 2ms, 4 every 5ms,
+// bulk transfer of 12 frames every 10ms, about 90% of the bus
+static void test_mixed (void)
+{
+    static const char *name[CAN_TX_PRIORITY_QTY] = {"bulk", "slow", "status", "control"};
+    uint32_t start, t, lat_us[CAN_TX_PRIORITY_QTY];
+    uint16_t expected_seq[CAN_TX_PRIORITY_QTY] = {0}, k, p;
+    uint32_t pushed = 0;
+
+    node_init();
+    CAN_reset_tx_latency(node);
+    start = HOST_timebase_now;
+    for (t = 0; t < 1000000UL; t += 10)
+    {
+        if ((t % 1000) == 0){pushed += push(0x080, 3);}
+        if ((t % 2000) == 500){pushed += push(0x100, 2); pushed += push(0x101, 2);}
+        if ((t % 5000) == 1200)
+        {
+            for (k = 0; k < 4; k++){pushed += push(0x200 + k, 1);}
+        }
+        if ((t % 10000) == 3000)
+        {
+            for (k = 0; k < 12; k++){pushed += push(0x400 + k, 0);}
+        }
+        SIM_ecan_run(US(10));
+    }
+    SIM_ecan_run(US(20000));
+
+    TEST_CHECK_EQ(CAN_tx_queue_get_overflow(node), 0);
+    TEST_CHECK_EQ(pushed, 1000 + 1000 + 800 + 1200);
+    TEST_CHECK_EQ(sent_count, pushed);
+    for (k = 0; k < sent_count; k++)
+    {
+        // One priority keeps its push order
+        p = sent[k].priority;
+        TEST_CHECK_EQ(sent[k].seq, expected_seq[p]);
+        expected_seq[p] = sent[k].seq + 1;
+    }
+
+    printf("  %-8s %4s %8s %14s\n", "priority", "", "frames", "latency max us");
+    for (p = CAN_TX_PRIORITY_QTY; p-- > 0; )
+    {
+        lat_us[p] = CAN_get_tx_latency(node, p, CAN_TX_LATENCY_MAX) / (FCY / 1000000UL);
+        printf("  %-8s %4u %8u %14lu\n", name[p], p, expected_seq[p], (unsigned long)lat_us[p]);
+    }
+    printf("  bus busy %lu%%, control bound %lu us\n", (unsigned long)((100ULL * sent_count * frame_ticks()) / (HOST_timebase_now - start)),
+           (unsigned long)((2 * frame_ticks()) / (FCY / 1000000UL)));
+
+    // The control frame waits for the frame on the bus, then goes : it is the
+    // only one of its priority in any 1ms
+    TEST_CHECK(CAN_get_tx_latency(node, 3, CAN_TX_LATENCY_MAX) <= 2 * frame_ticks());
+    TEST_CHECK(lat_us[3] <= lat_us[2]);
+    TEST_CHECK(lat_us[2] <= lat_us[1]);
+    TEST_CHECK(lat_us[1] <= lat_us[0]);
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+int main (void)
+{
+    HOST_timebase_freq = FCY;
+    HOST_timebase_now = 0xFFFFFFFFUL - US(300000);      // Wraps during the tests
+    test_equal_priority();
+    test_overtake();
+    test_mixed();
+    return TEST_end("test_can_tx");
+}
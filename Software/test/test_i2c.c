@@ -0,0 +1,506 @@
+//****************************************************************************//
+// File      :  test_i2c.c
+//
+// Includes  :  i2c.h, test.h
+//
+// Purpose   :  I2C_init baud rate generator formula and range, transaction
+//              timeout of a queued read serviced by I2C_task. The queue is
+//              run on the I2C1 model against a register-file slave : a
+//              transaction refused by a full queue is left untouched, the
+//              queued ones complete in submit order, chained back to back
+//              from the master interrupt. The recovery clocks a slave stuck
+//              on SDA out through the PORT / TRIS pins, a queued transaction
+//              held on the bus completes with I2C_STATUS_TIMEOUT and the next
+//              one goes out after the recovery. The _buffer transfers and
+//              the queue move the caller bytes without touching the port
+//              i2c_tx/rx_data arrays, the legacy transfers copy through them
+//****************************************************************************//
+#include "i2c.h"
+#include "i2c_sim.h"
+#include "test.h"
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+extern STRUCT_I2C i2c_struct[I2C_QTY];
+
+#define SLAVE_ADR       0x52
+#define BIT_TICKS       (FCY / I2C_FREQ_400k)
+#define US(x)           ((uint32_t)(x) * (FCY / 1000000UL))
+
+static int8_t done_status = -1;
+
+static void done (void *context, uint8_t status)
+{
+    (void)context;
+    done_status = status;
+}
+
+static void test_brg (void)
+{
+    STRUCT_I2C i2c;
+    uint32_t freq, cycles;
+
+    // Datasheet example : (1/400k - 120ns) x 70MHz - 2 = 164.6, rounded up
+    TEST_CHECK_EQ(I2C_init(&i2c, I2C_1, I2C_FREQ_400k, I2C_mode_master, 0), 0);
+    TEST_CHECK_EQ(i2c.brg, 165);
+    TEST_CHECK(I2C_get_freq(&i2c) <= I2C_FREQ_400k);
+    TEST_CHECK_NEAR(I2C_get_freq(&i2c), I2C_FREQ_400k, 2000);
+
+    // Out of range
+    TEST_CHECK_EQ(I2C_init(&i2c, I2C_1, 0, I2C_mode_master, 0), 1);
+    TEST_CHECK_EQ(I2C_init(&i2c, I2C_1, I2C_FREQ_MAX + 1, I2C_mode_master, 0), 1);
+    TEST_CHECK_EQ(I2C_init(&i2c, I2C_1, 100000UL, I2C_mode_master, 0), 1);  // No standard mode at 70MIPS
+    TEST_CHECK_EQ(I2C_init(&i2c, I2C_2, I2C_FREQ_MIN - 1, I2C_mode_master, 0), 1);
+    TEST_CHECK_EQ(I2C_init(&i2c, I2C_2, I2C_FREQ_MIN, I2C_mode_master, 0), 0);
+    TEST_CHECK_EQ(i2c.brg, I2C_BRG_MAX);
+
+    // I2C_2 master leaves I2C_1 running
+    I2C1CONbits.I2CEN = 1;
+    I2C2CONbits.I2CEN = 0;
+    TEST_CHECK_EQ(I2C_init(&i2c, I2C_2, I2C_FREQ_400k, I2C_mode_master, 0), 0);
+    TEST_CHECK_EQ(I2C1CONbits.I2CEN, 1);
+    TEST_CHECK_EQ(I2C2CONbits.I2CEN, 1);
+    TEST_CHECK_EQ(I2C2BRG, 165);
+
+    // Every frequency : the bus period in FCY cycles is the shortest one
+    // that is not faster than requested
+    for (freq = I2C_FREQ_MIN; freq <= I2C_FREQ_MAX; freq += 97)
+    {
+        if (I2C_init(&i2c, I2C_1, freq, I2C_mode_master, 0) != 0)
+        {
+            TEST_CHECK(0);
+            break;
+        }
+        cycles = i2c.brg + I2C_PGD_CYCLES + 2;
+        TEST_CHECK((uint64_t)cycles * freq >= FCY);
+        TEST_CHECK((uint64_t)(cycles - 1) * freq < FCY);
+    }
+}
+
+static void test_timeout (void)
+{
+    STRUCT_I2C i2c;
+    STRUCT_I2C_TRANSACTION t = {0};
+    uint8_t buf[4];
+
+    HOST_timebase_freq = 1000000;           // 1 tick = 1us
+    HOST_timebase_now = 0;
+    I2C_init(&i2c, I2C_1, I2C_FREQ_400k, I2C_mode_master, 0);
+    t.type = I2C_TRANSACTION_READ;
+    t.rx_buf = buf;
+    t.rx_length = sizeof(buf);
+    t.callback = done;
+    TEST_CHECK_EQ(I2C_queue_submit(&i2c, &t), 1);
+    TEST_CHECK_EQ(t.status, I2C_STATUS_PENDING);
+
+    // No interrupt ever completes it
+    HOST_timebase_now = I2C_TIMEOUT_US / 2;
+    TEST_CHECK_EQ(I2C_task(&i2c), 0);
+    TEST_CHECK_EQ(done_status, -1);
+    HOST_timebase_now = I2C_TIMEOUT_US + 1;
+    TEST_CHECK_EQ(I2C_task(&i2c), 1);
+    TEST_CHECK_EQ(t.status, I2C_STATUS_TIMEOUT);
+    TEST_CHECK_EQ(done_status, I2C_STATUS_TIMEOUT);
+    TEST_CHECK_EQ(I2C_get_fault_count(&i2c), 1);
+    TEST_CHECK_EQ(I2C_task(&i2c), 0);
+
+    // Shorter timeout
+    done_status = -1;
+    I2C_set_timeout(&i2c, 1000);
+    I2C_queue_submit(&i2c, &t);
+    HOST_timebase_now += 1001;
+    TEST_CHECK_EQ(I2C_task(&i2c), 1);
+    TEST_CHECK_EQ(done_status, I2C_STATUS_TIMEOUT);
+}
+
+// Register-file slave : the 1st byte written sets the pointer, the next
+// ones are stored, reads return the registers from the pointer on
+static uint8_t slave_reg[256];
+static uint8_t slave_ptr, slave_first;
+
+static uint8_t slave_address (uint8_t rw)
+{
+    slave_first = (rw == 0);
+    return 0;
+}
+
+static uint8_t slave_write (uint8_t byte)
+{
+    if (slave_first)
+    {
+        slave_ptr = byte;
+        slave_first = 0;
+    }
+    else
+    {
+        slave_reg[slave_ptr++] = byte;
+    }
+    return 0;
+}
+
+static uint8_t slave_read (void)
+{
+    return slave_reg[slave_ptr++];
+}
+
+static STRUCT_SIM_I2C_DEVICE slave = {SLAVE_ADR, slave_address, slave_write, slave_read, 0};
+
+static uint8_t order[2 * I2C_QUEUE_SIZE];
+static uint32_t order_time[2 * I2C_QUEUE_SIZE];
+static uint8_t order_qty;
+
+static void queue_done (void *context, uint8_t status)
+{
+    TEST_CHECK_EQ(status, I2C_STATUS_DONE);
+    order_time[order_qty] = HOST_timebase_now;
+    order[order_qty++] = (uint8_t)(uintptr_t)context;
+}
+
+// Even : write 2 registers at 0x10 + 2k, odd : read them back with a
+// RESTART. Returns the bus bits of the transaction
+static uint32_t queue_transaction (STRUCT_I2C_TRANSACTION *t, uint8_t k, uint8_t *tx, uint8_t *rx)
+{
+    memset(t, 0, sizeof(*t));
+    tx[0] = 0x10 + (2 * (k / 2));
+    tx[1] = 0xA0 + k;
+    tx[2] = 0xB0 + k;
+    t->address = SLAVE_ADR;
+    t->tx_buf = tx;
+    t->rx_buf = rx;
+    t->callback = queue_done;
+    t->context = (void *)(uintptr_t)k;
+    t->status = I2C_STATUS_DONE;
+    if ((k & 1) == 0)
+    {
+        t->type = I2C_TRANSACTION_WRITE;
+        t->tx_length = 3;
+        return 1 + 9 + (3 * 9) + 1;                     // START, ADR, 3 bytes, STOP
+    }
+    t->type = I2C_TRANSACTION_WRITE_READ;
+    t->tx_length = 1;
+    t->rx_length = 2;
+    return 1 + 9 + 9 + 1 + 9 + (2 * 9) + 1;             // START, ADR, pointer, RESTART, ADR+1, 2 bytes, STOP
+}
+
+static void test_queue (void)
+{
+    STRUCT_I2C *i2c = &i2c_struct[I2C_1];
+    STRUCT_I2C_TRANSACTION t[I2C_QUEUE_SIZE + 2];
+    uint8_t tx[I2C_QUEUE_SIZE + 2][3], rx[I2C_QUEUE_SIZE + 2][2];
+    uint32_t start, bits = 0;
+    uint8_t k, last = I2C_QUEUE_SIZE + 1;
+
+    HOST_timebase_freq = FCY;
+    HOST_timebase_now = 0;
+    I2C_init(i2c, I2C_1, I2C_FREQ_400k, I2C_mode_master, 0);
+    SIM_i2c_init(&slave, I2C_FREQ_400k);
+    memset(slave_reg, 0, sizeof(slave_reg));
+    order_qty = 0;
+
+    // The 1st starts at once, I2C_QUEUE_SIZE more are queued
+    start = HOST_timebase_now;
+    for (k = 0; k < last; k++)
+    {
+        bits += queue_transaction(&t[k], k, tx[k], rx[k]);
+        TEST_CHECK_EQ(I2C_queue_submit(i2c, &t[k]), 1);
+        TEST_CHECK_EQ(t[k].status, I2C_STATUS_PENDING);
+    }
+    TEST_CHECK_EQ(I2C_queue_get_count(i2c), last);
+
+    // Full : refused, its status is not touched
+    queue_transaction(&t[last], last, tx[last], rx[last]);
+    TEST_CHECK_EQ(I2C_queue_submit(i2c, &t[last]), 0);
+    TEST_CHECK_EQ(t[last].status, I2C_STATUS_DONE);
+    TEST_CHECK_EQ(I2C_queue_get_count(i2c), last);
+
+    // Nothing but the bus runs : every transaction is started by the master
+    // interrupt of the previous STOP, the bus never idles in between
+    SIM_i2c_run(2 * bits * BIT_TICKS);
+    TEST_CHECK_EQ(order_qty, last);
+    for (k = 0; k < order_qty; k++)
+    {
+        TEST_CHECK_EQ(order[k], k);
+        TEST_CHECK_EQ(t[k].status, I2C_STATUS_DONE);
+    }
+    TEST_CHECK_EQ(order_time[last - 1] - start, bits * BIT_TICKS);
+    TEST_CHECK_EQ(I2C_queue_get_count(i2c), 0);
+    TEST_CHECK_EQ(IEC1bits.MI2C1IE, 0);
+    TEST_CHECK_EQ(SIM_i2c_stops, last);
+    printf("  %u chained transactions, %lu bus bits, %lu us at 400kHz\n", last, (unsigned long)bits,
+           (unsigned long)((order_time[last - 1] - start) / (FCY / 1000000UL)));
+
+    // Data landed in place : each read returns the registers written before it
+    for (k = 1; k < last; k += 2)
+    {
+        TEST_CHECK_EQ(rx[k][0], 0xA0 + k - 1);
+        TEST_CHECK_EQ(rx[k][1], 0xB0 + k - 1);
+    }
+
+    // The refused one is accepted once there is room
+    order_qty = 0;
+    TEST_CHECK_EQ(I2C_queue_submit(i2c, &t[last]), 1);
+    SIM_i2c_run(1000 * BIT_TICKS);
+    TEST_CHECK_EQ(order_qty, 1);
+    TEST_CHECK_EQ(order[0], last);
+    TEST_CHECK_EQ(rx[last][0], 0xA0 + last - 1);
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+static void test_recovery (void)
+{
+    STRUCT_I2C *i2c = &i2c_struct[I2C_1];
+    uint32_t start;
+
+    HOST_timebase_freq = FCY;
+    HOST_timebase_now = 0;
+    I2C_init(i2c, I2C_1, I2C_FREQ_400k, I2C_mode_master, 0);
+    SIM_i2c_init(&slave, I2C_FREQ_400k);
+
+    // Free bus : no pulse, STOP only
+    start = HOST_timebase_now;
+    TEST_CHECK_EQ(I2C_bus_recover(i2c), 1);
+    TEST_CHECK_EQ(SIM_i2c_scl_pulses, 0);
+    TEST_CHECK_EQ(HOST_timebase_now - start, US(5 * I2C_RECOVERY_HALF_US));
+
+    // Slave stuck in a byte, released after 5 clocks
+    SIM_i2c_sda_stuck = 5;
+    start = HOST_timebase_now;
+    TEST_CHECK_EQ(I2C_bus_recover(i2c), 1);
+    TEST_CHECK_EQ(SIM_i2c_scl_pulses, 5);
+    TEST_CHECK_EQ(HOST_timebase_now - start, US((5 + (2 * 5)) * I2C_RECOVERY_HALF_US));
+    TEST_CHECK_EQ(I2C1CONbits.I2CEN, 1);
+    TEST_CHECK_EQ(DSPEAK_MKB_SCL_DIR, 1);
+    TEST_CHECK_EQ(DSPEAK_MKB_SDA_DIR, 1);
+
+    // Never released : 9 clocks, SDA still low
+    SIM_i2c_sda_stuck = SIM_I2C_STUCK_FOREVER;
+    TEST_CHECK_EQ(I2C_bus_recover(i2c), 0);
+    TEST_CHECK_EQ(SIM_i2c_scl_pulses, I2C_RECOVERY_PULSES);
+    TEST_CHECK_EQ(I2C1CONbits.I2CEN, 1);
+    SIM_i2c_sda_stuck = 0;
+    TEST_CHECK_EQ(I2C_bus_recover(i2c), 1);
+    TEST_CHECK_EQ(SIM_i2c_scl_pulses, 0);
+}
+
+static uint8_t status_log[4];
+static uint32_t status_time[4];
+static uint8_t status_qty;
+
+static void log_status (void *context, uint8_t status)
+{
+    (void)context;
+    status_time[status_qty] = HOST_timebase_now;
+    status_log[status_qty++] = status;
+}
+
+// Runs the bus with I2C_task every 500us, as a scheduler task would
+static void run_with_task (STRUCT_I2C *i2c, uint32_t us)
+{
+    uint32_t t;
+
+    for (t = 0; t < us; t += 500)
+    {
+        SIM_i2c_run(US(500));
+        I2C_task(i2c);
+    }
+}
+
+static void test_queue_timeout (void)
+{
+    STRUCT_I2C *i2c = &i2c_struct[I2C_1];
+    STRUCT_I2C_TRANSACTION t[3];
+    uint8_t rx[4], tx[3] = {0x40, 0x5A, 0xA5};
+    uint32_t start;
+    uint8_t k;
+
+    HOST_timebase_freq = FCY;
+    HOST_timebase_now = 0;
+    I2C_init(i2c, I2C_1, I2C_FREQ_400k, I2C_mode_master, 0);
+    I2C_set_timeout(i2c, 2000);
+    SIM_i2c_init(&slave, I2C_FREQ_400k);
+    memset(slave_reg, 0, sizeof(slave_reg));
+    memset(t, 0, sizeof(t));
+    status_qty = 0;
+    for (k = 0; k < 3; k++)
+    {
+        t[k].address = SLAVE_ADR;
+        t[k].callback = log_status;
+        t[k].type = I2C_TRANSACTION_WRITE;
+        t[k].tx_buf = tx;
+        t[k].tx_length = sizeof(tx);
+    }
+    t[0].type = I2C_TRANSACTION_READ;
+    t[0].rx_buf = rx;
+    t[0].rx_length = sizeof(rx);
+
+    // The slave hangs in the 1st byte of the read, SDA held low
+    start = HOST_timebase_now;
+    TEST_CHECK_EQ(I2C_queue_submit(i2c, &t[0]), 1);
+    TEST_CHECK_EQ(I2C_queue_submit(i2c, &t[1]), 1);
+    SIM_i2c_run(15 * BIT_TICKS);                    // START and address byte
+    SIM_i2c_hold = 1;
+    SIM_i2c_sda_stuck = 3;
+    run_with_task(i2c, 1500);
+    TEST_CHECK_EQ(t[0].status, I2C_STATUS_PENDING);
+    TEST_CHECK_EQ(status_qty, 0);
+
+    // Aborted by the 1st I2C_task past 2ms, the recovery frees SDA and the
+    // write queued behind it goes out
+    run_with_task(i2c, 1000);
+    TEST_CHECK_EQ(t[0].status, I2C_STATUS_TIMEOUT);
+    TEST_CHECK_EQ(status_qty, 2);
+    TEST_CHECK_EQ(status_log[0], I2C_STATUS_TIMEOUT);
+    TEST_CHECK(status_time[0] - start > US(2000));
+    TEST_CHECK(status_time[0] - start <= US(2500 + 200));
+    TEST_CHECK_EQ(SIM_i2c_scl_pulses, 3);
+    TEST_CHECK_EQ(I2C_get_fault(i2c), I2C_FAULT_TIMEOUT);
+    TEST_CHECK_EQ(I2C_get_fault(i2c), I2C_FAULT_NONE);
+    TEST_CHECK_EQ(I2C_get_fault_count(i2c), 1);
+    TEST_CHECK_EQ(t[1].status, I2C_STATUS_DONE);
+    TEST_CHECK_EQ(status_log[1], I2C_STATUS_DONE);
+    TEST_CHECK_EQ(slave_reg[0x40], 0x5A);
+    TEST_CHECK_EQ(slave_reg[0x41], 0xA5);
+
+    // Stuck for good : timeout, the fault says the bus is still stuck
+    status_qty = 0;
+    TEST_CHECK_EQ(I2C_queue_submit(i2c, &t[2]), 1);
+    SIM_i2c_run(5 * BIT_TICKS);
+    SIM_i2c_hold = 1;
+    SIM_i2c_sda_stuck = SIM_I2C_STUCK_FOREVER;
+    run_with_task(i2c, 3000);
+    TEST_CHECK_EQ(t[2].status, I2C_STATUS_TIMEOUT);
+    TEST_CHECK_EQ(status_qty, 1);
+    TEST_CHECK_EQ(SIM_i2c_scl_pulses, I2C_RECOVERY_PULSES);
+    TEST_CHECK_EQ(I2C_get_fault(i2c), I2C_FAULT_BUS_STUCK);
+    TEST_CHECK_EQ(I2C_get_fault_count(i2c), 2);
+    TEST_CHECK_EQ(I2C_queue_get_count(i2c), 0);
+    TEST_CHECK_EQ(IEC1bits.MI2C1IE, 0);
+
+    // The slave comes back, the next transaction completes
+    SIM_i2c_sda_stuck = 0;
+    TEST_CHECK_EQ(I2C_bus_recover(i2c), 1);
+    tx[1] = 0x33;
+    TEST_CHECK_EQ(I2C_queue_submit(i2c, &t[2]), 1);
+    run_with_task(i2c, 500);
+    TEST_CHECK_EQ(t[2].status, I2C_STATUS_DONE);
+    TEST_CHECK_EQ(slave_reg[0x40], 0x33);
+    TEST_CHECK_EQ(I2C_get_fault_count(i2c), 2);
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+// Bytes of a port array that no longer hold the canary
+static uint16_t touched (const uint8_t *array, uint16_t size)
+{
+    uint16_t i, n = 0;
+
+    for (i = 0; i < size; i++)
+    {
+        if (array[i] != 0xEE){n++;}
+    }
+    return n;
+}
+
+static void test_copies (void)
+{
+    STRUCT_I2C *i2c = &i2c_struct[I2C_1];
+    STRUCT_I2C_TRANSACTION t[2];
+    uint8_t msg[1 + 1 + 64], rx[64];
+    uint16_t copied[4], bus[4], k;
+    uint32_t bytes;
+    static const char *path[4] = {"_buffer", "queue", "legacy write", "legacy read"};
+
+    HOST_timebase_freq = FCY;
+    HOST_timebase_now = 0;
+    I2C_init(i2c, I2C_1, I2C_FREQ_400k, I2C_mode_master, 0);
+    SIM_i2c_init(&slave, I2C_FREQ_400k);
+    msg[0] = SLAVE_ADR;                     // Address, legacy transfers only
+    msg[1] = 0x80;                          // Register pointer
+    for (k = 0; k < 64; k++)
+    {
+        msg[2 + k] = (uint8_t)k;            // Never the canary
+    }
+
+    // _buffer : write 64 registers, read them back with a RESTART
+    memset(i2c->i2c_tx_data, 0xEE, sizeof(i2c->i2c_tx_data));
+    memset(i2c->i2c_rx_data, 0xEE, sizeof(i2c->i2c_rx_data));
+    memset(rx, 0, sizeof(rx));
+    bytes = SIM_i2c_bytes;
+    I2C_master_write_buffer(i2c, SLAVE_ADR, &msg[1], 65);
+    TEST_CHECK(i2c->tx_ptr == &msg[1]);
+    SIM_i2c_run(1000 * BIT_TICKS);
+    I2C_master_read_buffer(i2c, I2C_READ_MODE_RESTART, SLAVE_ADR, &msg[1], 1, rx, 64);
+    TEST_CHECK(i2c->rx_ptr == rx);
+    SIM_i2c_run(1000 * BIT_TICKS);
+    TEST_CHECK_EQ(I2C_rx_done(i2c), 1);
+    TEST_CHECK(memcmp(rx, &msg[2], 64) == 0);
+    copied[0] = touched(i2c->i2c_tx_data, I2C_TX_LENGTH) + touched(i2c->i2c_rx_data, I2C_RX_LENGTH);
+    bus[0] = SIM_i2c_bytes - bytes;
+
+    // Queue : the same 2 transfers as transactions
+    memset(t, 0, sizeof(t));
+    memset(rx, 0, sizeof(rx));
+    memset(&slave_reg[0x80], 0, 64);
+    t[0].type = I2C_TRANSACTION_WRITE;
+    t[0].address = SLAVE_ADR;
+    t[0].tx_buf = &msg[1];
+    t[0].tx_length = 65;
+    t[1].type = I2C_TRANSACTION_WRITE_READ;
+    t[1].address = SLAVE_ADR;
+    t[1].tx_buf = &msg[1];
+    t[1].tx_length = 1;
+    t[1].rx_buf = rx;
+    t[1].rx_length = 64;
+    bytes = SIM_i2c_bytes;
+    TEST_CHECK_EQ(I2C_queue_submit(i2c, &t[0]), 1);
+    TEST_CHECK_EQ(I2C_queue_submit(i2c, &t[1]), 1);
+    SIM_i2c_run(2000 * BIT_TICKS);
+    TEST_CHECK_EQ(t[1].status, I2C_STATUS_DONE);
+    TEST_CHECK(memcmp(rx, &msg[2], 64) == 0);
+    copied[1] = touched(i2c->i2c_tx_data, I2C_TX_LENGTH) + touched(i2c->i2c_rx_data, I2C_RX_LENGTH);
+    bus[1] = SIM_i2c_bytes - bytes;
+
+    // Legacy : the message goes through i2c_tx_data, the bytes read land in
+    // i2c_rx_data and the application copies them out
+    memset(&slave_reg[0x80], 0, 64);
+    bytes = SIM_i2c_bytes;
+    TEST_CHECK_EQ(I2C_master_write(i2c, msg, sizeof(msg)), 0);
+    SIM_i2c_run(1000 * BIT_TICKS);
+    copied[2] = touched(i2c->i2c_tx_data, I2C_TX_LENGTH);
+    bus[2] = SIM_i2c_bytes - bytes;
+    TEST_CHECK(memcmp(&slave_reg[0x80], &msg[2], 64) == 0);
+
+    memset(i2c->i2c_tx_data, 0xEE, sizeof(i2c->i2c_tx_data));
+    bytes = SIM_i2c_bytes;
+    TEST_CHECK_EQ(I2C_master_read(i2c, I2C_READ_MODE_RESTART, msg, 2, 64), 0);
+    SIM_i2c_run(1000 * BIT_TICKS);
+    TEST_CHECK_EQ(I2C_rx_done(i2c), 1);
+    memcpy(rx, I2C_get_rx_buffer(i2c), 64);
+    copied[3] = touched(i2c->i2c_tx_data, I2C_TX_LENGTH) + touched(i2c->i2c_rx_data, I2C_RX_LENGTH) + 64;
+    bus[3] = SIM_i2c_bytes - bytes;
+    TEST_CHECK(memcmp(rx, &msg[2], 64) == 0);
+
+    printf("  %-13s %9s %12s\n", "path", "bus bytes", "bytes copied");
+    for (k = 0; k < 4; k++)
+    {
+        printf("  %-13s %9u %12u\n", path[k], bus[k], copied[k]);
+    }
+    printf("  STRUCT_I2C %u bytes, %u of them i2c_tx/rx_data, unused by the zero-copy paths\n",
+           (unsigned)sizeof(STRUCT_I2C), I2C_TX_LENGTH + I2C_RX_LENGTH);
+    TEST_CHECK_EQ(copied[0], 0);
+    TEST_CHECK_EQ(copied[1], 0);
+    TEST_CHECK_EQ(copied[2], 65);           // Pointer and data, the address is not stored
+    TEST_CHECK_EQ(copied[3], 1 + 64 + 64);  // Pointer, bytes read, copy out
+    TEST_CHECK_EQ(bus[0], bus[1]);          // Same bus traffic either way
+    TEST_CHECK_EQ(bus[2], 1 + 65);
+    TEST_CHECK_EQ(bus[3], 1 + 1 + 1 + 64);
+}
+
+int main (void)
+{
+    test_brg();
+    test_timeout();
+    test_queue();
+    test_recovery();
+    test_queue_timeout();
+    test_copies();
+    return TEST_end("test_i2c");
+}
@@ -0,0 +1,173 @@
+//****************************************************************************//
+// File      :  test_idle.c
+//
+// Includes  :  idle.h, scheduler.h, timer_sim.h, test.h
+//
+// Purpose   :  Duty cycle of the dsPeak_dev main loop : SCHED_run, then
+//              IDLE_enter(SCHED_get_next_release) when nothing is ready, on
+//              simulated timers. TIMER_1 wakes the CPU, TIMER_8/9 is the
+//              timebase, Idle() runs the timers up to the wake-up flag. The
+//              busy ratio, idle time and wake-up latency are checked against
+//              the task run times, and the sleep bounds against other timers
+//              and the IDLE_MAX_SLEEP_TICKS cap
+//****************************************************************************//
+#include "idle.h"
+#include "scheduler.h"
+#include "timer_sim.h"
+#include "test.h"
+
+extern STRUCT_TIMER TIMER_struct[TIMER_QTY];
+extern STRUCT_TASK SCHED_task_struct[SCHED_TASK_QTY];
+extern void (*HOST_idle_hook)(void);
+
+#define US(x)           ((uint32_t)(x) * (FCY / 1000000UL))
+#define RUN_TIME_S      10UL
+#define WAKE_RES        256UL                   // Wake timer resolution, prescaler 256
+#define LOOP_COST       70UL                    // Main loop pass that does not sleep
+
+static const uint32_t period_us[SCHED_TASK_QTY] = {33333, 33333, 100000, 100000, 33333, 33333, 200000, 16667};
+static const uint32_t cost_us[SCHED_TASK_QTY] = {120, 120, 40, 40, 30, 80, 900, 3500};
+static uint64_t busy_cycles;
+static uint32_t wakes;
+
+static void idle_wait (void)
+{
+    wakes++;
+    SIM_timer_wait();
+}
+
+static void work (uint8_t prio)
+{
+    busy_cycles += US(cost_us[prio]);
+    SIM_timer_run(US(cost_us[prio]));
+}
+
+static void task_0 (uint16_t events){work(0);}
+static void task_1 (uint16_t events){work(1);}
+static void task_2 (uint16_t events){work(2);}
+static void task_3 (uint16_t events){work(3);}
+static void task_4 (uint16_t events){work(4);}
+static void task_5 (uint16_t events){work(5);}
+static void task_6 (uint16_t events){work(6);}
+static void task_7 (uint16_t events){work(7);}
+
+static void (* const handler[SCHED_TASK_QTY])(uint16_t) =
+{
+    task_0, task_1, task_2, task_3, task_4, task_5, task_6, task_7
+};
+
+static void test_duty_cycle (void)
+{
+    uint32_t start, idle_entries = 0;
+    uint16_t busy, expected;
+    uint8_t i;
+
+    TEST_CHECK_EQ(SCHED_init(&TIMER_struct[TIMER_8], TIMER_8), 1);
+    TEST_CHECK_EQ(IDLE_init(&TIMER_struct[TIMER_1], TIMER_1), 1);
+    for (i = 0; i < SCHED_TASK_QTY; i++)
+    {
+        SCHED_task_init(&SCHED_task_struct[i], i, handler[i], period_us[i], period_us[i]);
+    }
+    start = TIMER_timebase_get();
+    IDLE_reset_stat();
+    busy_cycles = 0;
+
+    // dsPeak_dev main loop
+    while ((TIMER_timebase_get() - start) < (RUN_TIME_S * FCY))
+    {
+        if (SCHED_run() == 0)
+        {
+            if (IDLE_enter(SCHED_get_next_release) == 1)
+            {
+                idle_entries++;
+            }
+            else
+            {
+                // Release closer than IDLE_MIN_SLEEP_TICKS, spin
+                busy_cycles += LOOP_COST;
+                SIM_timer_run(LOOP_COST);
+            }
+        }
+    }
+
+    expected = (uint16_t)((busy_cycles * 1000) / (TIMER_timebase_get() - start));
+    busy = IDLE_get_busy_permille();
+    printf("  busy %u permille (tasks and spin %u), %lu idle periods, %lu wake-ups, wake latency max %lu cycles\n",
+           busy, expected, (unsigned long)IDLE_get_stat(IDLE_STAT_COUNT), (unsigned long)wakes,
+           (unsigned long)IDLE_get_stat(IDLE_STAT_WAKE_LATENCY_MAX));
+
+    // The CPU sleeps whenever no task runs, up to the wake timer resolution
+    TEST_CHECK_NEAR(busy, expected, 2);
+    TEST_CHECK_EQ(IDLE_get_stat(IDLE_STAT_COUNT), idle_entries);
+    TEST_CHECK_EQ(wakes, idle_entries);
+    TEST_CHECK(IDLE_get_stat(IDLE_STAT_WAKE_LATENCY_MAX) < 2 * WAKE_RES);
+    for (i = 0; i < SCHED_TASK_QTY; i++)
+    {
+        TEST_CHECK_EQ(SCHED_get_stat(i, SCHED_STAT_DEADLINE_MISS), 0);
+        TEST_CHECK_NEAR(SCHED_get_stat(i, SCHED_STAT_RUN_COUNT), (RUN_TIME_S * 1000000UL) / period_us[i], 1);
+    }
+    // Highest priority task : released during Idle, dispatched right at wake-up
+    // unless the eve refresh runs
+    TEST_CHECK(SCHED_get_stat(0, SCHED_STAT_LATENCY_MAX) <= US(cost_us[7]) + 2 * WAKE_RES);
+    TEST_CHECK_EQ(T1CONbits.TON, 0);            // Wake timer stopped outside Idle
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+static uint32_t bound_value;
+static uint32_t bound (void)
+{
+    return bound_value;
+}
+
+static void test_bounds (void)
+{
+    uint32_t t0;
+
+    SCHED_init(&TIMER_struct[TIMER_8], TIMER_8);
+    IDLE_init(&TIMER_struct[TIMER_1], TIMER_1);
+
+    // Too short to sleep
+    bound_value = IDLE_MIN_SLEEP_TICKS - 1;
+    wakes = 0;
+    TEST_CHECK_EQ(IDLE_enter(bound), 0);
+    TEST_CHECK_EQ(wakes, 0);
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+
+    // Nothing due : capped at IDLE_MAX_SLEEP_TICKS
+    bound_value = 0xFFFFFFFF;
+    t0 = TIMER_timebase_get();
+    TEST_CHECK_EQ(IDLE_enter(bound), 1);
+    TEST_CHECK_NEAR(TIMER_timebase_get() - t0, IDLE_MAX_SLEEP_TICKS, 2 * WAKE_RES);
+
+    // A caller bound of one character at 460800 baud : the main loop gets
+    // back to its RS-485 driver enable within a character time
+    bound_value = US(22);
+    t0 = TIMER_timebase_get();
+    TEST_CHECK_EQ(IDLE_enter(bound), 1);
+    TEST_CHECK(TIMER_timebase_get() - t0 <= US(22) + WAKE_RES);
+
+    // Another running timer expires first, 1kHz on TIMER_2 / TIMER_3
+    TIMER_init(&TIMER_struct[TIMER_2], TIMER_2, TIMER_MODE_32B, TIMER_PRESCALER_1, 1000);
+    TIMER_start(&TIMER_struct[TIMER_2]);
+    SIM_timer_run(US(300));
+    bound_value = US(50000);
+    t0 = TIMER_timebase_get();
+    TEST_CHECK_EQ(IDLE_enter(bound), 1);
+    TEST_CHECK_NEAR(TIMER_timebase_get() - t0, US(700), WAKE_RES);
+    SIM_timer_irq();
+    TEST_CHECK_EQ(TIMER_get_elapsed(&TIMER_struct[TIMER_2]), 1);
+    TIMER_stop(&TIMER_struct[TIMER_2]);
+
+    // Without a wake timer the CPU only sleeps when something else wakes it
+    IDLE_init(0, 0);
+    bound_value = 0xFFFFFFFF;
+    TEST_CHECK_EQ(IDLE_enter(bound), 0);
+}
+
+int main (void)
+{
+    HOST_idle_hook = idle_wait;
+    test_duty_cycle();
+    test_bounds();
+    return TEST_end("test_idle");
+}
@@ -0,0 +1,506 @@
+//****************************************************************************//
+// File      :  test_isotp.c
+//
+// Includes  :  isotp.h, test.h
+//
+// Purpose   :  ISO-TP segmentation, flow control and reassembly. The CAN
+//              transmit queue is replaced by a frame log, frames are fed
+//              back to the links by the test
+//****************************************************************************//
+#include <string.h>
+#include "isotp.h"
+#include "test.h"
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+
+#define LOG_SIZE        64
+
+static STRUCT_CAN node;
+static STRUCT_CAN_FRAME frame_log[LOG_SIZE];
+static uint8_t frame_qty = 0;
+static uint8_t queue_full = 0;
+
+uint8_t CAN_tx_queue_push (STRUCT_CAN *can, STRUCT_CAN_FRAME *frame, uint8_t priority)
+{
+    (void)can;
+    (void)priority;
+    if ((queue_full == 1) || (frame_qty >= LOG_SIZE))
+    {
+        return 0;
+    }
+    frame_log[frame_qty++] = *frame;
+    return 1;
+}
+
+static STRUCT_CAN_FRAME make_frame (uint16_t sid, const uint8_t *data, uint8_t dlc)
+{
+    STRUCT_CAN_FRAME frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.SID = sid;
+    frame.DLC = dlc;
+    memcpy(frame.payload, data, dlc);
+    return frame;
+}
+
+static uint8_t feed (STRUCT_ISOTP *link, uint16_t sid, const uint8_t *data, uint8_t dlc)
+{
+    STRUCT_CAN_FRAME frame = make_frame(sid, data, dlc);
+    return ISOTP_rx_frame(link, &frame);
+}
+
+static void test_init (void)
+{
+    STRUCT_ISOTP link;
+    uint8_t buf[16];
+
+    TEST_CHECK_EQ(ISOTP_init(&link, &node, 0x7E0, 0x7E8, buf, ISOTP_RX_BUF_MIN - 1, 0, 0), 0);
+    TEST_CHECK_EQ(ISOTP_init(&link, &node, 0x800, 0x7E8, buf, sizeof(buf), 0, 0), 0);
+    TEST_CHECK_EQ(ISOTP_init(&link, 0, 0x7E0, 0x7E8, buf, sizeof(buf), 0, 0), 0);
+    TEST_CHECK_EQ(ISOTP_init(&link, &node, 0x7E0, 0x7E8, buf, ISOTP_RX_BUF_MIN, 0, 0), 1);
+}
+
+static void test_single_frame (void)
+{
+    STRUCT_ISOTP link;
+    uint8_t buf[16];
+    uint8_t msg[5] = {1, 2, 3, 4, 5};
+    uint8_t sf[8] = {0x03, 0xA1, 0xA2, 0xA3, 0, 0, 0, 0};
+
+    ISOTP_init(&link, &node, 0x7E0, 0x7E8, buf, sizeof(buf), 0, 0);
+    frame_qty = 0;
+    TEST_CHECK_EQ(ISOTP_send(&link, msg, 0), 0);
+    TEST_CHECK_EQ(ISOTP_send(&link, msg, 5), 1);
+    TEST_CHECK_EQ(frame_qty, 1);
+    TEST_CHECK_EQ(frame_log[0].SID, 0x7E0);
+    TEST_CHECK_EQ(frame_log[0].DLC, 8);
+    TEST_CHECK_EQ(frame_log[0].payload[0], ISOTP_PCI_SF | 5);
+    TEST_CHECK(memcmp(&frame_log[0].payload[1], msg, 5) == 0);
+    TEST_CHECK_EQ(frame_log[0].payload[6], ISOTP_PADDING);
+    TEST_CHECK_EQ(frame_log[0].payload[7], ISOTP_PADDING);
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&link), ISOTP_TX_DONE);
+
+    // Reception, other identifiers are left to the caller
+    TEST_CHECK_EQ(feed(&link, 0x123, sf, 8), 0);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&link), 0);
+    TEST_CHECK_EQ(feed(&link, 0x7E8, sf, 8), 1);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&link), 3);
+    TEST_CHECK_EQ(buf[2], 0xA3);
+
+    // Not released, the next single frame is not taken
+    sf[0] = 0x01;
+    sf[1] = 0x55;
+    feed(&link, 0x7E8, sf, 8);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&link), 3);
+    TEST_CHECK_EQ(buf[0], 0xA1);
+    ISOTP_rx_release(&link);
+    feed(&link, 0x7E8, sf, 8);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&link), 1);
+    TEST_CHECK_EQ(buf[0], 0x55);
+
+    // Length past the DLC
+    ISOTP_rx_release(&link);
+    sf[0] = 0x05;
+    feed(&link, 0x7E8, sf, 4);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&link), 0);
+    TEST_CHECK_EQ(ISOTP_get_error(&link, ISOTP_ERROR_OVERFLOW), 1);
+}
+
+static void test_segmented_send (void)
+{
+    STRUCT_ISOTP link;
+    uint8_t buf[16];
+    uint8_t msg[40];
+    uint8_t out[40];
+    uint8_t fc[8] = {ISOTP_PCI_FC | ISOTP_FC_CTS, 0, 0, 0, 0, 0, 0, 0};
+    uint8_t i;
+
+    for (i = 0; i < sizeof(msg); i++)
+    {
+        msg[i] = i + 100;
+    }
+    ISOTP_init(&link, &node, 0x7E0, 0x7E8, buf, sizeof(buf), 0, 0);
+    frame_qty = 0;
+    TEST_CHECK_EQ(ISOTP_send(&link, msg, 19), 1);
+    TEST_CHECK_EQ(frame_qty, 1);
+    TEST_CHECK_EQ(frame_log[0].payload[0], ISOTP_PCI_FF);
+    TEST_CHECK_EQ(frame_log[0].payload[1], 19);
+    TEST_CHECK(memcmp(&frame_log[0].payload[2], msg, 6) == 0);
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&link), ISOTP_TX_WAIT_FC);
+    TEST_CHECK_EQ(ISOTP_send(&link, msg, 5), 0);          // Busy
+
+    // Nothing goes out before the flow control
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 1);
+    feed(&link, 0x7E8, fc, 3);
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 3);
+    TEST_CHECK_EQ(frame_log[1].payload[0], ISOTP_PCI_CF | 1);
+    TEST_CHECK_EQ(frame_log[2].payload[0], ISOTP_PCI_CF | 2);
+    TEST_CHECK_EQ(frame_log[2].payload[7], ISOTP_PADDING);  // 6 + 7 + 6 = 19
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&link), ISOTP_TX_DONE);
+    memcpy(out, &frame_log[0].payload[2], 6);
+    memcpy(&out[6], &frame_log[1].payload[1], 7);
+    memcpy(&out[13], &frame_log[2].payload[1], 6);
+    TEST_CHECK(memcmp(out, msg, 19) == 0);
+
+    // Block size 2 : a flow control every 2 consecutive frames
+    frame_qty = 0;
+    ISOTP_send(&link, msg, 40);
+    fc[1] = 2;
+    feed(&link, 0x7E8, fc, 3);
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 3);
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&link), ISOTP_TX_WAIT_FC);
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 3);
+    feed(&link, 0x7E8, fc, 3);
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 5);
+    feed(&link, 0x7E8, fc, 3);
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 6);                            // 6 + 5 x 7 = 41
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&link), ISOTP_TX_DONE);
+    for (i = 1; i < frame_qty; i++)
+    {
+        TEST_CHECK_EQ(frame_log[i].payload[0], ISOTP_PCI_CF | i);
+    }
+    TEST_CHECK(memcmp(&frame_log[5].payload[1], &msg[34], 6) == 0);
+
+    // STmin 10ms, 1 consecutive frame per separation time
+    HOST_timebase_now = 0;
+    frame_qty = 0;
+    ISOTP_send(&link, msg, 27);
+    fc[1] = 0;
+    fc[2] = 10;
+    feed(&link, 0x7E8, fc, 3);
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 2);
+    HOST_timebase_now += 9000;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 2);
+    HOST_timebase_now += 1000;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 3);
+
+    // STmin 0xF1-0xF9 is 100-900us
+    HOST_timebase_now += 10000;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 4);
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&link), ISOTP_TX_DONE);
+    frame_qty = 0;
+    ISOTP_send(&link, msg, 30);
+    fc[2] = 0xF5;
+    feed(&link, 0x7E8, fc, 3);
+    ISOTP_task(&link);
+    HOST_timebase_now += 499;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 2);
+    HOST_timebase_now += 1;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 3);
+
+    // A full CAN queue is retried on the next call
+    HOST_timebase_now += 500;
+    queue_full = 1;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 3);
+    queue_full = 0;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 4);
+}
+
+static void test_send_errors (void)
+{
+    STRUCT_ISOTP link;
+    uint8_t buf[16];
+    uint8_t msg[20] = {0};
+    uint8_t fc[8] = {ISOTP_PCI_FC | ISOTP_FC_WAIT, 0, 0, 0, 0, 0, 0, 0};
+
+    ISOTP_init(&link, &node, 0x7E0, 0x7E8, buf, sizeof(buf), 0, 0);
+    TEST_CHECK_EQ(ISOTP_send(&link, msg, ISOTP_MAX_LENGTH + 1), 0);
+
+    // N_Bs, restarted by FC_WAIT
+    HOST_timebase_now = 0;
+    ISOTP_send(&link, msg, 20);
+    HOST_timebase_now += ISOTP_TIMEOUT_US;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&link), ISOTP_TX_WAIT_FC);
+    feed(&link, 0x7E8, fc, 3);
+    HOST_timebase_now += ISOTP_TIMEOUT_US;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&link), ISOTP_TX_WAIT_FC);
+    HOST_timebase_now += 1;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&link), ISOTP_TX_ERROR);
+    TEST_CHECK_EQ(ISOTP_get_error(&link, ISOTP_ERROR_TIMEOUT), 1);
+
+    // Peer buffer too small
+    ISOTP_send(&link, msg, 20);
+    fc[0] = ISOTP_PCI_FC | ISOTP_FC_OVERFLOW;
+    feed(&link, 0x7E8, fc, 3);
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&link), ISOTP_TX_ERROR);
+    TEST_CHECK_EQ(ISOTP_get_error(&link, ISOTP_ERROR_OVERFLOW), 1);
+}
+
+// Delivers the logged frames to both links, the frames they send in return
+// are delivered on the next pass
+static void pump (STRUCT_ISOTP *a, STRUCT_ISOTP *b)
+{
+    STRUCT_CAN_FRAME pending[LOG_SIZE];
+    uint8_t qty, i, pass;
+
+    for (pass = 0; pass < 255; pass++)
+    {
+        ISOTP_task(a);
+        ISOTP_task(b);
+        if (frame_qty == 0)
+        {
+            break;
+        }
+        qty = frame_qty;
+        memcpy(pending, frame_log, qty * sizeof(STRUCT_CAN_FRAME));
+        frame_qty = 0;
+        for (i = 0; i < qty; i++)
+        {
+            ISOTP_rx_frame(a, &pending[i]);
+            ISOTP_rx_frame(b, &pending[i]);
+        }
+    }
+}
+
+static void test_reassembly (void)
+{
+    static uint8_t buf_a[64], buf_b[4095];
+    static uint8_t msg[4095];
+    STRUCT_ISOTP a, b;
+    uint16_t i;
+
+    for (i = 0; i < sizeof(msg); i++)
+    {
+        msg[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    HOST_timebase_now = 0;
+    frame_qty = 0;
+    ISOTP_init(&a, &node, 0x7E0, 0x7E8, buf_a, sizeof(buf_a), 0, 0);
+    ISOTP_init(&b, &node, 0x7E8, 0x7E0, buf_b, sizeof(buf_b), 8, 0);
+
+    // 100 bytes, block size 8 on the receiver
+    ISOTP_send(&a, msg, 100);
+    pump(&a, &b);
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&a), ISOTP_TX_DONE);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&b), 100);
+    TEST_CHECK(memcmp(buf_b, msg, 100) == 0);
+    ISOTP_rx_release(&b);
+
+    // Largest message, the sequence number wraps
+    ISOTP_send(&a, msg, ISOTP_MAX_LENGTH);
+    pump(&a, &b);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&b), ISOTP_MAX_LENGTH);
+    TEST_CHECK(memcmp(buf_b, msg, ISOTP_MAX_LENGTH) == 0);
+    ISOTP_rx_release(&b);
+
+    // Receiver buffer too small : overflow flow control
+    ISOTP_send(&b, msg, 65);
+    pump(&a, &b);
+    TEST_CHECK_EQ(ISOTP_get_tx_state(&b), ISOTP_TX_ERROR);
+    TEST_CHECK_EQ(ISOTP_get_error(&a, ISOTP_ERROR_OVERFLOW), 1);
+    TEST_CHECK_EQ(ISOTP_get_error(&b, ISOTP_ERROR_OVERFLOW), 1);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&a), 0);
+}
+
+static void test_rx_errors (void)
+{
+    uint8_t mem[16 + 4];
+    uint8_t *buf = &mem[2];
+    uint8_t ff[8] = {ISOTP_PCI_FF, 10, 1, 2, 3, 4, 5, 6};
+    uint8_t cf[8] = {ISOTP_PCI_CF | 1, 7, 8, 9, 10, 11, 12, 13};
+    STRUCT_ISOTP link;
+
+    memset(mem, 0xEE, sizeof(mem));
+    HOST_timebase_now = 0;
+    ISOTP_init(&link, &node, 0x7E0, 0x7E8, buf, 16, 0, 0);
+
+    // First frame shorter than 8 bytes is invalid and ignored
+    frame_qty = 0;
+    ff[1] = 7;
+    feed(&link, 0x7E8, ff, 8);
+    TEST_CHECK_EQ(frame_qty, 0);
+    TEST_CHECK_EQ(link.rx_state, ISOTP_RX_IDLE);
+    ff[1] = 10;
+    feed(&link, 0x7E8, ff, 7);
+    TEST_CHECK_EQ(frame_qty, 0);
+
+    // The last consecutive frame only copies the bytes of the message
+    feed(&link, 0x7E8, ff, 8);
+    TEST_CHECK_EQ(frame_qty, 1);
+    TEST_CHECK_EQ(frame_log[0].SID, 0x7E0);
+    TEST_CHECK_EQ(frame_log[0].payload[0], ISOTP_PCI_FC | ISOTP_FC_CTS);
+    feed(&link, 0x7E8, cf, 8);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&link), 10);
+    TEST_CHECK_EQ(buf[9], 10);
+    TEST_CHECK_EQ(buf[10], 0xEE);
+    TEST_CHECK_EQ(mem[0], 0xEE);
+    TEST_CHECK_EQ(mem[19], 0xEE);
+    ISOTP_rx_release(&link);
+
+    // Wrong sequence number
+    feed(&link, 0x7E8, ff, 8);
+    cf[0] = ISOTP_PCI_CF | 2;
+    feed(&link, 0x7E8, cf, 8);
+    TEST_CHECK_EQ(ISOTP_get_error(&link, ISOTP_ERROR_SEQUENCE), 1);
+    TEST_CHECK_EQ(link.rx_state, ISOTP_RX_IDLE);
+
+    // N_Cr
+    feed(&link, 0x7E8, ff, 8);
+    HOST_timebase_now += ISOTP_TIMEOUT_US + 1;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(ISOTP_get_error(&link, ISOTP_ERROR_TIMEOUT), 1);
+    TEST_CHECK_EQ(link.rx_state, ISOTP_RX_IDLE);
+
+    // Larger than the buffer
+    frame_qty = 0;
+    ff[1] = 17;
+    feed(&link, 0x7E8, ff, 8);
+    TEST_CHECK_EQ(frame_log[0].payload[0], ISOTP_PCI_FC | ISOTP_FC_OVERFLOW);
+    TEST_CHECK_EQ(ISOTP_get_error(&link, ISOTP_ERROR_OVERFLOW), 1);
+    TEST_CHECK_EQ(link.rx_state, ISOTP_RX_IDLE);
+}
+
+static void test_rx_hold_off (void)
+{
+    uint8_t buf[16];
+    uint8_t sf[8] = {0x02, 0xA1, 0xA2, 0, 0, 0, 0, 0};
+    uint8_t ff[8] = {ISOTP_PCI_FF, 9, 1, 2, 3, 4, 5, 6};
+    uint8_t cf[8] = {ISOTP_PCI_CF | 1, 7, 8, 9, 0, 0, 0, 0};
+    STRUCT_ISOTP link;
+    uint8_t i;
+
+    HOST_timebase_now = 0;
+    ISOTP_init(&link, &node, 0x7E0, 0x7E8, buf, sizeof(buf), 0, 0);
+    feed(&link, 0x7E8, sf, 8);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&link), 2);
+
+    // A first frame while the buffer is held is answered with FC_WAIT
+    frame_qty = 0;
+    feed(&link, 0x7E8, ff, 8);
+    TEST_CHECK_EQ(frame_qty, 1);
+    TEST_CHECK_EQ(frame_log[0].payload[0], ISOTP_PCI_FC | ISOTP_FC_WAIT);
+    TEST_CHECK_EQ(buf[0], 0xA1);
+    HOST_timebase_now += ISOTP_FC_WAIT_US - 1;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 1);
+    HOST_timebase_now += 1;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 2);
+    TEST_CHECK_EQ(frame_log[1].payload[0], ISOTP_PCI_FC | ISOTP_FC_WAIT);
+
+    // Released : the held first frame is accepted, the peer gets CTS
+    ISOTP_rx_release(&link);
+    TEST_CHECK_EQ(frame_qty, 3);
+    TEST_CHECK_EQ(frame_log[2].payload[0], ISOTP_PCI_FC | ISOTP_FC_CTS);
+    feed(&link, 0x7E8, cf, 8);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&link), 9);
+    TEST_CHECK_EQ(buf[0], 1);
+    TEST_CHECK_EQ(buf[8], 9);
+
+    // Never released : dropped after ISOTP_WFT_MAX FC_WAIT
+    frame_qty = 0;
+    feed(&link, 0x7E8, ff, 8);
+    for (i = 0; i < ISOTP_WFT_MAX + 2; i++)
+    {
+        HOST_timebase_now += ISOTP_FC_WAIT_US;
+        ISOTP_task(&link);
+    }
+    TEST_CHECK_EQ(frame_qty, ISOTP_WFT_MAX);
+    TEST_CHECK_EQ(ISOTP_get_error(&link, ISOTP_ERROR_TIMEOUT), 1);
+    frame_qty = 0;
+    ISOTP_rx_release(&link);
+    TEST_CHECK_EQ(frame_qty, 0);
+    TEST_CHECK_EQ(link.rx_state, ISOTP_RX_IDLE);
+}
+
+// Flow control refused by a full transmit queue : sent by the next task call
+static void test_fc_queue_full (void)
+{
+    uint8_t buf[32];
+    uint8_t ff[8] = {ISOTP_PCI_FF, 20, 1, 2, 3, 4, 5, 6};
+    uint8_t cf[8] = {ISOTP_PCI_CF | 1, 7, 8, 9, 10, 11, 12, 13};
+    STRUCT_ISOTP link;
+
+    HOST_timebase_now = 0;
+    ISOTP_init(&link, &node, 0x7E0, 0x7E8, buf, sizeof(buf), 1, 0);
+    frame_qty = 0;
+    queue_full = 1;
+    feed(&link, 0x7E8, ff, 8);
+    TEST_CHECK_EQ(frame_qty, 0);
+    TEST_CHECK_EQ(link.fc_pending, ISOTP_FC_CTS);
+    TEST_CHECK_EQ(link.rx_state, ISOTP_RX_RECEIVING);
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 0);
+
+    // Queue free again : the CTS goes out once, N_Cr restarts from it
+    queue_full = 0;
+    HOST_timebase_now += ISOTP_TIMEOUT_US / 2;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 1);
+    TEST_CHECK_EQ(frame_log[0].payload[0], ISOTP_PCI_FC | ISOTP_FC_CTS);
+    TEST_CHECK_EQ(frame_log[0].payload[1], 1);
+    TEST_CHECK_EQ(link.fc_pending, ISOTP_FC_NONE);
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 1);
+    HOST_timebase_now += (ISOTP_TIMEOUT_US / 2) + 1;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(ISOTP_get_error(&link, ISOTP_ERROR_TIMEOUT), 0);
+
+    // Block size 1 : the CTS after the 1st CF is refused, then sent
+    queue_full = 1;
+    feed(&link, 0x7E8, cf, 8);
+    TEST_CHECK_EQ(frame_qty, 1);
+    TEST_CHECK_EQ(link.fc_pending, ISOTP_FC_CTS);
+    queue_full = 0;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 2);
+    TEST_CHECK_EQ(frame_log[1].payload[0], ISOTP_PCI_FC | ISOTP_FC_CTS);
+    cf[0] = ISOTP_PCI_CF | 2;
+    feed(&link, 0x7E8, cf, 8);
+    TEST_CHECK_EQ(ISOTP_rx_get_length(&link), 20);
+    TEST_CHECK_EQ(buf[19], 13);
+    TEST_CHECK_EQ(frame_qty, 2);
+    ISOTP_rx_release(&link);
+
+    // Never sent before N_Cr : the transfer is dropped with its CTS
+    frame_qty = 0;
+    queue_full = 1;
+    feed(&link, 0x7E8, ff, 8);
+    HOST_timebase_now += ISOTP_TIMEOUT_US + 1;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(ISOTP_get_error(&link, ISOTP_ERROR_TIMEOUT), 1);
+    TEST_CHECK_EQ(link.fc_pending, ISOTP_FC_NONE);
+    queue_full = 0;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 0);
+
+    // Overflow flow control is also kept
+    ff[1] = 40;
+    queue_full = 1;
+    feed(&link, 0x7E8, ff, 8);
+    TEST_CHECK_EQ(link.fc_pending, ISOTP_FC_OVERFLOW);
+    queue_full = 0;
+    ISOTP_task(&link);
+    TEST_CHECK_EQ(frame_qty, 1);
+    TEST_CHECK_EQ(frame_log[0].payload[0], ISOTP_PCI_FC | ISOTP_FC_OVERFLOW);
+}
+
+int main (void)
+{
+    HOST_timebase_freq = 1000000;           // 1 tick = 1us
+    test_init();
+    test_single_frame();
+    test_segmented_send();
+    test_send_errors();
+    test_reassembly();
+    test_rx_errors();
+    test_rx_hold_off();
+    test_fc_queue_full();
+    return TEST_end("test_isotp");
+}
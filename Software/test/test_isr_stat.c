@@ -0,0 +1,187 @@
+//****************************************************************************//
+// File      :  test_isr_stat.c
+//
+// Includes  :  isr_stat.h, test.h
+//
+// Purpose   :  ISR_STAT on simulated interrupts. Three sources fire at
+//              pseudo-random times while the main code runs masked sections
+//              (IPL 7), each ISR body has a known run time and reports its
+//              latency from the request, as the timer ISRs do from TMRx.
+//              Counts, durations and latencies must match the simulation
+//              exactly once the calibrated probe overhead is removed.
+//              Each timebase read costs READ_COST cycles, the XC16 cost of
+//              TIMER_timebase_get with its IPL save / restore, which bounds
+//              the instrumentation share of the CPU
+//****************************************************************************//
+#include "isr_stat.h"
+#include "test.h"
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq, HOST_timebase_step;
+
+#define READ_COST       24                      // Cycles per timebase read
+#define RUN_CYCLES      (FCY / 2)
+#define SRC_QTY         3
+
+typedef struct
+{
+    uint8_t vector;
+    uint32_t period;                            // Mean request period, cycles
+    uint32_t body_max;                          // ISR body run time, cycles
+    uint8_t ipl;
+    uint32_t request;                           // Next request time
+    uint32_t count;
+    uint32_t body_seen;
+    uint32_t latency_seen;
+}STRUCT_SRC;
+
+static STRUCT_SRC src[SRC_QTY] =
+{
+    {ISR_VECT_T1,    FCY / 1000,  300, 4},      // 1kHz timer
+    {ISR_VECT_U1RX,  FCY / 46080, 120, 7},      // 460800bps receive
+    {ISR_VECT_C1,    FCY / 4000,  800, 4},      // CAN frames
+};
+static uint32_t rng = 7;
+static uint64_t probe_cycles;
+
+static uint32_t rand_range (uint32_t lo, uint32_t hi)
+{
+    rng = rng * 1103515245UL + 12345UL;
+    return lo + ((rng >> 8) % (hi - lo + 1));
+}
+
+// Instrumented ISR, as _T1Interrupt : ENTER, LATENCY, body, EXIT
+static void isr (STRUCT_SRC *s)
+{
+    uint32_t t0 = HOST_timebase_now, body, latency;
+    ISR_STAT_ENTER(s->vector);
+
+    latency = isr_stat_entry - s->request;
+    ISR_STAT_LATENCY(s->vector, latency);
+    body = rand_range(s->body_max / 4, s->body_max);
+    HOST_timebase_now += body;
+    ISR_STAT_EXIT(s->vector);
+
+    s->count++;
+    if (body > s->body_seen){s->body_seen = body;}
+    if (latency > s->latency_seen){s->latency_seen = latency;}
+    probe_cycles += (HOST_timebase_now - t0) - body;
+    s->request += rand_range(s->period / 2, (3 * s->period) / 2);
+}
+
+// Pending requests up to now, the highest IPL first when the CPU allows it
+static void dispatch (void)
+{
+    STRUCT_SRC *s;
+    uint8_t i;
+
+    do
+    {
+        s = 0;
+        for (i = 0; i < SRC_QTY; i++)
+        {
+            if (((int32_t)(HOST_timebase_now - src[i].request) >= 0) && (src[i].ipl > HOST_cpu_ipl))
+            {
+                if ((s == 0) || (src[i].ipl > s->ipl)){s = &src[i];}
+            }
+        }
+        if (s != 0)
+        {
+            uint16_t save = HOST_cpu_ipl;
+            HOST_cpu_ipl = s->ipl;
+            isr(s);
+            HOST_cpu_ipl = save;
+        }
+    }while (s != 0);
+}
+
+// Main code advances one cycle step at a time so requests are served on time
+static void run (uint32_t cycles)
+{
+    while (cycles > 0)
+    {
+        dispatch();
+        HOST_timebase_now += 1;
+        cycles--;
+    }
+    dispatch();
+}
+
+static void test_overhead (void)
+{
+    ISR_STAT_init();
+    printf("  probe overhead : %lu cycles\n", (unsigned long)ISR_STAT_get_overhead());
+    TEST_CHECK_EQ(ISR_STAT_get_overhead(), READ_COST);
+    TEST_CHECK_EQ(ISR_STAT_get(ISR_VECT_T1, ISR_STAT_COUNT), 0);
+    TEST_CHECK_EQ(ISR_STAT_get(ISR_VECT_T1, ISR_STAT_DURATION_MAX), 0);
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+static void test_interrupts (void)
+{
+    uint32_t start = HOST_timebase_now, masked_max = 0, masked, isr_max;
+    double share, bound;
+    uint8_t i;
+
+    for (i = 0; i < SRC_QTY; i++)
+    {
+        src[i].request = start + rand_range(0, src[i].period);
+    }
+    // Main code : masked sections of up to 2000 cycles between free running code
+    while ((HOST_timebase_now - start) < RUN_CYCLES)
+    {
+        run(rand_range(100, 5000));
+        masked = rand_range(10, 2000);
+        if (masked > masked_max){masked_max = masked;}
+        HOST_cpu_ipl = 7;
+        HOST_timebase_now += masked;
+        HOST_cpu_ipl = 0;
+    }
+    dispatch();
+
+    printf("  %-6s %8s %10s %10s\n", "vector", "count", "dur max", "lat max");
+    for (i = 0; i < SRC_QTY; i++)
+    {
+        printf("  %-6u %8lu %10lu %10lu\n", src[i].vector, (unsigned long)ISR_STAT_get(src[i].vector, ISR_STAT_COUNT),
+               (unsigned long)ISR_STAT_get(src[i].vector, ISR_STAT_DURATION_MAX),
+               (unsigned long)ISR_STAT_get(src[i].vector, ISR_STAT_LATENCY_MAX));
+        TEST_CHECK_EQ(ISR_STAT_get(src[i].vector, ISR_STAT_COUNT), src[i].count);
+        TEST_CHECK_EQ(ISR_STAT_get(src[i].vector, ISR_STAT_DURATION_MAX), src[i].body_seen);
+        TEST_CHECK_EQ(ISR_STAT_get(src[i].vector, ISR_STAT_LATENCY_MAX), src[i].latency_seen);
+    }
+    // Nesting is disabled : the IPL 7 receive ISR is served first but waits
+    // for a masked section or for the ISR in progress, the IPL 4 ones also
+    // wait for each other and for the receive ISR
+    isr_max = src[2].body_max + (2 * READ_COST);
+    TEST_CHECK(ISR_STAT_get(ISR_VECT_U1RX, ISR_STAT_LATENCY_MAX) <= ((masked_max > isr_max) ? masked_max : isr_max));
+    TEST_CHECK(ISR_STAT_get(ISR_VECT_T1, ISR_STAT_LATENCY_MAX) > masked_max / 2);
+
+    // Instrumentation bound : 2 timebase reads per ISR, the CPU share is
+    // 2 * READ_COST per request at the mean request rates, about 3.5% here
+    // where the byte rate receive ISR dominates
+    TEST_CHECK_EQ(probe_cycles, 2ULL * READ_COST * (src[0].count + src[1].count + src[2].count));
+    share = (1000.0 * probe_cycles) / (HOST_timebase_now - start);
+    bound = 0;
+    for (i = 0; i < SRC_QTY; i++)
+    {
+        bound += (1000.0 * 2 * READ_COST) / src[i].period;
+    }
+    printf("  instrumentation : %.1f permille of the CPU, analytic %.1f\n", share, bound);
+    TEST_CHECK(share <= bound * 1.05);
+    TEST_CHECK(share < 40.0);
+
+    ISR_STAT_reset(ISR_VECT_C1);
+    TEST_CHECK_EQ(ISR_STAT_get(ISR_VECT_C1, ISR_STAT_COUNT), 0);
+    TEST_CHECK_EQ(ISR_STAT_get(ISR_VECT_C1, ISR_STAT_LATENCY_MAX), 0);
+    TEST_CHECK_EQ(ISR_STAT_get(ISR_VECT_QTY, ISR_STAT_COUNT), 0);
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+int main (void)
+{
+    HOST_timebase_freq = FCY;
+    HOST_timebase_step = READ_COST;
+    HOST_timebase_now = 0xFFFFFFFFUL - (FCY / 10);     // Wraps during the run
+    test_overhead();
+    test_interrupts();
+    return TEST_end("test_isr_stat");
+}
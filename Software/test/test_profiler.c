@@ -0,0 +1,203 @@
+//****************************************************************************//
+// File      :  test_profiler.c
+//
+// Includes  :  profiler.h, prof_decode.h, test.h
+//
+// Purpose   :  Probe overhead calibration and removal, then PROF_export of
+//              the region statistics and the entry / exit ring through a
+//              UART capture, decoded back by tools/prof_decode. Each timebase
+//              read costs HOST_timebase_step ticks as the probes would
+//****************************************************************************//
+#include "profiler.h"
+#include "prof_decode.h"
+#include "test.h"
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq, HOST_timebase_step;
+extern STRUCT_PROFILER PROF_struct;
+
+#define READ_COST       12                      // Ticks per timebase read
+#define CAPTURE_LINES   64
+
+static char capture[CAPTURE_LINES][81];
+static uint16_t capture_count;
+static uint16_t uart_calls;
+static STRUCT_PROF_DECODE dec;
+static STRUCT_PROF_SPAN span[PROF_DECODE_RECORD_QTY];
+
+// Debug port : busy on every 3rd call, as when the previous DMA is not done
+uint8_t UART_putstr_dma (STRUCT_UART *uart, const char *string)
+{
+    if ((++uart_calls % 3) == 0)
+    {
+        return 0;
+    }
+    TEST_CHECK(strlen(string) < sizeof(capture[0]));
+    if (capture_count < CAPTURE_LINES)
+    {
+        strcpy(capture[capture_count++], string);
+    }
+    return 1;
+}
+
+static void region (uint8_t r, uint32_t ticks)
+{
+    PROF_enter(r);
+    HOST_timebase_now += ticks;
+    PROF_exit(r);
+}
+
+static uint16_t export_all (STRUCT_UART *uart)
+{
+    uint16_t calls = 0;
+
+    capture_count = 0;
+    while (PROF_export(uart) == PROF_EXPORT_BUSY)
+    {
+        // Probes keep running between lines, the ring does not move
+        region(0, 5);
+        calls++;
+        TEST_CHECK(calls < 200);
+    }
+    return calls;
+}
+
+static void test_overhead (void)
+{
+    uint16_t k;
+
+    PROF_init();
+    printf("  probe overhead : %lu ticks\n", (unsigned long)PROF_get_overhead());
+    TEST_CHECK_EQ(PROF_get_overhead(), READ_COST);
+    TEST_CHECK_EQ(PROF_struct.ring_count, 0);
+    TEST_CHECK_EQ(PROF_get_stat(0, PROF_STAT_COUNT), 0);
+
+    // Durations are exact once the calibrated overhead is removed
+    PROF_region_init(0, "motor_pid");
+    for (k = 0; k < 10; k++)
+    {
+        region(0, 1000 + k);
+    }
+    TEST_CHECK_EQ(PROF_get_stat(0, PROF_STAT_COUNT), 10);
+    TEST_CHECK_EQ(PROF_get_stat(0, PROF_STAT_MIN), 1000);
+    TEST_CHECK_EQ(PROF_get_stat(0, PROF_STAT_MAX), 1009);
+    TEST_CHECK_EQ(PROF_get_stat(0, PROF_STAT_AVG), 1004);
+    region(0, 0);
+    TEST_CHECK_EQ(PROF_get_stat(0, PROF_STAT_LAST), 0);
+}
+
+static void test_export_decode (void)
+{
+    STRUCT_UART uart;
+    uint16_t k, n, lines_ring = 0, runs_0 = 0;
+    uint32_t start[PROF_REGION_QTY] = {0};
+    int ret;
+
+    PROF_init();
+    PROF_region_init(0, "motor_pid");
+    PROF_region_init(2, "eve_keys");
+    for (k = 0; k < 40; k++)
+    {
+        region(0, 1000 + k);
+        HOST_timebase_now += 500;
+        PROF_enter(2);
+        region(5, 77);                          // Unnamed, nested in region 2
+        HOST_timebase_now += 3000;
+        PROF_exit(2);
+    }
+    TEST_CHECK_EQ(PROF_struct.ring_count, PROF_RING_SIZE);
+
+    export_all(&uart);
+    TEST_CHECK_EQ(capture_count, 2 + 1 + ((PROF_RING_SIZE + PROF_EXPORT_RECORDS - 1) / PROF_EXPORT_RECORDS));
+    TEST_CHECK_EQ(PROF_struct.ring_freeze, 0);
+    printf("  %s  %s  %s  %s", capture[0], capture[1], capture[2], capture[3]);
+
+    PROF_decode_init(&dec);
+    for (k = 0; k < capture_count; k++)
+    {
+        ret = PROF_decode_line(&dec, capture[k]);
+        TEST_CHECK_EQ(ret, 1);
+        if (strncmp(capture[k], "PROFR", 5) == 0){lines_ring++;}
+    }
+    TEST_CHECK_EQ(PROF_decode_line(&dec, "BTN1 pressed\r\n"), 0);
+    TEST_CHECK_EQ(PROF_decode_line(&dec, "PROF motor_pid n=3\r\n"), -1);
+
+    // Region statistics, read while region 0 kept running during the export
+    TEST_CHECK_EQ(strcmp(dec.region[0].name, "motor_pid"), 0);
+    TEST_CHECK_EQ(strcmp(dec.region[2].name, "eve_keys"), 0);
+    TEST_CHECK_EQ(dec.region[5].name[0], 0);
+    TEST_CHECK_EQ(dec.region[0].min, 1000);
+    TEST_CHECK_EQ(dec.region[2].count, 40);
+    TEST_CHECK_EQ(dec.region[2].min, PROF_get_stat(2, PROF_STAT_MIN));
+    TEST_CHECK_EQ(dec.region[2].max, PROF_get_stat(2, PROF_STAT_MAX));
+    TEST_CHECK_EQ(dec.ring_count, PROF_RING_SIZE);
+    TEST_CHECK_EQ(dec.overhead, READ_COST);
+    TEST_CHECK_EQ(dec.freq, FCY);
+
+    // Ring : the last 64 records, oldest first, 6 per iteration. Region 0 
+    // of the oldest iteration is cut by the wrap, its exit is dropped
+    TEST_CHECK_EQ(lines_ring, (PROF_RING_SIZE + PROF_EXPORT_RECORDS - 1) / PROF_EXPORT_RECORDS);
+    TEST_CHECK_EQ(dec.record_count, PROF_RING_SIZE);
+    TEST_CHECK_EQ(dec.record[PROF_RING_SIZE - 1].region, 2);
+    TEST_CHECK_EQ(dec.record[PROF_RING_SIZE - 1].type, PROF_RECORD_EXIT);
+    n = PROF_decode_spans(&dec, span, PROF_DECODE_RECORD_QTY);
+    TEST_CHECK_EQ(n, (3 * (PROF_RING_SIZE / 6)) + 2);
+    for (k = 0; k < n; k++)
+    {
+        switch (span[k].region)
+        {
+            case 0:
+                TEST_CHECK_EQ(span[k].duration, 1000 + 40 - (PROF_RING_SIZE / 6) + runs_0);
+                runs_0++;
+                break;
+            case 5:
+                TEST_CHECK_EQ(span[k].duration, 77);
+                break;
+            case 2:
+                // Includes the nested probe pair
+                TEST_CHECK_EQ(span[k].duration, 3000 + 77 + (2 * READ_COST));
+                TEST_CHECK_EQ(span[k].duration, PROF_get_stat(2, PROF_STAT_LAST));
+                break;
+            default:
+                TEST_CHECK(0);
+                break;
+        }
+        // Spans come in exit order, nested ones first
+        if (start[span[k].region] != 0){TEST_CHECK((int32_t)(span[k].start - start[span[k].region]) > 0);}
+        start[span[k].region] = span[k].start;
+    }
+    TEST_CHECK_EQ(runs_0, PROF_RING_SIZE / 6);
+
+    // Recording resumes after the export
+    region(2, 10);
+    TEST_CHECK_EQ(PROF_get_record(0)->region, 2);
+    TEST_CHECK_EQ(PROF_get_record(0)->type, PROF_RECORD_EXIT);
+    TEST_CHECK_EQ(PROF_get_record(1)->type, PROF_RECORD_ENTER);
+    TEST_CHECK_EQ(PROF_get_record(0)->timestamp - PROF_get_record(1)->timestamp, 10 + READ_COST);
+}
+
+static void test_export_short_ring (void)
+{
+    STRUCT_UART uart;
+
+    PROF_init();
+    region(1, 250);
+    export_all(&uart);
+    TEST_CHECK_EQ(capture_count, 2);            // No named region : header and 2 records
+    PROF_decode_init(&dec);
+    TEST_CHECK_EQ(PROF_decode_line(&dec, capture[0]), 1);
+    TEST_CHECK_EQ(PROF_decode_line(&dec, capture[1]), 1);
+    TEST_CHECK_EQ(dec.ring_count, 2);
+    TEST_CHECK_EQ(PROF_decode_spans(&dec, span, PROF_DECODE_RECORD_QTY), 1);
+    TEST_CHECK_EQ(span[0].duration, 250);
+}
+
+int main (void)
+{
+    HOST_timebase_freq = FCY;
+    HOST_timebase_step = READ_COST;
+    HOST_timebase_now = 0xFFFFFFFFUL - 100000;  // Wraps during the tests
+    test_overhead();
+    test_export_decode();
+    test_export_short_ring();
+    return TEST_end("test_profiler");
+}
@@ -0,0 +1,115 @@
+//****************************************************************************//
+// File      :  test_pwm.c
+//
+// Includes  :  pwm.h, test.h
+//
+// Purpose   :  PWM_init periods on both time bases, PWM_change_duty scaling
+//              of the Q15 duty to the duty register of every channel, the
+//              1% path and the servo base / end values
+//****************************************************************************//
+#include <math.h>
+#include "pwm.h"
+#include "test.h"
+
+typedef struct
+{
+    uint8_t channel;
+    volatile uint16_t *period;
+    volatile uint16_t *duty;
+    uint32_t phase;
+    uint8_t mtbs;
+    float servo_base;
+    float servo_end;
+}STRUCT_TEST_PWM;
+
+static const STRUCT_TEST_PWM pwm_map[PWM_QTY] =
+{
+    {PWM_1L, &SPHASE1, &SDC1, PWM1L_PHASE, PWM1_MTBS, PWM1L_SERVO_BASE, PWM1L_SERVO_END},
+    {PWM_1H, &PHASE1, &PDC1, PWM1H_PHASE, PWM1_MTBS, PWM1H_SERVO_BASE, PWM1H_SERVO_END},
+    {PWM_2L, &SPHASE2, &SDC2, PWM2L_PHASE, PWM2_MTBS, PWM2L_SERVO_BASE, PWM2L_SERVO_END},
+    {PWM_2H, &PHASE2, &PDC2, PWM2H_PHASE, PWM2_MTBS, PWM2H_SERVO_BASE, PWM2H_SERVO_END},
+    {PWM_4H, &PHASE4, &PDC4, PWM4H_PHASE, PWM4_MTBS, PWM4H_SERVO_BASE, PWM4H_SERVO_END},
+    {PWM_5L, &SPHASE5, &SDC5, PWM5L_PHASE, PWM5_MTBS, PWM5L_SERVO_BASE, PWM5L_SERVO_END},
+    {PWM_5H, &PHASE5, &PDC5, PWM5H_PHASE, PWM5_MTBS, PWM5H_SERVO_BASE, PWM5H_SERVO_END},
+    {PWM_6L, &SPHASE6, &SDC6, PWM6L_PHASE, PWM6_MTBS, PWM6L_SERVO_BASE, PWM6L_SERVO_END},
+    {PWM_6H, &PHASE6, &PDC6, PWM6H_PHASE, PWM6_MTBS, PWM6H_SERVO_BASE, PWM6H_SERVO_END},
+};
+
+static void test_load (const STRUCT_TEST_PWM *map)
+{
+    STRUCT_PWM pwm;
+    uint32_t duty;
+    uint16_t last = 0, period;
+    double exact, err_max = 0;
+    uint8_t perc;
+
+    PWM_init(&pwm, map->channel, PWM_TYPE_LOAD);
+    period = (uint16_t)(FOSC / (map->phase * PWM_TB_PRESCALE(map->mtbs)));
+    TEST_CHECK_EQ(*map->period, period);
+    TEST_CHECK_EQ(pwm.range, period);
+    TEST_CHECK_EQ(*map->duty, 0);
+    TEST_CHECK_EQ(PTCONbits.PTEN, 1);
+
+    // Every Q15 duty : rounded to nearest, monotonic
+    for (duty = 0; duty <= PWM_DUTY_MAX; duty++)
+    {
+        PWM_change_duty(&pwm, (uint16_t)duty);
+        exact = (double)pwm.range * duty / PWM_DUTY_MAX;
+        if (fabs(*map->duty - exact) > err_max){err_max = fabs(*map->duty - exact);}
+        if (*map->duty < last){TEST_CHECK(0);}
+        last = *map->duty;
+    }
+    TEST_CHECK(err_max <= 0.5);
+    TEST_CHECK_EQ(*map->duty, pwm.range);
+    TEST_CHECK_EQ(PWM_get_duty(&pwm), PWM_DUTY_MAX);
+    TEST_CHECK_EQ(PWM_get_position(&pwm), 100);
+
+    PWM_change_duty(&pwm, 0xFFFF);              // Clamped to 100%
+    TEST_CHECK_EQ(*map->duty, pwm.range);
+    TEST_CHECK_EQ(PWM_get_duty(&pwm), PWM_DUTY_MAX);
+
+    // 1% steps
+    for (perc = 0; perc <= 100; perc++)
+    {
+        PWM_change_duty_perc(&pwm, perc);
+        TEST_CHECK_NEAR(*map->duty, (double)pwm.range * perc / 100, 0.5 + (pwm.range / 65536.0));
+        TEST_CHECK_EQ(PWM_get_position(&pwm), perc);
+    }
+    PWM_change_duty_perc(&pwm, 150);
+    TEST_CHECK_EQ(*map->duty, pwm.range);
+}
+
+static void test_servo (const STRUCT_TEST_PWM *map)
+{
+    STRUCT_PWM pwm;
+    uint16_t period;
+
+    PWM_init(&pwm, map->channel, PWM_TYPE_SERVO);
+    period = (uint16_t)(FOSC / (map->phase * PWM_TB_PRESCALE(map->mtbs)));
+    TEST_CHECK_EQ(pwm.base_value, (uint16_t)(period * map->servo_base));
+    TEST_CHECK_EQ(pwm.end_value, (uint16_t)(period * map->servo_end));
+    TEST_CHECK_EQ(*map->duty, pwm.base_value);
+    PWM_change_duty(&pwm, PWM_DUTY_MAX);
+    TEST_CHECK_EQ(*map->duty, pwm.end_value);
+    PWM_change_duty(&pwm, PWM_DUTY_MAX / 2);
+    TEST_CHECK_NEAR(*map->duty, (pwm.base_value + pwm.end_value) / 2.0, 0.5);
+}
+
+int main (void)
+{
+    uint8_t i;
+
+    for (i = 0; i < PWM_QTY; i++)
+    {
+        test_load(&pwm_map[i]);
+        test_servo(&pwm_map[i]);
+    }
+
+    // Servo channels on the 1:64 time base, motors at full resolution
+    TEST_CHECK_EQ(STCON2bits.PCLKDIV, PWM_SERVO_CLOCK_PCLKDIV);
+    TEST_CHECK_EQ(PTCON2bits.PCLKDIV, PWM_CLOCK_PCLKDIV);
+    TEST_CHECK_EQ(PWMCON4bits.MTBS, PWM_MTBS_SECONDARY);
+    TEST_CHECK_EQ(PWMCON1bits.MTBS, PWM_MTBS_PRIMARY);
+    TEST_CHECK_EQ(PHASE1, FOSC / PWM1H_PHASE);
+    return TEST_end("test_pwm");
+}
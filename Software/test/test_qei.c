@@ -0,0 +1,228 @@
+//****************************************************************************//
+// File      :  test_qei.c
+//
+// Includes  :  QEI.h, test.h
+//
+// Purpose   :  QEI_calculate_velocity edge timed estimator. A simulated
+//              encoder with evenly spaced edges sets VEL1CNT, INT1TMR and
+//              INT1HLD before each call, polled at 30Hz on a FCY timebase
+//****************************************************************************//
+#include "QEI.h"
+#include "test.h"
+
+extern STRUCT_QEI QEI_struct[];
+extern uint16_t HOST_cpu_ipl;
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+
+#define POLL        (FCY / 30UL)            // Main loop period, FCY ticks
+#define RPM(x)      ((x) / 65536.0)
+
+typedef struct
+{
+    uint32_t period;                        // FCY ticks between edges, 0 = stopped
+    int8_t dir;
+    uint32_t next_edge;
+    uint32_t last_edge;
+    uint32_t prev_period;
+    int16_t count;
+}STRUCT_ENC;
+
+// Edges up to now, then the registers as QEI_calculate_velocity reads them
+static void poll (STRUCT_ENC *enc, uint32_t now)
+{
+    uint32_t since;
+
+    while ((enc->period != 0) && ((int32_t)(now - enc->next_edge) >= 0))
+    {
+        enc->prev_period = enc->next_edge - enc->last_edge;
+        enc->last_edge = enc->next_edge;
+        enc->next_edge += enc->period;
+        enc->count += enc->dir;
+    }
+    since = now - enc->last_edge;
+    HOST_timebase_now = now;
+    VEL1CNT = (uint16_t)enc->count;
+    enc->count = 0;
+    INT1TMRH = since >> 16;
+    INT1TMRL = since & 0xFFFF;
+    INT1HLDH = enc->prev_period >> 16;
+    INT1HLDL = enc->prev_period & 0xFFFF;
+    QEI_calculate_velocity(QEI_1);
+}
+
+static void enc_start (STRUCT_ENC *enc, uint32_t t0, uint32_t period, int8_t dir)
+{
+    enc->period = period;
+    enc->dir = dir;
+    enc->last_edge = t0 - period;
+    enc->next_edge = t0;
+    enc->prev_period = period;
+    enc->count = 0;
+}
+
+static double enc_rpm (uint32_t period)
+{
+    return (60.0 * FCY) / ((double)period * QEI_MOT1_PPT);
+}
+
+static void test_constant (void)
+{
+    const double rpms[] = {0.5, 1, 2, 5, 10, 20, 35, 60, 100, 130};
+    STRUCT_ENC enc;
+    uint32_t t, period;
+    uint8_t r;
+    uint16_t n;
+
+    for (r = 0; r < (sizeof(rpms) / sizeof(rpms[0])); r++)
+    {
+        period = (uint32_t)((60.0 * FCY) / (rpms[r] * QEI_MOT1_PPT));
+        QEI_init(QEI_1);
+        QEI_set_fs(QEI_1, 30);
+        t = 12345;
+        enc_start(&enc, t, period, 1);
+        for (n = 0; n < 90; n++)
+        {
+            t += POLL;
+            poll(&enc, t);
+            // Between two edges the speed only drops to 1 count / since,
+            // which is never below the real speed here
+            TEST_CHECK_NEAR(RPM(QEI_get_speed_rpm_q16(QEI_1)), enc_rpm(period), enc_rpm(period) * 1e-5);
+        }
+        TEST_CHECK_EQ(QEI_get_direction(QEI_1), QEI_DIR_FORWARD);
+        TEST_CHECK_EQ(QEI_get_speed_rpm(QEI_1), (uint16_t)(enc_rpm(period) + 0.5));
+        TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+    }
+}
+
+static void test_direction (void)
+{
+    STRUCT_ENC enc;
+    uint32_t t = 0, period = (uint32_t)((60.0 * FCY) / (20 * QEI_MOT1_PPT));
+    uint8_t n;
+
+    QEI_init(QEI_1);
+    QEI_set_fs(QEI_1, 30);
+    enc_start(&enc, t, period, -1);
+    for (n = 0; n < 10; n++)
+    {
+        t += POLL;
+        poll(&enc, t);
+    }
+    TEST_CHECK_EQ(QEI_get_direction(QEI_1), QEI_DIR_BACKWARD);
+    TEST_CHECK_NEAR(RPM(QEI_get_speed_rpm_q16(QEI_1)), 20, 0.001);
+    TEST_CHECK_EQ(QEI_get_velocity(QEI_1), (POLL + period - 1) / period);
+
+    enc.dir = 1;
+    t += POLL;
+    poll(&enc, t);
+    TEST_CHECK_EQ(QEI_get_direction(QEI_1), QEI_DIR_FORWARD);
+}
+
+static void test_start_stop (void)
+{
+    STRUCT_ENC enc = {0};
+    uint32_t t = 0xFFFFFFFFUL - (2 * POLL), period = (uint32_t)((60.0 * FCY) / (20 * QEI_MOT1_PPT));
+    uint32_t last = 0;
+    uint8_t n;
+
+    QEI_init(QEI_1);
+    QEI_set_fs(QEI_1, 30);
+
+    // Standing still
+    enc.last_edge = t;
+    t += POLL;
+    poll(&enc, t);
+    TEST_CHECK_EQ(QEI_get_speed_rpm_q16(QEI_1), 0);
+
+    // 1st period with edges : the last edge period (INT1HLD) only,
+    // across the timebase wrap
+    enc_start(&enc, t + 1000, period, 1);
+    t += POLL;
+    poll(&enc, t);
+    TEST_CHECK_NEAR(RPM(QEI_get_speed_rpm_q16(QEI_1)), enc_rpm(period), 0.001);
+    t += POLL;
+    poll(&enc, t);
+    TEST_CHECK(t < POLL);
+    TEST_CHECK_NEAR(RPM(QEI_get_speed_rpm_q16(QEI_1)), enc_rpm(period), 0.001);
+
+    // Encoder stops : 1 count / since bound, then 0 after QEI_VEL_TIMEOUT
+    enc.period = 0;
+    last = QEI_get_speed_rpm_q16(QEI_1);
+    for (n = 0; n < 30; n++)
+    {
+        t += POLL;
+        poll(&enc, t);
+        if ((t - enc.last_edge) > QEI_VEL_TIMEOUT)
+        {
+            TEST_CHECK_EQ(QEI_get_speed_rpm_q16(QEI_1), 0);
+            TEST_CHECK_EQ(QEI_get_speed_rpm(QEI_1), 0);
+        }
+        else
+        {
+            TEST_CHECK(QEI_get_speed_rpm_q16(QEI_1) < last);
+            TEST_CHECK_NEAR(RPM(QEI_get_speed_rpm_q16(QEI_1)), enc_rpm(t - enc.last_edge), 0.001);
+            last = QEI_get_speed_rpm_q16(QEI_1);
+        }
+    }
+
+    // Restart after the timeout uses INT1HLD again, not the stale edge
+    enc_start(&enc, t + 1000, period / 2, 1);
+    t += POLL;
+    poll(&enc, t);
+    TEST_CHECK_NEAR(RPM(QEI_get_speed_rpm_q16(QEI_1)), enc_rpm(period / 2), 0.002);
+}
+
+static void test_no_timebase (void)
+{
+    HOST_timebase_freq = 0;
+    QEI_init(QEI_1);
+    QEI_set_fs(QEI_1, 30);
+
+    // Count per refresh period : 176 counts x 30Hz = 5280 counts/s
+    VEL1CNT = (uint16_t)-176;
+    QEI_calculate_velocity(QEI_1);
+    TEST_CHECK_EQ(QEI_get_velocity(QEI_1), 176);
+    TEST_CHECK_EQ(QEI_get_direction(QEI_1), QEI_DIR_BACKWARD);
+    TEST_CHECK_NEAR(RPM(QEI_get_speed_rpm_q16(QEI_1)), 176.0 * 30 * 60 / QEI_MOT1_PPT, 0.001);
+    VEL1CNT = 176;
+    QEI_calculate_velocity(QEI_1);
+    TEST_CHECK_EQ(QEI_get_direction(QEI_1), QEI_DIR_FORWARD);
+    HOST_timebase_freq = FCY;
+}
+
+static void test_range (void)
+{
+    QEI_init(QEI_1);
+    QEI_set_fs(QEI_1, 30);
+
+    // The constant follows the cpr and gear derate
+    QEI_set_cpr(QEI_1, 12);
+    TEST_CHECK_EQ(QEI_struct[QEI_1].pulse_per_tour, 12 * QEI_MOT1_GDR);
+    TEST_CHECK_EQ(QEI_struct[QEI_1].rpm_num, QEI_VEL_RPM_NUM / (12 * QEI_MOT1_GDR));
+    QEI_set_gear_derate(QEI_1, 0);
+    TEST_CHECK_EQ(QEI_struct[QEI_1].rpm_num, 0);
+
+    // Bare encoder, 1 count per turn : over 65535 RPM saturates
+    QEI_set_gear_derate(QEI_1, 1);
+    QEI_set_cpr(QEI_1, 1);
+    HOST_timebase_now = 1000;
+    VEL1CNT = 1000;
+    INT1TMRH = 0;
+    INT1TMRL = 0;
+    INT1HLDH = 0;
+    INT1HLDL = 100;
+    QEI_calculate_velocity(QEI_1);
+    TEST_CHECK_EQ(QEI_get_speed_rpm_q16(QEI_1), 0xFFFFFFFFUL);
+    TEST_CHECK_EQ(QEI_get_speed_rpm(QEI_1), 0xFFFF);
+}
+
+int main (void)
+{
+    HOST_timebase_freq = FCY;
+    test_constant();
+    test_direction();
+    test_start_stop();
+    test_no_timebase();
+    test_range();
+    return TEST_end("test_qei");
+}
@@ -0,0 +1,193 @@
+//****************************************************************************//
+// File      :  test_scheduler.c
+//
+// Includes  :  scheduler.h, test.h
+//
+// Purpose   :  Replay of the dsPeak_dev task mix (main.c priorities and
+//              periods) for 10s of timebase. Each handler consumes a varying
+//              run time, a UART receive ISR posts events at any time, also
+//              while a task runs. Worst-case dispatch latency per task is
+//              reported and bounded by the non-preemptive analysis :
+//              longest other task + one run of every higher priority task
+//****************************************************************************//
+#include "scheduler.h"
+#include "test.h"
+
+extern uint32_t HOST_timebase_now, HOST_timebase_freq;
+extern STRUCT_TASK SCHED_task_struct[SCHED_TASK_QTY];
+
+#define US(x)           ((uint32_t)(x) * (FCY / 1000000UL))
+#define RUN_TIME_S      10UL
+#define ISR_PERIOD_US   7300UL                  // UART receive events on TASK_uart1_tx
+
+typedef struct
+{
+    const char *name;
+    uint32_t period_us;
+    uint32_t cost_us;                           // Worst-case run time
+}STRUCT_LOAD;
+
+// dsPeak_dev main.c, run times of the FT8XX redraw and the others estimated
+static const STRUCT_LOAD load[SCHED_TASK_QTY] =
+{
+    {"motor1_pid",   33333,  120},
+    {"motor2_pid",   33333,  120},
+    {"uart1_tx",    100000,   40},
+    {"uart2_tx",    100000,   40},
+    {"button",       33333,   30},
+    {"motor_debug",  33333,   80},
+    {"5sec",        200000,  900},              // Profiler export on the debug port
+    {"eve_refresh",  16667, 3500},
+};
+
+static uint32_t rng = 1;
+static uint32_t isr_next;
+static uint32_t isr_count;
+static uint32_t run_count[SCHED_TASK_QTY];
+
+static uint32_t rand_range (uint32_t lo, uint32_t hi)
+{
+    rng = rng * 1103515245UL + 12345UL;
+    return lo + ((rng >> 8) % (hi - lo + 1));
+}
+
+// ISRs that fire up to the timebase value "until"
+static void isr_until (uint32_t until)
+{
+    uint32_t now = HOST_timebase_now;
+
+    while ((int32_t)(until - isr_next) >= 0)
+    {
+        HOST_timebase_now = isr_next;
+        SCHED_post_event(2, SCHED_EVENT_USER_1);
+        isr_count++;
+        isr_next += US(ISR_PERIOD_US) + US(rand_range(0, 500));
+    }
+    HOST_timebase_now = now;
+}
+
+// Task body : 50 to 100% of the worst-case run time
+static void work (uint8_t prio)
+{
+    uint32_t end = HOST_timebase_now + US(rand_range(load[prio].cost_us / 2, load[prio].cost_us));
+
+    run_count[prio]++;
+    isr_until(end);
+    HOST_timebase_now = end;
+}
+
+static void task_0 (uint16_t events){work(0);}
+static void task_1 (uint16_t events){work(1);}
+static void task_2 (uint16_t events){work(2);}
+static void task_3 (uint16_t events){work(3);}
+static void task_4 (uint16_t events){work(4);}
+static void task_5 (uint16_t events){work(5);}
+static void task_6 (uint16_t events){work(6);}
+static void task_7 (uint16_t events){work(7);}
+
+static void (* const handler[SCHED_TASK_QTY])(uint16_t) =
+{
+    task_0, task_1, task_2, task_3, task_4, task_5, task_6, task_7
+};
+
+static uint32_t latency_bound (uint8_t prio)
+{
+    uint32_t block = 0, higher = 0;
+    uint8_t i;
+
+    for (i = 0; i < SCHED_TASK_QTY; i++)
+    {
+        if ((i != prio) && (load[i].cost_us > block)){block = load[i].cost_us;}
+        if (i < prio){higher += load[i].cost_us;}
+    }
+    return US(block + higher);
+}
+
+static void test_replay (void)
+{
+    STRUCT_TIMER timebase;
+    uint32_t start, next, lat;
+    uint8_t i;
+
+    TEST_CHECK_EQ(SCHED_init(&timebase, TIMER_8), 1);
+    TEST_CHECK_EQ(HOST_timebase_freq, FCY);
+    HOST_timebase_now = 0xFFFFFFFFUL - US(3000000);      // Wraps during the replay
+    start = HOST_timebase_now;
+    for (i = 0; i < SCHED_TASK_QTY; i++)
+    {
+        TEST_CHECK_EQ(SCHED_task_init(&SCHED_task_struct[i], i, handler[i], load[i].period_us, load[i].period_us), 1);
+    }
+    isr_next = start + US(1234);
+
+    // main loop : dispatch, idle until the next release or ISR otherwise
+    while ((HOST_timebase_now - start) < (RUN_TIME_S * FCY))
+    {
+        if (SCHED_run() == 0)
+        {
+            next = SCHED_get_next_release();
+            TEST_CHECK(next != 0);
+            if ((int32_t)(isr_next - HOST_timebase_now) < (int32_t)next)
+            {
+                next = isr_next - HOST_timebase_now;
+            }
+            isr_until(HOST_timebase_now + next);
+            HOST_timebase_now += next;
+        }
+    }
+
+    printf("  %-12s %8s %6s %10s %10s %6s\n", "task", "period", "runs", "lat max us", "bound us", "miss");
+    for (i = 0; i < SCHED_TASK_QTY; i++)
+    {
+        lat = TIMER_timebase_ticks_to_us(SCHED_get_stat(i, SCHED_STAT_LATENCY_MAX));
+        printf("  %-12s %8lu %6lu %10lu %10lu %6lu\n", load[i].name, (unsigned long)load[i].period_us,
+               (unsigned long)SCHED_get_stat(i, SCHED_STAT_RUN_COUNT), (unsigned long)lat,
+               (unsigned long)TIMER_timebase_ticks_to_us(latency_bound(i)),
+               (unsigned long)SCHED_get_stat(i, SCHED_STAT_DEADLINE_MISS));
+
+        TEST_CHECK(SCHED_get_stat(i, SCHED_STAT_LATENCY_MAX) <= latency_bound(i));
+        TEST_CHECK(SCHED_get_stat(i, SCHED_STAT_RUN_TIME_MAX) <= US(load[i].cost_us));
+        TEST_CHECK_EQ(SCHED_get_stat(i, SCHED_STAT_DEADLINE_MISS), 0);
+        TEST_CHECK_EQ(SCHED_get_stat(i, SCHED_STAT_RELEASE_OVERRUN), 0);
+        TEST_CHECK_EQ(SCHED_get_stat(i, SCHED_STAT_RUN_COUNT), run_count[i]);
+        if (i != 2)
+        {
+            // Periodic only, one run per period
+            TEST_CHECK_NEAR(run_count[i], (RUN_TIME_S * 1000000UL) / load[i].period_us, 1);
+        }
+    }
+    // uart1_tx also runs on the posted events, several may merge into one run
+    TEST_CHECK(run_count[2] > (RUN_TIME_S * 1000000UL) / load[2].period_us);
+    TEST_CHECK(run_count[2] <= ((RUN_TIME_S * 1000000UL) / load[2].period_us) + isr_count);
+    TEST_CHECK(SCHED_get_stat(0, SCHED_STAT_LATENCY_MAX) < SCHED_get_stat(7, SCHED_STAT_LATENCY_MAX));
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+// A task slower than its period : lost releases are counted, phase is kept
+static void test_overload (void)
+{
+    STRUCT_TIMER timebase;
+    uint32_t release;
+    uint16_t n;
+
+    SCHED_init(&timebase, TIMER_8);
+    HOST_timebase_now = 0;
+    SCHED_task_init(&SCHED_task_struct[7], 7, task_7, 1000, 1000);     // 3.5ms run every 1ms
+    release = SCHED_task_struct[7].next_release;
+    for (n = 0; n < 100; n++)
+    {
+        if (SCHED_run() == 0)
+        {
+            HOST_timebase_now += SCHED_get_next_release();
+        }
+    }
+    TEST_CHECK(SCHED_get_stat(7, SCHED_STAT_RELEASE_OVERRUN) >= SCHED_get_stat(7, SCHED_STAT_RUN_COUNT) - 1);
+    TEST_CHECK(SCHED_get_stat(7, SCHED_STAT_DEADLINE_MISS) > 0);
+    TEST_CHECK_EQ((SCHED_task_struct[7].next_release - release) % US(1000), 0);
+}
+
+int main (void)
+{
+    test_replay();
+    test_overload();
+    return TEST_end("test_scheduler");
+}
@@ -0,0 +1,163 @@
+//****************************************************************************//
+// File      :  test_timer.c
+//
+// Includes  :  Timer.h, timer_sim.h, test.h
+//
+// Purpose   :  Expiry counting of Timer.c on simulated timers running faster
+//              than their consumer : every period counted by the ISR is
+//              either returned by TIMER_get_elapsed / TIMER_get_state or
+//              accumulated in the overrun counter, none is lost. Also the
+//              ticks to expiry and the 32-bit timebase
+//****************************************************************************//
+#include "Timer.h"
+#include "timer_sim.h"
+#include "test.h"
+
+extern STRUCT_TIMER TIMER_struct[TIMER_QTY];
+
+// Consumer reads every poll cycles, returns the periods it saw
+static uint32_t consume (STRUCT_TIMER *timer, uint32_t poll, uint32_t reads, uint8_t use_state, uint16_t *elapsed_max)
+{
+    uint32_t seen = 0, n;
+    uint16_t elapsed;
+
+    *elapsed_max = 0;
+    for (n = 0; n < reads; n++)
+    {
+        SIM_timer_run(poll);
+        if (use_state)
+        {
+            // Superloop style, one action per flag
+            if (TIMER_get_state(timer, TIMER_INT_STATE))
+            {
+                elapsed = TIMER_get_last_elapsed(timer);
+                TEST_CHECK(elapsed >= 1);
+            }
+            else
+            {
+                elapsed = 0;
+            }
+        }
+        else
+        {
+            elapsed = TIMER_get_elapsed(timer);
+        }
+        TEST_CHECK_EQ(timer->int_state, 0);
+        TEST_CHECK_EQ(timer->expiry_cnt, 0);
+        if (elapsed > *elapsed_max){*elapsed_max = elapsed;}
+        seen += elapsed;
+    }
+    return seen;
+}
+
+// TIMER_1 at 1kHz, read every 3.3ms and every 0.25ms
+static void test_overrun_16b (void)
+{
+    STRUCT_TIMER *timer = &TIMER_struct[TIMER_1];
+    uint32_t period, seen, expected;
+    uint16_t emax;
+
+    TEST_CHECK_EQ(TIMER_init(timer, TIMER_1, TIMER_MODE_16B, TIMER_PRESCALER_8, 1000), 1);
+    TEST_CHECK_EQ(PR1, (FCY / 8) / 1000);
+    period = (PR1 + 1UL) * 8;
+    TIMER_start(timer);
+    TEST_CHECK_EQ(TIMER_get_elapsed(timer), 0);
+
+    // Late consumer : 3 or 4 periods collapse into each read
+    seen = consume(timer, FCY / 300, 300, 0, &emax);
+    expected = ((FCY / 300) * 300) / period;
+    TEST_CHECK_EQ(seen, expected);
+    TEST_CHECK_EQ(emax, 4);
+    TEST_CHECK_EQ(TIMER_get_overrun(timer), seen - 300);
+    printf("  1kHz read at 300Hz : %lu periods, %lu missed\n", (unsigned long)seen, (unsigned long)TIMER_get_overrun(timer));
+
+    // Same through TIMER_get_state, the superloop reader of the projects
+    TIMER_clear_overrun(timer);
+    TEST_CHECK_EQ(TIMER_get_overrun(timer), 0);
+    seen = consume(timer, FCY / 300, 300, 1, &emax);
+    TEST_CHECK_NEAR(seen, 1000, 4);
+    TEST_CHECK_EQ(TIMER_get_overrun(timer), seen - 300);
+
+    // Fast consumer : never more than 1 period per read, no overrun
+    TIMER_clear_overrun(timer);
+    seen = consume(timer, FCY / 4000, 4000, 0, &emax);
+    TEST_CHECK_NEAR(seen, 1000, 1);
+    TEST_CHECK_EQ(emax, 1);
+    TEST_CHECK_EQ(TIMER_get_overrun(timer), 0);
+    TEST_CHECK_EQ(HOST_cpu_ipl, 0);
+}
+
+// 30Hz PID rate on the TIMER_2 / TIMER_3 pair, the consumer stalls for 200ms
+static void test_overrun_32b (void)
+{
+    STRUCT_TIMER *timer = &TIMER_struct[TIMER_2];
+    uint32_t seen;
+    uint16_t emax;
+
+    TEST_CHECK_EQ(TIMER_init(timer, TIMER_2, TIMER_MODE_32B, TIMER_PRESCALER_1, 30), 1);
+    TIMER_start(timer);
+    seen = consume(timer, FCY / 60, 60, 1, &emax);
+    TEST_CHECK_NEAR(seen, 30, 1);
+    TEST_CHECK_EQ(TIMER_get_overrun(timer), 0);
+
+    SIM_timer_run(FCY / 5);
+    TEST_CHECK_EQ(TIMER_get_elapsed(timer), 6);
+    TEST_CHECK_EQ(TIMER_get_last_elapsed(timer), 6);
+    TEST_CHECK_EQ(TIMER_get_overrun(timer), 5);
+    TEST_CHECK_EQ(TIMER_get_elapsed(timer), 0);
+    TEST_CHECK_EQ(TIMER_get_last_elapsed(timer), 6);
+    TIMER_stop(timer);
+}
+
+static void test_ticks_to_expiry (void)
+{
+    STRUCT_TIMER *timer = &TIMER_struct[TIMER_1];
+    uint32_t left;
+
+    TEST_CHECK_EQ(TIMER_init(timer, TIMER_1, TIMER_MODE_16B, TIMER_PRESCALER_8, 1000), 1);
+    TEST_CHECK_EQ(TIMER_get_ticks_to_expiry(timer), 0xFFFFFFFF);
+    TIMER_start(timer);
+    left = TIMER_get_ticks_to_expiry(timer);
+    TEST_CHECK_NEAR(left, FCY / 1000, 8);
+    SIM_timer_run(left / 2);
+    TEST_CHECK_NEAR(TIMER_get_ticks_to_expiry(timer), left / 2, 8);
+
+    // Pending expiry, masked ISR
+    HOST_cpu_ipl = 7;
+    SIM_timer_run(left);
+    TEST_CHECK_EQ(IFS0bits.T1IF, 1);
+    TEST_CHECK_EQ(TIMER_get_elapsed(timer), 0);
+    HOST_cpu_ipl = 0;
+    SIM_timer_irq();
+    TEST_CHECK_EQ(TIMER_get_ticks_to_expiry(timer), 0);
+    TEST_CHECK_EQ(TIMER_get_elapsed(timer), 1);
+    TIMER_stop(timer);
+}
+
+static void test_timebase (void)
+{
+    uint32_t t0, cycles0;
+
+    TEST_CHECK_EQ(TIMER_timebase_get(), 0);
+    TEST_CHECK_EQ(TIMER_timebase_init(&TIMER_struct[TIMER_8], TIMER_8, TIMER_PRESCALER_1), 1);
+    TEST_CHECK_EQ(TIMER_timebase_get_freq(), FCY);
+    t0 = TIMER_timebase_get();
+    cycles0 = SIM_timer_cycles;
+    SIM_timer_run(123456789);
+    TEST_CHECK_EQ(TIMER_timebase_get() - t0, SIM_timer_cycles - cycles0);
+    TEST_CHECK_EQ(TIMER_timebase_us_to_ticks(1000), FCY / 1000);
+    TEST_CHECK_EQ(TIMER_timebase_ticks_to_us(FCY), 1000000);
+
+    // 61s wrap-around
+    SIM_timer_run(0xFFFFFFFF);
+    TEST_CHECK_EQ(TIMER_timebase_get() - t0, 123456788);
+}
+
+int main (void)
+{
+    test_overrun_16b();
+    test_overrun_32b();
+    test_ticks_to_expiry();
+    test_timebase();
+    return TEST_end("test_timer");
+}
@@ -0,0 +1,128 @@
+//****************************************************************************//
+// File      :  prof_decode.c
+//
+// Includes  :  prof_decode.h
+//
+// Purpose   :  Linux decoder of the PROF_export() lines, see prof_decode.h
+//****************************************************************************//
+#include <stdio.h>
+#include <string.h>
+#include "prof_decode.h"
+
+void PROF_decode_init (STRUCT_PROF_DECODE *dec)
+{
+    memset(dec, 0, sizeof(STRUCT_PROF_DECODE));
+}
+
+// PROF <name> r=<region> n=<count> min=<cycles> avg=<cycles> max=<cycles>
+static int PROF_decode_region (STRUCT_PROF_DECODE *dec, const char *line)
+{
+    char name[PROF_DECODE_NAME_LENGTH];
+    unsigned region;
+    unsigned long count, min, avg, max;
+
+    if (sscanf(line, "PROF %15s r=%u n=%lu min=%lu avg=%lu max=%lu", name, &region, &count, &min, &avg, &max) != 6)
+    {
+        return -1;
+    }
+    if (region >= PROF_DECODE_REGION_QTY)
+    {
+        return -1;
+    }
+    strcpy(dec->region[region].name, name);
+    dec->region[region].count = count;
+    dec->region[region].min = min;
+    dec->region[region].avg = avg;
+    dec->region[region].max = max;
+    return 1;
+}
+
+// PROFR <region><E|X><8 hex> ...
+static int PROF_decode_records (STRUCT_PROF_DECODE *dec, const char *line)
+{
+    const char *p = line + 5;
+    unsigned region;
+    unsigned long timestamp;
+    char type;
+    int used;
+
+    while (*p == ' ')
+    {
+        if (sscanf(p, " %u%c%8lx%n", &region, &type, &timestamp, &used) != 3)
+        {
+            return -1;
+        }
+        if ((region >= PROF_DECODE_REGION_QTY) || ((type != 'E') && (type != 'X')) ||
+            (dec->record_count >= PROF_DECODE_RECORD_QTY))
+        {
+            return -1;
+        }
+        dec->record[dec->record_count].region = region;
+        dec->record[dec->record_count].type = (type == 'E') ? 0 : 1;
+        dec->record[dec->record_count].timestamp = timestamp;
+        dec->record_count++;
+        p += used;
+    }
+    return ((*p == 0) || (*p == '\r') || (*p == '\n')) ? 1 : -1;
+}
+
+// Returns 1 for a profiler line, 0 for other traffic, -1 for a malformed
+// profiler line. A PROFT line starts a new ring
+int PROF_decode_line (STRUCT_PROF_DECODE *dec, const char *line)
+{
+    unsigned long count, overhead, freq;
+
+    if (strncmp(line, "PROFT ", 6) == 0)
+    {
+        if (sscanf(line, "PROFT n=%lu ovh=%lu hz=%lu", &count, &overhead, &freq) != 3)
+        {
+            return -1;
+        }
+        dec->ring_count = count;
+        dec->overhead = overhead;
+        dec->freq = freq;
+        dec->record_count = 0;
+        return 1;
+    }
+    if (strncmp(line, "PROFR ", 6) == 0)
+    {
+        return PROF_decode_records(dec, line);
+    }
+    if (strncmp(line, "PROF ", 5) == 0)
+    {
+        return PROF_decode_region(dec, line);
+    }
+    return 0;
+}
+
+// Pairs each exit with the last entry of its region, oldest first. Exits 
+// whose entry was overwritten by the ring and entries still open at the
+// end of the ring are dropped. Returns the number of spans written
+uint16_t PROF_decode_spans (const STRUCT_PROF_DECODE *dec, STRUCT_PROF_SPAN *span, uint16_t max)
+{
+    uint32_t entry[PROF_DECODE_REGION_QTY];
+    uint8_t open[PROF_DECODE_REGION_QTY] = {0};
+    const STRUCT_PROF_DECODE_RECORD *rec;
+    uint32_t duration;
+    uint16_t i, n = 0;
+
+    for (i = 0; (i < dec->record_count) && (n < max); i++)
+    {
+        rec = &dec->record[i];
+        if (rec->type == 0)
+        {
+            entry[rec->region] = rec->timestamp;
+            open[rec->region] = 1;
+        }
+        else if (open[rec->region])
+        {
+            duration = rec->timestamp - entry[rec->region];
+            span[n].region = rec->region;
+            span[n].start = entry[rec->region];
+            span[n].duration = (duration > dec->overhead) ? (duration - dec->overhead) : 0;
+            open[rec->region] = 0;
+            n++;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,60 @@
+//****************************************************************************//
+// File      :  prof_decode.h
+//
+// Functions :  void PROF_decode_init (STRUCT_PROF_DECODE *dec);
+//              int PROF_decode_line (STRUCT_PROF_DECODE *dec, const char *line);
+//              uint16_t PROF_decode_spans (const STRUCT_PROF_DECODE *dec, 
+//                                          STRUCT_PROF_SPAN *span, uint16_t max);
+//
+// Includes  :  stdint.h
+//
+// Purpose   :  Linux decoder of the PROF_export() lines (format in 
+//              profiler.h). Lines are fed one at a time, other traffic on 
+//              the debug port is ignored. Spans pair each region exit with 
+//              its entry and remove the probe overhead
+//****************************************************************************//
+#ifndef __PROF_DECODE_H_
+#define __PROF_DECODE_H_
+#include <stdint.h>
+
+#define PROF_DECODE_REGION_QTY  32
+#define PROF_DECODE_RECORD_QTY  1024
+#define PROF_DECODE_NAME_LENGTH 16
+
+typedef struct
+{
+    char name[PROF_DECODE_NAME_LENGTH];     // Empty if no PROF line was seen
+    uint32_t count;
+    uint32_t min;
+    uint32_t avg;
+    uint32_t max;
+}STRUCT_PROF_DECODE_REGION;
+
+typedef struct
+{
+    uint8_t region;
+    uint8_t type;                           // 0 entry, 1 exit as PROF_RECORD_x
+    uint32_t timestamp;
+}STRUCT_PROF_DECODE_RECORD;
+
+typedef struct
+{
+    STRUCT_PROF_DECODE_REGION region[PROF_DECODE_REGION_QTY];
+    STRUCT_PROF_DECODE_RECORD record[PROF_DECODE_RECORD_QTY];
+    uint16_t record_count;
+    uint32_t ring_count;                    // From the PROFT line
+    uint32_t overhead;
+    uint32_t freq;
+}STRUCT_PROF_DECODE;
+
+typedef struct
+{
+    uint8_t region;
+    uint32_t start;                         // Entry timestamp
+    uint32_t duration;                      // Ticks, overhead removed
+}STRUCT_PROF_SPAN;
+
+void PROF_decode_init (STRUCT_PROF_DECODE *dec);
+int PROF_decode_line (STRUCT_PROF_DECODE *dec, const char *line);
+uint16_t PROF_decode_spans (const STRUCT_PROF_DECODE *dec, STRUCT_PROF_SPAN *span, uint16_t max);
+#endif
@@ -0,0 +1,55 @@
+//****************************************************************************//
+// File      :  prof_decode_main.c
+//
+// Includes  :  prof_decode.h
+//
+// Purpose   :  prof_decode tool : reads a debug port capture on stdin, prints
+//              the region statistics and every span of the ring
+//
+//              usage : prof_decode < capture.txt
+//****************************************************************************//
+#include <stdio.h>
+#include "prof_decode.h"
+
+static STRUCT_PROF_DECODE dec;
+static STRUCT_PROF_SPAN span[PROF_DECODE_RECORD_QTY];
+
+int main (void)
+{
+    char line[256];
+    unsigned long lineno = 0;
+    uint16_t i, n;
+    const char *name;
+
+    PROF_decode_init(&dec);
+    while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+        lineno++;
+        if (PROF_decode_line(&dec, line) < 0)
+        {
+            fprintf(stderr, "line %lu : malformed profiler line\n", lineno);
+        }
+    }
+
+    printf("%-16s %10s %10s %10s %10s\n", "region", "count", "min", "avg", "max");
+    for (i = 0; i < PROF_DECODE_REGION_QTY; i++)
+    {
+        if (dec.region[i].name[0] != 0)
+        {
+            printf("%-16s %10lu %10lu %10lu %10lu\n", dec.region[i].name, (unsigned long)dec.region[i].count,
+                   (unsigned long)dec.region[i].min, (unsigned long)dec.region[i].avg, (unsigned long)dec.region[i].max);
+        }
+    }
+
+    n = PROF_decode_spans(&dec, span, PROF_DECODE_RECORD_QTY);
+    printf("\nring : %u records, %u spans, overhead %lu ticks, timebase %lu Hz\n",
+           dec.record_count, n, (unsigned long)dec.overhead, (unsigned long)dec.freq);
+    printf("%-16s %12s %12s %12s\n", "region", "start", "ticks", "us");
+    for (i = 0; i < n; i++)
+    {
+        name = (dec.region[span[i].region].name[0] != 0) ? dec.region[span[i].region].name : "?";
+        printf("%-16s %12lu %12lu %12.3f\n", name, (unsigned long)span[i].start, (unsigned long)span[i].duration,
+               (dec.freq > 0) ? (span[i].duration * 1e6 / dec.freq) : 0.0);
+    }
+    return 0;
+}